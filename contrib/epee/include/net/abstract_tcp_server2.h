@@ -64,6 +64,8 @@
 #define MONERO_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_BATCH_MAX_COUNT 64 // queued chunks gathered into one write
+#define ABSTRACT_SERVER_SEND_BATCH_MAX_BYTES (128 * 1024)
 
 namespace epee
 {
@@ -146,6 +148,9 @@ namespace net_utils
     virtual bool release();
     //------------------------------------------------------
     bool do_send_chunk(byte_slice chunk); ///< will send (or queue) a part of data. internal use only
+    void start_write(); ///< writes a batch of queued chunks; m_send_que_lock must be held
+    void continue_write(const boost::system::error_code& e, size_t cb); ///< starts the next write once the out throttle admits the last one
+    void start_read(const boost::system::error_code& e, size_t bytes_transferred); ///< starts the next read once the in throttle admits the last one
 
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
@@ -162,6 +167,8 @@ namespace net_utils
 
     /// reset connection timeout timer and callback
     void reset_timer(boost::posix_time::milliseconds ms, bool add);
+    void wait_timer(const boost::shared_ptr<connection<t_protocol_handler>>& self);
+    void cancel_timer();
     boost::posix_time::milliseconds get_default_timeout();
     boost::posix_time::milliseconds get_timeout_from_bytes_read(size_t bytes);
 
@@ -193,6 +200,14 @@ namespace net_utils
     boost::mutex m_throttle_speed_out_mutex;
 
     boost::asio::deadline_timer m_timer;
+    // latest requested expiry: moving it later leaves the pending wait alone, which re-arms itself when it fires early
+    boost::posix_time::ptime m_timer_deadline;
+    bool m_timer_armed;
+    boost::mutex m_timer_lock;
+    boost::asio::deadline_timer m_throttle_timer_in;
+    boost::asio::deadline_timer m_throttle_timer_out;
+    size_t m_send_in_flight; // chunks at the front of m_send_que owned by the current write
+    bool m_send_active; // a write, or the throttle delay after one, is pending
     bool m_local;
     bool m_ready_to_close;
     std::string m_host;
@@ -236,6 +251,12 @@ namespace net_utils
 	const std::string port_ipv6 = "", const std::string address_ipv6 = "::", bool use_ipv6 = false, bool require_ipv4 = true,
 	ssl_options_t ssl_options = ssl_support_t::e_ssl_support_autodetect);
 
+    /// Accept IPv4 connections on one SO_REUSEPORT listener per worker thread,
+    /// each with its own io_service, so accepted connections stay on the thread
+    /// that accepted them. Must be called before init_server; returns false when
+    /// the platform or the server configuration cannot support it.
+    bool set_accept_sharding(bool enable);
+
     /// Run the server's io_service loop.
     bool run_server(size_t threads_count, bool wait = true, const boost::thread::attributes& attrs = boost::thread::attributes());
 
@@ -286,7 +307,8 @@ namespace net_utils
     long get_connections_count() const
     {
       assert(m_state != nullptr); // always set in constructor
-      auto connections_count = m_state->sock_count > 0 ? (m_state->sock_count - 1) : 0; // Socket count minus listening socket
+      const long listening = 1 + m_accept_shards_count; // one pending connection per listener
+      auto connections_count = m_state->sock_count > listening ? (m_state->sock_count - listening) : 0; // Socket count minus listening sockets
       return connections_count;
     }
 
@@ -349,12 +371,19 @@ namespace net_utils
     }
 
   private:
-    /// Run the server's io_service loop.
-    bool worker_thread();
+    struct accept_shard;
+
+    /// Run an io_service loop.
+    bool worker_thread(boost::asio::io_service& io_service);
     /// Handle completion of an asynchronous accept operation.
     void handle_accept_ipv4(const boost::system::error_code& e);
     void handle_accept_ipv6(const boost::system::error_code& e);
+    void handle_accept_shard(accept_shard* shard, const boost::system::error_code& e);
     void handle_accept(const boost::system::error_code& e, bool ipv6 = false);
+    template<class t_handler>
+    void accept_connection(const boost::system::error_code& e, boost::asio::ip::tcp::acceptor& acceptor, connection_ptr& new_connection, boost::asio::io_service& io_service, const t_handler& accept_handler);
+    /// Open up to count extra listeners on the bound IPv4 endpoint.
+    void start_accept_shards(size_t count);
 
     bool is_thread_worker();
 
@@ -373,6 +402,18 @@ namespace net_utils
     std::unique_ptr<worker> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
 
+    /// An IPv4 listener with its own io_service, run by a single thread.
+    struct accept_shard
+    {
+      accept_shard()
+        : acceptor(w.io_service)
+      {}
+
+      worker w;
+      boost::asio::ip::tcp::acceptor acceptor;
+      connection_ptr new_connection;
+    };
+
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
     boost::asio::ip::tcp::acceptor acceptor_ipv6;
@@ -401,6 +442,10 @@ namespace net_utils
 
     boost::mutex connections_mutex;
     std::set<connection_ptr> connections_;
+
+    bool m_accept_sharding;
+    std::vector<std::unique_ptr<accept_shard>> m_accept_shards; // guarded by m_threads_lock
+    std::atomic<long> m_accept_shards_count;
   }; // class <>boosted_tcp_server
 
 
@@ -76,6 +76,10 @@ namespace net_utils
     return *ptr;
   }
 
+#if defined(SO_REUSEPORT)
+  typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> reuse_port;
+#endif
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -105,6 +109,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_throttle_speed_in("speed_in", "throttle_speed_in"),
 		m_throttle_speed_out("speed_out", "throttle_speed_out"),
 		m_timer(GET_IO_SERVICE(socket_)),
+		m_timer_armed(false),
+		m_throttle_timer_in(GET_IO_SERVICE(socket_)),
+		m_throttle_timer_out(GET_IO_SERVICE(socket_)),
+		m_send_in_flight(0),
+		m_send_active(false),
 		m_local(false),
 		m_ready_to_close(false)
   {
@@ -351,26 +360,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred);
 		}
 
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
-
-
-		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-					CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred );
-				}
-				
-				delay *= 0.5;
-				long int ms = (long int)(delay * 100);
-				if (ms > 0) {
-					reset_timer(boost::posix_time::milliseconds(ms + 1), true);
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
-				}
-			} while(delay > 0);
-		} // any form of sleeping
-		
+		// speed limit is obeyed by delaying the next read in start_read, not by sleeping here
+
       //_info("[sock " << socket().native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
       context.m_last_recv = time(NULL);
@@ -392,11 +383,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       }else
       {
         reset_timer(get_timeout_from_bytes_read(bytes_transferred), false);
-        async_read_some(boost::asio::buffer(buffer_),
-          strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
-              boost::asio::placeholders::error,
-              boost::asio::placeholders::bytes_transferred)));
+        start_read(boost::system::error_code(), bytes_transferred);
         //_info("[sock " << socket().native_handle() << "]Async read requested.");
       }
     }else
@@ -428,6 +415,34 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_read(const boost::system::error_code& e, size_t bytes_transferred)
+  {
+    TRY_ENTRY();
+    if (e || m_was_shutdown)
+      return;
+
+    if (speed_limit_is_enabled())
+    {
+      const long ms = get_throttle_in_delay_ms(bytes_transferred);
+      if (ms > 0)
+      {
+        reset_timer(boost::posix_time::milliseconds(ms + 1), true);
+        m_throttle_timer_in.expires_from_now(boost::posix_time::milliseconds(ms));
+        m_throttle_timer_in.async_wait(strand_.wrap(
+          boost::bind(&connection<t_protocol_handler>::start_read, connection<t_protocol_handler>::shared_from_this(), _1, bytes_transferred)));
+        return;
+      }
+    }
+
+    async_read_some(boost::asio::buffer(buffer_),
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
+          boost::asio::placeholders::error,
+          boost::asio::placeholders::bytes_transferred)));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::start_read", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void connection<t_protocol_handler>::handle_receive(const boost::system::error_code& e,
     std::size_t bytes_transferred)
   {
@@ -662,11 +677,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     m_send_que.push_back(std::move(chunk));
 
-    if(m_send_que.size() > 1)
+    if(m_send_active)
     { // active operation should be in progress, nothing to do, just wait last operation callback
         auto size_now = m_send_que.back().size();
         MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
       
       LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
     }
@@ -679,21 +693,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
             return false;
         }
 
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+        MDEBUG("do_send_chunk() NOW SENDS: packet="<<m_send_que.front().size()<<" B");
         if (speed_limit_is_enabled())
 			do_send_handler_write( m_send_que.back().data(), m_send_que.back().size() ); // (((H)))
 
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
-        reset_timer(get_default_timeout(), false);
-            async_write(boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 )
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+        start_write();
     }
     
     //do_send_handler_stop( ptr , cb ); // empty function
@@ -704,6 +708,34 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write()
+  {
+    // gather the queued chunks into one vectored write, so a burst of small
+    // messages costs one write (and one completion) instead of one per chunk
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t size_now = 0;
+    for (const byte_slice& chunk: m_send_que)
+    {
+      if (buffers.size() >= ABSTRACT_SERVER_SEND_BATCH_MAX_COUNT)
+        break;
+      if (!buffers.empty() && size_now + chunk.size() > ABSTRACT_SERVER_SEND_BATCH_MAX_BYTES)
+        break;
+      buffers.emplace_back(chunk.data(), chunk.size());
+      size_now += chunk.size();
+    }
+    m_send_in_flight = buffers.size();
+    m_send_active = true;
+    MDEBUG("start_write() NOW SENDS: " << m_send_in_flight << " chunks, " << size_now << " B, from queue size=" << m_send_que.size());
+
+    reset_timer(get_default_timeout(), false);
+    async_write(buffers,
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
+      )
+    );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
   {
     unsigned count;
@@ -721,7 +753,12 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_timeout_from_bytes_read(size_t bytes)
   {
     boost::posix_time::milliseconds ms = (boost::posix_time::milliseconds)(unsigned)(bytes * TIMEOUT_EXTRA_MS_PER_BYTE);
-    const auto cur = m_timer.expires_from_now().total_milliseconds();
+    long long cur = 0;
+    {
+      CRITICAL_REGION_LOCAL(m_timer_lock);
+      if (m_timer_armed)
+        cur = (m_timer_deadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+    }
     if (cur > 0)
       ms += (boost::posix_time::milliseconds)cur;
     if (ms > get_default_timeout())
@@ -766,23 +803,53 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       MERROR("Setting timer on a shut down object");
       return;
     }
-    if (add)
-    {
-      const auto cur = m_timer.expires_from_now().total_milliseconds();
-      if (cur > 0)
-        ms += (boost::posix_time::milliseconds)cur;
-    }
-    m_timer.expires_from_now(ms);
-    m_timer.async_wait([=](const boost::system::error_code& ec)
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    CRITICAL_REGION_LOCAL(m_timer_lock);
+    if (add && m_timer_armed && m_timer_deadline > now)
+      ms += (boost::posix_time::milliseconds)(m_timer_deadline - now).total_milliseconds();
+    m_timer_deadline = now + ms;
+    // every read and write pushes the deadline back; leave a wait that expires
+    // sooner in place rather than cancel it, and let it re-arm for the rest
+    if (m_timer_armed && m_timer.expires_at() <= m_timer_deadline)
+      return;
+    m_timer_armed = true;
+    m_timer.expires_at(m_timer_deadline);
+    wait_timer(self);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::wait_timer(const boost::shared_ptr<connection<t_protocol_handler>>& self)
+  {
+    m_timer.async_wait([this, self](const boost::system::error_code& ec)
     {
       if(ec == boost::asio::error::operation_aborted)
         return;
+      {
+        CRITICAL_REGION_LOCAL(m_timer_lock);
+        if (!m_timer_armed)
+          return;
+        if (m_timer_deadline > m_timer.expires_at())
+        {
+          m_timer.expires_at(m_timer_deadline);
+          wait_timer(self);
+          return;
+        }
+        m_timer_armed = false;
+      }
       MDEBUG(context << "connection timeout, closing");
       self->close();
     });
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::cancel_timer()
+  {
+    CRITICAL_REGION_LOCAL(m_timer_lock);
+    m_timer_armed = false;
+    m_timer.cancel();
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool connection<t_protocol_handler>::shutdown()
   {
     CRITICAL_REGION_BEGIN(m_shutdown_lock);
@@ -790,7 +857,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return true;
     m_was_shutdown = true;
     // Initiate graceful connection closure.
-    m_timer.cancel();
+    cancel_timer();
+    m_throttle_timer_in.cancel();
+    m_throttle_timer_out.cancel();
     boost::system::error_code ignored_ec;
     if (m_ssl_support == epee::net_utils::ssl_support_t::e_ssl_support_enabled)
     {
@@ -817,7 +886,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     if(!self)
       return false;
     //_info("[sock " << socket().native_handle() << "] Que Shutdown called.");
-    m_timer.cancel();
+    cancel_timer();
     size_t send_que_size = 0;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     send_que_size = m_send_que.size();
@@ -861,22 +930,46 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }
     logger_handle_net_write(cb);
 
-                // The single sleeping that is needed for correctly handling "out" speed throttling
-		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
-		}
-
-    bool do_shutdown = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
-    if(m_send_que.empty())
+    if(m_send_que.size() < m_send_in_flight)
     {
-      _erro("[sock " << socket().native_handle() << "] m_send_que.size() == 0 at handle_write!");
+      _erro("[sock " << socket().native_handle() << "] m_send_que.size() < " << m_send_in_flight << " at handle_write!");
       return;
     }
+    m_send_que.erase(m_send_que.begin(), m_send_que.begin() + m_send_in_flight);
+    m_send_in_flight = 0;
+    CRITICAL_REGION_END();
 
-    m_send_que.pop_front();
+    continue_write(e, cb);
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write", void());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::continue_write(const boost::system::error_code& e, size_t cb)
+  {
+    TRY_ENTRY();
+    if (e || m_was_shutdown)
+      return;
+
+    // out speed throttling: the next write waits on a timer until the last one fits the limit
+    if (speed_limit_is_enabled())
+    {
+      const long ms = get_throttle_out_delay_ms(cb);
+      if (ms > 0)
+      {
+        reset_timer(boost::posix_time::milliseconds(ms), true);
+        m_throttle_timer_out.expires_from_now(boost::posix_time::milliseconds(ms));
+        m_throttle_timer_out.async_wait(strand_.wrap(
+          boost::bind(&connection<t_protocol_handler>::continue_write, connection<t_protocol_handler>::shared_from_this(), _1, cb)));
+        return;
+      }
+    }
+
+    bool do_shutdown = false;
+    CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
     {
+      m_send_active = false;
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
       {
         do_shutdown = true;
@@ -884,18 +977,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
-		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
-		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		  async_write(boost::asio::buffer(m_send_que.front().data(), size_now) , 
-           strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-			  )
-          );
-      //_dbg3("(normal)" << size_now);
+      if (speed_limit_is_enabled())
+        do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
+      start_write();
     }
     CRITICAL_REGION_END();
 
@@ -903,7 +987,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     {
       shutdown();
     }
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write", void());
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::continue_write", void());
   }
 
   //---------------------------------------------------------------------------------
@@ -937,7 +1021,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_thread_index(0),
 		m_connection_type( connection_type ),
     new_connection_(),
-    new_connection_ipv6()
+    new_connection_ipv6(),
+    m_accept_sharding(false),
+    m_accept_shards_count(0)
   {
     create_server_type_map();
     m_thread_name_prefix = "NET";
@@ -955,7 +1041,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_thread_index(0),
 		m_connection_type(connection_type),
     new_connection_(),
-    new_connection_ipv6()
+    new_connection_ipv6(),
+    m_accept_sharding(false),
+    m_accept_shards_count(0)
   {
     create_server_type_map();
     m_thread_name_prefix = "NET";
@@ -1003,6 +1091,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       acceptor_.open(endpoint.protocol());
 #if !defined(_WIN32)
       acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+#endif
+#if defined(SO_REUSEPORT)
+      if (m_accept_sharding)
+        acceptor_.set_option(reuse_port(true));
 #endif
       acceptor_.bind(endpoint);
       acceptor_.listen();
@@ -1104,7 +1196,7 @@ DISABLE_GCC_WARNING(maybe-uninitialized)
 POP_WARNINGS
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool boosted_tcp_server<t_protocol_handler>::worker_thread()
+  bool boosted_tcp_server<t_protocol_handler>::worker_thread(boost::asio::io_service& io_service)
   {
     TRY_ENTRY();
     uint32_t local_thr_index = boost::interprocess::ipcdetail::atomic_inc32(&m_thread_index); 
@@ -1116,7 +1208,7 @@ POP_WARNINGS
     {
       try
       {
-        io_service_.run();
+        io_service.run();
         return true;
       }
       catch(const std::exception& ex)
@@ -1151,24 +1243,92 @@ POP_WARNINGS
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::set_accept_sharding(bool enable)
+  {
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+    if (enable && !m_io_service_local_instance)
+    {
+      MWARNING("Accept sharding needs a server owning its io_service, using a single listener");
+      return false;
+    }
+    m_accept_sharding = enable;
+    return true;
+#else
+    if (enable)
+    {
+      MWARNING("SO_REUSEPORT is not supported on this platform, using a single listener");
+      return false;
+    }
+    return true;
+#endif
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::start_accept_shards(size_t count)
+  {
+#if defined(SO_REUSEPORT)
+    CRITICAL_REGION_LOCAL(m_threads_lock);
+    const boost::asio::ip::tcp::endpoint endpoint = acceptor_.local_endpoint();
+    while (m_accept_shards.size() < count)
+    {
+      try
+      {
+        std::unique_ptr<accept_shard> shard(new accept_shard());
+        shard->acceptor.open(endpoint.protocol());
+        shard->acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+        shard->acceptor.set_option(reuse_port(true));
+        shard->acceptor.bind(endpoint);
+        shard->acceptor.listen();
+        shard->new_connection.reset(new connection<t_protocol_handler>(shard->w.io_service, m_state, m_connection_type, m_state->ssl_options().support));
+        shard->acceptor.async_accept(shard->new_connection->socket(),
+          boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_shard, this, shard.get(),
+            boost::asio::placeholders::error));
+        m_accept_shards.push_back(std::move(shard));
+        ++m_accept_shards_count;
+      }
+      catch (const std::exception &e)
+      {
+        MWARNING("Failed to open SO_REUSEPORT listener on " << endpoint << ": " << e.what());
+        break;
+      }
+    }
+    MINFO("Accepting IPv4 connections on " << (m_accept_shards.size() + 1) << " SO_REUSEPORT listeners");
+#endif
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool boosted_tcp_server<t_protocol_handler>::run_server(size_t threads_count, bool wait, const boost::thread::attributes& attrs)
   {
     TRY_ENTRY();
     m_threads_count = threads_count;
     m_main_thread_id = boost::this_thread::get_id();
     MLOG_SET_THREAD_NAME("[SRV_MAIN]");
+
+    // in sharded mode every extra thread gets its own listener and io_service;
+    // the shared io_service keeps one thread for the main listener, IPv6 and
+    // outgoing connections
+    if (m_accept_sharding && threads_count > 1 && acceptor_.is_open())
+      start_accept_shards(threads_count - 1);
+
     while(!m_stop_signal_sent)
     {
 
       // Create a pool of threads to run all of the io_services.
       CRITICAL_REGION_BEGIN(m_threads_lock);
-      for (std::size_t i = 0; i < threads_count; ++i)
+      const size_t shared_threads = threads_count > m_accept_shards.size() ? threads_count - m_accept_shards.size() : 1;
+      for (std::size_t i = 0; i < shared_threads; ++i)
       {
         boost::shared_ptr<boost::thread> thread(new boost::thread(
-          attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this)));
+          attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this, boost::ref(io_service_))));
           _note("Run server thread name: " << m_thread_name_prefix);
         m_threads.push_back(thread);
       }
+      for (auto &shard: m_accept_shards)
+      {
+        boost::shared_ptr<boost::thread> thread(new boost::thread(
+          attrs, boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this, boost::ref(shard->w.io_service))));
+        m_threads.push_back(thread);
+      }
       CRITICAL_REGION_END();
       // Wait for all threads in the pool to exit.
       if (wait)
@@ -1253,6 +1413,10 @@ POP_WARNINGS
     connections_.clear();
     connections_mutex.unlock();
     io_service_.stop();
+    CRITICAL_REGION_BEGIN(m_threads_lock);
+    for (auto &shard: m_accept_shards)
+      shard->w.io_service.stop();
+    CRITICAL_REGION_END();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
@@ -1269,19 +1433,35 @@ POP_WARNINGS
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::handle_accept_shard(accept_shard* shard, const boost::system::error_code& e)
+  {
+    MDEBUG("handle_accept (shard)");
+    this->accept_connection(e, shard->acceptor, shard->new_connection, shard->w.io_service,
+      boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_shard, this, shard,
+        boost::asio::placeholders::error));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void boosted_tcp_server<t_protocol_handler>::handle_accept(const boost::system::error_code& e, bool ipv6)
   {
     MDEBUG("handle_accept");
 
-    boost::asio::ip::tcp::acceptor* current_acceptor = &acceptor_;
-    connection_ptr* current_new_connection = &new_connection_;
-    auto accept_function_pointer = &boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4;
     if (ipv6)
-    {
-      current_acceptor = &acceptor_ipv6;
-      current_new_connection = &new_connection_ipv6;
-      accept_function_pointer = &boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6;
-    }
+      this->accept_connection(e, acceptor_ipv6, new_connection_ipv6, io_service_,
+        boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6, this,
+          boost::asio::placeholders::error));
+    else
+      this->accept_connection(e, acceptor_, new_connection_, io_service_,
+        boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4, this,
+          boost::asio::placeholders::error));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  template<class t_handler>
+  void boosted_tcp_server<t_protocol_handler>::accept_connection(const boost::system::error_code& e, boost::asio::ip::tcp::acceptor& acceptor, connection_ptr& new_connection, boost::asio::io_service& io_service, const t_handler& accept_handler)
+  {
+    boost::asio::ip::tcp::acceptor* current_acceptor = &acceptor;
+    connection_ptr* current_new_connection = &new_connection;
 
     try
     {
@@ -1299,10 +1479,8 @@ POP_WARNINGS
         (*current_new_connection)->setRpcStation(); // hopefully this is not needed actually
       }
       connection_ptr conn(std::move((*current_new_connection)));
-      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, conn->get_ssl_support()));
-      current_acceptor->async_accept((*current_new_connection)->socket(),
-          boost::bind(accept_function_pointer, this,
-            boost::asio::placeholders::error));
+      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, conn->get_ssl_support()));
+      current_acceptor->async_accept((*current_new_connection)->socket(), accept_handler);
 
       boost::asio::socket_base::keep_alive opt(true);
       conn->socket().set_option(opt);
@@ -1334,10 +1512,8 @@ POP_WARNINGS
     assert(m_state != nullptr); // always set in constructor
     _erro("Some problems at accept: " << e.message() << ", connections_count = " << m_state->sock_count);
     misc_utils::sleep_no_w(100);
-    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
-    current_acceptor->async_accept((*current_new_connection)->socket(),
-        boost::bind(accept_function_pointer, this,
-          boost::asio::placeholders::error));
+    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
+    current_acceptor->async_accept((*current_new_connection)->socket(), accept_handler);
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
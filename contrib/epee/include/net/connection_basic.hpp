@@ -184,7 +184,8 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static int get_tos_flag();
 
 		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		long get_throttle_out_delay_ms(size_t packet_size); ///< 0 once the global out limit admits packet_size, which is then accounted; otherwise how long to wait before asking again
+		static long get_throttle_in_delay_ms(size_t packet_size); ///< how long to wait before reading more, 0 if under the global in limit
 		static void save_limit_to_file(int limit); ///< for dr-monero
 		static double get_sleep_time(size_t cb);
 };
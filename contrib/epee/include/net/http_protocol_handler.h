@@ -36,6 +36,7 @@
 #include "to_nonconst_iterator.h"
 #include "http_auth.h"
 #include "http_base.h"
+#include "syncobj.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.http"
@@ -116,8 +117,8 @@ namespace net_utils
 			bool analize_cached_request_header_and_invoke_state(size_t pos);
 
 			bool handle_invoke_query_line();
-			bool parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos);
-			std::string::size_type match_end_of_header(const std::string& buf);
+			bool parse_cached_header(http_header_info& body_info, const char* begin, const char* end);
+			std::string::size_type match_end_of_header();
 			bool get_len_from_content_lenght(const std::string& str, size_t& len);
 			bool handle_retriving_query_body();
 			bool handle_query_measure();
@@ -142,6 +143,8 @@ namespace net_utils
 			config_type& m_config;
 			bool m_want_close;
 			size_t m_newlines;
+			size_t m_cache_pos; // start of the unconsumed part of m_cache
+			size_t m_header_scan_pos; // header bytes past m_cache_pos already searched for the terminator
 		protected:
 			i_service_endpoint* m_psnd_hndlr; 
 			t_connection_context& m_conn_context;
@@ -25,10 +25,11 @@
 // 
 
 
-#include <boost/regex.hpp>
+#include <algorithm>
+#include <cctype>
+#include <limits>
 #include <boost/lexical_cast.hpp>
 #include "http_protocol_handler.h"
-#include "reg_exp_definer.h"
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "net_parse_helpers.h"
@@ -56,15 +57,32 @@ namespace net_utils
 			std::string m_body;
 		};
 
+		inline bool iequals_token(const char* begin, const char* end, const char* token)
+		{
+			for(; begin != end; ++begin, ++token)
+			{
+				if(!*token || std::tolower(static_cast<unsigned char>(*begin)) != std::tolower(static_cast<unsigned char>(*token)))
+					return false;
+			}
+			return !*token;
+		}
+
 		inline
 			bool match_boundary(const std::string& content_type, std::string& boundary)
 		{
-			STATIC_REGEXP_EXPR_1(rexp_match_boundary, "boundary=(.*?)(($)|([;\\s,]))", boost::regex::icase | boost::regex::normal);
-			//											        1
-			boost::smatch result;	
-			if(boost::regex_search(content_type, result, rexp_match_boundary, boost::match_default) && result[0].matched)
+			static const char key[] = "boundary=";
+			const size_t key_len = sizeof(key) - 1;
+			for(size_t pos = 0; pos + key_len <= content_type.size(); ++pos)
 			{
-				boundary = result[1];
+				const char* begin = content_type.data() + pos;
+				if(!iequals_token(begin, begin + key_len, key))
+					continue;
+				//the value runs up to the first separator, or to the end of the field
+				const size_t value_begin = pos + key_len;
+				size_t value_end = content_type.find_first_of("; \t\r\n\v\f,", value_begin);
+				if(std::string::npos == value_end)
+					value_end = content_type.size();
+				boundary.assign(content_type, value_begin, value_end - value_begin);
 				return true;
 			}
 
@@ -74,36 +92,46 @@ namespace net_utils
 		inline 
 			bool parse_header(std::string::const_iterator it_begin, std::string::const_iterator it_end, multipart_entry& entry)
 		{
-			STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-				"\n?((Content-Disposition)|(Content-Type)"
-				//  12                     3 
-				"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-				//4               56    7 
-				boost::regex::icase | boost::regex::normal);
-
-			boost::smatch		result;
-			std::string::const_iterator it_current_bound = it_begin;
-			std::string::const_iterator it_end_bound = it_end;
-
 			//lookup all fields and fill well-known fields
-			while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
+			std::string::const_iterator it_line = it_begin;
+			while(it_line != it_end)
 			{
-				const size_t field_val = 6;
-				const size_t field_etc_name = 4;
-
-				int i = 2; //start position = 2
-				if(result[i++].matched)//"Content-Disposition"
-					entry.m_content_disposition = result[field_val];
-				else if(result[i++].matched)//"Content-Type"
-					entry.m_content_type = result[field_val];
-				else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-					entry.m_etc_header_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-				else
+				std::string::const_iterator it_eol = std::find(it_line, it_end, '\n');
+				std::string::const_iterator it_line_end = it_eol;
+				if(it_line_end != it_line && *(it_line_end - 1) == '\r')
+					--it_line_end;
+				std::string::const_iterator it_next = it_eol == it_end ? it_end : it_eol + 1;
+
+				if(it_line == it_line_end)
+				{
+					it_line = it_next;
+					continue;
+				}
+
+				std::string::const_iterator it_colon = std::find(it_line, it_line_end, ':');
+				std::string::const_iterator it_name_end = it_colon;
+				if(it_name_end != it_line && *(it_name_end - 1) == ' ')
+					--it_name_end;
+				if(it_colon == it_line_end || it_name_end == it_line)
 				{
-					LOG_ERROR("simple_http_connection_handler::parse_header() not matched last entry in:"<<std::string(it_current_bound, it_end));
+					LOG_ERROR("simple_http_connection_handler::parse_header() not matched last entry in:"<<std::string(it_line, it_end));
+					return true;
 				}
 
-				it_current_bound = result[(int)result.size()-1].first;
+				std::string::const_iterator it_value = it_colon + 1;
+				if(it_value != it_line_end && *it_value == ' ')
+					++it_value;
+
+				const char* name_begin = &*it_line;
+				const char* name_end = name_begin + (it_name_end - it_line);
+				if(iequals_token(name_begin, name_end, "Content-Disposition"))
+					entry.m_content_disposition.assign(it_value, it_line_end);
+				else if(iequals_token(name_begin, name_end, "Content-Type"))
+					entry.m_content_type.assign(it_value, it_line_end);
+				else
+					entry.m_etc_header_fields.push_back(std::pair<std::string, std::string>(std::string(it_line, it_name_end), std::string(it_value, it_line_end)));
+
+				it_line = it_next;
 			}
 			return  true;
 		}
@@ -206,6 +234,8 @@ namespace net_utils
 		m_config(config),
 		m_want_close(false),
 		m_newlines(0),
+		m_cache_pos(0),
+		m_header_scan_pos(0),
 		m_psnd_hndlr(psnd_hndlr),
 		m_conn_context(conn_context)
 	{
@@ -221,6 +251,7 @@ namespace net_utils
 		m_query_info.clear();
 		m_len_summary = 0;
 		m_newlines = 0;
+		m_header_scan_pos = 0;
 		return true;
 	}
 	//--------------------------------------------------------------------------------------------
@@ -243,6 +274,8 @@ namespace net_utils
 
 		size_t ndel;
 
+		//everything before m_cache_pos is already consumed, it's only dropped once
+		//we run out of complete input, so pipelined requests are not erase()d one by one
 		if(m_cache.size())
 			m_cache += buf;
 		else
@@ -256,32 +289,32 @@ namespace net_utils
 			case http_state_retriving_comand_line:
 				//The HTTP protocol does not place any a priori limit on the length of a URI.  (c)RFC2616
 				//but we forebly restirct it len to HTTP_MAX_URI_LEN to make it more safely
-				if(!m_cache.size())
+				if(m_cache_pos == m_cache.size())
 					break;
 
 				//check_and_handle_fake_response();
-				ndel = m_cache.find_first_not_of("\r\n");
-				if (ndel != 0)
+				ndel = m_cache.find_first_not_of("\r\n", m_cache_pos);
+				if (ndel != m_cache_pos)
 				{
           //some times it could be that before query line cold be few line breaks
           //so we have to be calm without panic with assers
-					m_newlines += std::string::npos == ndel ? m_cache.size() : ndel;
+					m_newlines += std::string::npos == ndel ? m_cache.size() - m_cache_pos : ndel - m_cache_pos;
 					if (m_newlines > HTTP_MAX_STARTING_NEWLINES)
 					{
 						LOG_ERROR("simple_http_connection_handler::handle_buff_out: Too many starting newlines");
 						m_state = http_state_error;
 						return false;
 					}
-					m_cache.erase(0, ndel);
+					m_cache_pos = std::string::npos == ndel ? m_cache.size() : ndel;
 					break;
 				}
 
-				if(std::string::npos != m_cache.find('\n', 0))
+				if(std::string::npos != m_cache.find('\n', m_cache_pos))
 					handle_invoke_query_line();
 				else
 				{
 					m_is_stop_handling = true;
-					if(m_cache.size() > HTTP_MAX_URI_LEN)
+					if(m_cache.size() - m_cache_pos > HTTP_MAX_URI_LEN)
 					{
 						LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler::handle_buff_out: Too long URI line");
 						m_state = http_state_error;
@@ -291,11 +324,11 @@ namespace net_utils
 				break;
 			case http_state_retriving_header:
 				{
-					std::string::size_type pos = match_end_of_header(m_cache);
+					std::string::size_type pos = match_end_of_header();
 					if(std::string::npos == pos)
 					{
 						m_is_stop_handling = true;
-						if(m_cache.size() > HTTP_MAX_HEADER_LEN)
+						if(m_cache.size() - m_cache_pos > HTTP_MAX_HEADER_LEN)
 						{
 							LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler::handle_buff_in: Too long header area");
 							m_state = http_state_error;
@@ -308,7 +341,9 @@ namespace net_utils
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				if (!handle_retriving_query_body())
+					return false;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -319,34 +354,75 @@ namespace net_utils
 				return false;
 			}
 
-			if(!m_cache.size())
+			if(m_cache_pos == m_cache.size())
 				m_is_stop_handling = true;
 		}
 
+		if(m_cache_pos == m_cache.size())
+			m_cache.clear();
+		else
+			m_cache.erase(0, m_cache_pos);
+		m_cache_pos = 0;
 		return true;
 	}
 	//--------------------------------------------------------------------------------------------
-	inline bool analize_http_method(const boost::smatch& result, http::http_method& method, int& http_ver_major, int& http_ver_minor)
+	inline bool parse_http_version_number(const char*& it, const char* end, int& number)
 	{
-		CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-		if (!boost::conversion::try_lexical_convert<int>(result[11], http_ver_major))
+		const char* start = it;
+		number = 0;
+		for(; it != end && std::isdigit(static_cast<unsigned char>(*it)); ++it)
+		{
+			if(it - start >= 4)
+				return false;
+			number = number * 10 + (*it - '0');
+		}
+		return it != start;
+	}
+	//--------------------------------------------------------------------------------------------
+	//parses "METHOD SP URI SP HTTP/major.minor" (without the line break)
+	inline bool analize_http_method(const char* begin, const char* end, http::http_request_info& query_info)
+	{
+		const char* method_end = std::find(begin, end, ' ');
+		if(method_end == end)
 			return false;
-		if (!boost::conversion::try_lexical_convert<int>(result[12], http_ver_minor))
+
+		if(iequals_token(begin, method_end, "OPTIONS"))
+			query_info.m_http_method = http::http_method_options;
+		else if(iequals_token(begin, method_end, "GET"))
+			query_info.m_http_method = http::http_method_get;
+		else if(iequals_token(begin, method_end, "HEAD"))
+			query_info.m_http_method = http::http_method_head;
+		else if(iequals_token(begin, method_end, "POST"))
+			query_info.m_http_method = http::http_method_post;
+		else if(iequals_token(begin, method_end, "PUT"))
+			query_info.m_http_method = http::http_method_put;
+		else if(iequals_token(begin, method_end, "DELETE") || iequals_token(begin, method_end, "TRACE"))
+			query_info.m_http_method = http::http_method_etc;
+		else
 			return false;
 
-		if(result[3].matched)
-			method = http::http_method_options;
-		else if(result[4].matched)
-			method = http::http_method_get;
-		else if(result[5].matched)
-			method = http::http_method_head;
-		else if(result[6].matched)
-			method = http::http_method_post;
-		else if(result[7].matched)
-			method = http::http_method_put;
-		else 
-			method = http::http_method_etc;
+		const char* uri = method_end + 1;
+		const char* uri_end = uri;
+		while(uri_end != end && !std::isspace(static_cast<unsigned char>(*uri_end)))
+			++uri_end;
+		if(uri_end == uri || uri_end == end || *uri_end != ' ')
+			return false;
+
+		const char* it = uri_end + 1;
+		if(end - it < 5 || !iequals_token(it, it + 5, "HTTP/"))
+			return false;
+		it += 5;
+		if(!parse_http_version_number(it, end, query_info.m_http_ver_hi))
+			return false;
+		if(it == end || *it++ != '.')
+			return false;
+		if(!parse_http_version_number(it, end, query_info.m_http_ver_lo))
+			return false;
+		if(it != end)
+			return false;
 
+		query_info.m_http_method_str.assign(begin, method_end);
+		query_info.m_URI.assign(uri, uri_end);
 		return true;
 	}
 
@@ -354,29 +430,25 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
 	{ 
-		STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+)\\.(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-		//											    123         4     5      6      7     8        9        10          11     12    
-		//size_t match_len = 0;
-		boost::smatch result;	
-		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
+		const std::string::size_type eol = m_cache.find('\n', m_cache_pos);
+		CHECK_AND_ASSERT_MES(eol != std::string::npos, false, "simple_http_connection_handler::handle_invoke_query_line() called without a full line");
+		const char* begin = m_cache.data() + m_cache_pos;
+		const char* end = m_cache.data() + eol;
+		if(end != begin && end[-1] == '\r')
+			--end;
+
+		if(analize_http_method(begin, end, m_query_info))
 		{
-			if (!analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi))
-			{
-				m_state = http_state_error;
-				MERROR("Failed to analyze method");
-				return false;
-			}
-			m_query_info.m_URI = result[10];
 			if (!parse_uri(m_query_info.m_URI, m_query_info.m_uri_content))
 			{
 				m_state = http_state_error;
 				MERROR("Failed to parse URI: m_query_info.m_URI");
 				return false;
 			}
-			m_query_info.m_http_method_str = result[2];
-			m_query_info.m_full_request_str = result[0];
+			m_query_info.m_full_request_str.assign(m_cache, m_cache_pos, eol + 1 - m_cache_pos);
 
-			m_cache.erase(m_cache.begin(),  to_nonsonst_iterator(m_cache, result[0].second));
+			m_cache_pos = eol + 1;
+			m_header_scan_pos = 0;
 
 			m_state = http_state_retriving_header;
 
@@ -384,7 +456,7 @@ namespace net_utils
 		}else
 		{
 			m_state = http_state_error;
-			LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << m_cache);
+			LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << std::string(begin, end));
 			return false;
 		}
 
@@ -392,37 +464,44 @@ namespace net_utils
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	std::string::size_type simple_http_connection_handler<t_connection_context>::match_end_of_header(const std::string& buf)
+	std::string::size_type simple_http_connection_handler<t_connection_context>::match_end_of_header()
 	{
 
-    //Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
-		std::string::size_type res = buf.find("\r\n\r\n");
-		if(std::string::npos != res)
-			return res+4;
-		res = buf.find("\n\n");
-		if(std::string::npos != res)
-			return res+2;
-		return res;
+    //Here we returning head size from m_cache_pos, including terminating sequence (\r\n\r\n or \n\n).
+    //The scan picks up where the previous one (on less data) stopped.
+		const char* const head = m_cache.data() + m_cache_pos;
+		const size_t size = m_cache.size() - m_cache_pos;
+		for(size_t i = m_header_scan_pos; i < size; ++i)
+		{
+			if(head[i] != '\n')
+				continue;
+			if(i + 1 < size && head[i + 1] == '\n')
+				return i + 2;
+			if(i + 2 < size && head[i + 1] == '\r' && head[i + 2] == '\n')
+				return i + 3;
+		}
+		//the last two bytes might still be the start of a terminator
+		m_header_scan_pos = size > 2 ? size - 2 : 0;
+		return std::string::npos;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(size_t pos)
 	{ 
-		LOG_PRINT_L3("HTTP HEAD:\r\n" << m_cache.substr(0, pos));
+		LOG_PRINT_L3("HTTP HEAD:\r\n" << m_cache.substr(m_cache_pos, pos));
 
 		m_query_info.m_full_request_buf_size = pos;
-    m_query_info.m_request_head.assign(m_cache.begin(), m_cache.begin()+pos); 
+    m_query_info.m_request_head.assign(m_cache, m_cache_pos, pos); 
 
-		if(!parse_cached_header(m_query_info.m_header_info, m_cache, pos))
+		if(!parse_cached_header(m_query_info.m_header_info, m_cache.data() + m_cache_pos, m_cache.data() + m_cache_pos + pos))
 		{
-			LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): failed to anilize request header: " << m_cache);
+			LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): failed to anilize request header: " << m_query_info.m_request_head);
 			m_state = http_state_error;
 			return false;
 		}
 
-		m_cache.erase(0, pos);
+		m_cache_pos += pos;
 
-		std::string req_command_str = m_query_info.m_full_request_str;
     //if we have POST or PUT command, it is very possible tha we will get body
     //but now, we suppose than we have body only in case of we have "ContentLength" 
 		if(m_query_info.m_header_info.m_content_length.size())
@@ -476,15 +555,16 @@ namespace net_utils
 	bool simple_http_connection_handler<t_connection_context>::handle_query_measure()
 	{
 
-		if(m_len_remain >= m_cache.size())
+		const size_t available = m_cache.size() - m_cache_pos;
+		if(m_len_remain >= available)
 		{
-			m_len_remain -= m_cache.size();
-			m_query_info.m_body += m_cache;
-			m_cache.clear();
+			m_len_remain -= available;
+			m_query_info.m_body.append(m_cache, m_cache_pos, available);
+			m_cache_pos = m_cache.size();
 		}else
 		{
-			m_query_info.m_body.append(m_cache.begin(), m_cache.begin() + m_len_remain);
-			m_cache.erase(0, m_len_remain);
+			m_query_info.m_body.append(m_cache, m_cache_pos, m_len_remain);
+			m_cache_pos += m_len_remain;
 			m_len_remain = 0;
 		}
 
@@ -499,56 +579,84 @@ namespace net_utils
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
+	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const char* begin, const char* end)
 	{ 
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)|(User-Agent)|(Origin)"
-			//  12            3         4                5              6                   7                  8      9        10           11
-			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//11             1213   14 
-			boost::regex::icase | boost::regex::normal);
-
-		boost::smatch		result;
-		std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-		std::string::const_iterator it_end_bound = m_cache_to_process.begin()+pos;
-
 		body_info.clear();
 
-		//lookup all fields and fill well-known fields
-		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
+		std::string* last_value = nullptr;
+		for(const char* line = begin; line < end; )
 		{
-			const size_t field_val = 14;
-			const size_t field_etc_name = 12;
-
-			int i = 2; //start position = 2
-			if(result[i++].matched)//"Connection"
-				body_info.m_connection = result[field_val];
-			else if(result[i++].matched)//"Referer"
-				body_info.m_referer = result[field_val];
-			else if(result[i++].matched)//"Content-Length"
-				body_info.m_content_length = result[field_val];
-			else if(result[i++].matched)//"Content-Type"
-				body_info.m_content_type = result[field_val];
-			else if(result[i++].matched)//"Transfer-Encoding"
-				body_info.m_transfer_encoding = result[field_val];
-			else if(result[i++].matched)//"Content-Encoding"
-				body_info.m_content_encoding = result[field_val];
-			else if(result[i++].matched)//"Host"
-				body_info.m_host = result[field_val];
-			else if(result[i++].matched)//"Cookie"
-				body_info.m_cookie = result[field_val];
-			else if(result[i++].matched)//"User-Agent"
-				body_info.m_user_agent = result[field_val];
-			else if(result[i++].matched)//"Origin"
-				body_info.m_origin = result[field_val];
-			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
+			const char* eol = std::find(line, end, '\n');
+			const char* line_end = (eol != line && eol[-1] == '\r') ? eol - 1 : eol;
+			const char* next = eol == end ? end : eol + 1;
+			if(line_end == line)
+				break; //empty line terminates the header
+
+			if(*line == ' ' || *line == '\t')
+			{
+				//obsolete line folding, the line continues the previous field value
+				const char* value = line;
+				while(value != line_end && (*value == ' ' || *value == '\t'))
+					++value;
+				if(last_value && value != line_end)
+				{
+					last_value->push_back(' ');
+					last_value->append(value, line_end);
+				}
+				line = next;
+				continue;
+			}
+
+			const char* colon = std::find(line, line_end, ':');
+			const char* name_end = colon;
+			while(name_end != line && name_end[-1] == ' ')
+				--name_end;
+			bool valid_name = colon != line_end && name_end != line;
+			for(const char* c = line; valid_name && c != name_end; ++c)
+				valid_name = std::isalnum(static_cast<unsigned char>(*c)) || *c == '-' || *c == '_';
+			if(!valid_name)
+			{
+				LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::parse_cached_header() skipping malformed line: " << std::string(line, line_end));
+				last_value = nullptr;
+				line = next;
+				continue;
+			}
+
+			const char* value = colon + 1;
+			while(value != line_end && (*value == ' ' || *value == '\t'))
+				++value;
+			const char* value_end = line_end;
+			while(value_end != value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+				--value_end;
+
+			if(iequals_token(line, name_end, "Connection"))
+				last_value = &body_info.m_connection;
+			else if(iequals_token(line, name_end, "Referer"))
+				last_value = &body_info.m_referer;
+			else if(iequals_token(line, name_end, "Content-Length"))
+				last_value = &body_info.m_content_length;
+			else if(iequals_token(line, name_end, "Content-Type"))
+				last_value = &body_info.m_content_type;
+			else if(iequals_token(line, name_end, "Transfer-Encoding"))
+				last_value = &body_info.m_transfer_encoding;
+			else if(iequals_token(line, name_end, "Content-Encoding"))
+				last_value = &body_info.m_content_encoding;
+			else if(iequals_token(line, name_end, "Host"))
+				last_value = &body_info.m_host;
+			else if(iequals_token(line, name_end, "Cookie"))
+				last_value = &body_info.m_cookie;
+			else if(iequals_token(line, name_end, "User-Agent"))
+				last_value = &body_info.m_user_agent;
+			else if(iequals_token(line, name_end, "Origin"))
+				last_value = &body_info.m_origin;
 			else
 			{
-				LOG_ERROR_CC(m_conn_context, "simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:" << m_cache_to_process);
+				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(std::string(line, name_end), std::string()));
+				last_value = &body_info.m_etc_fields.back().second;
 			}
+			last_value->assign(value, value_end);
 
-			it_current_bound = result[(int)result.size()-1]. first;
+			line = next;
 		}
 		return  true;
 	}
@@ -556,14 +664,18 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string& str, size_t& OUT len)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-		std::string res;
-		boost::smatch result;
-		if(!(boost::regex_search( str, result, rexp_mach_field, boost::match_default) && result[0].matched))
+		std::string::const_iterator it = std::find_if(str.begin(), str.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+		if(it == str.end())
 			return false;
 
-		try { len = boost::lexical_cast<size_t>(result[0]); }
-		catch(...) { return false; }
+		len = 0;
+		for(; it != str.end() && std::isdigit(static_cast<unsigned char>(*it)); ++it)
+		{
+			const size_t digit = *it - '0';
+			if(len > (std::numeric_limits<size_t>::max() - digit) / 10)
+				return false;
+			len = len * 10 + digit;
+		}
 		return true;
 	}
 	//-----------------------------------------------------------------------------------
@@ -0,0 +1,379 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_to_bin.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Writes the portable_storage binary format straight from KV_SERIALIZE */
+    /* maps, without building the intermediate section tree.               */
+    /************************************************************************/
+    //  Store maps visit the tree depth first, so starting an entry in a
+    //  section closes everything that was opened below it. When a section is
+    //  closed its entries are put back in name order, the order the tree
+    //  storage keeps them in, and section/array element counts get a fixed
+    //  width placeholder which finish() shrinks to the minimal varint in one
+    //  pass over the output, so the result matches
+    //  portable_storage::store_to_binary byte for byte.
+    //  Cases the tree storage resolves by overwriting (the same name written
+    //  twice in one section) cannot be streamed; finish() reports them so the
+    //  caller can fall back to portable_storage.
+    struct binary_writer_handle
+    {
+      binary_writer_handle(std::nullptr_t = nullptr): m_depth(0), m_serial(0) {}
+      binary_writer_handle(size_t depth, size_t serial): m_depth(depth), m_serial(serial) {}
+      explicit operator bool() const { return m_serial != 0; }
+
+      size_t m_depth;   // position in the writer's stack of open sections/arrays
+      size_t m_serial;  // tells apart frames that reuse the same position
+    };
+
+    class portable_storage_binary_writer
+    {
+      struct frame
+      {
+        size_t m_serial;
+        size_t m_count_offset;
+        size_t m_count;
+        size_t m_first_count; // m_counts index of the first frame closed below this one
+        std::vector<std::pair<std::string, size_t>> m_entries; // name, offset
+      };
+
+    public:
+      typedef binary_writer_handle hsection;
+      typedef binary_writer_handle harray;
+      typedef storage_entry meta_entry;
+
+      explicit portable_storage_binary_writer(std::string& target);
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool set_value(const std::string& value_name, t_value&& target, hsection hparent_section);
+      bool set_value(const std::string& value_name, storage_entry&& target, hsection hparent_section);
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, t_value&& target, hsection hparent_section);
+      template<class t_value>
+      bool insert_next_value(harray hval_array, t_value&& target);
+      harray insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section);
+      bool insert_next_section(harray hsec_array, hsection& hinserted_childsection);
+
+      //! Closes every open section and array; false if the output is not usable.
+      bool finish();
+
+      void write(const char* data, size_t size) { m_target.append(data, size); }
+
+    private:
+      frame* enter(hsection h);
+      bool begin_entry(frame* parent, const std::string& name);
+      binary_writer_handle push_frame();
+      void close_back();
+      void sort_entries(frame& f);
+      void pack_counts();
+
+      template<class t_value>
+      void write_raw(const t_value& v)
+      {
+        static_assert(std::is_arithmetic<t_value>::value, "arithmetic type expected");
+        const t_value le = CONVERT_POD(v);
+        write(reinterpret_cast<const char*>(&le), sizeof(le));
+      }
+      void write_raw(const std::string& v)
+      {
+        pack_varint(*this, v.size());
+        write(v.data(), v.size());
+      }
+
+      static uint8_t type_code(const uint64_t&) { return SERIALIZE_TYPE_UINT64; }
+      static uint8_t type_code(const uint32_t&) { return SERIALIZE_TYPE_UINT32; }
+      static uint8_t type_code(const uint16_t&) { return SERIALIZE_TYPE_UINT16; }
+      static uint8_t type_code(const uint8_t&)  { return SERIALIZE_TYPE_UINT8; }
+      static uint8_t type_code(const int64_t&)  { return SERIALIZE_TYPE_INT64; }
+      static uint8_t type_code(const int32_t&)  { return SERIALIZE_TYPE_INT32; }
+      static uint8_t type_code(const int16_t&)  { return SERIALIZE_TYPE_INT16; }
+      static uint8_t type_code(const int8_t&)   { return SERIALIZE_TYPE_INT8; }
+      static uint8_t type_code(const double&)   { return SERIALIZE_TYPE_DUOBLE; }
+      static uint8_t type_code(const bool&)     { return SERIALIZE_TYPE_BOOL; }
+      static uint8_t type_code(const std::string&) { return SERIALIZE_TYPE_STRING; }
+
+      std::string& m_target;
+      std::vector<frame> m_frames;
+      std::vector<std::pair<size_t, size_t>> m_counts; // placeholder offset, element count
+      size_t m_serial;
+      bool m_failed;
+    };
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_binary_writer::portable_storage_binary_writer(std::string& target):m_target(target), m_serial(0), m_failed(false)
+    {
+      m_target.clear();
+      write_raw(uint32_t(PORTABLE_STORAGE_SIGNATUREA));
+      write_raw(uint32_t(PORTABLE_STORAGE_SIGNATUREB));
+      write_raw(uint8_t(PORTABLE_STORAGE_FORMAT_VER));
+      push_frame();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    binary_writer_handle portable_storage_binary_writer::push_frame()
+    {
+      m_frames.emplace_back();
+      frame& f = m_frames.back();
+      f.m_serial = ++m_serial;
+      f.m_count_offset = m_target.size();
+      f.m_count = 0;
+      f.m_first_count = m_counts.size();
+      write_raw(uint32_t(PORTABLE_RAW_SIZE_MARK_DWORD));
+      return binary_writer_handle(m_frames.size() - 1, f.m_serial);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_binary_writer::close_back()
+    {
+      frame& f = m_frames.back();
+      //larger counts would need a varint wider than the placeholder
+      if (f.m_count > (std::numeric_limits<uint32_t>::max() >> 2))
+        m_failed = true;
+      sort_entries(f);
+      m_counts.emplace_back(f.m_count_offset, f.m_count);
+      m_frames.pop_back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_binary_writer::sort_entries(frame& f)
+    {
+      typedef std::pair<std::string, size_t> entry;
+      std::vector<entry>& entries = f.m_entries;
+      const auto by_name = [](const entry& a, const entry& b) { return a.first < b.first; };
+      if (std::is_sorted(entries.begin(), entries.end(), by_name))
+        return;
+
+      //everything written since the first entry belongs to this section, nothing after it is open
+      const size_t begin = entries.front().second;
+      const size_t end = m_target.size();
+      std::vector<entry> sorted = entries;
+      std::sort(sorted.begin(), sorted.end(), by_name);
+      std::string buf;
+      buf.reserve(end - begin);
+      std::vector<std::pair<size_t, size_t>> moved; // old offset, new offset
+      moved.reserve(sorted.size());
+      for (const entry& e: sorted)
+      {
+        const auto next = std::upper_bound(entries.begin(), entries.end(), e.second, [](size_t o, const entry& x) { return o < x.second; });
+        const size_t e_end = next == entries.end() ? end : next->second;
+        moved.emplace_back(e.second, begin + buf.size());
+        buf.append(m_target, e.second, e_end - e.second);
+      }
+      std::sort(moved.begin(), moved.end());
+
+      //placeholders of the sections/arrays closed below this one move along with their entry
+      for (size_t i = f.m_first_count; i < m_counts.size(); ++i)
+      {
+        size_t& offset = m_counts[i].first;
+        const auto m = std::upper_bound(moved.begin(), moved.end(), std::make_pair(offset, std::numeric_limits<size_t>::max())) - 1;
+        offset = offset - m->first + m->second;
+      }
+      m_target.replace(begin, end - begin, buf);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_binary_writer::pack_counts()
+    {
+      struct varint_buffer
+      {
+        char data[sizeof(uint32_t)];
+        size_t size;
+        void write(const char* p, size_t n) { memcpy(data + size, p, n); size += n; }
+      };
+
+      //varints never outgrow their placeholder, so the output is compacted in place
+      std::sort(m_counts.begin(), m_counts.end());
+      size_t read = 0, written = 0;
+      for (const auto& c: m_counts)
+      {
+        const size_t n = c.first - read;
+        if (written != read)
+          memmove(&m_target[written], &m_target[read], n);
+        written += n;
+        varint_buffer v;
+        v.size = 0;
+        pack_varint(v, c.second);
+        memcpy(&m_target[written], v.data, v.size);
+        written += v.size;
+        read = c.first + sizeof(uint32_t);
+      }
+      const size_t n = m_target.size() - read;
+      if (written != read)
+        memmove(&m_target[written], &m_target[read], n);
+      m_target.resize(written + n);
+      m_counts.clear();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_binary_writer::frame* portable_storage_binary_writer::enter(hsection h)
+    {
+      //a handle names a frame by its depth, and the serial tells whether that frame is still the one it was given for
+      if (h.m_depth >= m_frames.size() || (h && m_frames[h.m_depth].m_serial != h.m_serial))
+      {
+        //handle of an already closed section: the output can not be streamed
+        m_failed = true;
+        return nullptr;
+      }
+      while (m_frames.size() > h.m_depth + 1)
+        close_back();
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_binary_writer::begin_entry(frame* parent, const std::string& name)
+    {
+      if (!parent || m_failed)
+        return false;
+      if (name.size() >= std::numeric_limits<uint8_t>::max())
+      {
+        m_failed = true;
+        return false;
+      }
+      for (const auto& e: parent->m_entries)
+      {
+        if (e.first == name)
+        {
+          m_failed = true;
+          return false;
+        }
+      }
+      parent->m_entries.emplace_back(name, m_target.size());
+      ++parent->m_count;
+      write_raw(uint8_t(name.size()));
+      write(name.data(), name.size());
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_binary_writer::hsection portable_storage_binary_writer::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      if (!create_if_notexist)
+        return nullptr;
+      if (!begin_entry(enter(hparent_section), section_name))
+        return nullptr;
+      write_raw(uint8_t(SERIALIZE_TYPE_OBJECT));
+      return push_frame();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_binary_writer::set_value(const std::string& value_name, t_value&& v, hsection hparent_section)
+    {
+      if (!begin_entry(enter(hparent_section), value_name))
+        return false;
+      write_raw(type_code(v));
+      write_raw(v);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_binary_writer::set_value(const std::string& value_name, storage_entry&& v, hsection hparent_section)
+    {
+      if (!begin_entry(enter(hparent_section), value_name))
+        return false;
+      if (!pack_entry_to_buff(*this, v))
+        m_failed = true;
+      return !m_failed;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_binary_writer::harray portable_storage_binary_writer::insert_first_value(const std::string& value_name, t_value&& v, hsection hparent_section)
+    {
+      if (!begin_entry(enter(hparent_section), value_name))
+        return nullptr;
+      write_raw(uint8_t(type_code(v) | SERIALIZE_FLAG_ARRAY));
+      const harray array = push_frame();
+      write_raw(v);
+      ++m_frames.back().m_count;
+      return array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_binary_writer::insert_next_value(harray hval_array, t_value&& v)
+    {
+      frame* array = hval_array ? enter(hval_array) : nullptr;
+      if (!array)
+        return false;
+      write_raw(v);
+      ++array->m_count;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_binary_writer::harray portable_storage_binary_writer::insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      if (!begin_entry(enter(hparent_section), section_name))
+        return nullptr;
+      write_raw(uint8_t(SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY));
+      const harray array = push_frame();
+      ++m_frames.back().m_count;
+      hinserted_childsection = push_frame();
+      return array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_binary_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      frame* array = hsec_array ? enter(hsec_array) : nullptr;
+      if (!array)
+        return false;
+      ++array->m_count;
+      hinserted_childsection = push_frame();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_binary_writer::finish()
+    {
+      while (!m_frames.empty())
+        close_back();
+      if (m_failed)
+        return false;
+      pack_counts();
+      return true;
+    }
+  }
+}
@@ -30,6 +30,7 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_binary_writer.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -113,6 +114,12 @@ namespace epee
     template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, size_t indent = 0)
     {
+      portable_storage_binary_writer writer(binary_buff);
+      str_in.store(writer);
+      if(writer.finish())
+        return true;
+
+      //the serialize map relies on tree semantics (e.g. a name written twice), build the full storage
       portable_storage ps;
       str_in.store(ps);
       return ps.store_to_binary(binary_buff);
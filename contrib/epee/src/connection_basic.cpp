@@ -234,34 +234,27 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size );
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
-
-// XXX LATER XXX
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size ); // increase counter - global
+long connection_basic::get_throttle_out_delay_ms(size_t packet_size) {
+	if (m_was_shutdown) {
+		_dbg2("m_was_shutdown - so no throttling");
+		return 0;
+	}
+
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
+	const double delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size ) * 0.50;
+	if (delay > 0) {
+		const long ms = std::max(1l, (long)(delay * 1000));
+		MTRACE("Delaying next write in " << __FUNCTION__ << " for " << ms << " ms after packet_size="<<packet_size);
+		return ms;
 	}
+	network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size ); // increase counter - global
+	return 0;
+}
 
+long connection_basic::get_throttle_in_delay_ms(size_t packet_size) {
+	CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
+	const double delay = network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( packet_size ) * 0.5;
+	return delay > 0 ? (long)(delay * 100) : 0;
 }
 
 void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
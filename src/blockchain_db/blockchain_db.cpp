@@ -132,7 +132,7 @@ bool txpool_tx_meta_t::upgrade_relay_method(relay_method method) noexcept
 
 const command_line::arg_descriptor<std::string> arg_db_sync_mode = {
   "db-sync-mode"
-, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]]." 
+, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]], or [fast|fastest]:pipelined:<max_unsynced_blocks> to flush every commit from a background thread." 
 , "fast:async:250000000bytes"
 };
 const command_line::arg_descriptor<bool> arg_db_salvage  = {
@@ -140,6 +140,11 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_presize_map  = {
+  "db-presize-map"
+, "Reserve a sparse database map sized to the free disk space and grow it geometrically, so that map resizes (which briefly block all readers) are rare"
+, false
+};
 
 BlockchainDB *new_db()
 {
@@ -150,6 +155,7 @@ void BlockchainDB::init_options(boost::program_options::options_description& des
 {
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_presize_map);
 }
 
 void BlockchainDB::pop_block()
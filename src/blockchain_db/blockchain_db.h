@@ -33,6 +33,7 @@
 #include <string>
 #include <exception>
 #include <boost/program_options.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
 #include "common/command_line.h"
 #include "crypto/hash.h"
 #include "cryptonote_basic/blobdatatype.h"
@@ -106,6 +107,7 @@ typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_presize_map;
 
 enum class relay_category : uint8_t
 {
@@ -141,6 +143,42 @@ struct tx_data_t
 };
 #pragma pack(pop)
 
+/**
+ * @brief a conversion as recorded in the circulating supply index
+ */
+struct circ_supply_conversion
+{
+  uint64_t height;                 //!< the height of the block containing the conversion
+  crypto::hash tx_hash;            //!< the conversion transaction
+  std::string source;              //!< the asset burnt
+  std::string dest;                //!< the asset minted
+  uint64_t pricing_record_height;  //!< the height of the pricing record used
+  uint64_t amount_burnt;
+  uint64_t amount_minted;
+};
+
+/**
+ * @brief the supply movement of one asset over a range of blocks
+ */
+struct circ_supply_delta
+{
+  boost::multiprecision::uint128_t burnt = 0;    //!< total burnt by conversions from the asset
+  boost::multiprecision::uint128_t minted = 0;   //!< total minted by conversions to the asset
+  uint64_t conversions = 0;                      //!< number of conversions from or to the asset
+};
+
+/**
+ * @brief where an incremental pruning job is at
+ */
+struct pruning_progress
+{
+  bool active = false;         //!< whether a job is still running
+  uint64_t next_height = 0;    //!< the first block the job has not processed yet
+  uint64_t end_height = 0;     //!< blocks from this height on were added pruned
+  uint64_t pruned_txes = 0;    //!< transactions whose prunable data was removed so far
+  uint64_t pruned_bytes = 0;   //!< size of the data removed so far
+};
+
 struct alt_block_data_t
 {
   uint64_t height;
@@ -197,6 +235,7 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_PRESIZE 0x20
 
 /***********************************
  * Exception Definitions
@@ -675,6 +714,19 @@ public:
    */
   virtual void safesyncmode(const bool onoff) = 0;
 
+  /**
+   * @brief flush commits to disk from a background thread
+   *
+   * For a DB opened without synchronous commits. Block application goes on
+   * in a new write txn while a dedicated thread makes the previous commits
+   * durable. A commit which would leave more than max_unsynced_blocks
+   * committed blocks not yet flushed waits for the flush to catch up, so
+   * that is the most a crash can lose.
+   *
+   * @param max_unsynced_blocks the bound on blocks not yet flushed, 0 stops the background flushes
+   */
+  virtual void set_pipelined_sync(uint64_t max_unsynced_blocks) = 0;
+
   /**
    * @brief Remove everything from the BlockchainDB
    *
@@ -1165,6 +1217,35 @@ public:
    * @return the current circulating supply tally values
    */
   virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const = 0;
+
+  /**
+   * @brief fetch the supply movement of an asset between two heights
+   *
+   * Sums the amounts burnt and minted by conversions in blocks
+   * [start_height, end_height). The sums are read from checkpoints kept
+   * every few blocks, so the cost does not depend on the size of the range.
+   * Unlike the tally, the sums are not corrected for underflow.
+   *
+   * @param asset_type the asset to query
+   * @param start_height the first block to include
+   * @param end_height one past the last block to include, capped to the chain height
+   *
+   * @return the amounts burnt and minted, and the number of conversions
+   */
+  virtual circ_supply_delta get_circulating_supply_delta(const std::string &asset_type, uint64_t start_height, uint64_t end_height) const = 0;
+
+  /**
+   * @brief fetch the conversions from one asset to another between two heights
+   *
+   * @param source the asset burnt
+   * @param dest the asset minted
+   * @param start_height the first block to include
+   * @param end_height one past the last block to include
+   * @param max_count the maximum number of conversions to return
+   *
+   * @return the conversions, in height order
+   */
+  virtual std::vector<circ_supply_conversion> get_circulating_supply_conversions(const std::string &source, const std::string &dest, uint64_t start_height, uint64_t end_height, size_t max_count) const = 0;
   
 
   /**
@@ -1639,6 +1720,40 @@ public:
    */
   virtual bool check_pruning() = 0;
 
+  /**
+   * @brief starts pruning the blockchain in small steps
+   *
+   * Sets the pruning seed right away, so blocks added from now on are
+   * pruned as usual, and records a job which prune_blockchain_step then
+   * works through for the blocks already in the database. The job is
+   * kept in the database, so it survives restarts.
+   *
+   * @param pruning_seed the seed to use, 0 for default (highly recommended)
+   *
+   * @return false if the blockchain was already pruned, true otherwise
+   */
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0) = 0;
+
+  /**
+   * @brief runs a step of the incremental pruning job, if any
+   *
+   * Each step is its own short write transaction, never part of a batch,
+   * so steps can be interleaved with adding blocks without the caller
+   * holding the blockchain lock.
+   *
+   * @param max_txes how many transactions to go through at most
+   *
+   * @return true if the job has more work left
+   */
+  virtual bool prune_blockchain_step(size_t max_txes) = 0;
+
+  /**
+   * @brief gets where the incremental pruning job is at
+   *
+   * @return the job's progress, inactive if there is no job
+   */
+  virtual pruning_progress get_pruning_progress() const = 0;
+
   /**
    * @brief get the max block size
    */
@@ -37,6 +37,7 @@
 #include "file_io_utils.h"
 #include "common/util.h"
 #include "common/pruning.h"
+#include "common/threadpool.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 #include "crypto/crypto.h"
@@ -56,6 +57,9 @@
 using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
+// consecutive failed syncs after which pipelined sync gives up and writes are refused
+#define SYNC_THREAD_MAX_FAILURES 10
+
 // Increase when the DB structure changes
 <<<<<<< HEAD
 <<<<<<< HEAD
@@ -186,6 +190,16 @@ int BlockchainLMDB::compare_string(const MDB_val *a, const MDB_val *b)
   return 0;
 }
 
+int BlockchainLMDB::compare_uint64_pair(const MDB_val *a, const MDB_val *b)
+{
+  uint64_t va[2], vb[2];
+  memcpy(va, a->mv_data, sizeof(va));
+  memcpy(vb, b->mv_data, sizeof(vb));
+  if (va[0] != vb[0])
+    return va[0] < vb[0] ? -1 : 1;
+  return (va[1] < vb[1]) ? -1 : va[1] > vb[1];
+}
+
 }
 
 namespace
@@ -217,6 +231,11 @@ namespace
  *
  * alt_blocks       block hash   {block data, block blob}
  *
+ * circ_supply      txn ID       {conversion data}
+ * circ_supply_tally asset       {supply tally}
+ * circ_supply_index asset pair  [{height, txn ID, conversion data}...]
+ * circ_supply_checkpoints asset [{height, cumulative burnt and minted}...]
+ *
  * Note: where the data items are of uniform size, DUPFIXED tables have
  * been used to save space. In most of these cases, a dummy "zerokval"
  * key is used when accessing the table; the Key listed above will be
@@ -254,6 +273,11 @@ const char* const LMDB_PROPERTIES = "properties";
 
 const char* const LMDB_CIRC_SUPPLY = "circ_supply";
 const char* const LMDB_CIRC_SUPPLY_TALLY = "circ_supply_tally";
+const char* const LMDB_CIRC_SUPPLY_INDEX = "circ_supply_index";
+const char* const LMDB_CIRC_SUPPLY_CHECKPOINTS = "circ_supply_checkpoints";
+
+// blocks between two circ_supply checkpoints
+const uint64_t CIRC_SUPPLY_CHECKPOINT_INTERVAL = 1000;
 
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
@@ -426,6 +450,35 @@ typedef struct circ_supply_tally {
   uint64_t amount_lo;
 } circ_supply_tally;
 
+// sorted by height, then txn ID
+typedef struct circ_supply_index_entry {
+  uint64_t height;
+  uint64_t tx_id;
+  crypto::hash tx_hash;
+  uint64_t pricing_record_height;
+  uint64_t amount_burnt;
+  uint64_t amount_minted;
+} circ_supply_index_entry;
+
+// totals for an asset over all blocks below height
+typedef struct circ_supply_checkpoint {
+  uint64_t height;
+  uint64_t burnt_hi;
+  uint64_t burnt_lo;
+  uint64_t minted_hi;
+  uint64_t minted_lo;
+  uint64_t conversions;
+} circ_supply_checkpoint;
+
+// state of an incremental pruning job, kept in the properties table
+typedef struct mdb_pruning_progress {
+  uint64_t next_height;
+  uint64_t next_tx_id;
+  uint64_t end_height;
+  uint64_t pruned_txes;
+  uint64_t pruned_bytes;
+} mdb_pruning_progress;
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
 
@@ -591,12 +644,14 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   CRITICAL_REGION_LOCAL(m_synchronization_lock);
   const uint64_t add_size = 1LL << 30;
+  uint64_t available = std::numeric_limits<uint64_t>::max();
 
   // check disk capacity
   try
   {
     boost::filesystem::path path(m_folder);
     boost::filesystem::space_info si = boost::filesystem::space(path);
+    available = si.available;
     if(si.available < add_size)
     {
       MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
@@ -627,6 +682,18 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
   if (increase_size > 0)
     new_mapsize = mei.me_mapsize + increase_size;
 
+  // A presized map grows geometrically, so resizes get rarer as the DB grows.
+  // The map is sparse, but there is no point reserving more than the disk
+  // could ever hold.
+  if (m_presize_map)
+  {
+    uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+    uint64_t grown_mapsize = mei.me_mapsize * PRESIZE_GROWTH_FACTOR;
+    if (available < std::numeric_limits<uint64_t>::max() - size_used)
+      grown_mapsize = std::min(grown_mapsize, size_used + available);
+    new_mapsize = std::max(new_mapsize, grown_mapsize);
+  }
+
   new_mapsize += (new_mapsize % mst.ms_psize);
 
   mdb_txn_safe::prevent_new_txns();
@@ -721,6 +788,15 @@ void BlockchainLMDB::check_and_resize_for_batch(uint64_t batch_num_blocks, uint6
     // minimum size increase is used to avoid frequent resizes when the batch
     // size is set to a very small numbers of blocks.
     increase_size = (threshold_size > min_increase_size) ? threshold_size : min_increase_size;
+
+    // With a presized map, look a few batches ahead, so that the resize (which
+    // has to wait for all readers) is done while there is still room, rather
+    // than in the middle of a busy sync.
+    if (m_presize_map)
+    {
+      threshold_size *= PRESIZE_LOOKAHEAD_BATCHES;
+      increase_size = std::max(increase_size, threshold_size);
+    }
     MDEBUG("increase size: " << increase_size);
   }
 
@@ -893,10 +969,19 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
 
+  // this block's conversions are indexed already, as txs are added first
+  if ((m_height + 1) % CIRC_SUPPLY_CHECKPOINT_INTERVAL == 0)
+  {
+    CURSOR(circ_supply_index)
+    CURSOR(circ_supply_checkpoints)
+    write_circ_supply_checkpoints(m_cur_circ_supply_index, m_cur_circ_supply_checkpoints, m_height + 1);
+  }
+
   // we use weight as a proxy for size, since we don't have size but weight is >= size
   // and often actually equal
   m_cum_size += block_weight;
   m_cum_count++;
+  m_txn_blocks++;
 }
 
 void BlockchainLMDB::remove_block()
@@ -914,6 +999,11 @@ void BlockchainLMDB::remove_block()
   CURSOR(block_info)
   CURSOR(block_heights)
   CURSOR(blocks)
+  CURSOR(circ_supply_checkpoints)
+
+  if (m_height % CIRC_SUPPLY_CHECKPOINT_INTERVAL == 0)
+    remove_circ_supply_checkpoints(m_cur_circ_supply_checkpoints, m_height);
+
   MDB_val_copy<uint64_t> k(m_height - 1);
   MDB_val h = k;
   if ((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
@@ -1004,6 +1094,142 @@ void write_circulating_supply_data(MDB_cursor *cur_circ_supply_tally, MDB_val id
     throw0(DB_ERROR(lmdb_error("Failed to update tally for source circulating supply: ", result).c_str()));
 }
 
+uint64_t circ_supply_asset_index(const std::string &asset_type)
+{
+  return std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), asset_type) - offshore::ASSET_TYPES.begin();
+}
+
+uint64_t circ_supply_pair_key(uint64_t source, uint64_t dest)
+{
+  return (source << 32) | dest;
+}
+
+boost::multiprecision::uint128_t import_uint128(uint64_t hi, uint64_t lo)
+{
+  boost::multiprecision::uint128_t v = hi;
+  v <<= 64;
+  v |= lo;
+  return v;
+}
+
+void export_uint128(const boost::multiprecision::uint128_t &v, uint64_t &hi, uint64_t &lo)
+{
+  hi = ((v >> 64) & 0xffffffffffffffff).convert_to<uint64_t>();
+  lo = (v & 0xffffffffffffffff).convert_to<uint64_t>();
+}
+
+// calls f on the indexed conversions of one asset pair in blocks [start_height, end_height), until f returns false
+template<typename F>
+void for_each_circ_supply_conversion(MDB_cursor *cur_circ_supply_index, uint64_t source, uint64_t dest, uint64_t start_height, uint64_t end_height, F f)
+{
+  if (start_height >= end_height)
+    return;
+  MDB_val_copy<uint64_t> k(circ_supply_pair_key(source, dest));
+  circ_supply_index_entry first = {};
+  first.height = start_height;
+  MDB_val v = {sizeof(first), (void *)&first};
+  int result = mdb_cursor_get(cur_circ_supply_index, &k, &v, MDB_GET_BOTH_RANGE);
+  while (!result)
+  {
+    const circ_supply_index_entry &entry = *(const circ_supply_index_entry *)v.mv_data;
+    if (entry.height >= end_height || !f(entry))
+      return;
+    result = mdb_cursor_get(cur_circ_supply_index, &k, &v, MDB_NEXT_DUP);
+  }
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate circulating supply index: ", result).c_str()));
+}
+
+void add_circ_supply_conversions(MDB_cursor *cur_circ_supply_index, uint64_t asset, uint64_t start_height, uint64_t end_height, circ_supply_delta &delta)
+{
+  for (uint64_t other = 0; other < offshore::ASSET_TYPES.size(); ++other)
+  {
+    if (other == asset)
+      continue;
+    for_each_circ_supply_conversion(cur_circ_supply_index, asset, other, start_height, end_height, [&delta](const circ_supply_index_entry &entry) {
+      delta.burnt += entry.amount_burnt;
+      ++delta.conversions;
+      return true;
+    });
+    for_each_circ_supply_conversion(cur_circ_supply_index, other, asset, start_height, end_height, [&delta](const circ_supply_index_entry &entry) {
+      delta.minted += entry.amount_minted;
+      ++delta.conversions;
+      return true;
+    });
+  }
+}
+
+bool read_circ_supply_checkpoint(MDB_cursor *cur_circ_supply_checkpoints, uint64_t asset, uint64_t height, circ_supply_delta &delta)
+{
+  MDB_val_copy<uint64_t> k(asset);
+  circ_supply_checkpoint cp = {};
+  cp.height = height;
+  MDB_val v = {sizeof(cp), (void *)&cp};
+  int result = mdb_cursor_get(cur_circ_supply_checkpoints, &k, &v, MDB_GET_BOTH);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to get circulating supply checkpoint: ", result).c_str()));
+  const circ_supply_checkpoint &stored = *(const circ_supply_checkpoint *)v.mv_data;
+  delta.burnt = import_uint128(stored.burnt_hi, stored.burnt_lo);
+  delta.minted = import_uint128(stored.minted_hi, stored.minted_lo);
+  delta.conversions = stored.conversions;
+  return true;
+}
+
+// checkpoint at a multiple of the interval, from the previous checkpoint and the conversions since
+void write_circ_supply_checkpoints(MDB_cursor *cur_circ_supply_index, MDB_cursor *cur_circ_supply_checkpoints, uint64_t height)
+{
+  for (uint64_t asset = 0; asset < offshore::ASSET_TYPES.size(); ++asset)
+  {
+    // an asset without a previous checkpoint had no conversions yet
+    circ_supply_delta delta;
+    if (height > CIRC_SUPPLY_CHECKPOINT_INTERVAL)
+      read_circ_supply_checkpoint(cur_circ_supply_checkpoints, asset, height - CIRC_SUPPLY_CHECKPOINT_INTERVAL, delta);
+    add_circ_supply_conversions(cur_circ_supply_index, asset, height - CIRC_SUPPLY_CHECKPOINT_INTERVAL, height, delta);
+
+    circ_supply_checkpoint cp;
+    cp.height = height;
+    export_uint128(delta.burnt, cp.burnt_hi, cp.burnt_lo);
+    export_uint128(delta.minted, cp.minted_hi, cp.minted_lo);
+    cp.conversions = delta.conversions;
+    MDB_val_copy<uint64_t> k(asset);
+    MDB_val v = {sizeof(cp), (void *)&cp};
+    int result = mdb_cursor_put(cur_circ_supply_checkpoints, &k, &v, MDB_APPENDDUP);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to add circulating supply checkpoint to db transaction: ", result).c_str()));
+  }
+}
+
+void remove_circ_supply_checkpoints(MDB_cursor *cur_circ_supply_checkpoints, uint64_t height)
+{
+  for (uint64_t asset = 0; asset < offshore::ASSET_TYPES.size(); ++asset)
+  {
+    MDB_val_copy<uint64_t> k(asset);
+    circ_supply_checkpoint cp = {};
+    cp.height = height;
+    MDB_val v = {sizeof(cp), (void *)&cp};
+    int result = mdb_cursor_get(cur_circ_supply_checkpoints, &k, &v, MDB_GET_BOTH);
+    if (result == MDB_NOTFOUND)
+      continue;
+    if (result)
+      throw1(DB_ERROR(lmdb_error("Failed to locate circulating supply checkpoint for removal: ", result).c_str()));
+    if ((result = mdb_cursor_del(cur_circ_supply_checkpoints, 0)))
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of circulating supply checkpoint to db transaction: ", result).c_str()));
+  }
+}
+
+// totals for an asset over blocks [0, height)
+circ_supply_delta read_circ_supply_prefix(MDB_cursor *cur_circ_supply_index, MDB_cursor *cur_circ_supply_checkpoints, uint64_t asset, uint64_t height)
+{
+  circ_supply_delta delta;
+  const uint64_t checkpoint_height = height - height % CIRC_SUPPLY_CHECKPOINT_INTERVAL;
+  if (checkpoint_height > 0)
+    read_circ_supply_checkpoint(cur_circ_supply_checkpoints, asset, checkpoint_height, delta);
+  add_circ_supply_conversions(cur_circ_supply_index, asset, checkpoint_height, height, delta);
+  return delta;
+}
+
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata>& txp, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash, bool miner_tx)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -1021,6 +1247,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   CURSOR(tx_indices)
   CURSOR(circ_supply)
   CURSOR(circ_supply_tally)
+  CURSOR(circ_supply_index)
 
   MDB_val_set(val_tx_id, tx_id);
   MDB_val_set(val_h, tx_hash);
@@ -1111,6 +1338,20 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
     if (result)
       throw0(DB_ERROR(  lmdb_error("Failed to add tx circulating supply to db transaction: ", result).c_str()  ));
 
+    // and the height ordered index, tx ids only grow so this sorts last for the pair
+    circ_supply_index_entry cse;
+    cse.height = m_height;
+    cse.tx_id = tx_id;
+    cse.tx_hash = tx_hash;
+    cse.pricing_record_height = cs.pricing_record_height;
+    cse.amount_burnt = cs.amount_burnt;
+    cse.amount_minted = cs.amount_minted;
+    MDB_val_copy<uint64_t> pair_key(circ_supply_pair_key(cs.source_currency_type, cs.dest_currency_type));
+    MDB_val val_cse = {sizeof(cse), (void *)&cse};
+    result = mdb_cursor_put(m_cur_circ_supply_index, &pair_key, &val_cse, MDB_APPENDDUP);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to add tx to circulating supply index: ", result).c_str()));
+
     // update the tally table as well
 
     // Get the current tally value for the source currency type
@@ -1156,6 +1397,7 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   CURSOR(txs_prunable_tip)
   CURSOR(circ_supply)
   CURSOR(circ_supply_tally)
+  CURSOR(circ_supply_index)
   CURSOR(tx_outputs)
 
   MDB_val_set(val_h, tx_hash);
@@ -1244,6 +1486,17 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
     if (result)
       throw1(DB_ERROR(lmdb_error("Failed to add removal of circulating supply to db transaction: ", result).c_str()));
 
+    circ_supply_index_entry cse = {};
+    cse.height = m_height;
+    cse.tx_id = tip->data.tx_id;
+    MDB_val_copy<uint64_t> pair_key(circ_supply_pair_key(cs.source_currency_type, cs.dest_currency_type));
+    MDB_val val_cse = {sizeof(cse), (void *)&cse};
+    if ((result = mdb_cursor_get(m_cur_circ_supply_index, &pair_key, &val_cse, MDB_GET_BOTH)))
+      throw1(DB_ERROR(lmdb_error("Failed to locate circulating supply index entry for removal: ", result).c_str()));
+    result = mdb_cursor_del(m_cur_circ_supply_index, 0);
+    if (result)
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of circulating supply index entry to db transaction: ", result).c_str()));
+
     LOG_PRINT_L1("tx ID " << tip->data.tx_id << "\nSource tally before undoing burn =" << boost::to_string(source_tally) << "\nSource tally after undoing burn =" << boost::to_string(final_source_tally) <<
        "\nDest tally before undoing mint =" << boost::to_string(dest_tally) << "\nDest tally after undoing mint =" << boost::to_string(final_dest_tally));
   }
@@ -1572,6 +1825,11 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
     else
       throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
   }
+
+  // added before the txn commits, so readers can never see a key image the filter misses;
+  // past its capacity it only gets less selective until grown before the next write txn
+  boost::unique_lock<boost::shared_mutex> lock(m_key_image_filter_lock);
+  m_key_image_filter.insert(k_image);
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -1592,6 +1850,7 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
   }
+  // the key image filter can't remove entries, it's left with a false positive
 }
 
 BlockchainLMDB::~BlockchainLMDB()
@@ -1619,8 +1878,18 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_write_txn = nullptr;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_presize_map = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_circ_supply_index_available = false;
+  m_max_unsynced_blocks = 0;
+  m_txn_blocks = 0;
+  m_committed_blocks = 0;
+  m_synced_blocks = 0;
+  m_commit_seq = 0;
+  m_synced_seq = 0;
+  m_sync_stop = false;
+  m_sync_failed = false;
 
   // reset may also need changing when initialize things here
 
@@ -1696,6 +1965,29 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   if (db_flags & DBF_SALVAGE)
     mdb_flags |= MDB_PREVSNAPSHOT;
 
+  // Reserve the map up front: LMDB only touches the pages it writes, so a
+  // map sized to the free disk space costs address space, not disk, and
+  // saves the stop-the-world resizes along the way.
+  m_presize_map = false;
+  uint64_t available_space = 0;
+  if ((db_flags & DBF_PRESIZE) && !(db_flags & DBF_RDONLY))
+  {
+#if defined(__arm__) || defined(_WIN32)
+    MWARNING("Presized database map is not supported on this platform, ignoring");
+#else
+    try
+    {
+      boost::filesystem::space_info si = boost::filesystem::space(direc);
+      available_space = si.available;
+      m_presize_map = true;
+    }
+    catch (...)
+    {
+      MWARNING("Unable to query free disk space, not presizing the database map");
+    }
+#endif
+  }
+
   if (auto result = mdb_env_open(m_env, filename.c_str(), mdb_flags, 0644))
     throw0(DB_ERROR(lmdb_error("Failed to open lmdb environment: ", result).c_str()));
 
@@ -1703,6 +1995,19 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   mdb_env_info(m_env, &mei);
   uint64_t cur_mapsize = (uint64_t)mei.me_mapsize;
 
+  if (m_presize_map)
+  {
+    // size from the pages in use, not the file: with MDB_WRITEMAP the file
+    // is as large as the previous map, so it would grow on every restart
+    MDB_stat mst;
+    mdb_env_stat(m_env, &mst);
+    const uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+    const uint64_t reserved_size = (size_used + available_space) & ~((1ULL << 20) - 1);
+    if (reserved_size > mapsize)
+      mapsize = reserved_size;
+    MINFO("Reserving LMDB memory map of " << (mapsize >> 20) << " MiB");
+  }
+
   if (cur_mapsize < mapsize)
   {
     if (auto result = mdb_env_set_mapsize(m_env, mapsize))
@@ -1768,6 +2073,20 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_CIRC_SUPPLY, MDB_INTEGERKEY | MDB_CREATE, m_circ_supply, "Failed to open db handle for m_circ_supply");
   lmdb_db_open(txn, LMDB_CIRC_SUPPLY_TALLY, MDB_CREATE, m_circ_supply_tally, "Failed to open db handle for m_circ_supply_tally");
 
+  // the circ_supply index is newer than the tables above, a read-only open
+  // of a database which never ran read-write with it will not find it
+  m_circ_supply_index_available = true;
+  for (const auto &i: {std::make_pair(LMDB_CIRC_SUPPLY_INDEX, &m_circ_supply_index), std::make_pair(LMDB_CIRC_SUPPLY_CHECKPOINTS, &m_circ_supply_checkpoints)})
+  {
+    const int flags = MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | (mdb_flags & MDB_RDONLY ? 0 : MDB_CREATE);
+    if ((result = mdb_dbi_open(txn, i.first, flags, i.second)))
+    {
+      if (result != MDB_NOTFOUND || !(mdb_flags & MDB_RDONLY))
+        throw0(DB_OPEN_FAILURE((lmdb_error(std::string("Failed to open db handle for ") + i.first + " : ", result)).c_str()));
+      m_circ_supply_index_available = false;
+    }
+  }
+
   mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
   mdb_set_dupsort(txn, m_block_heights, compare_hash32);
   mdb_set_dupsort(txn, m_tx_indices, compare_hash32);
@@ -1788,6 +2107,13 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
 
   mdb_set_compare(txn, m_circ_supply, compare_uint64);
   mdb_set_compare(txn, m_circ_supply_tally, compare_uint64);
+  if (m_circ_supply_index_available)
+  {
+    mdb_set_compare(txn, m_circ_supply_index, compare_uint64);
+    mdb_set_dupsort(txn, m_circ_supply_index, compare_uint64_pair);
+    mdb_set_compare(txn, m_circ_supply_checkpoints, compare_uint64);
+    mdb_set_dupsort(txn, m_circ_supply_checkpoints, compare_uint64);
+  }
 
   if (!(mdb_flags & MDB_RDONLY))
   {
@@ -1834,6 +2160,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
       txn.commit();
       m_open = true;
       migrate(db_version);
+      build_key_image_filter();
       return;
     }
 #endif
@@ -1857,6 +2184,20 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
     return;
   }
 
+  if (m_circ_supply_index_available && !circ_supply_index_is_current(txn, m_height))
+  {
+    if (mdb_flags & MDB_RDONLY)
+    {
+      MWARNING("The circulating supply index is out of date, open the database read-write once to rebuild it");
+      m_circ_supply_index_available = false;
+    }
+    else
+    {
+      MINFO("Rebuilding the circulating supply index, this may take a while");
+      rebuild_circ_supply_index(txn, m_height);
+    }
+  }
+
   if (!(mdb_flags & MDB_RDONLY))
   {
     // only write version on an empty DB
@@ -1880,6 +2221,9 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   txn.commit();
 
   m_open = true;
+
+  if (!(mdb_flags & MDB_RDONLY))
+    build_key_image_filter();
   // from here, init should be finished
 }
 
@@ -1891,6 +2235,7 @@ void BlockchainLMDB::close()
     LOG_PRINT_L3("close() first calling batch_abort() due to active batch transaction");
     batch_abort();
   }
+  stop_sync_thread();
   this->sync();
   m_tinfo.reset();
 
@@ -1921,6 +2266,129 @@ void BlockchainLMDB::safesyncmode(const bool onoff)
   mdb_env_set_flags(m_env, MDB_NOSYNC|MDB_MAPASYNC, !onoff);
 }
 
+void BlockchainLMDB::set_pipelined_sync(uint64_t max_unsynced_blocks)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (max_unsynced_blocks == 0)
+  {
+    stop_sync_thread();
+    return;
+  }
+  if (is_read_only())
+    return;
+
+  unsigned int env_flags = 0;
+  mdb_env_get_flags(m_env, &env_flags);
+  if (!(env_flags & MDB_NOSYNC))
+    MWARNING("Pipelined sync requested, but commits are already synchronous");
+
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  m_max_unsynced_blocks = max_unsynced_blocks;
+  if (!m_sync_thread.joinable())
+  {
+    m_sync_stop = false;
+    m_synced_blocks = m_committed_blocks;
+    m_synced_seq = m_commit_seq;
+    m_sync_failed = false;
+    m_sync_thread = boost::thread(&BlockchainLMDB::sync_thread, this);
+  }
+  MINFO("Pipelined sync enabled, at most " << max_unsynced_blocks << " blocks may be lost on a crash");
+}
+
+void BlockchainLMDB::stop_sync_thread()
+{
+  {
+    boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+    if (!m_sync_thread.joinable())
+      return;
+    m_sync_stop = true;
+  }
+  m_sync_cond.notify_all();
+  m_sync_thread.join();
+  m_sync_thread = boost::thread();
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  m_max_unsynced_blocks = 0;
+}
+
+void BlockchainLMDB::get_sync_progress(uint64_t &committed_blocks, uint64_t &synced_blocks) const
+{
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  committed_blocks = m_committed_blocks;
+  synced_blocks = m_synced_blocks;
+}
+
+void BlockchainLMDB::sync_thread()
+{
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  unsigned int failures = 0;
+  while (true)
+  {
+    m_sync_cond.wait(lock, [this]() { return m_sync_stop || m_commit_seq != m_synced_seq; });
+    if (m_commit_seq == m_synced_seq)
+      break;
+
+    // everything committed so far is flushed by a single sync, later
+    // commits go on while it runs
+    const uint64_t seq = m_commit_seq;
+    const uint64_t blocks = m_committed_blocks;
+    lock.unlock();
+    int result = 0;
+    {
+      // also keeps the map from being resized under us
+      CRITICAL_REGION_LOCAL(m_synchronization_lock);
+      result = mdb_env_sync(m_env, true);
+    }
+    lock.lock();
+    if (result)
+    {
+      // nothing is durable yet, so the writer stays bounded while we retry
+      MERROR("Failed to sync database: " << mdb_strerror(result));
+      if (++failures >= SYNC_THREAD_MAX_FAILURES)
+      {
+        MFATAL("Failed to sync database " << failures << " times in a row, refusing further writes");
+        m_sync_failed = true;
+        m_sync_cond.notify_all();
+        break;
+      }
+      m_sync_cond.wait_for(lock, boost::chrono::seconds(1));
+      continue;
+    }
+    failures = 0;
+    m_synced_seq = seq;
+    m_synced_blocks = blocks;
+    m_sync_cond.notify_all();
+  }
+}
+
+void BlockchainLMDB::write_txn_committed()
+{
+  const uint64_t blocks = m_txn_blocks;
+  m_txn_blocks = 0;
+
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  m_committed_blocks += blocks;
+  ++m_commit_seq;
+  if (!m_sync_thread.joinable())
+    return;
+  m_sync_cond.notify_all();
+  if (m_committed_blocks - m_synced_blocks > m_max_unsynced_blocks)
+  {
+    TIME_MEASURE_START(wait_time);
+    m_sync_cond.wait(lock, [this]() { return m_sync_stop || m_sync_failed || m_committed_blocks - m_synced_blocks <= m_max_unsynced_blocks; });
+    TIME_MEASURE_FINISH(wait_time);
+    MDEBUG("Waited " << wait_time << " ms for the sync thread to catch up");
+  }
+}
+
+void BlockchainLMDB::check_sync_failed() const
+{
+  boost::unique_lock<boost::mutex> lock(m_sync_mutex);
+  if (m_sync_failed)
+    throw0(DB_ERROR_TXN_START("Database sync keeps failing, refusing to start a write txn"));
+}
+
 void BlockchainLMDB::reset()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -1952,6 +2420,10 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_circ_supply_tally, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_tally: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_circ_supply_index, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_index: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_circ_supply_checkpoints, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_checkpoints: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_txs, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
@@ -1960,6 +2432,11 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_types: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_spent_keys, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_keys: ", result).c_str()));
+  {
+    boost::unique_lock<boost::shared_mutex> lock(m_key_image_filter_lock);
+    if (m_key_image_filter.capacity())
+      m_key_image_filter.reset(KEY_IMAGE_FILTER_MIN_SIZE);
+  }
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
@@ -2599,6 +3076,15 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     mdb_cursor_close(c_tx_indices);
   }
 
+  if (mode == prune_mode_prune)
+  {
+    // everything is pruned now, an incremental job has nothing left to do
+    MDB_val_str(kp, "pruning_progress");
+    result = mdb_del(txn, m_properties, &kp, NULL);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to delete pruning progress: ", result).c_str()));
+  }
+
   if ((result = mdb_stat(txn, m_txs_prunable, &db_stats)))
     throw0(DB_ERROR(lmdb_error("Failed to query m_txs_prunable: ", result).c_str()));
   const size_t pages1 = db_stats.ms_branch_pages + db_stats.ms_leaf_pages + db_stats.ms_overflow_pages;
@@ -2634,6 +3120,237 @@ bool BlockchainLMDB::check_pruning()
   return prune_worker(prune_mode_check, 0);
 }
 
+bool BlockchainLMDB::start_incremental_pruning(uint32_t pruning_seed)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
+  if (log_stripes && log_stripes != CRYPTONOTE_PRUNING_LOG_STRIPES)
+    throw0(DB_ERROR("Pruning seed not in range"));
+  pruning_seed = tools::get_pruning_stripe(pruning_seed);
+  if (pruning_seed > (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES))
+    throw0(DB_ERROR("Pruning seed not in range"));
+  check_open();
+
+  TXN_PREFIX(0);
+
+  MDB_val_str(k, "pruning_seed");
+  MDB_val v;
+  int result = mdb_get(*txn_ptr, m_properties, &k, &v);
+  if (result == 0)
+  {
+    if (v.mv_size != sizeof(uint32_t))
+      throw0(DB_ERROR("Failed to retrieve pruning seed: unexpected value size"));
+    uint32_t data;
+    memcpy(&data, v.mv_data, sizeof(data));
+    if (pruning_seed && tools::get_pruning_stripe(data) != pruning_seed)
+      throw0(DB_ERROR("Blockchain already pruned with different seed"));
+    MDEBUG("Blockchain already pruned, or being pruned");
+    return false;
+  }
+  if (result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning seed: ", result).c_str()));
+
+  if (pruning_seed == 0)
+    pruning_seed = tools::get_random_stripe();
+  pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
+  v.mv_data = &pruning_seed;
+  v.mv_size = sizeof(pruning_seed);
+  result = mdb_put(*txn_ptr, m_properties, &k, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to save pruning seed: ", result).c_str()));
+
+  // blocks from the current height on get their txes recorded in the tip table
+  // as they are added, so the job only has to go through the ones already there
+  MDB_stat db_stats;
+  if ((result = mdb_stat(*txn_ptr, m_blocks, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+  mdb_pruning_progress progress = {0, 0, db_stats.ms_entries, 0, 0};
+  MDB_val_str(kp, "pruning_progress");
+  MDB_val_set(vp, progress);
+  result = mdb_put(*txn_ptr, m_properties, &kp, &vp, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+
+  TXN_POSTFIX_SUCCESS();
+
+  MINFO("Started incremental pruning of " << progress.end_height << " blocks, seed " << epee::string_tools::to_string_hex(pruning_seed));
+  return true;
+}
+
+bool BlockchainLMDB::prune_blockchain_step(size_t max_txes)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  // always a txn of our own rather than a batch some other thread may have
+  // open, as the caller does not hold the blockchain lock
+  mdb_txn_safe auto_txn;
+  if (auto result = lmdb_txn_begin(m_env, NULL, 0, auto_txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for pruning: ", result).c_str()));
+  mdb_txn_safe *txn_ptr = &auto_txn;
+
+  MDB_val_str(kp, "pruning_progress");
+  MDB_val vp;
+  int result = mdb_get(*txn_ptr, m_properties, &kp, &vp);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+  if (vp.mv_size != sizeof(mdb_pruning_progress))
+    throw0(DB_ERROR("Failed to retrieve pruning progress: unexpected value size"));
+  mdb_pruning_progress progress;
+  memcpy(&progress, vp.mv_data, sizeof(progress));
+
+  MDB_val_str(k, "pruning_seed");
+  MDB_val v;
+  result = mdb_get(*txn_ptr, m_properties, &k, &v);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning seed: ", result).c_str()));
+  if (v.mv_size != sizeof(uint32_t))
+    throw0(DB_ERROR("Failed to retrieve pruning seed: unexpected value size"));
+  uint32_t pruning_seed;
+  memcpy(&pruning_seed, v.mv_data, sizeof(pruning_seed));
+
+  MDB_stat db_stats;
+  if ((result = mdb_stat(*txn_ptr, m_blocks, &db_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+  const uint64_t blockchain_height = db_stats.ms_entries;
+
+  // blocks popped since the job started were re-added with the seed set
+  progress.end_height = std::min(progress.end_height, blockchain_height);
+
+  MDB_cursor *c_blocks, *c_tx_indices, *c_txs_pruned, *c_txs_prunable, *c_txs_prunable_tip;
+  if ((result = mdb_cursor_open(*txn_ptr, m_blocks, &c_blocks)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for blocks: ", result).c_str()));
+  if ((result = mdb_cursor_open(*txn_ptr, m_tx_indices, &c_tx_indices)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+  if ((result = mdb_cursor_open(*txn_ptr, m_txs_pruned, &c_txs_pruned)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+  if ((result = mdb_cursor_open(*txn_ptr, m_txs_prunable, &c_txs_prunable)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+  if ((result = mdb_cursor_open(*txn_ptr, m_txs_prunable_tip, &c_txs_prunable_tip)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_tip: ", result).c_str()));
+
+  size_t n_txes = 0;
+  bool first = true;
+  while (progress.next_height < progress.end_height && n_txes < max_txes)
+  {
+    MDB_val_copy<uint64_t> kb(progress.next_height);
+    MDB_val vb;
+    result = mdb_cursor_get(c_blocks, &kb, &vb, MDB_SET);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve block for pruning: ", result).c_str()));
+    const blobdata bd((const char*)vb.mv_data, vb.mv_size);
+    block b;
+    if (!parse_and_validate_block_from_blob(bd, b))
+      throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+
+    if (first)
+    {
+      // tx ids follow chain order, resync in case a reorg moved them since the last step
+      const crypto::hash miner_tx_hash = get_transaction_hash(b.miner_tx);
+      MDB_val_set(vt, miner_tx_hash);
+      result = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &vt, MDB_GET_BOTH);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to find miner transaction for pruning: ", result).c_str()));
+      txindex ti;
+      memcpy(&ti, vt.mv_data, sizeof(ti));
+      progress.next_tx_id = ti.data.tx_id;
+      first = false;
+    }
+
+    const uint64_t block_height = progress.next_height;
+    const uint64_t n_block_txes = 1 + b.tx_hashes.size();
+    for (uint64_t tx_id = progress.next_tx_id; tx_id < progress.next_tx_id + n_block_txes; ++tx_id)
+    {
+      MDB_val_set(kt, tx_id);
+      if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
+      {
+        // too recent to prune yet, update_pruning takes it from here
+        MDB_val_set(vh, block_height);
+        result = mdb_cursor_put(c_txs_prunable_tip, &kt, &vh, 0);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to add transaction to prunable tip table: ", result).c_str()));
+      }
+      else if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kt))
+      {
+        result = mdb_cursor_get(c_txs_prunable, &kt, &v, MDB_SET);
+        if (result && result != MDB_NOTFOUND)
+          throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+        if (result == 0)
+        {
+          ++progress.pruned_txes;
+          progress.pruned_bytes += kt.mv_size + v.mv_size;
+          result = mdb_cursor_del(c_txs_prunable, 0);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
+        }
+      }
+    }
+    progress.next_tx_id += n_block_txes;
+    ++progress.next_height;
+    n_txes += n_block_txes;
+  }
+
+  mdb_cursor_close(c_txs_prunable_tip);
+  mdb_cursor_close(c_txs_prunable);
+  mdb_cursor_close(c_txs_pruned);
+  mdb_cursor_close(c_tx_indices);
+  mdb_cursor_close(c_blocks);
+
+  const bool done = progress.next_height >= progress.end_height;
+  if (done)
+  {
+    result = mdb_del(*txn_ptr, m_properties, &kp, NULL);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete pruning progress: ", result).c_str()));
+  }
+  else
+  {
+    MDB_val_set(vn, progress);
+    result = mdb_put(*txn_ptr, m_properties, &kp, &vn, 0);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+  }
+
+  auto_txn.commit();
+
+  if (done)
+    MINFO("Incremental pruning done: " << (progress.pruned_bytes/1024.0f/1024.0f) << " MB pruned in " << progress.pruned_txes << " records");
+  else
+    MDEBUG("Incremental pruning at height " << progress.next_height << "/" << progress.end_height);
+  return !done;
+}
+
+pruning_progress BlockchainLMDB::get_pruning_progress() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(properties)
+  MDB_val_str(k, "pruning_progress");
+  MDB_val v;
+  pruning_progress ret;
+  int result = mdb_cursor_get(m_cur_properties, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return ret;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+  if (v.mv_size != sizeof(mdb_pruning_progress))
+    throw0(DB_ERROR("Failed to retrieve pruning progress: unexpected value size"));
+  mdb_pruning_progress progress;
+  memcpy(&progress, v.mv_data, sizeof(progress));
+  TXN_POSTFIX_RDONLY();
+
+  ret.active = true;
+  ret.next_height = progress.next_height;
+  ret.end_height = progress.end_height;
+  ret.pruned_txes = progress.pruned_txes;
+  ret.pruned_bytes = progress.pruned_bytes;
+  return ret;
+}
+
 bool BlockchainLMDB::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, relay_category category) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3302,6 +4019,164 @@ std::vector<std::pair<std::string, std::string>> BlockchainLMDB::get_circulating
   return circulating_supply;
 }
 
+circ_supply_delta BlockchainLMDB::get_circulating_supply_delta(const std::string &asset_type, uint64_t start_height, uint64_t end_height) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_circ_supply_index_available)
+    throw0(DB_ERROR("Circulating supply index is not available"));
+  const uint64_t asset = circ_supply_asset_index(asset_type);
+  if (asset >= offshore::ASSET_TYPES.size())
+    throw0(DB_ERROR(("Unknown asset type: " + asset_type).c_str()));
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(blocks);
+  RCURSOR(circ_supply_index);
+  RCURSOR(circ_supply_checkpoints);
+
+  // read the height in the same txn as the checkpoints
+  MDB_stat db_stats;
+  int result = mdb_stat(m_txn, m_blocks, &db_stats);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+  end_height = std::min<uint64_t>(end_height, db_stats.ms_entries);
+  start_height = std::min(start_height, end_height);
+
+  const circ_supply_delta end = read_circ_supply_prefix(m_cur_circ_supply_index, m_cur_circ_supply_checkpoints, asset, end_height);
+  const circ_supply_delta start = read_circ_supply_prefix(m_cur_circ_supply_index, m_cur_circ_supply_checkpoints, asset, start_height);
+
+  TXN_POSTFIX_RDONLY();
+
+  circ_supply_delta delta;
+  delta.burnt = end.burnt - start.burnt;
+  delta.minted = end.minted - start.minted;
+  delta.conversions = end.conversions - start.conversions;
+  return delta;
+}
+
+std::vector<circ_supply_conversion> BlockchainLMDB::get_circulating_supply_conversions(const std::string &source, const std::string &dest, uint64_t start_height, uint64_t end_height, size_t max_count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (!m_circ_supply_index_available)
+    throw0(DB_ERROR("Circulating supply index is not available"));
+  const uint64_t source_idx = circ_supply_asset_index(source);
+  const uint64_t dest_idx = circ_supply_asset_index(dest);
+  if (source_idx >= offshore::ASSET_TYPES.size() || dest_idx >= offshore::ASSET_TYPES.size())
+    throw0(DB_ERROR("Unknown asset type"));
+
+  std::vector<circ_supply_conversion> conversions;
+  if (max_count == 0)
+    return conversions;
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(circ_supply_index);
+
+  for_each_circ_supply_conversion(m_cur_circ_supply_index, source_idx, dest_idx, start_height, end_height, [&](const circ_supply_index_entry &entry) {
+    conversions.push_back({entry.height, entry.tx_hash, source, dest, entry.pricing_record_height, entry.amount_burnt, entry.amount_minted});
+    return conversions.size() < max_count;
+  });
+
+  TXN_POSTFIX_RDONLY();
+
+  return conversions;
+}
+
+bool BlockchainLMDB::circ_supply_index_is_current(MDB_txn *txn, uint64_t height) const
+{
+  // both tables hold one record per conversion
+  MDB_stat circ_supply_stats, index_stats, checkpoint_stats;
+  int result;
+  if ((result = mdb_stat(txn, m_circ_supply, &circ_supply_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_circ_supply: ", result).c_str()));
+  if ((result = mdb_stat(txn, m_circ_supply_index, &index_stats)))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_circ_supply_index: ", result).c_str()));
+  if (circ_supply_stats.ms_entries != index_stats.ms_entries)
+    return false;
+
+  // and the last checkpoint must be for the last multiple of the interval
+  const uint64_t last_checkpoint = height - height % CIRC_SUPPLY_CHECKPOINT_INTERVAL;
+  if (last_checkpoint == 0)
+  {
+    if ((result = mdb_stat(txn, m_circ_supply_checkpoints, &checkpoint_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_circ_supply_checkpoints: ", result).c_str()));
+    return checkpoint_stats.ms_entries == 0;
+  }
+
+  MDB_cursor *cur;
+  if ((result = mdb_cursor_open(txn, m_circ_supply_checkpoints, &cur)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_circ_supply_checkpoints: ", result).c_str()));
+  MDB_val_copy<uint64_t> k(0);
+  MDB_val v;
+  result = mdb_cursor_get(cur, &k, &v, MDB_SET);
+  if (!result)
+    result = mdb_cursor_get(cur, &k, &v, MDB_LAST_DUP);
+  const bool current = !result && ((const circ_supply_checkpoint *)v.mv_data)->height == last_checkpoint;
+  mdb_cursor_close(cur);
+  if (result && result != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to get circulating supply checkpoint: ", result).c_str()));
+  return current;
+}
+
+void BlockchainLMDB::rebuild_circ_supply_index(MDB_txn *txn, uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  int result;
+  if ((result = mdb_drop(txn, m_circ_supply_index, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_index: ", result).c_str()));
+  if ((result = mdb_drop(txn, m_circ_supply_checkpoints, 0)))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_circ_supply_checkpoints: ", result).c_str()));
+
+  MDB_cursor *c_circ_supply, *c_tx_indices, *c_index, *c_checkpoints;
+  if ((result = mdb_cursor_open(txn, m_circ_supply, &c_circ_supply)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_circ_supply: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_tx_indices: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_circ_supply_index, &c_index)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_circ_supply_index: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_circ_supply_checkpoints, &c_checkpoints)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for m_circ_supply_checkpoints: ", result).c_str()));
+
+  // circ_supply is keyed by tx id, so conversions come in chain order
+  MDB_val k, v;
+  MDB_cursor_op op = MDB_FIRST;
+  while (1)
+  {
+    result = mdb_cursor_get(c_circ_supply, &k, &v, op);
+    op = MDB_NEXT;
+    if (result == MDB_NOTFOUND)
+      break;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate circ_supply table: ", result).c_str()));
+    const circ_supply &cs = *(const circ_supply *)v.mv_data;
+
+    MDB_val_set(val_h, cs.tx_hash);
+    if ((result = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH)))
+      throw0(DB_ERROR(lmdb_error("Failed to get tx index for conversion: ", result).c_str()));
+    const txindex &ti = *(const txindex *)val_h.mv_data;
+
+    circ_supply_index_entry cse;
+    cse.height = ti.data.block_id;
+    cse.tx_id = ti.data.tx_id;
+    cse.tx_hash = cs.tx_hash;
+    cse.pricing_record_height = cs.pricing_record_height;
+    cse.amount_burnt = cs.amount_burnt;
+    cse.amount_minted = cs.amount_minted;
+    MDB_val_copy<uint64_t> pair_key(circ_supply_pair_key(cs.source_currency_type, cs.dest_currency_type));
+    MDB_val val_cse = {sizeof(cse), (void *)&cse};
+    if ((result = mdb_cursor_put(c_index, &pair_key, &val_cse, MDB_APPENDDUP)))
+      throw0(DB_ERROR(lmdb_error("Failed to add tx to circulating supply index: ", result).c_str()));
+  }
+
+  for (uint64_t h = CIRC_SUPPLY_CHECKPOINT_INTERVAL; h <= height; h += CIRC_SUPPLY_CHECKPOINT_INTERVAL)
+    write_circ_supply_checkpoints(c_index, c_checkpoints, h);
+
+  mdb_cursor_close(c_checkpoints);
+  mdb_cursor_close(c_index);
+  mdb_cursor_close(c_tx_indices);
+  mdb_cursor_close(c_circ_supply);
+}
+
 uint64_t BlockchainLMDB::num_outputs() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3887,6 +4762,12 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  {
+    boost::shared_lock<boost::shared_mutex> lock(m_key_image_filter_lock);
+    if (!m_key_image_filter.may_contain(img))
+      return false;
+  }
+
   bool ret;
 
   TXN_PREFIX_RDONLY();
@@ -3932,6 +4813,110 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   return fret;
 }
 
+void BlockchainLMDB::build_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TIME_MEASURE_START(t);
+
+  uint64_t n_key_images;
+  {
+    TXN_PREFIX_RDONLY();
+    MDB_stat db_stats;
+    if (int result = mdb_stat(m_txn, m_spent_keys, &db_stats))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+    n_key_images = db_stats.ms_entries;
+    TXN_POSTFIX_RDONLY();
+  }
+
+  // each thread fills its own filter, merged at the end, so keep the count modest
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t n_threads = std::max<size_t>(1, std::min<size_t>(tpool.get_max_concurrency(), 4));
+  const size_t filter_size = std::max<size_t>(2 * n_key_images, KEY_IMAGE_FILTER_MIN_SIZE);
+  std::vector<tools::blocked_bloom_filter<crypto::key_image>> filters(n_threads, tools::blocked_bloom_filter<crypto::key_image>(filter_size));
+  std::atomic<bool> failed(false);
+
+  // spent_keys sorts on the last 32 bit word first, so each thread takes a range of those
+  static const size_t top_offset = sizeof(crypto::key_image) - sizeof(uint32_t);
+  tools::threadpool::waiter waiter;
+  for (size_t i = 0; i < n_threads; ++i)
+  {
+    const uint64_t lo = (((uint64_t)1) << 32) * i / n_threads;
+    const uint64_t hi = (((uint64_t)1) << 32) * (i + 1) / n_threads;
+    tpool.submit(&waiter, [this, &filters, &failed, i, lo, hi]() {
+      try
+      {
+        TXN_PREFIX_RDONLY();
+        RCURSOR(spent_keys);
+
+        crypto::key_image start;
+        memset(&start, 0, sizeof(start));
+        const uint32_t lo32 = lo;
+        memcpy((char*)&start + top_offset, &lo32, sizeof(lo32));
+        MDB_val k = zerokval;
+        MDB_val v = {sizeof(start), (void *)&start};
+        MDB_cursor_op op = MDB_GET_BOTH_RANGE;
+        while (1)
+        {
+          int ret = mdb_cursor_get(m_cur_spent_keys, &k, &v, op);
+          op = MDB_NEXT_DUP;
+          if (ret == MDB_NOTFOUND)
+            break;
+          if (ret)
+            throw0(DB_ERROR(lmdb_error("Failed to enumerate key images: ", ret).c_str()));
+          uint32_t top;
+          memcpy(&top, (const char*)v.mv_data + top_offset, sizeof(top));
+          if (top >= hi)
+            break;
+          crypto::key_image k_image;
+          memcpy(&k_image, v.mv_data, sizeof(k_image));
+          filters[i].insert(k_image);
+        }
+
+        TXN_POSTFIX_RDONLY();
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Failed to build key image filter: " << e.what());
+        failed = true;
+      }
+    }, true);
+  }
+  waiter.wait(&tpool);
+
+  boost::unique_lock<boost::shared_mutex> lock(m_key_image_filter_lock);
+  if (failed)
+  {
+    // an empty filter matches everything, so all lookups go to the db
+    m_key_image_filter.reset(0);
+    return;
+  }
+  for (size_t i = 1; i < n_threads; ++i)
+    filters[0].merge(filters[i]);
+  m_key_image_filter = std::move(filters[0]);
+  lock.unlock();
+
+  TIME_MEASURE_FINISH(t);
+  MINFO("Built key image filter for " << n_key_images << " key images in " << t << " ms (" <<
+      m_key_image_filter.memory_usage()/1024.0f/1024.0f << " MB)");
+}
+
+void BlockchainLMDB::grow_key_image_filter()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  {
+    boost::shared_lock<boost::shared_mutex> lock(m_key_image_filter_lock);
+    if (!m_key_image_filter.capacity() || !m_key_image_filter.full())
+      return;
+  }
+
+  // no write txn is open, so the committed key images are all of them
+  MINFO("Key image filter is full, rebuilding it");
+  build_key_image_filter();
+}
+
 bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -4173,6 +5158,8 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes
   if (m_write_txn)
     throw0(DB_ERROR("batch transaction attempted, but m_write_txn already in use"));
   check_open();
+  check_sync_failed();
+  grow_key_image_filter();
 
   m_writer = boost::this_thread::get_id();
   check_and_resize_for_batch(batch_num_blocks, batch_bytes);
@@ -4229,6 +5216,7 @@ void BlockchainLMDB::batch_commit()
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
+  write_txn_committed();
 }
 
 void BlockchainLMDB::cleanup_batch()
@@ -4264,9 +5252,11 @@ void BlockchainLMDB::batch_stop()
   }
   catch (const std::exception &e)
   {
+    m_txn_blocks = 0;
     cleanup_batch();
     throw;
   }
+  write_txn_committed();
   LOG_PRINT_L3("batch transaction: end");
 }
 
@@ -4289,6 +5279,7 @@ void BlockchainLMDB::batch_abort()
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  m_txn_blocks = 0;
   memset(&m_wcursors, 0, sizeof(m_wcursors));
   LOG_PRINT_L3("batch transaction: aborted");
 }
@@ -4370,6 +5361,8 @@ void BlockchainLMDB::block_wtxn_start()
     throw0(DB_ERROR_TXN_START((std::string("Attempted to start new write txn when write txn already exists in ")+__FUNCTION__).c_str()));
   if (! m_batch_active)
   {
+    check_sync_failed();
+    grow_key_image_filter();
     m_writer = boost::this_thread::get_id();
     m_write_txn = new mdb_txn_safe();
     if (auto mdb_res = lmdb_txn_begin(m_env, NULL, 0, *m_write_txn))
@@ -4407,6 +5400,7 @@ void BlockchainLMDB::block_wtxn_stop()
       delete m_write_txn;
       m_write_txn = nullptr;
       memset(&m_wcursors, 0, sizeof(m_wcursors));
+      write_txn_committed();
 	}
   }
 }
@@ -4424,6 +5418,7 @@ void BlockchainLMDB::block_wtxn_abort()
     delete m_write_txn;
     m_write_txn = nullptr;
     memset(&m_wcursors, 0, sizeof(m_wcursors));
+    m_txn_blocks = 0;
   }
 }
 
@@ -30,13 +30,21 @@
 
 #include "blockchain_db/blockchain_db.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
+#include "common/bloom_filter.h"
 #include "ringct/rctTypes.h"
 #include <boost/thread/tss.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <lmdb.h>
 
 #define ENABLE_AUTO_RESIZE
 
+// smallest size the key image filter is built at, in key images
+#define KEY_IMAGE_FILTER_MIN_SIZE (1 << 16)
+
 namespace cryptonote
 {
 
@@ -77,6 +85,8 @@ typedef struct mdb_txn_cursors
   // NEAC : Add cursor for the circulating supply data
   MDB_cursor *m_txc_circ_supply;
   MDB_cursor *m_txc_circ_supply_tally;
+  MDB_cursor *m_txc_circ_supply_index;
+  MDB_cursor *m_txc_circ_supply_checkpoints;
 
 } mdb_txn_cursors;
 
@@ -101,6 +111,8 @@ typedef struct mdb_txn_cursors
 #define m_cur_properties	m_cursors->m_txc_properties
 #define m_cur_circ_supply       m_cursors->m_txc_circ_supply
 #define m_cur_circ_supply_tally m_cursors->m_txc_circ_supply_tally
+#define m_cur_circ_supply_index m_cursors->m_txc_circ_supply_index
+#define m_cur_circ_supply_checkpoints m_cursors->m_txc_circ_supply_checkpoints
 
 typedef struct mdb_rflags
 {
@@ -126,6 +138,8 @@ typedef struct mdb_rflags
   bool m_rf_properties;
   bool m_rf_circ_supply;
   bool m_rf_circ_supply_tally;
+  bool m_rf_circ_supply_index;
+  bool m_rf_circ_supply_checkpoints;
 } mdb_rflags;
 
 typedef struct mdb_threadinfo
@@ -205,6 +219,11 @@ public:
 
   virtual void safesyncmode(const bool onoff);
 
+  virtual void set_pipelined_sync(uint64_t max_unsynced_blocks);
+
+  // blocks committed so far, and how many of them the sync thread has flushed
+  void get_sync_progress(uint64_t &committed_blocks, uint64_t &synced_blocks) const;
+
   virtual void reset();
 
   virtual std::vector<std::string> get_filenames() const;
@@ -258,6 +277,10 @@ public:
   virtual block get_top_block() const;
 
   virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const;
+
+  virtual circ_supply_delta get_circulating_supply_delta(const std::string &asset_type, uint64_t start_height, uint64_t end_height) const;
+
+  virtual std::vector<circ_supply_conversion> get_circulating_supply_conversions(const std::string &source, const std::string &dest, uint64_t start_height, uint64_t end_height, size_t max_count) const;
   
   virtual uint64_t height() const;
 
@@ -309,6 +332,9 @@ public:
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
   virtual bool update_pruning();
   virtual bool check_pruning();
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0);
+  virtual bool prune_blockchain_step(size_t max_txes);
+  virtual pruning_progress get_pruning_progress() const;
 
   virtual void add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata &blob);
   virtual bool get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob);
@@ -371,6 +397,7 @@ public:
   static int compare_uint64(const MDB_val *a, const MDB_val *b);
   static int compare_hash32(const MDB_val *a, const MDB_val *b);
   static int compare_string(const MDB_val *a, const MDB_val *b);
+  static int compare_uint64_pair(const MDB_val *a, const MDB_val *b);
 
 private:
   void do_resize(uint64_t size_increase=0);
@@ -439,9 +466,21 @@ private:
   // fix up anything that may be wrong due to past bugs
   virtual void fixup();
 
+  // check the circ_supply index and checkpoints cover the whole chain
+  bool circ_supply_index_is_current(MDB_txn *txn, uint64_t height) const;
+
+  // rebuild the circ_supply index and checkpoints from the circ_supply table
+  void rebuild_circ_supply_index(MDB_txn *txn, uint64_t height);
+
   // migrate from older DB version to current
   void migrate(const uint32_t oldversion);
 
+  // fill the key image filter from spent_keys, split across threads
+  void build_key_image_filter();
+
+  // rebuild the key image filter once it is full, before a write txn is opened
+  void grow_key_image_filter();
+
   // migrate from DB version 0 to 1
   void migrate_0_1();
 
@@ -474,6 +513,16 @@ private:
 >>>>>>> parent of 91f4c7f45 (Make difficulty 128 bit instead of 64 bit)
   void cleanup_batch();
 
+  // hand a commit to the sync thread, waiting if too many blocks are not yet durable
+  void write_txn_committed();
+
+  void stop_sync_thread();
+
+  void sync_thread();
+
+  // throws once the sync thread has given up on repeated failures
+  void check_sync_failed() const;
+
 private:
   MDB_env* m_env;
 
@@ -507,6 +556,14 @@ private:
   
   MDB_dbi m_circ_supply;
   MDB_dbi m_circ_supply_tally;
+  MDB_dbi m_circ_supply_index;
+  MDB_dbi m_circ_supply_checkpoints;
+  bool m_circ_supply_index_available;
+
+  // in front of spent_keys, matches everything (so is bypassed) on read only dbs,
+  // which another process may be writing to
+  tools::blocked_bloom_filter<crypto::key_image> m_key_image_filter;
+  mutable boost::shared_mutex m_key_image_filter_lock;
   
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
@@ -517,6 +574,20 @@ private:
 
   bool m_batch_transactions; // support for batch transactions
   bool m_batch_active; // whether batch transaction is in progress
+  bool m_presize_map; // map reserved up front from free disk space, grown geometrically
+
+  // pipelined sync: commits are counted by the writer and flushed by m_sync_thread
+  boost::thread m_sync_thread;
+  mutable boost::mutex m_sync_mutex;
+  boost::condition_variable m_sync_cond;
+  uint64_t m_max_unsynced_blocks;
+  uint64_t m_txn_blocks; // blocks added in the current write txn
+  uint64_t m_committed_blocks;
+  uint64_t m_synced_blocks;
+  uint64_t m_commit_seq;
+  uint64_t m_synced_seq;
+  bool m_sync_stop;
+  bool m_sync_failed; // the sync thread gave up, new write txns are refused
 
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
@@ -533,6 +604,12 @@ private:
 #endif
 
   constexpr static float RESIZE_PERCENT = 0.9f;
+
+  // with a presized map, each resize at least doubles the map, and batches
+  // check for room for this many batches ahead so resizes happen well before
+  // the map is actually full
+  constexpr static uint64_t PRESIZE_GROWTH_FACTOR = 2;
+  constexpr static uint64_t PRESIZE_LOOKAHEAD_BATCHES = 4;
 };
 
 }  // namespace cryptonote
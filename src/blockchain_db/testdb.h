@@ -46,6 +46,7 @@ public:
   virtual void close() override {}
   virtual void sync() override {}
   virtual void safesyncmode(const bool onoff) override {}
+  virtual void set_pipelined_sync(uint64_t max_unsynced_blocks) override {}
   virtual void reset() override {}
   virtual std::vector<std::string> get_filenames() const override { return std::vector<std::string>(); }
   virtual bool remove_data_file(const std::string& folder) const override { return true; }
@@ -155,6 +156,9 @@ public:
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) override { return true; }
   virtual bool update_pruning() override { return true; }
   virtual bool check_pruning() override { return true; }
+  virtual bool start_incremental_pruning(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool prune_blockchain_step(size_t max_txes) override { return false; }
+  virtual cryptonote::pruning_progress get_pruning_progress() const override { return cryptonote::pruning_progress(); }
   virtual void prune_outputs(uint64_t amount) override {}
 
   virtual uint64_t get_max_block_size() override { return 100000000; }
@@ -168,6 +172,8 @@ public:
   virtual bool for_all_alt_blocks(std::function<bool(const crypto::hash &blkid, const alt_block_data_t &data, const cryptonote::blobdata *blob)> f, bool include_blob = false) const override { return true; }
 
   virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const override { return std::vector<std::pair<std::string, std::string>>(); }
+  virtual cryptonote::circ_supply_delta get_circulating_supply_delta(const std::string &asset_type, uint64_t start_height, uint64_t end_height) const override { return cryptonote::circ_supply_delta(); }
+  virtual std::vector<cryptonote::circ_supply_conversion> get_circulating_supply_conversions(const std::string &source, const std::string &dest, uint64_t start_height, uint64_t end_height, size_t max_count) const override { return std::vector<cryptonote::circ_supply_conversion>(); }
   virtual void get_output_id_from_asset_type_output_index(const std::string asset_type, const std::vector<uint64_t> &asset_type_output_indices, std::vector<uint64_t> &output_indices) const override { }
   virtual bool for_all_transactions_by_id(std::function<bool(const crypto::hash&, const cryptonote::transaction&)>, bool pruned) const override { return true; }
 
@@ -60,6 +60,8 @@ int main(int argc, char* argv[])
   const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
   const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
   const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+  const command_line::arg_descriptor<bool> arg_indexed = {"indexed", "Output in the indexed format, with compressed chunks and a block index", false};
+  const command_line::arg_descriptor<int> arg_compression_level = {"compression-level", "zstd compression level for the indexed format, 0 to store chunks uncompressed", INDEXED_DEFAULT_COMPRESSION_LEVEL};
 
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
@@ -69,6 +71,8 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_log_level);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
   command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+  command_line::add_arg(desc_cmd_sett, arg_indexed);
+  command_line::add_arg(desc_cmd_sett, arg_compression_level);
 
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -109,6 +113,12 @@ int main(int argc, char* argv[])
     return 1;
   }
   bool opt_blocks_dat = command_line::get_arg(vm, arg_blocks_dat);
+  bool opt_indexed = command_line::get_arg(vm, arg_indexed);
+  if (opt_blocks_dat && opt_indexed)
+  {
+    std::cerr << "Can't specify more than one of --blocksdat and --indexed" << std::endl;
+    return 1;
+  }
 
   std::string m_config_folder;
 
@@ -175,6 +185,11 @@ int main(int argc, char* argv[])
     BlocksdatFile blocksdat;
     r = blocksdat.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop);
   }
+  else if (opt_indexed)
+  {
+    BootstrapFile bootstrap;
+    r = bootstrap.store_blockchain_indexed(core_storage, output_file_path, block_stop, command_line::get_arg(vm, arg_compression_level));
+  }
   else
   {
     BootstrapFile bootstrap;
@@ -29,6 +29,7 @@
 #include <atomic>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
 #include <fstream>
 
 #include <boost/filesystem.hpp>
@@ -42,6 +43,7 @@
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
 #include "include_base_utils.h"
+#include "common/threadpool.h"
 #include "cryptonote_core/cryptonote_core.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
@@ -55,6 +57,7 @@ bool opt_verify  = true; // use add_new_block, which does verification before ca
 bool opt_resume  = true;
 bool opt_testnet = true;
 bool opt_stagenet = true;
+bool opt_bulk    = false; // add blocks covered by the precompiled block hashes straight to the db
 
 // number of blocks per batch transaction
 // adjustable through command-line argument according to available RAM
@@ -69,6 +72,9 @@ uint64_t db_batch_size = 100;
 // frequently saved
 uint64_t db_batch_size_verify = 5000;
 
+// bulk loading keeps the large batches even when verifying
+uint64_t db_batch_size_bulk = 0;
+
 std::string refresh_string = "\r                                    \r";
 }
 
@@ -212,6 +218,209 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
   return 0;
 }
 
+// Adds the blocks in chunks straight to the db if they match the precompiled
+// block hashes. Parsing and hashing run in parallel, the txpool and tx
+// verification are skipped. Blocks that can't be matched are moved to blocks
+// instead, for check_flush to verify fully.
+int bulk_flush(cryptonote::core &core, std::vector<std::string> &chunks, std::vector<block_complete_entry> &blocks, bool force)
+{
+  if (chunks.empty())
+    return 0;
+
+  // wait till we can match a full HOH, or till the end of the precompiled hashes
+  Blockchain &bc = core.get_blockchain_storage();
+  const uint64_t height = bc.get_db().height();
+  const uint64_t new_height = height + chunks.size();
+  if (!force && bc.is_within_compiled_block_hash_area(new_height) && (chunks.size() < db_batch_size_bulk || new_height % HASH_OF_HASHES_STEP))
+    return 0;
+
+  std::vector<Blockchain::prevalidated_block> pblocks(chunks.size());
+  std::atomic<bool> failed(false);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+  const size_t per_thread = (chunks.size() + threads - 1) / threads;
+  for (size_t start = 0; start < chunks.size(); start += per_thread)
+  {
+    const size_t end = std::min(start + per_thread, chunks.size());
+    tpool.submit(&waiter, [&chunks, &pblocks, &failed, start, end]() {
+      for (size_t i = start; i < end && !failed; ++i)
+      {
+        bootstrap::block_package bp;
+        if (!::serialization::parse_binary(chunks[i], bp))
+        {
+          MERROR("Error in deserialization of chunk");
+          failed = true;
+          return;
+        }
+        Blockchain::prevalidated_block &pb = pblocks[i];
+        pb.bl = std::move(bp.block);
+        pb.id = get_block_hash(pb.bl);
+        pb.block_weight = bp.block_weight;
+        if (bp.txs.size() != pb.bl.tx_hashes.size())
+        {
+          MERROR("Block " << pb.id << " has " << bp.txs.size() << " txes, expected " << pb.bl.tx_hashes.size());
+          failed = true;
+          return;
+        }
+        pb.txs.reserve(bp.txs.size());
+        for (size_t n = 0; n < bp.txs.size(); ++n)
+        {
+          // the tx hashes are committed to by the block hash, which gets checked later
+          if (get_transaction_hash(bp.txs[n]) != pb.bl.tx_hashes[n])
+          {
+            MERROR("Transaction " << n << " does not match tx hash " << pb.bl.tx_hashes[n] << " in block " << pb.id);
+            failed = true;
+            return;
+          }
+          blobdata blob = tx_to_blob(bp.txs[n]);
+          pb.txs.push_back(std::make_pair(std::move(bp.txs[n]), std::move(blob)));
+        }
+      }
+    }, true);
+  }
+  waiter.wait(&tpool);
+  if (failed)
+    return 1;
+
+  std::vector<crypto::hash> hashes;
+  std::vector<uint64_t> weights;
+  uint64_t bytes = 0;
+  hashes.reserve(pblocks.size());
+  weights.reserve(pblocks.size());
+  for (size_t i = 0; i < pblocks.size(); ++i)
+  {
+    hashes.push_back(pblocks[i].id);
+    weights.push_back(pblocks[i].block_weight);
+    bytes += chunks[i].size();
+  }
+  core.prevalidate_block_hashes(height, hashes, weights);
+
+  size_t added = 0;
+  bc.get_db().batch_start(pblocks.size(), bytes);
+  if (!bc.add_prevalidated_blocks(pblocks, added))
+  {
+    bc.get_db().batch_abort();
+    return 1;
+  }
+  bc.get_db().batch_stop();
+  MDEBUG("Bulk loaded " << added << " blocks at height " << height);
+
+  for (size_t i = added; i < pblocks.size(); ++i)
+  {
+    block_complete_entry bce;
+    bce.pruned = false;
+    bce.block = block_to_blob(pblocks[i].bl);
+    for (const auto &tx: pblocks[i].txs)
+      bce.txs.push_back({tx.second, crypto::null_hash});
+    blocks.push_back(std::move(bce));
+  }
+  chunks.clear();
+  return 0;
+}
+
+// The circ_supply tally and the conversion index are both written by
+// add_transaction, so after skipping tx verification the supply is summed
+// again from the chain added since start_height: each conversion's burnt and
+// minted amounts as stored in the tx, and for XHV each miner tx's outputs
+// less the XHV fees of its block.
+bool check_circulating_supply(cryptonote::core &core, uint64_t start_height, const std::vector<std::pair<std::string, std::string>> &start_supply)
+{
+  typedef boost::multiprecision::int128_t int128_t;
+  const BlockchainDB &db = core.get_blockchain_storage().get_db();
+  const uint64_t height = db.height();
+  std::map<std::string, int128_t> expected;
+  for (const auto &i: start_supply)
+    expected[i.first] = int128_t(i.second);
+  bool ok = true;
+  try
+  {
+    for (uint64_t h = start_height; h < height; ++h)
+    {
+      const block b = db.get_block_from_height(h);
+      uint64_t fees = 0;
+      for (const crypto::hash &tx_hash: b.tx_hashes)
+      {
+        transaction tx;
+        std::string source, dest;
+        if (!db.get_tx(tx_hash, tx) || !get_tx_asset_types(tx, tx_hash, source, dest, false))
+        {
+          MERROR("Failed to read tx " << tx_hash << " at height " << h);
+          return false;
+        }
+        if (source == "XHV")
+        {
+          fees += tx.rct_signatures.txnFee;
+          if (source != dest)
+            fees += tx.rct_signatures.txnOffshoreFee;
+        }
+        if (tx.version >= OFFSHORE_TRANSACTION_VERSION && source != dest)
+        {
+          expected[source] -= tx.amount_burnt;
+          expected[dest] += tx.amount_minted;
+        }
+      }
+      expected["XHV"] += int128_t(get_outs_money_amount(b.miner_tx)["XHV"]) - fees;
+    }
+
+    for (const auto &i: db.get_circulating_supply())
+    {
+      const int128_t tally(i.second);
+      const auto it = expected.find(i.first);
+      const int128_t sum = it == expected.end() ? 0 : it->second;
+      if (tally != sum)
+      {
+        MERROR("Circulating supply mismatch for " << i.first << ": tally " << tally << ", from the chain " << sum);
+        ok = false;
+      }
+    }
+  }
+  catch (const DB_ERROR &e)
+  {
+    MWARNING("Failed to check circulating supply: " << e.what());
+    return true;
+  }
+  if (ok)
+    MINFO("Circulating supply tally matches the chain");
+  return ok;
+}
+
+// Reads the next few chunks of an indexed file, and decodes them in parallel.
+// blocks is left empty at the end of the file.
+bool read_indexed_chunks(BootstrapFile &bootstrap, std::ifstream &import_file, const std::vector<bootstrap::chunk_index_entry> &index, size_t &next_chunk, std::deque<std::string> &blocks)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t count = std::min<size_t>(index.size() - next_chunk, 2 * std::max<size_t>(1, tpool.get_max_concurrency()));
+  std::vector<bootstrap::chunk_header> headers(count);
+  std::vector<std::string> stored(count);
+  for (size_t i = 0; i < count; ++i)
+    if (!bootstrap.read_chunk(import_file, index[next_chunk + i], headers[i], stored[i]))
+      return false;
+
+  std::vector<std::vector<std::string>> decoded(count);
+  std::atomic<bool> failed(false);
+  tools::threadpool::waiter waiter;
+  for (size_t i = 0; i < count; ++i)
+  {
+    tpool.submit(&waiter, [&headers, &stored, &decoded, &failed, &index, next_chunk, i]() {
+      if (!BootstrapFile::decode_chunk(headers[i], stored[i], decoded[i]))
+      {
+        MERROR("Failed to decode chunk starting at block " << index[next_chunk + i].first_height);
+        failed = true;
+      }
+    }, true);
+  }
+  waiter.wait(&tpool);
+  if (failed)
+    return false;
+
+  for (auto &chunk: decoded)
+    for (auto &block: chunk)
+      blocks.push_back(std::move(block));
+  next_chunk += count;
+  return true;
+}
+
 int import_from_file(cryptonote::core& core, const std::string& import_file_path, uint64_t block_stop=0)
 {
   // Reset stats, in case we're using newly created db, accumulating stats
@@ -234,6 +443,7 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   seek_height = start_height;
   BootstrapFile bootstrap;
   std::streampos pos;
+  const bool indexed = BootstrapFile::is_indexed(import_file_path);
   // BootstrapFile bootstrap(import_file_path);
   uint64_t total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
   MINFO("bootstrap file last block number: " << total_source_blocks-1 << " (zero-based height)  total blocks: " << total_source_blocks);
@@ -261,6 +471,26 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   // 4 byte magic + (currently) 1024 byte header structures
   bootstrap.seek_to_first_chunk(import_file);
 
+  // indexed files are read a few chunks at a time, starting right at the
+  // chunk holding start_height
+  std::vector<bootstrap::chunk_index_entry> index;
+  std::deque<std::string> indexed_blocks;
+  size_t next_chunk = 0;
+  uint64_t skip_blocks = 0;
+  if (indexed)
+  {
+    if (!bootstrap.read_index(import_file, index) || index.empty())
+    {
+      MFATAL("Failed to read bootstrap file index");
+      return 2;
+    }
+    const auto it = std::upper_bound(index.begin(), index.end(), start_height,
+        [](uint64_t height, const bootstrap::chunk_index_entry &e) { return height < e.first_height; });
+    next_chunk = it == index.begin() ? 0 : it - index.begin() - 1;
+    skip_blocks = start_height - index[next_chunk].first_height;
+    MINFO("indexed bootstrap file, starting at chunk " << next_chunk << " of " << index.size());
+  }
+
   std::string str1;
   char buffer1[1024];
   char buffer_block[BUFFER_SIZE];
@@ -288,8 +518,18 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   std::cout << ENDL;
 
   std::vector<block_complete_entry> blocks;
+  std::vector<std::string> bulk_chunks;
+  uint64_t num_bulk = 0;
+  const uint64_t bulk_start_height = core.get_blockchain_storage().get_current_blockchain_height();
+  const std::vector<std::pair<std::string, std::string>> bulk_start_supply = opt_bulk ? core.get_blockchain_storage().get_db().get_circulating_supply() : std::vector<std::pair<std::string, std::string>>();
 
   // Skip to start_height before we start adding.
+  if (indexed)
+  {
+    bytes_read = 0;
+    h = start_height;
+  }
+  else
   {
     bool q2 = false;
     import_file.seekg(pos);
@@ -304,65 +544,95 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
   if (use_batch)
   {
-    uint64_t bytes, h2;
+    uint64_t bytes = 0, h2;
     bool q2;
-    pos = import_file.tellg();
-    bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-    if (import_file.eof())
-      import_file.clear();
-    import_file.seekg(pos);
+    if (!indexed)
+    {
+      pos = import_file.tellg();
+      bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+      if (import_file.eof())
+        import_file.clear();
+      import_file.seekg(pos);
+    }
     core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
   }
   while (! quit)
   {
-    uint32_t chunk_size;
-    import_file.read(buffer1, sizeof(chunk_size));
-    // TODO: bootstrap.read_chunk();
-    if (! import_file) {
-      std::cout << refresh_string;
-      MINFO("End of file reached");
-      quit = 1;
-      break;
-    }
-    bytes_read += sizeof(chunk_size);
-
-    str1.assign(buffer1, sizeof(chunk_size));
-    if (! ::serialization::parse_binary(str1, chunk_size))
-    {
-      throw std::runtime_error("Error in deserialization of chunk size");
-    }
-    MDEBUG("chunk_size: " << chunk_size);
-
-    if (chunk_size > BUFFER_SIZE)
+    if (indexed)
     {
-      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-      throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+      if (indexed_blocks.empty())
+      {
+        if (!read_indexed_chunks(bootstrap, import_file, index, next_chunk, indexed_blocks))
+        {
+          MFATAL("ERROR: failed to read chunks from bootstrap file");
+          return 2;
+        }
+        for (; skip_blocks && !indexed_blocks.empty(); --skip_blocks)
+          indexed_blocks.pop_front();
+      }
+      if (indexed_blocks.empty())
+      {
+        std::cout << refresh_string;
+        MINFO("End of file reached");
+        quit = 1;
+        break;
+      }
+      str1 = std::move(indexed_blocks.front());
+      indexed_blocks.pop_front();
+      bytes_read += str1.size();
     }
-    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+    else
     {
-      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
-    }
-    else if (chunk_size == 0) {
-      MFATAL("ERROR: chunk_size == 0");
-      return 2;
-    }
-    import_file.read(buffer_block, chunk_size);
-    if (! import_file) {
-      if (import_file.eof())
-      {
+      uint32_t chunk_size;
+      import_file.read(buffer1, sizeof(chunk_size));
+      // TODO: bootstrap.read_chunk();
+      if (! import_file) {
         std::cout << refresh_string;
-        MINFO("End of file reached - file was truncated");
+        MINFO("End of file reached");
         quit = 1;
         break;
       }
-      else
+      bytes_read += sizeof(chunk_size);
+
+      str1.assign(buffer1, sizeof(chunk_size));
+      if (! ::serialization::parse_binary(str1, chunk_size))
       {
-        MFATAL("ERROR: unexpected end of file: bytes read before error: "
-            << import_file.gcount() << " of chunk_size " << chunk_size);
+        throw std::runtime_error("Error in deserialization of chunk size");
+      }
+      MDEBUG("chunk_size: " << chunk_size);
+
+      if (chunk_size > BUFFER_SIZE)
+      {
+        MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
+        throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+      }
+      if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+      {
+        MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
+      }
+      else if (chunk_size == 0) {
+        MFATAL("ERROR: chunk_size == 0");
         return 2;
       }
+      import_file.read(buffer_block, chunk_size);
+      if (! import_file) {
+        if (import_file.eof())
+        {
+          std::cout << refresh_string;
+          MINFO("End of file reached - file was truncated");
+          quit = 1;
+          break;
+        }
+        else
+        {
+          MFATAL("ERROR: unexpected end of file: bytes read before error: "
+              << import_file.gcount() << " of chunk_size " << chunk_size);
+          return 2;
+        }
+      }
+      bytes_read += chunk_size;
+      str1.assign(buffer_block, chunk_size);
     }
-    bytes_read += chunk_size;
     MDEBUG("Total bytes read: " << bytes_read);
 
     if (h > block_stop)
@@ -378,7 +648,28 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
     try
     {
-      str1.assign(buffer_block, chunk_size);
+      // blocks are only handed to check_flush in order, so once one has gone
+      // there, the rest does too
+      if (opt_bulk && blocks.empty() && core.get_blockchain_storage().is_within_compiled_block_hash_area(h))
+      {
+        ++h;
+        if ((h-1) % 10 == 0)
+        {
+          std::cout << refresh_string << "block " << h-1
+            << " / " << block_stop
+            << "\r" << std::flush;
+        }
+        bulk_chunks.push_back(std::move(str1));
+        if (bulk_flush(core, bulk_chunks, blocks, false))
+        {
+          quit = 2;
+          break;
+        }
+        ++num_bulk;
+        ++num_imported;
+        continue;
+      }
+
       bootstrap::block_package bp;
       if (! ::serialization::parse_binary(str1, bp))
         throw std::runtime_error("Error in deserialization of chunk");
@@ -477,15 +768,18 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
           {
             if ((h-1) % db_batch_size == 0)
             {
-              uint64_t bytes, h2;
+              uint64_t bytes = 0, h2;
               bool q2;
               std::cout << refresh_string;
               // zero-based height
               std::cout << ENDL << "[- batch commit at height " << h-1 << " -]" << ENDL;
               core.get_blockchain_storage().get_db().batch_stop();
-              pos = import_file.tellg();
-              bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-              import_file.seekg(pos);
+              if (!indexed)
+              {
+                pos = import_file.tellg();
+                bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+                import_file.seekg(pos);
+              }
               core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
               std::cout << ENDL;
               core.get_blockchain_storage().get_db().show_stats();
@@ -508,9 +802,14 @@ quitting:
 
   if (opt_verify)
   {
-    int ret = check_flush(core, blocks, true);
+    int ret = quit > 1 ? 0 : bulk_flush(core, bulk_chunks, blocks, true);
+    if (ret)
+      return ret;
+    ret = check_flush(core, blocks, true);
     if (ret)
       return ret;
+    if (num_bulk && !check_circulating_supply(core, bulk_start_height, bulk_start_supply))
+      return 2;
   }
 
   if (use_batch)
@@ -571,11 +870,14 @@ int main(int argc, char* argv[])
     "Batch transactions for faster import", true};
   const command_line::arg_descriptor<bool> arg_resume =  {"resume",
     "Resume from current height if output database already exists", true};
+  const command_line::arg_descriptor<bool> arg_bulk =  {"bulk",
+    "Add blocks covered by the precompiled block hashes in large batches, without the txpool or tx verification", false};
 
   command_line::add_arg(desc_cmd_sett, arg_input_file);
   command_line::add_arg(desc_cmd_sett, arg_log_level);
   command_line::add_arg(desc_cmd_sett, arg_batch_size);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_bulk);
 
   command_line::add_arg(desc_cmd_only, arg_count_blocks);
   command_line::add_arg(desc_cmd_only, arg_pop_blocks);
@@ -609,6 +911,7 @@ int main(int argc, char* argv[])
   opt_resume    = command_line::get_arg(vm, arg_resume);
   block_stop    = command_line::get_arg(vm, arg_block_stop);
   db_batch_size = command_line::get_arg(vm, arg_batch_size);
+  opt_bulk      = command_line::get_arg(vm, arg_bulk);
 
   if (command_line::get_arg(vm, command_line::arg_help))
   {
@@ -627,6 +930,12 @@ int main(int argc, char* argv[])
     std::cerr << "Error: batch-size must be > 0" << ENDL;
     return 1;
   }
+  if (opt_bulk && !opt_verify)
+  {
+    std::cerr << "Error: bulk can't be used with an unverified import" << ENDL;
+    return 1;
+  }
+  db_batch_size_bulk = db_batch_size;
   if (opt_verify && command_line::is_arg_defaulted(vm, arg_batch_size))
   {
     // usually want batch size default lower if verify on, so progress can be
@@ -685,6 +994,7 @@ int main(int argc, char* argv[])
     MINFO("batch:   " << std::boolalpha << opt_batch << std::noboolalpha);
   }
   MINFO("resume:  " << std::boolalpha << opt_resume  << std::noboolalpha);
+  MINFO("bulk:    " << std::boolalpha << opt_bulk  << std::noboolalpha);
   MINFO("nettype: " << (opt_testnet ? "testnet" : opt_stagenet ? "stagenet" : "mainnet"));
 
   MINFO("bootstrap file path: " << import_file_path);
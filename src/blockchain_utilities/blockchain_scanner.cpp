@@ -27,7 +27,14 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <boost/thread/thread.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
 #include "common/command_line.h"
 #include "common/varint.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
@@ -48,177 +55,54 @@ namespace po = boost::program_options;
 using namespace epee;
 using namespace cryptonote;
 
-static bool stop_requested = false;
+static std::atomic<bool> stop_requested(false);
 
-int main(int argc, char* argv[])
+namespace
 {
-  TRY_ENTRY();
-
-  epee::string_tools::set_module_name_and_folder(argv[0]);
-
-  uint32_t log_level = 0;
-  uint64_t block_start = 0;
-  uint64_t block_stop = 0;
-
-  tools::on_startup();
-
-  boost::filesystem::path output_file_path;
-
-  po::options_description desc_cmd_only("Command line options");
-  po::options_description desc_cmd_sett("Command line options and settings options");
-  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
-  const command_line::arg_descriptor<uint64_t> arg_block_start  = {"block-start", "start at block number", block_start};
-  const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
-  const command_line::arg_descriptor<std::string> arg_delimiter  = {"delimiter", "\"<string>\"", DELIM};
-
-  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
-  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
-  command_line::add_arg(desc_cmd_sett, cryptonote::arg_stagenet_on);
-  command_line::add_arg(desc_cmd_sett, arg_log_level);
-  command_line::add_arg(desc_cmd_sett, arg_block_start);
-  command_line::add_arg(desc_cmd_sett, arg_block_stop);
-  command_line::add_arg(desc_cmd_sett, arg_delimiter);
-  command_line::add_arg(desc_cmd_only, command_line::arg_help);
-
-  po::options_description desc_options("Allowed options");
-  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
-
-  po::variables_map vm;
-  bool r = command_line::handle_error_helper(desc_options, [&]()
+  // supply movement of one asset within a block, from the conversion txs it contains
+  struct asset_supply_delta
   {
-    auto parser = po::command_line_parser(argc, argv).options(desc_options);
-    po::store(parser.run(), vm);
-    po::notify(vm);
-    return true;
-  });
-  if (! r)
-    return 1;
-
-  if (command_line::get_arg(vm, command_line::arg_help))
-  {
-    std::cout << "Haven '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << ENDL << ENDL;
-    std::cout << desc_options << std::endl;
-    return 1;
-  }
-
-  mlog_configure(mlog_get_default_log_path("haven-blockchain-scanner.log"), true);
-  if (!command_line::is_arg_defaulted(vm, arg_log_level))
-    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
-  else
-    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
-
-  LOG_PRINT_L0("Starting...");
-
-  std::string opt_data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
-  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
-  bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
-  network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
-  block_start = command_line::get_arg(vm, arg_block_start);
-  block_stop = command_line::get_arg(vm, arg_block_stop);
-  std::string delimiter = command_line::get_arg(vm, arg_delimiter);
-
-  LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
-  std::unique_ptr<Blockchain> core_storage;
-  tx_memory_pool m_mempool(*core_storage);
-  core_storage.reset(new Blockchain(m_mempool));
-  BlockchainDB *db = new_db();
-  if (db == NULL)
-  {
-    LOG_ERROR("Failed to initialize a database");
-    throw std::runtime_error("Failed to initialize a database");
-  }
-
-  boost::filesystem::path folder(opt_data_dir);
-  if (opt_stagenet) {
-    folder /= std::to_string(STAGENET_VERSION);
-  } else if (opt_testnet) {
-    folder /= std::to_string(TESTNET_VERSION);
-  }
-  folder /= db->get_db_name();
-  LOG_PRINT_L0("Loading blockchain from folder " << folder << " ...");
-  const std::string filename = folder.string();
-
-  try
+    boost::multiprecision::uint128_t burnt = 0;
+    boost::multiprecision::uint128_t minted = 0;
+    uint64_t conversions = 0;
+    uint64_t collateral_outputs = 0;
+    std::set<uint64_t> pricing_record_heights;
+  };
+
+  struct block_scan_result
   {
-    db->open(filename, DBF_RDONLY);
-  }
-  catch (const std::exception& e)
+    uint64_t height = 0;
+    crypto::hash hash = crypto::null_hash;
+    std::string report;
+    std::map<std::string, asset_supply_delta> supply;
+  };
+
+  // results of a range of blocks, only blocks with something to say are kept
+  struct chunk_scan_result
   {
-    LOG_PRINT_L0("Error opening database: " << e.what());
-    return 1;
-  }
-  r = core_storage->init(db, net_type);
-
-  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
-  LOG_PRINT_L0("Source blockchain storage initialized OK");
-
-  tools::signal_handler::install([](int type) {
-    stop_requested = true;
-  });
-
-  const uint64_t db_height = db->height();
-  if (!block_stop)
-      block_stop = db_height;
-  MINFO("Starting from height " << block_start << ", stopping at height " << block_stop);
-
-/*
- * The default output can be plotted with GnuPlot using these commands:
-set key autotitle columnhead
-set title "Haven Blockchain Growth"
-set timefmt "%Y-%m-%d"
-set xdata time
-set xrange ["2014-04-17":*]
-set format x "%Y-%m-%d"
-set yrange [0:*]
-set y2range [0:*]
-set ylabel "Txs/Day"
-set y2label "Bytes"
-set y2tics nomirror
-plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, '' using (timecolumn(1,"%Y-%m-%d")):7 axes x1y2 with lines
- */
+    bool ok = true;
+    uint64_t failed_height = 0;
+    std::string error;
+    std::vector<block_scan_result> blocks;
+  };
 
-  // spit out a comment that GnuPlot can use as an index
-  std::cout << ENDL << "# DATA" << ENDL;
-  std::cout << "Date" << delimiter << "Height" << delimiter << "Transaction ID" << delimiter << "Reason" << delimiter << "Extra Information";
-  std::cout << ENDL;
-
-#define MAX_INOUT	0xffffffff
-#define MAX_RINGS	0xffffffff
-
-  struct tm prevtm = {0}, currtm;
-  uint64_t prevsz = 0, currsz = 0;
-  uint64_t prevtxs = 0, currtxs = 0;
-  uint64_t currblks = 0;
-  uint32_t txhr[24] = {0};
-  unsigned int i;
-
-  for (uint64_t h = block_start; h < block_stop; ++h)
+  bool scan_block(BlockchainDB *db, uint64_t h, const std::string &delimiter, block_scan_result &result)
   {
+    std::ostringstream out;
     cryptonote::blobdata bd = db->get_block_blob_from_height(h);
     cryptonote::block blk;
     if (!cryptonote::parse_and_validate_block_from_blob(bd, blk))
     {
       LOG_PRINT_L0("Bad block from db");
-      return 1;
+      return false;
     }
-    time_t tt = blk.timestamp;
+    // each block is dated on its own, ranges are scanned out of order
+    struct tm currtm;
     char timebuf[64];
-    epee::misc_utils::get_gmt_time(tt, currtm);
-    if (!prevtm.tm_year)
-      prevtm = currtm;
-    // catch change of day
-    if (currtm.tm_mday > prevtm.tm_mday || (currtm.tm_mday == 1 && prevtm.tm_mday > 27))
-    {
-      // check for timestamp fudging around month ends
-      if (prevtm.tm_mday == 1 && currtm.tm_mday > 27)
-        goto skip;
-      strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &currtm);
-      prevtm = currtm;
-    }
-skip:
-    currsz += bd.size();
-    uint64_t coinbase_amount;
-    uint64_t tx_fee_amount = 0;
+    epee::misc_utils::get_gmt_time(blk.timestamp, currtm);
+    strftime(timebuf, sizeof(timebuf), "%Y-%m-%d", &currtm);
+    result.height = h;
+    result.hash = cryptonote::get_block_hash(blk);
     std::set<std::string> used_assets, miner_tx_assets;
     used_assets.insert("XHV");
 
@@ -249,13 +133,8 @@ skip:
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
       {
         LOG_PRINT_L0("Bad txn from db");
-        return 1;
+        return false;
       }
-      currsz += bd.size();
-      if (db->get_prunable_tx_blob(tx_id, bd))
-        currsz += bd.size();
-      currtxs++;
-
       // Set the offshore TX type flags
       bool offshore = false;
       bool onshore = false;
@@ -268,18 +147,18 @@ skip:
       offshore::pricing_record pr;
       cryptonote::transaction_type tx_type;
       if (!cryptonote::get_tx_asset_types(tx, tx.hash, source, dest, false)) {
-        std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "At least 1 input or 1 output of the tx was invalid" << delimiter << "get_tx_asset_types() failed : ";
+        out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "At least 1 input or 1 output of the tx was invalid" << delimiter << "get_tx_asset_types() failed : ";
         if (source.empty()) {
-          std::cout << "source is empty" << std::endl;
+          out << "source is empty" << std::endl;
         }
         if (dest.empty()) {
-          std::cout << "dest is empty" << std::endl;
+          out << "dest is empty" << std::endl;
         }
       }
       if (!cryptonote::get_tx_type(source, dest, tx_type)) {
-        std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "At least 1 input or 1 output of the tx was invalid" << delimiter << "get_tx_type() failed" << std::endl;
+        out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "At least 1 input or 1 output of the tx was invalid" << delimiter << "get_tx_type() failed" << std::endl;
       }
-      
+
       using t_type = cryptonote::transaction_type;
       if (tx_type == t_type::OFFSHORE) {
         offshore = true;
@@ -297,18 +176,31 @@ skip:
 
       // Add the source currency to the list of expected ones
       used_assets.insert(source);
-        
+
+      // same rule as the circ_supply table
+      if (tx.version >= OFFSHORE_TRANSACTION_VERSION && source != dest && !source.empty() && !dest.empty()) {
+        asset_supply_delta &burnt = result.supply[source];
+        burnt.burnt += tx.amount_burnt;
+        ++burnt.conversions;
+        burnt.collateral_outputs += tx.collateral_indices.size();
+        burnt.pricing_record_heights.insert(tx.pricing_record_height);
+        asset_supply_delta &minted = result.supply[dest];
+        minted.minted += tx.amount_minted;
+        ++minted.conversions;
+        minted.pricing_record_heights.insert(tx.pricing_record_height);
+      }
+
       if ((offshore && !tx.rct_signatures.txnOffshoreFee) ||
           (onshore && !tx.rct_signatures.txnOffshoreFee_usd) ||
           (xusd_to_xasset && !tx.rct_signatures.txnOffshoreFee_usd) ||
           (xasset_to_xusd && !tx.rct_signatures.txnOffshoreFee_xasset)) {
-        std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "Missing conversion fee." << delimiter << "" <<
+        out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "Missing conversion fee." << delimiter << "" <<
           "Source:" << source << ", dest:" << dest <<
           ", XHV fees:" << tx.rct_signatures.txnFee << "," << tx.rct_signatures.txnOffshoreFee <<
           ", XUSD fees:" << tx.rct_signatures.txnFee_usd << "," << tx.rct_signatures.txnOffshoreFee_usd <<
           ", burnt:" << tx.amount_burnt << ", minted:" << tx.amount_minted << std::endl;
       } else if ((offshore || onshore || xusd_to_xasset || xasset_to_xusd) && (!tx.amount_burnt || !tx.amount_minted)) {
-        std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "Missing burnt/minted value." << std::endl;
+        out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "Missing burnt/minted value." << std::endl;
       }
 
       // Only run these checks for conversions
@@ -316,7 +208,7 @@ skip:
 
         // Check PR record is not too old
         if (h > (tx.pricing_record_height + 10)) {
-          std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "pricing record used by tx was too old" <<
+          out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "pricing record used by tx was too old" <<
             delimiter << "tx.pricing_record_height = " << tx.pricing_record_height << std::endl;
         }
 
@@ -325,12 +217,12 @@ skip:
         cryptonote::block blk_pr;
         if (!cryptonote::parse_and_validate_block_from_blob(bd_pr, blk_pr)) {
           LOG_PRINT_L0("Bad block from db");
-          return 1;
+          return false;
         }
 
         // Get a more convenient handle on the conversion PR
         pr = blk_pr.pricing_record;
-        
+
         // Verify the fees in 128-bit space
         boost::multiprecision::uint128_t burnt_128 = tx.amount_burnt;
         boost::multiprecision::uint128_t minted_128 = tx.amount_minted;
@@ -342,7 +234,7 @@ skip:
         boost::multiprecision::uint128_t fee;
         if (offshore) {
           if (fees_version >= 3) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid fee version " << fees_version << "" << delimiter << "..." << std::endl;
           } else if (fees_version == 2) {
 
@@ -374,14 +266,14 @@ skip:
           }
 
           if ((h >= 658500) && (fee != tx.rct_signatures.txnOffshoreFee)) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid fee " << tx.rct_signatures.txnOffshoreFee << "" << delimiter << "check:" << fee << std::endl;
           }
-        
+
         } else if (onshore) {
-          
+
           if (fees_version >= 3) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid fee version " << fees_version << "" << delimiter << "..." << std::endl;
           } else if (fees_version == 2) {
 
@@ -390,9 +282,9 @@ skip:
               (blocks_to_unlock >= 1430) ? (tx.amount_burnt / 20) :
               (blocks_to_unlock >= 710) ? (tx.amount_burnt / 10) :
               tx.amount_burnt / 5;
-            
+
           } else {
-            
+
             // Calculate the priority based on the unlock time
             uint64_t priority =
               (blocks_to_unlock >= 5030) ? 1 :
@@ -413,7 +305,7 @@ skip:
           }
 
           if ((h >= 658500) && (fee != tx.rct_signatures.txnOffshoreFee_usd)) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid offshore fee " << tx.rct_signatures.txnOffshoreFee_usd << "" << delimiter << "check:" << fee << std::endl;
           }
 
@@ -422,9 +314,9 @@ skip:
           fee = tx.amount_burnt;
           fee *= 3;
           fee /= 1000;
-          
+
           if (fee != tx.rct_signatures.txnOffshoreFee_usd) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid xusd_to_xasset fee " << tx.rct_signatures.txnOffshoreFee_usd << "" << delimiter << "check:" << fee << std::endl;
           }
 
@@ -433,26 +325,26 @@ skip:
           fee = tx.amount_burnt;
           fee *= 3;
           fee /= 1000;
-          
+
           if (fee != tx.rct_signatures.txnOffshoreFee_xasset) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter
                       << "invalid xasset_to_xusd fee " << tx.rct_signatures.txnOffshoreFee_xasset << "" << delimiter << "check:" << fee << std::endl;
           }
 
         }
-        
+
         // Check for 0 price in the source or destination currency
         if (offshore|| xusd_to_xasset) {
           if (!pr[dest]) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "0 exchange rate used for dest " << dest << "" << delimiter << "..." << std::endl;
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "0 exchange rate used for dest " << dest << "" << delimiter << "..." << std::endl;
           } else if (pr[dest] == 1000000000000) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "1.0000 exchange rate used for dest " << dest << "" << delimiter << "..." << std::endl;
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "1.0000 exchange rate used for dest " << dest << "" << delimiter << "..." << std::endl;
           }
         } else if (onshore || xasset_to_xusd) {
           if (!pr[source]) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "0 exchange rate used for source " << source << "" << delimiter << "..." << std::endl;
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "0 exchange rate used for source " << source << "" << delimiter << "..." << std::endl;
           } else if (pr[source] == 1000000000000) {
-            std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "1.0000 exchange rate used for source " << source << "" << delimiter << "..." << std::endl;
+            out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << tx_id << "" << delimiter << "1.0000 exchange rate used for source " << source << "" << delimiter << "..." << std::endl;
           }
         }
       }
@@ -462,23 +354,321 @@ skip:
     if (used_assets == miner_tx_assets) {
     } else if (used_assets.empty() && (miner_tx_assets.size() == 1) && (miner_tx_assets.count("XHV") == 1)) {
     } else {
-      std::cout << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << blk.miner_tx.hash << "" << delimiter << "Mismatch in miner reward assets detected" << delimiter << "Used assets = { ";
+      out << timebuf << "" << delimiter << "" << h << "" << delimiter << "" << blk.miner_tx.hash << "" << delimiter << "Mismatch in miner reward assets detected" << delimiter << "Used assets = { ";
       for (auto const &i: used_assets)
-        std::cout << i << " ";
-      std::cout << "}, miner_tx claimed { ";
+        out << i << " ";
+      out << "}, miner_tx claimed { ";
       for (auto const &i: miner_tx_assets)
-        std::cout << i << " ";
-      std::cout << "}" << std::endl;
+        out << i << " ";
+      out << "}" << std::endl;
+    }
+
+    result.report = out.str();
+    return true;
+  }
+
+  void scan_chunk(BlockchainDB *db, uint64_t start, uint64_t stop, const std::string &delimiter, chunk_scan_result &chunk)
+  {
+    for (uint64_t h = start; h < stop && !stop_requested; ++h)
+    {
+      block_scan_result result;
+      try
+      {
+        if (!scan_block(db, h, delimiter, result))
+        {
+          chunk.ok = false;
+          chunk.failed_height = h;
+          return;
+        }
+      }
+      catch (const std::exception &e)
+      {
+        chunk.ok = false;
+        chunk.failed_height = h;
+        chunk.error = e.what();
+        return;
+      }
+      if (!result.report.empty() || !result.supply.empty())
+        chunk.blocks.push_back(std::move(result));
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  uint32_t log_level = 0;
+  uint64_t block_start = 0;
+  uint64_t block_stop = 0;
+
+  tools::on_startup();
+
+  boost::filesystem::path output_file_path;
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<uint64_t> arg_block_start  = {"block-start", "start at block number", block_start};
+  const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
+  const command_line::arg_descriptor<std::string> arg_delimiter  = {"delimiter", "\"<string>\"", DELIM};
+  const command_line::arg_descriptor<unsigned> arg_threads = {"threads", "Number of scanning threads", std::max(1u, std::thread::hardware_concurrency())};
+  const command_line::arg_descriptor<uint64_t> arg_chunk_size = {"chunk-size", "Number of blocks per work unit", 1000};
+  const command_line::arg_descriptor<std::string> arg_supply_ledger = {"supply-ledger", "Write per-block, per-asset supply changes to this file", ""};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_stagenet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_block_start);
+  command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_delimiter);
+  command_line::add_arg(desc_cmd_sett, arg_threads);
+  command_line::add_arg(desc_cmd_sett, arg_chunk_size);
+  command_line::add_arg(desc_cmd_sett, arg_supply_ledger);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    auto parser = po::command_line_parser(argc, argv).options(desc_options);
+    po::store(parser.run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Haven '" << MONERO_RELEASE_NAME << "' (v" << MONERO_VERSION_FULL << ")" << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("haven-blockchain-scanner.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  LOG_PRINT_L0("Starting...");
+
+  std::string opt_data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+  bool opt_stagenet = command_line::get_arg(vm, cryptonote::arg_stagenet_on);
+  network_type net_type = opt_testnet ? TESTNET : opt_stagenet ? STAGENET : MAINNET;
+  block_start = command_line::get_arg(vm, arg_block_start);
+  block_stop = command_line::get_arg(vm, arg_block_stop);
+  std::string delimiter = command_line::get_arg(vm, arg_delimiter);
+  const unsigned threads = std::max(1u, command_line::get_arg(vm, arg_threads));
+  const uint64_t chunk_size = std::max<uint64_t>(1, command_line::get_arg(vm, arg_chunk_size));
+  const std::string supply_ledger_path = command_line::get_arg(vm, arg_supply_ledger);
+
+  LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
+  std::unique_ptr<Blockchain> core_storage;
+  tx_memory_pool m_mempool(*core_storage);
+  core_storage.reset(new Blockchain(m_mempool));
+  BlockchainDB *db = new_db();
+  if (db == NULL)
+  {
+    LOG_ERROR("Failed to initialize a database");
+    throw std::runtime_error("Failed to initialize a database");
+  }
+
+  boost::filesystem::path folder(opt_data_dir);
+  if (opt_stagenet) {
+    folder /= std::to_string(STAGENET_VERSION);
+  } else if (opt_testnet) {
+    folder /= std::to_string(TESTNET_VERSION);
+  }
+  folder /= db->get_db_name();
+  LOG_PRINT_L0("Loading blockchain from folder " << folder << " ...");
+  const std::string filename = folder.string();
+
+  try
+  {
+    db->open(filename, DBF_RDONLY);
+  }
+  catch (const std::exception& e)
+  {
+    LOG_PRINT_L0("Error opening database: " << e.what());
+    return 1;
+  }
+  r = core_storage->init(db, net_type);
+
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
+  LOG_PRINT_L0("Source blockchain storage initialized OK");
+
+  tools::signal_handler::install([](int type) {
+    stop_requested = true;
+  });
+
+  const uint64_t db_height = db->height();
+  if (!block_stop)
+      block_stop = db_height;
+  MINFO("Starting from height " << block_start << ", stopping at height " << block_stop);
+
+/*
+ * The default output can be plotted with GnuPlot using these commands:
+set key autotitle columnhead
+set title "Haven Blockchain Growth"
+set timefmt "%Y-%m-%d"
+set xdata time
+set xrange ["2014-04-17":*]
+set format x "%Y-%m-%d"
+set yrange [0:*]
+set y2range [0:*]
+set ylabel "Txs/Day"
+set y2label "Bytes"
+set y2tics nomirror
+plot 'stats.csv' index "DATA" using (timecolumn(1,"%Y-%m-%d")):4 with lines, '' using (timecolumn(1,"%Y-%m-%d")):7 axes x1y2 with lines
+ */
+
+  // spit out a comment that GnuPlot can use as an index
+  std::cout << ENDL << "# DATA" << ENDL;
+  std::cout << "Date" << delimiter << "Height" << delimiter << "Transaction ID" << delimiter << "Reason" << delimiter << "Extra Information";
+  std::cout << ENDL;
+
+  std::ofstream supply_ledger;
+  if (!supply_ledger_path.empty())
+  {
+    supply_ledger.open(supply_ledger_path, std::ios_base::out | std::ios_base::trunc);
+    if (!supply_ledger)
+    {
+      LOG_PRINT_L0("Failed to open supply ledger " << supply_ledger_path);
+      return 1;
+    }
+    supply_ledger << "# SUPPLY" << ENDL;
+    supply_ledger << "Height" << delimiter << "Block hash" << delimiter << "Asset" << delimiter << "Burnt" << delimiter << "Minted" << delimiter
+                  << "Net change" << delimiter << "Cumulative net" << delimiter << "Conversions" << delimiter << "Collateral outputs" << delimiter
+                  << "Pricing record heights" << ENDL;
+  }
+
+  // Blocks are scanned in chunks by a pool of workers, each with its own
+  // read txn, and merged back in height order so the output matches a
+  // sequential scan. Workers stay within a window of the next chunk to be
+  // written so memory use is bounded.
+  const uint64_t chunks = block_stop > block_start ? (block_stop - block_start + chunk_size - 1) / chunk_size : 0;
+  const uint64_t window = threads * 4;
+  std::atomic<uint64_t> next_chunk(0);
+  uint64_t emit_chunk = 0;
+  std::map<uint64_t, chunk_scan_result> done;
+  std::mutex done_mutex;
+  std::condition_variable done_cond;
+
+  auto worker = [&]() {
+    while (!stop_requested)
+    {
+      uint64_t c;
+      {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_cond.wait(lock, [&]() { return stop_requested || next_chunk >= chunks || next_chunk < emit_chunk + window; });
+        if (stop_requested || next_chunk >= chunks)
+          break;
+        c = next_chunk++;
+      }
+      const uint64_t start = block_start + c * chunk_size;
+      chunk_scan_result chunk;
+      scan_chunk(db, start, std::min(start + chunk_size, block_stop), delimiter, chunk);
+      {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.emplace(c, std::move(chunk));
+      }
+      done_cond.notify_all();
     }
-    
-    currblks++;
+  };
 
-    if (stop_requested)
+  // boost threads, so the per-thread read txns are cleaned up on exit
+  std::vector<boost::thread> workers;
+  for (unsigned t = 0; t < std::min<uint64_t>(threads, chunks); ++t)
+    workers.emplace_back(worker);
+
+  std::map<std::string, boost::multiprecision::int128_t> cumulative;
+  bool ok = true;
+  while (emit_chunk < chunks)
+  {
+    chunk_scan_result chunk;
+    {
+      std::unique_lock<std::mutex> lock(done_mutex);
+      done_cond.wait_for(lock, std::chrono::milliseconds(100), [&]() { return stop_requested || done.count(emit_chunk); });
+      if (stop_requested)
+        break;
+      auto it = done.find(emit_chunk);
+      if (it == done.end())
+        continue;
+      chunk = std::move(it->second);
+      done.erase(it);
+      ++emit_chunk;
+    }
+    done_cond.notify_all();
+
+    for (const block_scan_result &result: chunk.blocks)
+    {
+      std::cout << result.report;
+      for (const auto &i: result.supply)
+      {
+        const asset_supply_delta &delta = i.second;
+        const boost::multiprecision::int128_t net = boost::multiprecision::int128_t(delta.minted) - boost::multiprecision::int128_t(delta.burnt);
+        boost::multiprecision::int128_t &total = cumulative[i.first];
+        total += net;
+        if (!supply_ledger.is_open())
+          continue;
+        supply_ledger << result.height << delimiter << result.hash << delimiter << i.first << delimiter << delta.burnt << delimiter << delta.minted
+                      << delimiter << net << delimiter << total << delimiter << delta.conversions << delimiter << delta.collateral_outputs << delimiter;
+        const char *sep = "";
+        for (uint64_t pr_height: delta.pricing_record_heights)
+        {
+          supply_ledger << sep << pr_height;
+          sep = " ";
+        }
+        supply_ledger << ENDL;
+      }
+    }
+    if (!chunk.ok)
+    {
+      LOG_PRINT_L0("Failed to scan block " << chunk.failed_height << (chunk.error.empty() ? "" : ": ") << chunk.error);
+      ok = false;
+      stop_requested = true;
       break;
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(done_mutex);
+    if (emit_chunk < chunks)
+      stop_requested = true;
+  }
+  done_cond.notify_all();
+  for (auto &t: workers)
+    t.join();
+
+  // a scan of the whole chain must add up to the circ_supply tally
+  if (ok && !stop_requested && supply_ledger.is_open() && block_start == 0 && block_stop == db_height)
+  {
+    const uint64_t coinbase = db_height ? db->get_block_already_generated_coins(db_height - 1) : 0;
+    supply_ledger << ENDL << "# TALLY" << ENDL;
+    supply_ledger << "Asset" << delimiter << "Scanned net" << delimiter << "Database supply" << delimiter << "Database net" << delimiter << "Difference" << ENDL;
+    for (const auto &i: db->get_circulating_supply())
+    {
+      boost::multiprecision::int128_t db_net(i.second);
+      if (i.first == "XHV")
+        db_net -= coinbase;
+      const auto it = cumulative.find(i.first);
+      const boost::multiprecision::int128_t scanned = it == cumulative.end() ? 0 : it->second;
+      supply_ledger << i.first << delimiter << scanned << delimiter << i.second << delimiter << db_net << delimiter << (scanned - db_net) << ENDL;
+      if (scanned != db_net)
+        MWARNING("Supply mismatch for " << i.first << ": scanned " << scanned << ", database " << db_net);
+    }
   }
 
   core_storage->deinit();
-  return 0;
+  return ok ? 0 : 1;
 
   CATCH_ENTRY("Stats reporting error", 1);
 }
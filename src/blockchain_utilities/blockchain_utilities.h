@@ -38,3 +38,8 @@
 #define NUM_BLOCKS_PER_CHUNK 1
 #define BLOCKCHAIN_RAW "blockchain.raw"
 
+// indexed files: chunks are cut once they reach the target size
+#define INDEXED_CHUNK_TARGET_SIZE (1024 * 1024)
+#define INDEXED_CHUNK_MAX_SIZE (16 * 1024 * 1024)
+#define INDEXED_DEFAULT_COMPRESSION_LEVEL 3
+
@@ -26,6 +26,11 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/crc.hpp>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "bootstrap_serialization.h"
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
@@ -47,32 +52,75 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // Likewise, from:
+  // echo Haven indexed bootstrap file | sha1sum
+  // echo Haven bootstrap index | sha1sum
+  const uint32_t blockchain_indexed_magic = 0x587d670b;
+  const uint32_t index_footer_magic = 0x848d0bb3;
+
   std::string refresh_string = "\r                                    \r";
-}
 
+  uint32_t get_checksum(const std::string& data)
+  {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+  }
 
+  template<typename T>
+  size_t get_serialized_size()
+  {
+    T t = AUTO_VAL_INIT(t);
+    return t_serializable_object_to_blob(t).size();
+  }
 
-bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
-{
-  const boost::filesystem::path dir_path = file_path.parent_path();
-  if (!dir_path.empty())
+  template<typename T>
+  bool read_object(std::ifstream& import_file, T& t)
+  {
+    std::string str1(get_serialized_size<T>(), 0);
+    import_file.read(&str1[0], str1.size());
+    if (! import_file)
+      return false;
+    return ::serialization::parse_binary(str1, t);
+  }
+
+  bool create_parent_directory(const boost::filesystem::path& file_path)
   {
-    if (boost::filesystem::exists(dir_path))
+    const boost::filesystem::path dir_path = file_path.parent_path();
+    if (!dir_path.empty())
     {
-      if (!boost::filesystem::is_directory(dir_path))
+      if (boost::filesystem::exists(dir_path))
       {
-        MFATAL("export directory path is a file: " << dir_path);
-        return false;
+        if (!boost::filesystem::is_directory(dir_path))
+        {
+          MFATAL("export directory path is a file: " << dir_path);
+          return false;
+        }
       }
-    }
-    else
-    {
-      if (!boost::filesystem::create_directory(dir_path))
+      else
       {
-        MFATAL("Failed to create directory " << dir_path);
-        return false;
+        if (!boost::filesystem::create_directory(dir_path))
+        {
+          MFATAL("Failed to create directory " << dir_path);
+          return false;
+        }
       }
     }
+    return true;
+  }
+}
+
+
+
+bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
+{
+  if (!create_parent_directory(file_path))
+    return false;
+
+  if (boost::filesystem::exists(file_path) && is_indexed(file_path.string()))
+  {
+    MFATAL("existing file is in the indexed format: " << file_path);
+    return false;
   }
 
   m_raw_data_file = new std::ofstream();
@@ -112,9 +160,9 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
 }
 
 
-bool BootstrapFile::initialize_file()
+bool BootstrapFile::initialize_file(bool indexed)
 {
-  const uint32_t file_magic = blockchain_raw_magic;
+  const uint32_t file_magic = indexed ? blockchain_indexed_magic : blockchain_raw_magic;
 
   std::string blob;
   if (! ::serialization::dump_binary(file_magic, blob))
@@ -124,8 +172,8 @@ bool BootstrapFile::initialize_file()
   *m_raw_data_file << blob;
 
   bootstrap::file_info bfi;
-  bfi.major_version = 0;
-  bfi.minor_version = 1;
+  bfi.major_version = indexed ? 1 : 0;
+  bfi.minor_version = indexed ? 0 : 1;
   bfi.header_size = header_size;
 
   bootstrap::blocks_info bbi;
@@ -208,6 +256,12 @@ void BootstrapFile::flush_chunk()
 }
 
 void BootstrapFile::write_block(block& block)
+{
+  blobdata bd = get_block_blob(block);
+  m_output_stream->write((const char*)bd.data(), bd.size());
+}
+
+blobdata BootstrapFile::get_block_blob(block& block)
 {
   bootstrap::block_package bp;
   bp.block = block;
@@ -245,8 +299,7 @@ void BootstrapFile::write_block(block& block)
     bp.coins_generated = coins_generated;
   }
 
-  blobdata bd = t_serializable_object_to_blob(bp);
-  m_output_stream->write((const char*)bd.data(), bd.size());
+  return t_serializable_object_to_blob(bp);
 }
 
 bool BootstrapFile::close()
@@ -337,7 +390,7 @@ uint64_t BootstrapFile::seek_to_first_chunk(std::ifstream& import_file)
   if (! ::serialization::parse_binary(str1, file_magic))
     throw std::runtime_error("Error in deserialization of file_magic");
 
-  if (file_magic != blockchain_raw_magic)
+  if (file_magic != blockchain_raw_magic && file_magic != blockchain_indexed_magic)
   {
     MFATAL("bootstrap file not recognized");
     throw std::runtime_error("Aborting");
@@ -460,6 +513,20 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
     throw std::runtime_error("Aborting");
   }
 
+  if (is_indexed(import_file_path))
+  {
+    // no need to scan, and callers seek by height through the index
+    std::vector<bootstrap::chunk_index_entry> index;
+    if (!read_index(import_file, index))
+      throw std::runtime_error("Aborting: failed to read bootstrap file index");
+    if (!index.empty())
+      h = index.back().first_height + index.back().block_count;
+    seek_height = 0;
+    std::cout << "Indexed bootstrap file, chunks: " << index.size() << ENDL;
+    std::cout << "Number of blocks: " << h << ENDL;
+    return h;
+  }
+
   uint64_t full_header_size; // 4 byte magic + length of header structures
   full_header_size = seek_to_first_chunk(import_file);
 
@@ -501,3 +568,354 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
   // one-based height.
   return h;
 }
+
+bool BootstrapFile::is_indexed(const std::string& import_file_path)
+{
+  std::ifstream import_file;
+  import_file.open(import_file_path, std::ios_base::binary | std::ifstream::in);
+  uint32_t file_magic;
+  if (import_file.fail() || !read_object(import_file, file_magic))
+    return false;
+  return file_magic == blockchain_indexed_magic;
+}
+
+// If the file has no valid index, e.g. because an export was interrupted,
+// it is rebuilt from the chunk headers, up to the last complete chunk.
+bool BootstrapFile::read_index(std::ifstream& import_file, std::vector<bootstrap::chunk_index_entry>& index, uint64_t* data_end)
+{
+  index.clear();
+  import_file.clear();
+  import_file.seekg(0, std::ios_base::end);
+  const uint64_t file_size = import_file.tellg();
+  import_file.seekg(0);
+  const uint64_t full_header_size = seek_to_first_chunk(import_file);
+
+  const size_t footer_size = get_serialized_size<bootstrap::index_footer>();
+  bootstrap::index_footer footer;
+  if (file_size >= full_header_size + footer_size)
+  {
+    import_file.seekg(file_size - footer_size);
+    if (read_object(import_file, footer) && footer.magic == index_footer_magic && footer.index_offset >= full_header_size
+        && footer.index_offset + footer.index_size + footer_size == file_size)
+    {
+      std::string str1(footer.index_size, 0);
+      import_file.seekg(footer.index_offset);
+      import_file.read(&str1[0], str1.size());
+      bootstrap::chunk_index chunk_index;
+      if (import_file && get_checksum(str1) == footer.index_checksum && ::serialization::parse_binary(str1, chunk_index))
+      {
+        index = std::move(chunk_index.chunks);
+        if (data_end)
+          *data_end = footer.index_offset;
+        import_file.clear();
+        return true;
+      }
+    }
+    MWARNING("Bootstrap file index is missing or damaged, scanning chunks");
+  }
+
+  const size_t chunk_header_size = get_serialized_size<bootstrap::chunk_header>();
+  uint64_t pos = full_header_size, h = 0;
+  import_file.clear();
+  import_file.seekg(pos);
+  while (pos + chunk_header_size <= file_size)
+  {
+    bootstrap::chunk_header header;
+    if (!read_object(import_file, header) || header.block_count == 0)
+      break;
+    if (pos + chunk_header_size + header.stored_size > file_size)
+      break;
+    index.push_back({h, pos, header.block_count});
+    h += header.block_count;
+    pos += chunk_header_size + header.stored_size;
+    import_file.seekg(pos);
+  }
+  if (data_end)
+    *data_end = pos;
+  import_file.clear();
+  return true;
+}
+
+bool BootstrapFile::read_chunk(std::ifstream& import_file, const bootstrap::chunk_index_entry& entry, bootstrap::chunk_header& header, std::string& stored)
+{
+  import_file.seekg(entry.offset);
+  if (!read_object(import_file, header))
+  {
+    MERROR("Error reading chunk header at offset " << entry.offset);
+    return false;
+  }
+  if (header.block_count != entry.block_count || header.raw_size > INDEXED_CHUNK_MAX_SIZE || header.stored_size > 2 * INDEXED_CHUNK_MAX_SIZE)
+  {
+    MERROR("Invalid chunk header at offset " << entry.offset);
+    return false;
+  }
+  stored.resize(header.stored_size);
+  import_file.read(&stored[0], stored.size());
+  if (! import_file)
+  {
+    MERROR("Unexpected end of file in chunk at offset " << entry.offset);
+    return false;
+  }
+  return true;
+}
+
+bool BootstrapFile::decode_chunk(const bootstrap::chunk_header& header, const std::string& stored, std::vector<std::string>& blocks)
+{
+  if (get_checksum(stored) != header.checksum)
+  {
+    MERROR("Chunk checksum mismatch");
+    return false;
+  }
+
+  std::string decompressed;
+  const std::string* raw = &stored;
+  switch (header.compression)
+  {
+    case bootstrap::chunk_compression_none:
+      break;
+    case bootstrap::chunk_compression_zstd:
+    {
+#ifdef HAVE_ZSTD
+      decompressed.resize(header.raw_size);
+      const size_t size = ZSTD_decompress(&decompressed[0], decompressed.size(), stored.data(), stored.size());
+      if (ZSTD_isError(size) || size != header.raw_size)
+      {
+        MERROR("Failed to decompress chunk" << (ZSTD_isError(size) ? std::string(": ") + ZSTD_getErrorName(size) : std::string()));
+        return false;
+      }
+      raw = &decompressed;
+      break;
+#else
+      MERROR("Chunk is compressed with zstd, but zstd support was not built in");
+      return false;
+#endif
+    }
+    default:
+      MERROR("Unknown chunk compression " << unsigned(header.compression));
+      return false;
+  }
+  if (raw->size() != header.raw_size)
+  {
+    MERROR("Unexpected chunk size");
+    return false;
+  }
+
+  uint64_t pos = 0;
+  blocks.clear();
+  blocks.reserve(header.block_count);
+  for (uint32_t i = 0; i < header.block_count; ++i)
+  {
+    uint32_t block_size;
+    if (raw->size() - pos < sizeof(block_size) || ! ::serialization::parse_binary(raw->substr(pos, sizeof(block_size)), block_size))
+    {
+      MERROR("Error in deserialization of block size");
+      return false;
+    }
+    pos += sizeof(block_size);
+    if (raw->size() - pos < block_size)
+    {
+      MERROR("Block size exceeds chunk size");
+      return false;
+    }
+    blocks.push_back(raw->substr(pos, block_size));
+    pos += block_size;
+  }
+  if (pos != raw->size())
+  {
+    MERROR("Unexpected data after the last block in chunk");
+    return false;
+  }
+  return true;
+}
+
+bool BootstrapFile::open_indexed_writer(const boost::filesystem::path& file_path)
+{
+  if (!create_parent_directory(file_path))
+    return false;
+
+  m_raw_data_file = new std::ofstream();
+  m_output_stream = nullptr;
+  m_index.clear();
+  m_chunk_data.clear();
+  m_chunk_blocks = 0;
+  m_height = 0;
+
+  const bool do_initialize_file = !boost::filesystem::exists(file_path);
+  if (do_initialize_file)
+  {
+    MDEBUG("creating file");
+    m_raw_data_file->open(file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios::trunc);
+  }
+  else
+  {
+    if (!is_indexed(file_path.string()))
+    {
+      MFATAL("existing file is not in the indexed format: " << file_path);
+      return false;
+    }
+
+    // drop the index, it gets written again with the new chunks
+    std::ifstream import_file;
+    import_file.open(file_path.string(), std::ios_base::binary | std::ifstream::in);
+    uint64_t data_end = 0;
+    if (import_file.fail() || !read_index(import_file, m_index, &data_end))
+    {
+      MFATAL("failed to read the index of " << file_path);
+      return false;
+    }
+    import_file.close();
+    boost::filesystem::resize_file(file_path, data_end);
+    if (!m_index.empty())
+      m_height = m_index.back().first_height + m_index.back().block_count;
+    MDEBUG("appending to existing file with height: " << m_height-1 << "  total blocks: " << m_height);
+    m_raw_data_file->open(file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios::app | std::ios::ate);
+  }
+
+  if (m_raw_data_file->fail())
+    return false;
+
+  if (do_initialize_file)
+    initialize_file(true);
+
+  return true;
+}
+
+void BootstrapFile::flush_indexed_chunk()
+{
+  if (m_chunk_blocks == 0)
+    return;
+
+  bootstrap::chunk_header header;
+  header.compression = bootstrap::chunk_compression_none;
+  header.raw_size = m_chunk_data.size();
+  header.block_count = m_chunk_blocks;
+
+  std::string stored;
+#ifdef HAVE_ZSTD
+  if (m_compression_level > 0)
+  {
+    stored.resize(ZSTD_compressBound(m_chunk_data.size()));
+    const size_t size = ZSTD_compress(&stored[0], stored.size(), m_chunk_data.data(), m_chunk_data.size(), m_compression_level);
+    if (ZSTD_isError(size))
+      throw std::runtime_error(std::string("Error compressing chunk: ") + ZSTD_getErrorName(size));
+    stored.resize(size);
+    header.compression = bootstrap::chunk_compression_zstd;
+  }
+#endif
+  if (header.compression == bootstrap::chunk_compression_none)
+    stored.swap(m_chunk_data);
+  header.stored_size = stored.size();
+  header.checksum = get_checksum(stored);
+
+  bootstrap::chunk_index_entry entry;
+  entry.first_height = m_chunk_first_height;
+  entry.offset = m_raw_data_file->tellp();
+  entry.block_count = m_chunk_blocks;
+
+  *m_raw_data_file << t_serializable_object_to_blob(header);
+  m_raw_data_file->write(stored.data(), stored.size());
+  m_raw_data_file->flush();
+  if (m_raw_data_file->fail())
+  {
+    MFATAL("Error writing chunk:  height: " << m_chunk_first_height << "  chunk_size: " << stored.size());
+    throw std::runtime_error("Error writing chunk");
+  }
+  m_index.push_back(entry);
+
+  if (m_max_chunk < header.raw_size)
+    m_max_chunk = header.raw_size;
+  MDEBUG("flushed chunk:  blocks: " << m_chunk_blocks << "  raw size: " << header.raw_size << "  stored size: " << header.stored_size);
+  m_chunk_data.clear();
+  m_chunk_blocks = 0;
+}
+
+bool BootstrapFile::close_indexed()
+{
+  flush_indexed_chunk();
+
+  bootstrap::chunk_index chunk_index;
+  chunk_index.chunks = m_index;
+  const blobdata bd = t_serializable_object_to_blob(chunk_index);
+
+  bootstrap::index_footer footer;
+  footer.index_offset = m_raw_data_file->tellp();
+  footer.index_size = bd.size();
+  footer.index_checksum = get_checksum(bd);
+  footer.magic = index_footer_magic;
+
+  *m_raw_data_file << bd;
+  *m_raw_data_file << t_serializable_object_to_blob(footer);
+  m_raw_data_file->flush();
+  const bool r = !m_raw_data_file->fail();
+  delete m_raw_data_file;
+  return r;
+}
+
+bool BootstrapFile::store_blockchain_indexed(Blockchain* _blockchain_storage, boost::filesystem::path& output_file, uint64_t requested_block_stop, int compression_level)
+{
+  uint64_t num_blocks_written = 0;
+  m_max_chunk = 0;
+  m_blockchain_storage = _blockchain_storage;
+  m_tx_pool = NULL;
+  m_compression_level = compression_level;
+  uint64_t progress_interval = 100;
+#ifndef HAVE_ZSTD
+  if (m_compression_level > 0)
+    MWARNING("zstd support was not built in, chunks will not be compressed");
+#endif
+  MINFO("Storing blocks in indexed format...");
+  if (!open_indexed_writer(output_file))
+  {
+    MFATAL("failed to open indexed file for write");
+    return false;
+  }
+
+  uint64_t block_start = m_height;
+  uint64_t block_stop = 0;
+  MINFO("source blockchain height: " <<  m_blockchain_storage->get_current_blockchain_height()-1);
+  if ((requested_block_stop > 0) && (requested_block_stop < m_blockchain_storage->get_current_blockchain_height()))
+  {
+    MINFO("Using requested block height: " << requested_block_stop);
+    block_stop = requested_block_stop;
+  }
+  else
+  {
+    block_stop = m_blockchain_storage->get_current_blockchain_height() - 1;
+    MINFO("Using block height of source blockchain: " << block_stop);
+  }
+  block b;
+  for (m_cur_height = block_start; m_cur_height <= block_stop; ++m_cur_height)
+  {
+    crypto::hash hash = m_blockchain_storage->get_block_id_by_height(m_cur_height);
+    m_blockchain_storage->get_block_by_hash(hash, b);
+    const blobdata bd = get_block_blob(b);
+
+    uint32_t block_size = bd.size();
+    std::string blob;
+    if (! ::serialization::dump_binary(block_size, blob))
+      throw std::runtime_error("Error in serialization of block size");
+    if (m_chunk_blocks == 0)
+      m_chunk_first_height = m_cur_height;
+    m_chunk_data += blob;
+    m_chunk_data += bd;
+    ++m_chunk_blocks;
+    ++num_blocks_written;
+    if (m_chunk_data.size() >= INDEXED_CHUNK_TARGET_SIZE)
+      flush_indexed_chunk();
+
+    if (m_cur_height % progress_interval == 0) {
+      std::cout << refresh_string;
+      std::cout << "block " << m_cur_height << "/" << block_stop << "\r" << std::flush;
+    }
+  }
+  std::cout << refresh_string;
+  std::cout << "block " << m_cur_height-1 << "/" << block_stop << ENDL;
+
+  if (!close_indexed())
+    return false;
+
+  MINFO("Number of blocks exported: " << num_blocks_written);
+  if (num_blocks_written > 0)
+    MINFO("Largest chunk: " << m_max_chunk << " bytes");
+  return true;
+}
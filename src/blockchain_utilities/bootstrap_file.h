@@ -48,6 +48,7 @@
 #include "version.h"
 
 #include "blockchain_utilities.h"
+#include "bootstrap_serialization.h"
 
 
 using namespace cryptonote;
@@ -65,6 +66,15 @@ public:
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
       boost::filesystem::path& output_file, uint64_t use_block_height=0);
 
+  // indexed files, with compressed and checksummed multi-block chunks
+  bool store_blockchain_indexed(cryptonote::Blockchain* cs, boost::filesystem::path& output_file,
+      uint64_t use_block_height=0, int compression_level=INDEXED_DEFAULT_COMPRESSION_LEVEL);
+  static bool is_indexed(const std::string& import_file_path);
+  bool read_index(std::ifstream& import_file, std::vector<bootstrap::chunk_index_entry>& index, uint64_t* data_end = NULL);
+  static bool read_chunk(std::ifstream& import_file, const bootstrap::chunk_index_entry& entry, bootstrap::chunk_header& header, std::string& stored);
+  // CPU bound part of reading a chunk, safe to run on several chunks at once
+  static bool decode_chunk(const bootstrap::chunk_header& header, const std::string& stored, std::vector<std::string>& blocks);
+
 protected:
 
   Blockchain* m_blockchain_storage;
@@ -77,14 +87,23 @@ protected:
 
   // open export file for write
   bool open_writer(const boost::filesystem::path& file_path);
-  bool initialize_file();
+  bool initialize_file(bool indexed = false);
   bool close();
   void write_block(block& block);
+  blobdata get_block_blob(block& block);
   void flush_chunk();
+  bool open_indexed_writer(const boost::filesystem::path& file_path);
+  void flush_indexed_chunk();
+  bool close_indexed();
 
 private:
 
   uint64_t m_height;
   uint64_t m_cur_height; // tracks current height during export
   uint32_t m_max_chunk;
+  int m_compression_level;
+  uint32_t m_chunk_blocks;
+  uint64_t m_chunk_first_height;
+  std::string m_chunk_data;
+  std::vector<bootstrap::chunk_index_entry> m_index;
 };
@@ -83,6 +83,70 @@ namespace cryptonote
       END_SERIALIZE()
     };
 
+    // indexed files: each chunk holds several size-prefixed block_package
+    // blobs, optionally compressed, and is preceded by a chunk_header. A
+    // chunk_index and a fixed size index_footer follow the last chunk.
+
+    enum chunk_compression: uint8_t
+    {
+      chunk_compression_none = 0,
+      chunk_compression_zstd = 1,
+    };
+
+    struct chunk_header
+    {
+      uint8_t  compression;
+      uint32_t stored_size;  // bytes following the header
+      uint32_t raw_size;     // bytes once decompressed
+      uint32_t block_count;
+      uint32_t checksum;     // CRC-32 of the stored bytes
+
+      BEGIN_SERIALIZE_OBJECT()
+        FIELD(compression)
+        FIELD(stored_size)
+        FIELD(raw_size)
+        FIELD(block_count)
+        FIELD(checksum)
+      END_SERIALIZE()
+    };
+
+    struct chunk_index_entry
+    {
+      uint64_t first_height;
+      uint64_t offset;       // file position of the chunk_header
+      uint32_t block_count;
+
+      BEGIN_SERIALIZE_OBJECT()
+        VARINT_FIELD(first_height)
+        VARINT_FIELD(offset)
+        VARINT_FIELD(block_count)
+      END_SERIALIZE()
+    };
+
+    struct chunk_index
+    {
+      std::vector<chunk_index_entry> chunks;
+
+      BEGIN_SERIALIZE_OBJECT()
+        FIELD(chunks)
+      END_SERIALIZE()
+    };
+
+    struct index_footer
+    {
+      uint64_t index_offset;
+      uint32_t index_size;
+      uint32_t index_checksum;
+      uint32_t magic;
+
+      BEGIN_SERIALIZE_OBJECT()
+        FIELD(index_offset)
+        FIELD(index_size)
+        FIELD(index_checksum)
+        FIELD(magic)
+      END_SERIALIZE()
+    };
+
   }
 
 }
@@ -0,0 +1,144 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+namespace tools
+{
+  //! A blocked bloom filter, for sets where most lookups are expected to miss.
+  //! Each key sets a few bits in a single 64 byte block, so a lookup touches
+  //! one cache line. False positives are possible, false negatives are not,
+  //! so a positive answer must be confirmed against the real set. Keys must
+  //! be at least 16 bytes of mostly uniform data (hashes, public keys, key
+  //! images), no further hashing is done beyond mixing their first two words.
+  template<typename T>
+  class blocked_bloom_filter
+  {
+  public:
+    static_assert(sizeof(T) >= 2 * sizeof(uint64_t), "Key too small for blocked_bloom_filter");
+    static_assert(std::is_trivially_copyable<T>::value, "Key must be trivially copyable");
+
+    static constexpr size_t BITS_PER_ELEMENT = 16;
+    static constexpr size_t BITS_PER_KEY = 6;
+
+    blocked_bloom_filter(size_t expected_elements = 0) { reset(expected_elements); }
+
+    //! clears the filter and sizes it for the given number of elements;
+    //! with no elements, the filter matches everything until rebuilt
+    void reset(size_t expected_elements)
+    {
+      size_t n_blocks = 0;
+      if (expected_elements > 0)
+      {
+        n_blocks = 1;
+        while (n_blocks * ELEMENTS_PER_BLOCK < expected_elements)
+          n_blocks <<= 1;
+      }
+      m_blocks.clear();
+      m_blocks.resize(n_blocks);
+      m_mask = n_blocks ? n_blocks - 1 : 0;
+      m_elements = 0;
+    }
+
+    void insert(const T &key)
+    {
+      if (m_blocks.empty())
+        return;
+      uint64_t block_index, bits;
+      hash(key, block_index, bits);
+      block &b = m_blocks[block_index & m_mask];
+      for (size_t i = 0; i < BITS_PER_KEY; ++i, bits >>= 9)
+        b.words[(bits >> 6) & 7] |= ((uint64_t)1) << (bits & 63);
+      ++m_elements;
+    }
+
+    bool may_contain(const T &key) const
+    {
+      if (m_blocks.empty())
+        return true;
+      uint64_t block_index, bits;
+      hash(key, block_index, bits);
+      const block &b = m_blocks[block_index & m_mask];
+      for (size_t i = 0; i < BITS_PER_KEY; ++i, bits >>= 9)
+        if (!(b.words[(bits >> 6) & 7] & (((uint64_t)1) << (bits & 63))))
+          return false;
+      return true;
+    }
+
+    //! adds the contents of a filter of the same capacity, so parts of a
+    //! set can be added to separate filters in parallel
+    bool merge(const blocked_bloom_filter &other)
+    {
+      if (other.m_blocks.size() != m_blocks.size())
+        return false;
+      for (size_t i = 0; i < m_blocks.size(); ++i)
+        for (size_t w = 0; w < 8; ++w)
+          m_blocks[i].words[w] |= other.m_blocks[i].words[w];
+      m_elements += other.m_elements;
+      return true;
+    }
+
+    //! number of insertions since the last reset
+    size_t size() const { return m_elements; }
+    //! number of insertions the filter was sized for
+    size_t capacity() const { return m_blocks.size() * ELEMENTS_PER_BLOCK; }
+    //! true when the false positive rate would degrade with more insertions
+    bool full() const { return m_elements >= capacity(); }
+    size_t memory_usage() const { return m_blocks.size() * sizeof(block); }
+
+  private:
+    struct block { uint64_t words[8]; block() { memset(words, 0, sizeof(words)); } };
+    static constexpr size_t ELEMENTS_PER_BLOCK = sizeof(block) * 8 / BITS_PER_ELEMENT;
+
+    static uint64_t mix(uint64_t x)
+    {
+      x ^= x >> 33;
+      x *= 0xff51afd7ed558ccdull;
+      x ^= x >> 33;
+      x *= 0xc4ceb9fe1a85ec53ull;
+      x ^= x >> 33;
+      return x;
+    }
+
+    static void hash(const T &key, uint64_t &block_index, uint64_t &bits)
+    {
+      uint64_t w[2];
+      memcpy(w, &key, sizeof(w));
+      block_index = mix(w[0]);
+      bits = mix(w[1] ^ block_index);
+    }
+
+    std::vector<block> m_blocks;
+    size_t m_mask;
+    size_t m_elements;
+  };
+}
@@ -283,6 +283,39 @@ bool HardFork::rescan_from_chain_height(uint64_t height)
   return rescan_from_block_height(height - 1);
 }
 
+bool HardFork::follow_from_chain_height(uint64_t height)
+{
+  CRITICAL_REGION_LOCAL(lock);
+  db_rtxn_guard rtxn_guard(&db);
+  const uint64_t bc_height = db.height();
+  if (height == 0 || height > bc_height)
+    return false;
+
+  for (uint64_t h = height; h < bc_height; ++h) {
+    const uint8_t v = get_effective_version(get_block_vote(db.get_block_from_height(h)));
+    while (versions.size() >= window_size) {
+      const uint8_t old_version = versions.front();
+      assert(last_versions[old_version] >= 1);
+      last_versions[old_version]--;
+      versions.pop_front();
+    }
+    last_versions[v]++;
+    versions.push_back(v);
+  }
+
+  // the writer already recorded the version it applied to each block
+  const uint8_t lastv = db.get_hard_fork_version(bc_height - 1);
+  while (current_fork_index + 1 < heights.size() && heights[current_fork_index].version < lastv)
+    ++current_fork_index;
+
+  uint8_t voted = get_voted_fork_index(bc_height);
+  if (voted > current_fork_index) {
+    current_fork_index = voted;
+  }
+
+  return true;
+}
+
 void HardFork::on_block_popped(uint64_t nblocks)
 {
   CHECK_AND_ASSERT_THROW_MES(nblocks > 0, "nblocks must be greater than 0");
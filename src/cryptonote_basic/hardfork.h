@@ -150,6 +150,18 @@ namespace cryptonote
     bool reorganize_from_block_height(uint64_t height);
     bool reorganize_from_chain_height(uint64_t height);
 
+    /**
+     * @brief called when blocks were added to the db by another process
+     *
+     * Updates the voting window with the blocks from the given chain
+     * height up to the current db height, without writing to the db.
+     *
+     * returns true if no error, false otherwise
+     *
+     * @param height the chain height before the new blocks
+     */
+    bool follow_from_chain_height(uint64_t height);
+
     /**
      * @brief called when one or more blocks are popped from the blockchain
      *
@@ -105,6 +105,8 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
+  m_followed_top_hash(crypto::null_hash),
+  m_followed_height(0),
   m_btc_valid(false),
   m_batch_success(true),
   m_prepare_height(0)
@@ -856,8 +858,8 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   m_async_pool.create_thread(boost::bind(&boost::asio::io_service::run, &m_async_service));
 
 #if defined(PER_BLOCK_CHECKPOINT)
-  if (m_nettype != FAKECHAIN)
-    load_compiled_in_block_hashes(get_checkpoints);
+  // there is no compiled in data for FAKECHAIN, but tests may pass their own
+  load_compiled_in_block_hashes(get_checkpoints);
 #endif
 
   MINFO("Blockchain initialized. last block: " << m_db->height() - 1 << ", " << epee::misc_utils::get_time_interval_string(timestamp_diff) << " time ago, current difficulty: " << get_difficulty_for_next_block());
@@ -924,6 +926,11 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
     db_txn_guard txn_guard(m_db, m_db->is_read_only());
     if (!update_next_cumulative_weight_limit())
       return false;
+    if (m_db->is_read_only())
+    {
+      m_followed_top_hash = m_db->top_block_hash(&m_followed_height);
+      ++m_followed_height;
+    }
   }
   return true;
 }
@@ -979,6 +986,9 @@ bool Blockchain::deinit()
   m_async_pool.join_all();
   m_async_service.stop();
 
+  if (!m_txpool_store.store())
+    LOG_ERROR("Failed to save the txpool snapshot");
+
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
   // memory operation), otherwise we may cause a loop.
@@ -1016,6 +1026,7 @@ void Blockchain::pop_blocks(uint64_t nblocks)
 
   bool stop_batch = m_db->batch_start();
 
+  std::vector<std::pair<uint64_t, crypto::hash>> popped;
   try
   {
     const uint64_t blockchain_height = m_db->height();
@@ -1023,7 +1034,8 @@ void Blockchain::pop_blocks(uint64_t nblocks)
       nblocks = std::min(nblocks, blockchain_height - 1);
     while (i < nblocks)
     {
-      pop_block_from_blockchain();
+      const uint64_t height = m_db->height() - 1;
+      popped.emplace_back(height, get_block_hash(pop_block_from_blockchain()));
       ++i;
     }
   }
@@ -1037,6 +1049,9 @@ void Blockchain::pop_blocks(uint64_t nblocks)
 
   if (stop_batch)
     m_db->batch_stop();
+
+  for (const auto &p: popped)
+    notify_block_disconnected(p.first, p.second);
 }
 //------------------------------------------------------------------
 // This function tells BlockchainDB to remove the top block from the
@@ -1624,6 +1639,26 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
     for (const auto &bei: alt_chain)
       block_notify->notify("%s", epee::string_tools::pod_to_hex(get_block_hash(bei.bl)).c_str(), NULL);
 
+  if (!m_block_disconnected_callbacks.empty())
+  {
+    uint64_t height = split_height + disconnected_chain.size();
+    for (auto it = disconnected_chain.rbegin(); it != disconnected_chain.rend(); ++it)
+      notify_block_disconnected(--height, get_block_hash(*it));
+  }
+
+  if (!m_block_added_callbacks.empty())
+  {
+    for (const auto &bei: alt_chain)
+    {
+      std::vector<transaction> txs;
+      std::vector<crypto::hash> missed_txs;
+      get_transactions(bei.bl.tx_hashes, txs, missed_txs);
+      if (!missed_txs.empty())
+        MERROR("Block " << get_block_hash(bei.bl) << " has " << missed_txs.size() << " transactions missing from the db");
+      notify_block_added(bei.height, get_block_hash(bei.bl), bei.bl, txs);
+    }
+  }
+
   MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
   return true;
 }
@@ -5698,11 +5733,50 @@ leave: {
     std::shared_ptr<tools::Notify> block_notify = m_block_notify;
     if (block_notify)
       block_notify->notify("%s", epee::string_tools::pod_to_hex(id).c_str(), NULL);
+
+    if (!m_block_added_callbacks.empty())
+    {
+      std::vector<transaction> block_txs;
+      block_txs.reserve(txs.size());
+      for (const auto &tx: txs)
+        block_txs.push_back(tx.first);
+      notify_block_added(new_height - 1, id, bl, block_txs);
+    }
   }
 
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::notify_block_added(uint64_t height, const crypto::hash &id, const block &bl, const std::vector<transaction> &txs)
+{
+  for (const auto &notify: m_block_added_callbacks)
+  {
+    try
+    {
+      notify(height, id, bl, txs);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Block notification callback failed: " << e.what());
+    }
+  }
+}
+//------------------------------------------------------------------
+void Blockchain::notify_block_disconnected(uint64_t height, const crypto::hash &id)
+{
+  for (const auto &notify: m_block_disconnected_callbacks)
+  {
+    try
+    {
+      notify(height, id);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Block disconnection callback failed: " << e.what());
+    }
+  }
+}
+//------------------------------------------------------------------
 bool Blockchain::prune_blockchain(uint32_t pruning_seed)
 {
   m_tx_pool.lock();
@@ -5721,6 +5795,55 @@ bool Blockchain::update_blockchain_pruning()
   return m_db->update_pruning();
 }
 //------------------------------------------------------------------
+bool Blockchain::start_incremental_pruning(uint32_t pruning_seed)
+{
+  m_tx_pool.lock();
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  return m_db->start_incremental_pruning(pruning_seed);
+}
+//------------------------------------------------------------------
+bool Blockchain::prune_blockchain_step(size_t max_txes)
+{
+  // no locks: a step is a write txn of its own, which the DB serializes with
+  // block additions, and it only drops prunable data of blocks below the tip
+  return m_db->prune_blockchain_step(max_txes);
+}
+//------------------------------------------------------------------
+bool Blockchain::refresh_read_only_view()
+{
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+
+  db_rtxn_guard rtxn_guard(m_db);
+  uint64_t top_height;
+  const crypto::hash top_hash = m_db->top_block_hash(&top_height);
+  if (top_hash == m_followed_top_hash)
+    return false;
+
+  // if the blocks we saw are still there, only the new ones need scanning,
+  // otherwise the writer reorganized and we start over
+  const bool extended = m_followed_height > 0 && m_followed_height <= top_height
+      && m_db->get_block_hash_from_height(m_followed_height - 1) == m_followed_top_hash;
+  if (extended)
+    m_hardfork->follow_from_chain_height(m_followed_height);
+  else
+    m_hardfork->init();
+
+  m_timestamps_and_difficulties_height = 0;
+  m_reset_timestamps_and_difficulties_height = true;
+  invalidate_block_template_cache();
+  if (!update_next_cumulative_weight_limit())
+    return false;
+
+  if (m_followed_height > 0)
+    MINFO("Followed db to height " << top_height << ", top block " << top_hash << (extended ? "" : " (reorganized)"));
+  m_followed_top_hash = top_hash;
+  m_followed_height = top_height + 1;
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::check_blockchain_pruning()
 {
   m_tx_pool.lock();
@@ -6012,7 +6135,7 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
       {
         store_blockchain();
       }
-      else // db_nosync
+      else // db_nosync, db_pipelined
       {
         // DO NOTHING, not required to call sync.
       }
@@ -6187,6 +6310,95 @@ bool Blockchain::has_block_weights(uint64_t height, uint64_t nblocks) const
   return true;
 }
 
+bool Blockchain::add_prevalidated_blocks(const std::vector<prevalidated_block> &blocks, size_t &added)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+
+  added = 0;
+  for (const prevalidated_block &pb: blocks)
+  {
+    const uint64_t height = m_db->height();
+    if (!is_within_compiled_block_hash_area(height) || height >= m_blocks_hash_check.size())
+      break;
+    const auto &expected = m_blocks_hash_check[height];
+    if (expected.first == crypto::null_hash || expected.second == 0)
+      break;
+    if (pb.id != expected.first)
+    {
+      MERROR("Block with id " << pb.id << " at height " << height << " does not match the precompiled block hash " << expected.first);
+      return false;
+    }
+    if (pb.block_weight != expected.second)
+    {
+      MERROR("Block with id " << pb.id << " has weight " << pb.block_weight << ", expected " << expected.second);
+      return false;
+    }
+    if (pb.txs.size() != pb.bl.tx_hashes.size())
+    {
+      MERROR("Block with id " << pb.id << " has " << pb.txs.size() << " txes, expected " << pb.bl.tx_hashes.size());
+      return false;
+    }
+
+    // the miner tx isn't validated here, but the generated coins are derived
+    // from it the same way handle_block_to_main_chain does: XHV outputs minus
+    // the XHV fees it collects
+    uint64_t fees = 0;
+    for (size_t i = 0; i < pb.txs.size(); ++i)
+    {
+      const transaction &tx = pb.txs[i].first;
+      std::string source, dest;
+      if (!get_tx_asset_types(tx, pb.bl.tx_hashes[i], source, dest, false))
+      {
+        MERROR("Block with id " << pb.id << " has a tx with invalid asset types");
+        return false;
+      }
+      if (source != "XHV")
+        continue;
+      fees += tx.rct_signatures.txnFee;
+      if (source != dest)
+        fees += tx.rct_signatures.txnOffshoreFee;
+    }
+    const uint64_t money_in_use = get_outs_money_amount(pb.bl.miner_tx)["XHV"];
+    if (money_in_use < fees)
+    {
+      MERROR("Block with id " << pb.id << " has a miner tx claiming less than its fees");
+      return false;
+    }
+    const uint64_t base_reward = money_in_use - fees;
+    uint64_t already_generated_coins = height ? m_db->get_block_already_generated_coins(height - 1) : 0;
+    already_generated_coins = base_reward < (MONEY_SUPPLY - already_generated_coins) ? already_generated_coins + base_reward : MONEY_SUPPLY;
+
+    difficulty_type cumulative_difficulty = get_difficulty_for_next_block();
+    if (height)
+      cumulative_difficulty += m_db->get_block_cumulative_difficulty(height - 1);
+
+    try
+    {
+      uint64_t long_term_block_weight = get_next_long_term_block_weight(pb.block_weight);
+      m_db->add_block(std::make_pair(pb.bl, cryptonote::block_to_blob(pb.bl)), pb.block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, pb.txs);
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("Error adding block with hash: " << pb.id << " to blockchain, what = " << e.what());
+      return false;
+    }
+    ++added;
+  }
+
+  if (added)
+  {
+    invalidate_block_template_cache();
+    if (!update_next_cumulative_weight_limit())
+    {
+      MERROR("Failed to update next cumulative weight limit");
+      return false;
+    }
+  }
+  return true;
+}
+
 //------------------------------------------------------------------
 // ND: Speedups:
 // 1. Thread long_hash computations if possible (m_max_prepare_blocks_threads = nthreads, default = 4)
@@ -6656,49 +6868,64 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   return true;
 }
 
+bool Blockchain::init_txpool_store(const std::string &snapshot_filename)
+{
+  return m_txpool_store.init(snapshot_filename, *m_db);
+}
+
+bool Blockchain::store_txpool()
+{
+  return m_txpool_store.store();
+}
+
 void Blockchain::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
 {
-  m_db->add_txpool_tx(txid, blob, meta);
+  m_txpool_store.add_tx(txid, blob, meta);
 }
 
 void Blockchain::update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
 {
-  m_db->update_txpool_tx(txid, meta);
+  m_txpool_store.update_tx(txid, meta);
 }
 
 void Blockchain::remove_txpool_tx(const crypto::hash &txid)
 {
-  m_db->remove_txpool_tx(txid);
+  m_txpool_store.remove_tx(txid);
 }
 
 uint64_t Blockchain::get_txpool_tx_count(bool include_sensitive) const
 {
-  return m_db->get_txpool_tx_count(include_sensitive ? relay_category::all : relay_category::broadcasted);
+  return m_txpool_store.get_tx_count(include_sensitive ? relay_category::all : relay_category::broadcasted);
 }
 
 bool Blockchain::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const
 {
-  return m_db->get_txpool_tx_meta(txid, meta);
+  return m_txpool_store.get_tx_meta(txid, meta);
 }
 
 bool Blockchain::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd, relay_category tx_category) const
 {
-  return m_db->get_txpool_tx_blob(txid, bd, tx_category);
+  return m_txpool_store.get_tx_blob(txid, bd, tx_category);
 }
 
 cryptonote::blobdata Blockchain::get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const
 {
-  return m_db->get_txpool_tx_blob(txid, tx_category);
+  return m_txpool_store.get_tx_blob(txid, tx_category);
 }
 
 bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, relay_category tx_category) const
 {
-  return m_db->for_all_txpool_txes(f, include_blob, tx_category);
+  return m_txpool_store.for_all_txes(f, include_blob, tx_category);
 }
 
 bool Blockchain::txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category)
 {
-  return m_db->txpool_tx_matches_category(tx_hash, category);
+  return m_txpool_store.tx_matches_category(tx_hash, category);
+}
+
+bool Blockchain::txpool_has_tx(const crypto::hash &txid, relay_category tx_category) const
+{
+  return m_txpool_store.has_tx(txid, tx_category);
 }
 
 void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold, blockchain_db_sync_mode sync_mode, bool fast_sync)
@@ -60,9 +60,12 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "txpool_store.h"
 
 namespace tools { class Notify; }
 
+class blockchain_accessor_test;
+
 namespace cryptonote
 {
   class tx_memory_pool;
@@ -76,7 +79,8 @@ namespace cryptonote
     db_defaultsync, //!< user didn't specify, use db_async
     db_sync,  //!< handle syncing calls instead of the backing db, synchronously
     db_async, //!< handle syncing calls instead of the backing db, asynchronously
-    db_nosync //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_nosync, //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_pipelined //!< the backing db flushes each commit from its own thread, with a bound on unflushed blocks
   };
 
   /** 
@@ -93,6 +97,8 @@ namespace cryptonote
   /************************************************************************/
   class Blockchain
   {
+    friend class ::blockchain_accessor_test;
+
   public:
     /**
      * @brief container for passing a block and metadata about it on the blockchain
@@ -106,6 +112,17 @@ namespace cryptonote
       uint64_t already_generated_coins; //!< the total coins minted after that block
     };
 
+    /**
+     * @brief container for passing a block to add_prevalidated_blocks
+     */
+    struct prevalidated_block
+    {
+      block bl; //!< the block
+      crypto::hash id; //!< the block's hash
+      std::vector<std::pair<transaction, blobdata>> txs; //!< the block's transactions, in tx_hashes order
+      uint64_t block_weight; //!< the weight of the block
+    };
+
     /**
      * @brief Blockchain constructor
      *
@@ -779,6 +796,38 @@ namespace cryptonote
      */
     void set_reorg_notify(const std::shared_ptr<tools::Notify> &notify) { m_reorg_notify = notify; }
 
+    /**
+     * @brief callback invoked with every block added to the main chain, with its transactions
+     */
+    typedef std::function<void(uint64_t height, const crypto::hash &id, const block &bl, const std::vector<transaction> &txs)> block_added_callback;
+
+    /**
+     * @brief adds a callback to call for every new block, including blocks
+     * brought in by a reorg
+     *
+     * Callbacks run with the blockchain lock held, and must not block.
+     *
+     * @param notify the callback
+     */
+    void add_block_notify(block_added_callback notify) { m_block_added_callbacks.push_back(std::move(notify)); }
+
+    /**
+     * @brief callback invoked with every block removed from the main chain
+     */
+    typedef std::function<void(uint64_t height, const crypto::hash &id)> block_disconnected_callback;
+
+    /**
+     * @brief adds a callback to call for every block removed from the main
+     * chain, by a reorg or by pop_blocks
+     *
+     * On a reorg, removed blocks are reported highest first, before the
+     * blocks replacing them are reported to the block_added_callback list.
+     * Callbacks run with the blockchain lock held, and must not block.
+     *
+     * @param notify the callback
+     */
+    void add_block_disconnected_notify(block_disconnected_callback notify) { m_block_disconnected_callbacks.push_back(std::move(notify)); }
+
     /**
      * @brief Put DB in safe sync mode
      */
@@ -984,6 +1033,26 @@ namespace cryptonote
     std::vector<std::pair<block_extended_info,std::vector<crypto::hash>>> get_alternative_chains() const;
 
     network_type get_nettype() const { return m_nettype; }
+
+    /**
+     * @brief sets up the in-memory txpool store
+     *
+     * Loads the txpool snapshot and moves any txpool transactions still in
+     * the database into the store.
+     *
+     * @param snapshot_filename where to keep the txpool snapshot, or empty for none
+     *
+     * @return false if the database txpool could not be read, true otherwise
+     */
+    bool init_txpool_store(const std::string &snapshot_filename);
+
+    /**
+     * @brief writes the txpool snapshot if the txpool changed since the last one
+     */
+    bool store_txpool();
+
+    txpool_store& get_txpool_store() { return m_txpool_store; }
+
     void add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta);
     void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
     void remove_txpool_tx(const crypto::hash &txid);
@@ -993,12 +1062,26 @@ namespace cryptonote
     cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
     bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)>, bool include_blob = false, relay_category tx_category = relay_category::broadcasted) const;
     bool txpool_tx_matches_category(const crypto::hash& tx_hash, relay_category category);
+    bool txpool_has_tx(const crypto::hash &txid, relay_category tx_category) const;
 
     bool is_within_compiled_block_hash_area() const { return is_within_compiled_block_hash_area(m_db->height()); }
     uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes, const std::vector<uint64_t> &weights);
     uint32_t get_blockchain_pruning_seed() const { return m_db->get_blockchain_pruning_seed(); }
     bool prune_blockchain(uint32_t pruning_seed = 0);
     bool update_blockchain_pruning();
+    bool start_incremental_pruning(uint32_t pruning_seed = 0);
+    bool prune_blockchain_step(size_t max_txes);
+    pruning_progress get_pruning_progress() const { return m_db->get_pruning_progress(); }
+
+    /**
+     * @brief picks up blocks added to a read only db by another process
+     *
+     * Brings the cached chain state (hard fork voting, difficulty and weight
+     * limits) up to date with the db's current top block.
+     *
+     * @return true if the top block changed since the last call
+     */
+    bool refresh_read_only_view();
     bool check_blockchain_pruning();
 
     void lock();
@@ -1040,6 +1123,23 @@ namespace cryptonote
      */
     bool has_block_weights(uint64_t height, uint64_t nblocks) const;
 
+    /**
+     * @brief adds blocks straight to the db, trusting the precompiled block hashes
+     *
+     * Only blocks whose hash and weight were already matched against the
+     * precompiled block hashes by prevalidate_block_hashes are added: their
+     * transactions are neither verified nor passed through the txpool. The
+     * caller must have checked that each block's transactions hash to its
+     * tx_hashes. Stops without error at the first block with no known hash,
+     * so the rest can go through full verification.
+     *
+     * @param blocks the blocks to add, in height order, starting at the current height
+     * @param added return-by-reference the number of blocks added
+     *
+     * @return false if a block is not the expected one or could not be added
+     */
+    bool add_prevalidated_blocks(const std::vector<prevalidated_block> &blocks, size_t &added);
+
     /**
      * @brief flush the invalid blocks set
      */
@@ -1059,6 +1159,8 @@ namespace cryptonote
 
     BlockchainDB* m_db;
 
+    txpool_store m_txpool_store;
+
     tx_memory_pool& m_tx_pool;
 
     mutable epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
@@ -1099,6 +1201,9 @@ namespace cryptonote
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
 
+    crypto::hash m_followed_top_hash;
+    uint64_t m_followed_height;
+
     boost::asio::io_service m_async_service;
     boost::thread_group m_async_pool;
     std::unique_ptr<boost::asio::io_service::work> m_async_work_idle;
@@ -1133,6 +1238,8 @@ namespace cryptonote
 
     std::shared_ptr<tools::Notify> m_block_notify;
     std::shared_ptr<tools::Notify> m_reorg_notify;
+    std::vector<block_added_callback> m_block_added_callbacks;
+    std::vector<block_disconnected_callback> m_block_disconnected_callbacks;
 
     // for prepare_handle_incoming_blocks
     uint64_t m_prepare_height;
@@ -1238,6 +1345,24 @@ namespace cryptonote
      */
     block pop_block_from_blockchain();
 
+    /**
+     * @brief calls the block_added_callback list for a block on the main chain
+     *
+     * @param height the height of the block
+     * @param id the hash of the block
+     * @param bl the block
+     * @param txs the block's transactions, not including the miner tx
+     */
+    void notify_block_added(uint64_t height, const crypto::hash &id, const block &bl, const std::vector<transaction> &txs);
+
+    /**
+     * @brief calls the block_disconnected_callback list for a block removed from the main chain
+     *
+     * @param height the height the block had
+     * @param id the hash of the block
+     */
+    void notify_block_disconnected(uint64_t height, const crypto::hash &id);
+
     /**
      * @brief validate and add a new block to the end of the blockchain
      *
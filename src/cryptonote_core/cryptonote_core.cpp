@@ -68,6 +68,8 @@ DISABLE_VS_WARNINGS(4355)
 // basically at least how many bytes the block itself serializes to without the miner tx
 #define BLOCK_SIZE_SANITY_LEEWAY 100
 
+#define DB_PIPELINED_MAX_UNSYNCED_BLOCKS 20
+
 namespace cryptonote
 {
   const command_line::arg_descriptor<bool, false> arg_testnet_on  = {
@@ -112,6 +114,10 @@ namespace cryptonote
     "offline"
   , "Do not listen for peers, nor connect to any"
   };
+  const command_line::arg_descriptor<bool> arg_db_readonly_follow = {
+    "db-readonly-follow"
+  , "Open the database read only and follow the blocks added to it by another local daemon, serving RPC without P2P or validation (implies --offline)"
+  };
   const command_line::arg_descriptor<bool> arg_disable_dns_checkpoints = {
     "disable-dns-checkpoints"
   , "Do not retrieve checkpoints from DNS"
@@ -195,6 +201,16 @@ namespace cryptonote
   , "Prune blockchain"
   , false
   };
+  static const command_line::arg_descriptor<bool> arg_prune_blockchain_background  = {
+    "prune-blockchain-background"
+  , "Prune blockchain in small steps while the daemon runs, instead of all at once at startup"
+  , false
+  };
+  static const command_line::arg_descriptor<size_t> arg_prune_blockchain_rate  = {
+    "prune-blockchain-rate"
+  , "Max number of transactions background pruning goes through per second"
+  , 1000
+  };
   static const command_line::arg_descriptor<std::string> arg_reorg_notify = {
     "reorg-notify"
   , "Run a program for each reorg, '%s' will be replaced by the split height, "
@@ -236,7 +252,10 @@ namespace cryptonote
               m_disable_dns_checkpoints(false),
               m_update_download(0),
               m_nettype(UNDEFINED),
-              m_update_available(false)
+              m_update_available(false),
+              m_read_only_follow(false),
+              m_background_pruning(false),
+              m_background_pruning_rate(0)
   {
     m_checkpoints_updating.clear();
     set_cryptonote_protocol(pprotocol);
@@ -330,12 +349,15 @@ namespace cryptonote
     command_line::add_arg(desc, arg_no_fluffy_blocks);
     command_line::add_arg(desc, arg_test_dbg_lock_sleep);
     command_line::add_arg(desc, arg_offline);
+    command_line::add_arg(desc, arg_db_readonly_follow);
     command_line::add_arg(desc, arg_disable_dns_checkpoints);
     command_line::add_arg(desc, arg_block_download_max_size);
     command_line::add_arg(desc, arg_sync_pruned_blocks);
     command_line::add_arg(desc, arg_max_txpool_weight);
     command_line::add_arg(desc, arg_block_notify);
     command_line::add_arg(desc, arg_prune_blockchain);
+    command_line::add_arg(desc, arg_prune_blockchain_background);
+    command_line::add_arg(desc, arg_prune_blockchain_rate);
     command_line::add_arg(desc, arg_reorg_notify);
     command_line::add_arg(desc, arg_block_rate_notify);
     command_line::add_arg(desc, arg_keep_alt_blocks);
@@ -376,7 +398,8 @@ namespace cryptonote
     set_enforce_dns_checkpoints(command_line::get_arg(vm, arg_dns_checkpoints));
     test_drop_download_height(command_line::get_arg(vm, arg_test_drop_download_height));
     m_fluffy_blocks_enabled = !get_arg(vm, arg_no_fluffy_blocks);
-    m_offline = get_arg(vm, arg_offline);
+    m_read_only_follow = get_arg(vm, arg_db_readonly_follow);
+    m_offline = get_arg(vm, arg_offline) || m_read_only_follow;
     m_disable_dns_checkpoints = get_arg(vm, arg_disable_dns_checkpoints);
     if (!command_line::is_arg_defaulted(vm, arg_fluffy_blocks))
       MWARNING(arg_fluffy_blocks.name << " is obsolete, it is now default");
@@ -464,11 +487,15 @@ namespace cryptonote
 
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_presize_map = command_line::get_arg(vm, cryptonote::arg_db_presize_map) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     std::string check_updates_string = command_line::get_arg(vm, arg_check_updates);
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
     bool prune_blockchain = command_line::get_arg(vm, arg_prune_blockchain);
+    bool prune_blockchain_background = command_line::get_arg(vm, arg_prune_blockchain_background);
+    m_background_pruning_rate = command_line::get_arg(vm, arg_prune_blockchain_rate);
+    CHECK_AND_ASSERT_MES(m_background_pruning_rate > 0, false, "--" << arg_prune_blockchain_rate.name << " must be at least 1");
     bool keep_alt_blocks = command_line::get_arg(vm, arg_keep_alt_blocks);
     bool keep_fakechain = command_line::get_arg(vm, arg_keep_fakechain);
 
@@ -519,7 +546,7 @@ namespace cryptonote
     bool sync_on_blocks = true;
     uint64_t sync_threshold = 1;
 
-    if (m_nettype == FAKECHAIN && !keep_fakechain)
+    if (m_nettype == FAKECHAIN && !keep_fakechain && !m_read_only_follow)
     {
       // reset the db by removing the database file before opening it
       if (!db->remove_data_file(filename))
@@ -527,6 +554,8 @@ namespace cryptonote
         MERROR("Failed to remove data file in " << filename);
         return false;
       }
+      boost::system::error_code ec;
+      boost::filesystem::remove(folder / CRYPTONOTE_POOLDATA_FILENAME, ec);
     }
 
     try
@@ -580,6 +609,11 @@ namespace cryptonote
           sync_mode = db_sync_mode_is_default ? db_defaultsync : db_sync;
         else if(options[1] == "async")
           sync_mode = db_sync_mode_is_default ? db_defaultsync : db_async;
+        else if(options[1] == "pipelined")
+        {
+          sync_mode = db_pipelined;
+          sync_threshold = DB_PIPELINED_MAX_UNSYNCED_BLOCKS;
+        }
       }
 
       if(options.size() >= 3 && !safemode)
@@ -591,7 +625,7 @@ namespace cryptonote
           sync_on_blocks = true;
           sync_threshold = threshold;
         }
-        else if (!strcmp(endptr, "bytes"))
+        else if (!strcmp(endptr, "bytes") && sync_mode != db_pipelined)
         {
           sync_on_blocks = false;
           sync_threshold = threshold;
@@ -605,10 +639,23 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_presize_map)
+        db_flags |= DBF_PRESIZE;
+
+      // the daemon writing the db owns its sync mode and size
+      if (m_read_only_follow)
+        db_flags = DBF_RDONLY;
 
       db->open(filename, db_flags);
       if(!db->m_open)
         return false;
+      if (m_read_only_follow && db->height() == 0)
+      {
+        MERROR("No blockchain to follow in " << filename);
+        return false;
+      }
+      if (sync_mode == db_pipelined && !m_read_only_follow)
+        db->set_pipelined_sync(sync_threshold);
     }
     catch (const DB_ERROR& e)
     {
@@ -658,6 +705,10 @@ namespace cryptonote
     r = m_blockchain_storage.init(db.release(), m_nettype, m_offline, regtest ? &regtest_test_options : test_options, fixed_difficulty, get_checkpoints);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
+    // a follower's pool stays in memory, the snapshot belongs to the writer
+    r = m_blockchain_storage.init_txpool_store(m_read_only_follow ? std::string() : (folder / CRYPTONOTE_POOLDATA_FILENAME).string());
+    CHECK_AND_ASSERT_MES(r, false, "Failed to initialize txpool storage");
+
     r = m_mempool.init(max_txpool_weight, m_nettype == FAKECHAIN);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
@@ -700,10 +751,19 @@ namespace cryptonote
     if (!keep_alt_blocks && !m_blockchain_storage.get_db().is_read_only())
       m_blockchain_storage.get_db().drop_alt_blocks();
 
-    if (prune_blockchain)
+    if ((prune_blockchain || prune_blockchain_background) && m_read_only_follow)
+    {
+      MWARNING("Ignoring --" << arg_prune_blockchain.name << " on a read only follower, prune the daemon writing the db instead");
+    }
+    else if (prune_blockchain || prune_blockchain_background)
     {
       // display a message if the blockchain is not pruned yet
-      if (!m_blockchain_storage.get_blockchain_pruning_seed())
+      if (!m_blockchain_storage.get_blockchain_pruning_seed() && prune_blockchain_background)
+      {
+        MGINFO("Pruning blockchain in the background...");
+        CHECK_AND_ASSERT_MES(m_blockchain_storage.start_incremental_pruning(), false, "Failed to start pruning blockchain");
+      }
+      else if (!m_blockchain_storage.get_blockchain_pruning_seed())
       {
         MGINFO("Pruning blockchain...");
         CHECK_AND_ASSERT_MES(m_blockchain_storage.prune_blockchain(), false, "Failed to prune blockchain");
@@ -714,6 +774,9 @@ namespace cryptonote
       }
     }
 
+    // picks up a job left unfinished by an earlier run too
+    m_background_pruning = !m_read_only_follow && m_blockchain_storage.get_pruning_progress().active;
+
     return load_state_data();
   }
   //-----------------------------------------------------------------------------------------------
@@ -1704,6 +1767,11 @@ namespace cryptonote
     return m_mempool.get_transactions_count(include_sensitive_txes);
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pool_cookie() const
+  {
+    return m_mempool.cookie();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id) const
   {
     return m_blockchain_storage.have_block(id);
@@ -1813,7 +1881,14 @@ namespace cryptonote
     m_check_updates_interval.do_call(boost::bind(&core::check_updates, this));
     m_check_disk_space_interval.do_call(boost::bind(&core::check_disk_space, this));
     m_block_rate_interval.do_call(boost::bind(&core::check_block_rate, this));
-    m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
+    if (m_read_only_follow)
+      m_read_only_follow_interval.do_call(boost::bind(&core::refresh_read_only_view, this));
+    else
+    {
+      m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
+      if (m_background_pruning)
+        m_background_pruning_interval.do_call(boost::bind(&core::prune_blockchain_step, this));
+    }
     m_miner.on_idle();
     m_mempool.on_idle();
     return true;
@@ -2075,6 +2150,45 @@ namespace cryptonote
     return m_blockchain_storage.update_blockchain_pruning();
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::start_incremental_pruning(uint32_t pruning_seed)
+  {
+    if (!m_blockchain_storage.start_incremental_pruning(pruning_seed))
+      return false;
+    m_background_pruning = true;
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::prune_blockchain_step()
+  {
+    try
+    {
+      m_background_pruning = m_blockchain_storage.prune_blockchain_step(m_background_pruning_rate);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to prune blockchain: " << e.what());
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  pruning_progress core::get_pruning_progress() const
+  {
+    return m_blockchain_storage.get_pruning_progress();
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::refresh_read_only_view()
+  {
+    try
+    {
+      m_blockchain_storage.refresh_read_only_view();
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to refresh the followed db: " << e.what());
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::check_blockchain_pruning()
   {
     return m_blockchain_storage.check_blockchain_pruning();
@@ -65,6 +65,7 @@ namespace cryptonote
   extern const command_line::arg_descriptor<bool, false> arg_regtest_on;
   extern const command_line::arg_descriptor<difficulty_type> arg_fixed_difficulty;
   extern const command_line::arg_descriptor<bool> arg_offline;
+  extern const command_line::arg_descriptor<bool> arg_db_readonly_follow;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
   extern const command_line::arg_descriptor<bool> arg_sync_pruned_blocks;
 
@@ -521,6 +522,13 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count(bool include_sensitive_txes = false) const;
 
+     /**
+      * @copydoc tx_memory_pool::cookie
+      *
+      * @note see tx_memory_pool::cookie
+      */
+     uint64_t get_pool_cookie() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -804,6 +812,13 @@ namespace cryptonote
       */
      bool offline() const { return m_offline; }
 
+     /**
+      * @brief get whether the core follows a db written by another daemon
+      *
+      * @return whether the core is a read only follower
+      */
+     bool is_read_only_follower() const { return m_read_only_follow; }
+
      /**
       * @brief get the blockchain pruning seed
       *
@@ -827,6 +842,36 @@ namespace cryptonote
       */
      bool update_blockchain_pruning();
 
+     /**
+      * @brief starts pruning the blockchain in small steps from on_idle
+      *
+      * @param pruning_seed the seed to use to prune the chain (0 for default, highly recommended)
+      *
+      * @return false if the blockchain is already pruned
+      */
+     bool start_incremental_pruning(uint32_t pruning_seed = 0);
+
+     /**
+      * @brief runs a rate limited step of background pruning
+      *
+      * @return true
+      */
+     bool prune_blockchain_step();
+
+     /**
+      * @brief get where background pruning is at
+      *
+      * @return the pruning progress, inactive if not pruning in the background
+      */
+     pruning_progress get_pruning_progress() const;
+
+     /**
+      * @brief picks up blocks added by the daemon writing the followed db
+      *
+      * @return true
+      */
+     bool refresh_read_only_view();
+
      /**
       * @brief checks the blockchain pruning if enabled
       *
@@ -1053,6 +1098,8 @@ namespace cryptonote
      epee::math_helper::once_a_time_seconds<60*10, true> m_check_disk_space_interval; //!< interval for checking for disk space
      epee::math_helper::once_a_time_seconds<90, false> m_block_rate_interval; //!< interval for checking block rate
      epee::math_helper::once_a_time_seconds<60*60*5, true> m_blockchain_pruning_interval; //!< interval for incremental blockchain pruning
+     epee::math_helper::once_a_time_seconds<1, true> m_read_only_follow_interval; //!< interval for checking the followed db for new blocks
+     epee::math_helper::once_a_time_seconds<1, true> m_background_pruning_interval; //!< interval for background pruning steps
 
      std::atomic<bool> m_starter_message_showed; //!< has the "daemon will sync now" message been shown?
 
@@ -1089,6 +1136,9 @@ namespace cryptonote
 
      bool m_fluffy_blocks_enabled;
      bool m_offline;
+     bool m_read_only_follow;
+     std::atomic<bool> m_background_pruning; //!< whether a background pruning job is running
+     size_t m_background_pruning_rate; //!< max txes background pruning goes through per second
 
      std::shared_ptr<tools::Notify> m_block_rate_notify;
    };
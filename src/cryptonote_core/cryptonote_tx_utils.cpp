@@ -722,6 +722,46 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  bool get_tx_asset_info(const transaction& tx, const crypto::hash &txid, tx_asset_info& info)
+  {
+    info = tx_asset_info();
+    const bool miner_tx = is_coinbase(tx);
+    if (!get_tx_asset_types(tx, txid, info.source_asset_type, info.dest_asset_type, miner_tx))
+      return false;
+    if (!get_tx_type(info.source_asset_type, info.dest_asset_type, info.type))
+      return false;
+
+    info.pricing_record_height = tx.pricing_record_height;
+    info.amount_burnt = tx.amount_burnt;
+    info.amount_minted = tx.amount_minted;
+    info.collateral_indices = tx.collateral_indices;
+    if (!miner_tx && tx.version >= 2)
+    {
+      info.fee = tx.rct_signatures.txnFee;
+      info.conversion_fee = tx.rct_signatures.txnOffshoreFee;
+    }
+    else if (!miner_tx)
+    {
+      get_tx_fee(tx, info.fee);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------
+  const char* get_tx_type_name(transaction_type type)
+  {
+    switch (type)
+    {
+      case transaction_type::TRANSFER: return "transfer";
+      case transaction_type::OFFSHORE: return "offshore";
+      case transaction_type::ONSHORE: return "onshore";
+      case transaction_type::OFFSHORE_TRANSFER: return "offshore_transfer";
+      case transaction_type::XUSD_TO_XASSET: return "xusd_to_xasset";
+      case transaction_type::XASSET_TO_XUSD: return "xasset_to_xusd";
+      case transaction_type::XASSET_TRANSFER: return "xasset_transfer";
+      default: return "unset";
+    }
+  }
+  //---------------------------------------------------------------
   bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts)
   {
     using namespace boost::multiprecision;
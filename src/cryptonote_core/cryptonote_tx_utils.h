@@ -244,6 +244,24 @@ namespace cryptonote
   uint64_t get_xusd_to_xasset_fee(const std::vector<cryptonote::tx_destination_entry>& dsts, const uint32_t hf_version);
   bool get_tx_asset_types(const transaction& tx, const crypto::hash &txid, std::string& source, std::string& destination, const bool is_miner_tx);
   bool get_tx_type(const std::string& source, const std::string& destination, transaction_type& type);
+
+  //! Haven specific fields of a transaction, decoded from its prefix and rct base
+  struct tx_asset_info
+  {
+    transaction_type type;
+    std::string source_asset_type;
+    std::string dest_asset_type;
+    uint64_t pricing_record_height;
+    uint64_t amount_burnt;
+    uint64_t amount_minted;
+    uint64_t fee;
+    uint64_t conversion_fee;
+    std::vector<uint32_t> collateral_indices; //!< vout indices of the collateral and its change, amounts are hidden by RingCT
+
+    tx_asset_info(): type(transaction_type::UNSET), pricing_record_height(0), amount_burnt(0), amount_minted(0), fee(0), conversion_fee(0) {}
+  };
+  bool get_tx_asset_info(const transaction& tx, const crypto::hash &txid, tx_asset_info& info);
+  const char* get_tx_type_name(transaction_type type);
   bool get_collateral_requirements(const transaction_type &tx_type, const uint64_t amount, uint64_t &collateral, const offshore::pricing_record &pr, const std::vector<std::pair<std::string, std::string>> &amounts);
   uint64_t get_block_cap(const std::vector<std::pair<std::string, std::string>>& supply_amounts, const offshore::pricing_record& pr);
   bool tx_pr_height_valid(const uint64_t current_height, const uint64_t pr_height, const crypto::hash& tx_hash);
@@ -38,7 +38,7 @@
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
 #include "cryptonote_config.h"
 #include "blockchain.h"
-#include "blockchain_db/locked_txn.h"
+#include "txpool_store.h"
 #include "blockchain_db/blockchain_db.h"
 #include "common/boost_serialization_helper.h"
 #include "int-util.h"
@@ -576,7 +576,7 @@ namespace cryptonote
           if (kept_by_block)
             m_parsed_tx_cache.insert(std::make_pair(id, tx));
           CRITICAL_REGION_LOCAL1(m_blockchain);
-          LockedTXN lock(m_blockchain.get_db());
+          txpool_store::txn lock(m_blockchain.get_txpool_store());
           if (!insert_key_images(tx, id, tx_relay))
             return false;
 
@@ -614,7 +614,7 @@ namespace cryptonote
         if (kept_by_block)
           m_parsed_tx_cache.insert(std::make_pair(id, tx));
         CRITICAL_REGION_LOCAL1(m_blockchain);
-        LockedTXN lock(m_blockchain.get_db());
+        txpool_store::txn lock(m_blockchain.get_txpool_store());
 
         const bool existing_tx = m_blockchain.get_txpool_tx_meta(id, meta);
         if (existing_tx)
@@ -1087,7 +1087,7 @@ namespace cryptonote
           if (kept_by_block)
             m_parsed_tx_cache.insert(std::make_pair(id, tx));
           CRITICAL_REGION_LOCAL1(m_blockchain);
-          LockedTXN lock(m_blockchain.get_db());
+          txpool_store::txn lock(m_blockchain.get_txpool_store());
           if (!insert_key_images(tx, id, tx_relay))
             return false;
 
@@ -1116,7 +1116,7 @@ namespace cryptonote
         if (kept_by_block)
           m_parsed_tx_cache.insert(std::make_pair(id, tx));
         CRITICAL_REGION_LOCAL1(m_blockchain);
-        LockedTXN lock(m_blockchain.get_db());
+        txpool_store::txn lock(m_blockchain.get_txpool_store());
 
         const bool existing_tx = m_blockchain.get_txpool_tx_meta(id, meta);
         if (existing_tx)
@@ -1226,7 +1226,7 @@ namespace cryptonote
     if (bytes == 0)
       bytes = m_txpool_max_weight;
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    LockedTXN lock(m_blockchain.get_db());
+    txpool_store::txn lock(m_blockchain.get_txpool_store());
     bool changed = false;
 
     // this will never remove the first one, but we don't care
@@ -1457,7 +1457,7 @@ namespace cryptonote
 
     try
     {
-      LockedTXN lock(m_blockchain.get_db());
+      txpool_store::txn lock(m_blockchain.get_txpool_store());
       txpool_tx_meta_t meta;
       if (!m_blockchain.get_txpool_tx_meta(id, meta))
       {
@@ -1514,7 +1514,7 @@ namespace cryptonote
 
     try
     {
-      LockedTXN lock(m_blockchain.get_db());
+      txpool_store::txn lock(m_blockchain.get_txpool_store());
       txpool_tx_meta_t meta;
       if (!m_blockchain.get_txpool_tx_meta(txid, meta))
       {
@@ -1595,6 +1595,7 @@ namespace cryptonote
   void tx_memory_pool::on_idle()
   {
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
+    m_store_txpool_interval.do_call([this](){return m_blockchain.store_txpool();});
   }
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
@@ -1656,7 +1657,7 @@ namespace cryptonote
 
     if (!remove.empty())
     {
-      LockedTXN lock(m_blockchain.get_db());
+      txpool_store::txn lock(m_blockchain.get_txpool_store());
       for (const std::pair<crypto::hash, uint64_t> &entry: remove)
       {
         const crypto::hash &txid = entry.first;
@@ -1734,7 +1735,7 @@ namespace cryptonote
 
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    LockedTXN lock(m_blockchain.get_db());
+    txpool_store::txn lock(m_blockchain.get_txpool_store());
     for (const auto& hash : hashes)
     {
       try
@@ -2065,7 +2066,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
-    return m_blockchain.get_db().txpool_has_tx(id, tx_category);
+    return m_blockchain.txpool_has_tx(id, tx_category);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx, const crypto::hash& txid) const
@@ -2273,7 +2274,7 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     CRITICAL_REGION_LOCAL1(m_blockchain);
     bool changed = false;
-    LockedTXN lock(m_blockchain.get_db());
+    txpool_store::txn lock(m_blockchain.get_txpool_store());
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       crypto::key_image itk_key_image;
@@ -2396,7 +2397,7 @@ namespace cryptonote
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
-    LockedTXN lock(m_blockchain.get_db());
+    txpool_store::txn lock(m_blockchain.get_txpool_store());
 
     // grap the latest pricing record for conversion of fee values and block cap calculation.
     // ignore the fee converison and block conversions if we fail.
@@ -2662,7 +2663,7 @@ namespace cryptonote
     size_t n_removed = 0;
     if (!remove.empty())
     {
-      LockedTXN lock(m_blockchain.get_db());
+      txpool_store::txn lock(m_blockchain.get_txpool_store());
       for (const crypto::hash &txid: remove)
       {
         try
@@ -2721,13 +2722,20 @@ namespace cryptonote
       bool r = m_blockchain.for_all_txpool_txes([this, &remove, kept](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
         if (!!kept != !!meta.kept_by_block)
           return true;
-        cryptonote::transaction_prefix tx;
+        cryptonote::transaction tx;
         if (!parse_and_validate_tx_prefix_from_blob(*bd, tx))
         {
           MWARNING("Failed to parse tx from txpool, removing");
           remove.push_back(txid);
           return true;
         }
+        // the snapshot may predate blocks the chain has since stored
+        if (m_blockchain.have_tx(txid) || m_blockchain.have_tx_keyimges_as_spent(tx))
+        {
+          MINFO("Tx " << txid << " from txpool is already mined or double spent, removing");
+          remove.push_back(txid);
+          return true;
+        }
         if (!insert_key_images(tx, txid, meta.get_relay_method()))
         {
           MFATAL("Failed to insert key images from txpool tx");
@@ -2742,7 +2750,7 @@ namespace cryptonote
     }
     if (!remove.empty())
     {
-      LockedTXN lock(m_blockchain.get_db());
+      txpool_store::txn lock(m_blockchain.get_txpool_store());
       for (const auto &txid: remove)
       {
         try
@@ -2751,7 +2759,7 @@ namespace cryptonote
         }
         catch (const std::exception &e)
         {
-          MWARNING("Failed to remove corrupt transaction: " << txid);
+          MWARNING("Failed to remove stale or corrupt transaction: " << txid);
           // ignore error
         }
       }
@@ -195,7 +195,8 @@ namespace cryptonote
     /**
      * @brief action to take periodically
      *
-     * Currently checks transaction pool for stale ("stuck") transactions
+     * Currently checks transaction pool for stale ("stuck") transactions,
+     * and saves the txpool snapshot
      */
     void on_idle();
 
@@ -587,6 +588,9 @@ private:
     //! interval on which to check for stale/"stuck" transactions
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
+    //! interval on which to save the txpool snapshot
+    epee::math_helper::once_a_time_seconds<60*5> m_store_txpool_interval;
+
     //TODO: look into doing this better
     //!< container for transactions organized by fee per size and receive time
     sorted_tx_container m_txs_by_fee_and_receive_time;
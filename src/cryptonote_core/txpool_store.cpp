@@ -0,0 +1,451 @@
+// Copyright (c) 2014-2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <boost/filesystem.hpp>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "misc_log_ex.h"
+#include "file_io_utils.h"
+#include "txpool_store.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "txpool"
+
+// the snapshot is a header followed by one record per tx:
+// txid, raw txpool_tx_meta_t, blob size, blob
+#define TXPOOL_SNAPSHOT_MAGIC "HAVENTXPOOL"
+#define TXPOOL_SNAPSHOT_VERSION 1
+
+// don't bother compacting the blob arena below this much dead space
+#define TXPOOL_ARENA_MIN_COMPACT_SIZE (16 * 1024 * 1024)
+
+namespace cryptonote
+{
+  namespace
+  {
+    template<typename T>
+    void append_pod(std::string &s, const T &t)
+    {
+      s.append(reinterpret_cast<const char*>(&t), sizeof(t));
+    }
+
+    template<typename T>
+    bool read_pod(const std::string &s, size_t &offset, T &t)
+    {
+      if (s.size() - offset < sizeof(t))
+        return false;
+      memcpy(&t, s.data() + offset, sizeof(t));
+      offset += sizeof(t);
+      return true;
+    }
+
+    // writes data and makes sure it reached the disk before returning
+    bool write_file_synced(const std::string &filename, const std::string &data)
+    {
+      FILE *f = fopen(filename.c_str(), "wb");
+      if (!f)
+        return false;
+      bool success = fwrite(data.data(), 1, data.size(), f) == data.size() && fflush(f) == 0;
+#ifdef _WIN32
+      success = success && _commit(_fileno(f)) == 0;
+#else
+      success = success && fsync(fileno(f)) == 0;
+#endif
+      return fclose(f) == 0 && success;
+    }
+  }
+
+  //---------------------------------------------------------------------------------
+  txpool_store::txpool_store():
+    m_arena_dead(0),
+    m_dirty(false)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::init(const std::string &snapshot_filename, BlockchainDB &db)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_txes.clear();
+    m_arena.clear();
+    m_arena_dead = 0;
+    m_journals.clear();
+    m_snapshot_filename = snapshot_filename;
+    m_dirty = false;
+
+    if (!m_snapshot_filename.empty() && boost::filesystem::exists(m_snapshot_filename))
+    {
+      if (!load(m_snapshot_filename))
+      {
+        MWARNING("Failed to load txpool snapshot from " << m_snapshot_filename << ", starting with an empty txpool");
+        m_txes.clear();
+        m_arena.clear();
+        m_arena_dead = 0;
+      }
+    }
+
+    // earlier versions kept the txpool in the db: move those txes here and
+    // empty the db tables, so they are only ever read once
+    std::vector<crypto::hash> migrated;
+    try
+    {
+      if (db.get_txpool_tx_count(relay_category::all) == 0)
+        return true;
+      db.for_all_txpool_txes([this, &migrated](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+        if (m_txes.find(txid) == m_txes.end())
+          insert(txid, bd->data(), bd->size(), meta);
+        migrated.push_back(txid);
+        return true;
+      }, true, relay_category::all);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to read txpool from the db: " << e.what());
+      return false;
+    }
+    MINFO("Moved " << migrated.size() << " txpool transactions out of the db");
+
+    // only forget them in the db once they are safely in a snapshot
+    if (m_snapshot_filename.empty() || !store())
+      return true;
+    try
+    {
+      db_wtxn_guard guard(&db);
+      for (const crypto::hash &txid: migrated)
+        db.remove_txpool_tx(txid);
+    }
+    catch (const std::exception &e)
+    {
+      // they will be skipped as duplicates next time
+      MWARNING("Failed to remove migrated txpool transactions from the db: " << e.what());
+    }
+
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::load(const std::string &filename)
+  {
+    std::string data;
+    if (!epee::file_io_utils::load_file_to_string(filename, data, std::numeric_limits<size_t>::max()))
+      return false;
+
+    size_t offset = 0;
+    char magic[sizeof(TXPOOL_SNAPSHOT_MAGIC)];
+    uint32_t version;
+    uint64_t count;
+    if (!read_pod(data, offset, magic) || memcmp(magic, TXPOOL_SNAPSHOT_MAGIC, sizeof(magic)))
+      return false;
+    if (!read_pod(data, offset, version) || version != TXPOOL_SNAPSHOT_VERSION)
+      return false;
+    if (!read_pod(data, offset, count))
+      return false;
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      crypto::hash txid;
+      txpool_tx_meta_t meta;
+      uint64_t blob_size;
+      if (!read_pod(data, offset, txid) || !read_pod(data, offset, meta) || !read_pod(data, offset, blob_size))
+        return false;
+      if (data.size() - offset < blob_size)
+        return false;
+      if (m_txes.find(txid) == m_txes.end())
+        insert(txid, data.data() + offset, blob_size, meta);
+      offset += blob_size;
+    }
+    m_dirty = false;
+    MINFO("Loaded " << m_txes.size() << " txpool transactions from " << filename);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::store()
+  {
+    CRITICAL_REGION_LOCAL(m_snapshot_lock);
+    std::string data;
+    {
+      CRITICAL_REGION_LOCAL1(m_lock);
+      if (m_snapshot_filename.empty() || !m_dirty)
+        return true;
+
+      // build the image with the store locked, but write it out without
+      data.reserve(sizeof(TXPOOL_SNAPSHOT_MAGIC) + 12 + m_arena.size() - m_arena_dead
+          + m_txes.size() * (sizeof(crypto::hash) + sizeof(txpool_tx_meta_t) + sizeof(uint64_t)));
+      data.append(TXPOOL_SNAPSHOT_MAGIC, sizeof(TXPOOL_SNAPSHOT_MAGIC));
+      append_pod(data, (uint32_t)TXPOOL_SNAPSHOT_VERSION);
+      append_pod(data, (uint64_t)m_txes.size());
+      for (const auto &e: m_txes)
+      {
+        append_pod(data, e.first);
+        append_pod(data, e.second.meta);
+        append_pod(data, e.second.blob_size);
+        data.append(m_arena.data() + e.second.blob_offset, e.second.blob_size);
+      }
+      m_dirty = false;
+    }
+
+    const std::string tmp_filename = m_snapshot_filename + ".tmp";
+    bool success = false;
+    try
+    {
+      // synced before the rename, so a crash never leaves a truncated snapshot in place
+      if (write_file_synced(tmp_filename, data))
+      {
+        boost::filesystem::rename(tmp_filename, m_snapshot_filename);
+        success = true;
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to write txpool snapshot: " << e.what());
+    }
+
+    if (!success)
+    {
+      MERROR("Failed to write txpool snapshot to " << m_snapshot_filename);
+      CRITICAL_REGION_LOCAL1(m_lock);
+      m_dirty = true;
+      return false;
+    }
+    MDEBUG("Wrote txpool snapshot, " << data.size() << " bytes");
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::journal(const crypto::hash &txid)
+  {
+    auto j = m_journals.find(boost::this_thread::get_id());
+    if (j == m_journals.end())
+      return;
+    undo_record rec;
+    rec.txid = txid;
+    const auto i = m_txes.find(txid);
+    rec.existed = i != m_txes.end();
+    if (rec.existed)
+    {
+      rec.meta = i->second.meta;
+      rec.blob.assign(m_arena.data() + i->second.blob_offset, i->second.blob_size);
+    }
+    j->second.push_back(std::move(rec));
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::insert(const crypto::hash &txid, const char *blob, size_t blob_size, const txpool_tx_meta_t &meta)
+  {
+    entry e;
+    e.meta = meta;
+    e.blob_offset = m_arena.size();
+    e.blob_size = blob_size;
+    m_arena.append(blob, blob_size);
+    m_txes.emplace(txid, e);
+    m_dirty = true;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::erase(std::unordered_map<crypto::hash, entry>::iterator it)
+  {
+    m_arena_dead += it->second.blob_size;
+    m_txes.erase(it);
+    m_dirty = true;
+    if (m_arena_dead >= TXPOOL_ARENA_MIN_COMPACT_SIZE && m_arena_dead * 2 > m_arena.size())
+      compact();
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::compact()
+  {
+    std::string arena;
+    arena.reserve(m_arena.size() - m_arena_dead);
+    for (auto &e: m_txes)
+    {
+      const uint64_t offset = arena.size();
+      arena.append(m_arena.data() + e.second.blob_offset, e.second.blob_size);
+      e.second.blob_offset = offset;
+    }
+    MDEBUG("Compacted txpool blob arena from " << m_arena.size() << " to " << arena.size() << " bytes");
+    m_arena.swap(arena);
+    m_arena_dead = 0;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::add_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (m_txes.find(txid) != m_txes.end())
+      throw DB_ERROR("Attempting to add txpool tx that's already in the txpool");
+    journal(txid);
+    insert(txid, blob.data(), blob.size(), meta);
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::update_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end())
+      throw DB_ERROR("Error finding txpool tx meta to update");
+    journal(txid);
+    i->second.meta = meta;
+    m_dirty = true;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::remove_tx(const crypto::hash &txid)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end())
+      return;
+    journal(txid);
+    erase(i);
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t txpool_store::get_tx_count(relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (category == relay_category::all)
+      return m_txes.size();
+    uint64_t count = 0;
+    for (const auto &e: m_txes)
+      if (e.second.meta.matches(category))
+        ++count;
+    return count;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::has_tx(const crypto::hash &txid, relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    return i != m_txes.end() && i->second.meta.matches(category);
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end())
+      return false;
+    meta = i->second.meta;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::get_tx_blob(const crypto::hash &txid, cryptonote::blobdata &bd, relay_category category) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_txes.find(txid);
+    if (i == m_txes.end() || !i->second.meta.matches(category))
+      return false;
+    bd.assign(m_arena.data() + i->second.blob_offset, i->second.blob_size);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  cryptonote::blobdata txpool_store::get_tx_blob(const crypto::hash &txid, relay_category category) const
+  {
+    cryptonote::blobdata bd;
+    if (!get_tx_blob(txid, bd, category))
+      throw DB_ERROR("Tx not found in txpool: ");
+    return bd;
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::tx_matches_category(const crypto::hash &txid, relay_category category) const
+  {
+    txpool_tx_meta_t meta;
+    if (!get_tx_meta(txid, meta))
+    {
+      MERROR("Failed to get tx meta from txpool");
+      return false;
+    }
+    return meta.matches(category);
+  }
+  //---------------------------------------------------------------------------------
+  bool txpool_store::for_all_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, relay_category category) const
+  {
+    std::vector<std::pair<crypto::hash, txpool_tx_meta_t>> txes;
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      txes.reserve(m_txes.size());
+      for (const auto &e: m_txes)
+        if (e.second.meta.matches(category))
+          txes.emplace_back(e.first, e.second.meta);
+    }
+
+    cryptonote::blobdata bd;
+    for (const auto &tx: txes)
+    {
+      if (include_blob)
+      {
+        CRITICAL_REGION_LOCAL(m_lock);
+        const auto i = m_txes.find(tx.first);
+        if (i == m_txes.end())
+          continue;
+        bd.assign(m_arena.data() + i->second.blob_offset, i->second.blob_size);
+      }
+      if (!f(tx.first, tx.second, include_blob ? &bd : nullptr))
+        return false;
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  txpool_store::txn::txn(txpool_store &store): m_store(store), m_active(false)
+  {
+    CRITICAL_REGION_LOCAL(m_store.m_lock);
+    m_active = m_store.m_journals.emplace(boost::this_thread::get_id(), std::vector<undo_record>()).second;
+  }
+  //---------------------------------------------------------------------------------
+  txpool_store::txn::~txn()
+  {
+    abort();
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::txn::commit()
+  {
+    if (!m_active)
+      return;
+    CRITICAL_REGION_LOCAL(m_store.m_lock);
+    m_store.m_journals.erase(boost::this_thread::get_id());
+    m_active = false;
+  }
+  //---------------------------------------------------------------------------------
+  void txpool_store::txn::abort()
+  {
+    if (!m_active)
+      return;
+    CRITICAL_REGION_LOCAL(m_store.m_lock);
+    const auto j = m_store.m_journals.find(boost::this_thread::get_id());
+    std::vector<undo_record> records = std::move(j->second);
+    m_store.m_journals.erase(j);
+    m_active = false;
+
+    for (auto i = records.rbegin(); i != records.rend(); ++i)
+    {
+      const auto e = m_store.m_txes.find(i->txid);
+      if (e != m_store.m_txes.end())
+        m_store.erase(e);
+      if (i->existed)
+        m_store.insert(i->txid, i->blob.data(), i->blob.size(), i->meta);
+    }
+  }
+}
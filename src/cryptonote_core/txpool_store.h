@@ -0,0 +1,148 @@
+// Copyright (c) 2014-2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/thread.hpp>
+
+#include "syncobj.h"
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief in-memory storage for txpool transactions
+   *
+   * Keeps the txpool metadata and blobs in memory instead of in the
+   * blockchain database, so that txpool activity does not compete with
+   * block writes for the database writer. Blobs are packed into a single
+   * arena, which is compacted once enough of it is dead.
+   *
+   * The contents are saved to a snapshot file periodically and at shutdown,
+   * and loaded back at startup. Transactions left in the database's own
+   * txpool tables by earlier versions are moved over on init.
+   */
+  class txpool_store
+  {
+  public:
+    txpool_store();
+
+    /**
+     * @brief loads the snapshot and migrates txpool txes left in the db
+     *
+     * @param snapshot_filename where the snapshot lives, or empty to keep the pool in memory only
+     * @param db the blockchain database, whose txpool tables are emptied into this store
+     *
+     * @return false if the database txpool could not be read
+     */
+    bool init(const std::string &snapshot_filename, BlockchainDB &db);
+
+    /**
+     * @brief writes a snapshot if anything changed since the last one
+     *
+     * @return false if the snapshot could not be written
+     */
+    bool store();
+
+    void add_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta);
+    void update_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
+    void remove_tx(const crypto::hash &txid);
+    uint64_t get_tx_count(relay_category category) const;
+    bool has_tx(const crypto::hash &txid, relay_category category) const;
+    bool get_tx_meta(const crypto::hash &txid, txpool_tx_meta_t &meta) const;
+    bool get_tx_blob(const crypto::hash &txid, cryptonote::blobdata &bd, relay_category category) const;
+    cryptonote::blobdata get_tx_blob(const crypto::hash &txid, relay_category category) const;
+    bool tx_matches_category(const crypto::hash &txid, relay_category category) const;
+
+    /**
+     * @brief runs a function over all txpool transactions
+     *
+     * The function runs without the store locked and may use the store,
+     * transactions removed in the meantime are skipped.
+     */
+    bool for_all_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, relay_category category) const;
+
+    /**
+     * @brief groups changes so they can be rolled back together
+     *
+     * Takes over the role the database write transaction used to have for
+     * the txpool: changes made by this thread are undone unless commit() is
+     * called. Nested groups on the same thread are folded into the outer one.
+     */
+    class txn
+    {
+    public:
+      txn(txpool_store &store);
+      ~txn();
+      void commit();
+      void abort();
+
+    private:
+      txpool_store &m_store;
+      bool m_active;
+    };
+
+  private:
+    struct entry
+    {
+      txpool_tx_meta_t meta;
+      uint64_t blob_offset;
+      uint64_t blob_size;
+    };
+
+    struct undo_record
+    {
+      crypto::hash txid;
+      bool existed;
+      txpool_tx_meta_t meta;
+      cryptonote::blobdata blob;
+    };
+
+    void journal(const crypto::hash &txid);
+    void insert(const crypto::hash &txid, const char *blob, size_t blob_size, const txpool_tx_meta_t &meta);
+    void erase(std::unordered_map<crypto::hash, entry>::iterator it);
+    void compact();
+    bool load(const std::string &filename);
+
+    mutable epee::critical_section m_lock;
+    std::unordered_map<crypto::hash, entry> m_txes;
+    std::string m_arena;
+    uint64_t m_arena_dead;
+    std::map<boost::thread::id, std::vector<undo_record>> m_journals;
+    epee::critical_section m_snapshot_lock;
+    std::string m_snapshot_filename;
+    bool m_dirty;
+  };
+}
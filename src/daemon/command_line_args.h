@@ -127,6 +127,12 @@ namespace daemon_args
   , "Disable ZMQ RPC server"
   };
 
+  const command_line::arg_descriptor<std::string> arg_zmq_pub_bind_port = {
+    "zmq-pub-bind-port"
+  , "Port for ZMQ PUB block events (pricing record, supply changes) on zmq-rpc-bind-ip, disabled if empty"
+  , ""
+  };
+
 }  // namespace daemon_args
 
 #endif // DAEMON_COMMAND_LINE_ARGS_H
@@ -820,9 +820,20 @@ bool t_command_parser_executor::version(const std::vector<std::string>& args)
 
 bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>& args)
 {
-  if (args.size() > 1) return false;
+  if (args.size() > 2) return false;
+
+  bool background = false, confirmed = false;
+  for (const std::string &arg: args)
+  {
+    if (arg == "background")
+      background = true;
+    else if (arg == "confirm")
+      confirmed = true;
+    else
+      return false;
+  }
 
-  if (args.empty() || args[0] != "confirm")
+  if (!confirmed)
   {
     std::cout << "Warning: pruning from within havend will not shrink the database file size." << std::endl;
     std::cout << "Instead, parts of the file will be marked as free, so the file will not grow" << std::endl;
@@ -833,7 +844,7 @@ bool t_command_parser_executor::prune_blockchain(const std::vector<std::string>&
     return true;
   }
 
-  return m_executor.prune_blockchain();
+  return m_executor.prune_blockchain(background);
 }
 
 bool t_command_parser_executor::check_blockchain_pruning(const std::vector<std::string>& args)
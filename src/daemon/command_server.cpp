@@ -308,7 +308,8 @@ t_command_server::t_command_server(
     m_command_lookup.set_handler(
       "prune_blockchain"
     , std::bind(&t_command_parser_executor::prune_blockchain, &m_parser, p::_1)
-    , "Prune the blockchain."
+    , "prune_blockchain [background] [confirm]"
+    , "Prune the blockchain. With \"background\", prune in small steps while the daemon keeps running, and report progress."
     );
     m_command_lookup.set_handler(
       "check_blockchain_pruning"
@@ -69,7 +69,7 @@ public:
       boost::program_options::variables_map const & vm
     )
     : core{vm}
-    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline)}
+    , protocol{vm, core, command_line::get_arg(vm, cryptonote::arg_offline) || command_line::get_arg(vm, cryptonote::arg_db_readonly_follow)}
     , p2p{vm, protocol}
   {
     // Handle circular dependencies
@@ -107,6 +107,7 @@ t_daemon::t_daemon(
   zmq_rpc_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_port);
   zmq_rpc_bind_address = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_bind_ip);
   zmq_rpc_disabled = command_line::get_arg(vm, daemon_args::arg_zmq_rpc_disabled);
+  zmq_pub_bind_port = command_line::get_arg(vm, daemon_args::arg_zmq_pub_bind_port);
 }
 
 t_daemon::~t_daemon() = default;
@@ -194,6 +195,38 @@ bool t_daemon::run(bool interactive)
 
       MINFO(std::string("ZMQ server started at ") + zmq_rpc_bind_address
             + ":" + zmq_rpc_bind_port + ".");
+
+      if (!zmq_pub_bind_port.empty())
+      {
+        std::shared_ptr<cryptonote::listener::zmq_pub> shared_pub = zmq_server.init_pub(zmq_rpc_bind_address, zmq_pub_bind_port, mp_internals->core.get().get_blockchain_storage());
+        if (!shared_pub)
+        {
+          LOG_ERROR(std::string("Failed to bind ZMQ PUB socket (") + zmq_rpc_bind_address
+              + ":" + zmq_pub_bind_port + ")");
+
+          zmq_server.stop();
+
+          if (rpc_commands)
+            rpc_commands->stop_handling();
+
+          for(auto& rpc : mp_internals->rpcs)
+            rpc->stop();
+
+          return false;
+        }
+
+        mp_internals->core.get().get_blockchain_storage().add_block_notify(
+          [shared_pub](uint64_t height, const crypto::hash &id, const cryptonote::block &bl, const std::vector<cryptonote::transaction> &txs) {
+            shared_pub->send_block(height, id, bl, txs);
+          });
+        mp_internals->core.get().get_blockchain_storage().add_block_disconnected_notify(
+          [shared_pub](uint64_t height, const crypto::hash &id) {
+            shared_pub->send_disconnect(height, id);
+          });
+
+        MINFO(std::string("ZMQ block events published at ") + zmq_rpc_bind_address
+              + ":" + zmq_pub_bind_port + ".");
+      }
     }
     else
       MINFO("ZMQ server disabled");
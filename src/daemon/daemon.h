@@ -47,6 +47,7 @@ private:
   std::string zmq_rpc_bind_address;
   std::string zmq_rpc_bind_port;
   bool zmq_rpc_disabled;
+  std::string zmq_pub_bind_port;
 public:
   t_daemon(
       boost::program_options::variables_map const & vm,
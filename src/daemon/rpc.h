@@ -72,7 +72,7 @@ public:
   void run()
   {
     MGINFO("Starting " << m_description << " RPC server...");
-    if (!m_server.run(2, false))
+    if (!m_server.run(m_server.get_io_threads(), false))
     {
       throw std::runtime_error("Failed to start " + m_description + " RPC server.");
     }
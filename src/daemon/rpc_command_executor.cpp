@@ -2329,7 +2329,7 @@ bool t_rpc_command_executor::pop_blocks(uint64_t num_blocks)
   return true;
 }
 
-bool t_rpc_command_executor::prune_blockchain()
+bool t_rpc_command_executor::prune_blockchain(bool background)
 {
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::request req;
     cryptonote::COMMAND_RPC_PRUNE_BLOCKCHAIN::response res;
@@ -2337,6 +2337,7 @@ bool t_rpc_command_executor::prune_blockchain()
     epee::json_rpc::error error_resp;
 
     req.check = false;
+    req.background = background;
 
     if (m_is_rpc)
     {
@@ -2354,6 +2355,13 @@ bool t_rpc_command_executor::prune_blockchain()
         }
     }
 
+    if (res.background_pruning)
+    {
+      tools::success_msg_writer() << "Pruning blockchain in the background: block " << res.background_pruning_height << "/" << res.background_pruning_end_height
+          << ", " << res.background_pruned_txes << " txes (" << res.background_pruned_bytes/1024/1024 << " MB) pruned so far";
+      return true;
+    }
+
     tools::success_msg_writer() << "Blockchain pruned";
     return true;
 }
@@ -38,6 +38,7 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_binary_writer.h"
 #include "string_tools.h"
 
 namespace net
@@ -142,6 +143,12 @@ namespace net
         return out.store(dest, hparent);
     }
 
+    bool i2p_address::store(epee::serialization::portable_storage_binary_writer& dest, epee::serialization::binary_writer_handle hparent) const
+    {
+        const i2p_serialized out{std::string{host_}, port_};
+        return out.store(dest, hparent);
+    }
+
     i2p_address::i2p_address(const i2p_address& rhs) noexcept
       : port_(rhs.port_)
     {
@@ -41,7 +41,9 @@ namespace epee
 namespace serialization
 {
     class portable_storage;
+    class portable_storage_binary_writer;
     struct section;
+    struct binary_writer_handle;
 }
 }
 
@@ -81,6 +83,7 @@ namespace net
 
         //! Store in epee p2p format
         bool store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const;
+        bool store(epee::serialization::portable_storage_binary_writer& dest, epee::serialization::binary_writer_handle hparent) const;
 
         // Moves and copies are currently identical
 
@@ -38,6 +38,7 @@
 #include "net/error.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_binary_writer.h"
 #include "string_tools.h"
 
 namespace net
@@ -144,6 +145,12 @@ namespace net
         return out.store(dest, hparent);
     }
 
+    bool tor_address::store(epee::serialization::portable_storage_binary_writer& dest, epee::serialization::binary_writer_handle hparent) const
+    {
+        const tor_serialized out{std::string{host_}, port_};
+        return out.store(dest, hparent);
+    }
+
     tor_address::tor_address(const tor_address& rhs) noexcept
       : port_(rhs.port_)
     {
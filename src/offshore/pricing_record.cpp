@@ -31,6 +31,7 @@
 
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage.h"
+#include "storages/portable_storage_binary_writer.h"
 
 #include "string_tools.h"
 namespace offshore
@@ -138,15 +139,29 @@ namespace offshore
     return false;
   }
 
-  bool pricing_record::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+  namespace
   {
-    std::string sig_hex;
-    for (unsigned int i=0; i<64; i++) {
-      std::stringstream ss;
-      ss << std::hex << std::setw(2) << std::setfill('0') << (0xff & signature[i]);
-      sig_hex += ss.str();
+    pr_serialized to_serialized(const pricing_record& pr)
+    {
+      std::string sig_hex;
+      for (unsigned int i=0; i<64; i++) {
+        std::stringstream ss;
+        ss << std::hex << std::setw(2) << std::setfill('0') << (0xff & pr.signature[i]);
+        sig_hex += ss.str();
+      }
+      return pr_serialized{pr.xAG,pr.xAU,pr.xAUD,pr.xBTC,pr.xCAD,pr.xCHF,pr.xCNY,pr.xEUR,pr.xGBP,pr.xJPY,pr.xNOK,pr.xNZD,pr.xUSD,pr.unused1,pr.unused2,pr.unused3,pr.timestamp,sig_hex};
     }
-    const pr_serialized out{xAG,xAU,xAUD,xBTC,xCAD,xCHF,xCNY,xEUR,xGBP,xJPY,xNOK,xNZD,xUSD,unused1,unused2,unused3,timestamp,sig_hex};
+  }
+
+  bool pricing_record::store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const
+  {
+    const pr_serialized out = to_serialized(*this);
+    return out.store(dest, hparent);
+  }
+
+  bool pricing_record::store(epee::serialization::portable_storage_binary_writer& dest, epee::serialization::binary_writer_handle hparent) const
+  {
+    const pr_serialized out = to_serialized(*this);
     return out.store(dest, hparent);
   }
 
@@ -51,7 +51,9 @@ namespace epee
   namespace serialization
   {
     class portable_storage;
+    class portable_storage_binary_writer;
     struct section;
+    struct binary_writer_handle;
   }
 }
 
@@ -111,6 +113,7 @@ namespace offshore
       bool _load(epee::serialization::portable_storage& src, epee::serialization::section* hparent);
       //! Store in epee p2p format
       bool store(epee::serialization::portable_storage& dest, epee::serialization::section* hparent) const;
+      bool store(epee::serialization::portable_storage_binary_writer& dest, epee::serialization::binary_writer_handle hparent) const;
       pricing_record(const pricing_record& orig) noexcept;
       ~pricing_record() = default;
       void set_for_height_821428();
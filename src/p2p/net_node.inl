@@ -98,6 +98,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_p2p_bind_port_ipv6, false);
     command_line::add_arg(desc, arg_p2p_use_ipv6);
     command_line::add_arg(desc, arg_p2p_ignore_ipv4);
+    command_line::add_arg(desc, arg_p2p_reuseport);
     command_line::add_arg(desc, arg_p2p_external_port);
     command_line::add_arg(desc, arg_p2p_allow_local_ip);
     command_line::add_arg(desc, arg_p2p_add_peer);
@@ -382,9 +383,11 @@ namespace nodetool
       MFATAL("Invalid value for --" << arg_igd.name << ", expected enabled, disabled or delayed");
       return false;
     }
-    m_offline = command_line::get_arg(vm, cryptonote::arg_offline);
+    m_offline = command_line::get_arg(vm, cryptonote::arg_offline) || command_line::get_arg(vm, cryptonote::arg_db_readonly_follow);
     m_use_ipv6 = command_line::get_arg(vm, arg_p2p_use_ipv6);
     m_require_ipv4 = !command_line::get_arg(vm, arg_p2p_ignore_ipv4);
+    if (command_line::get_arg(vm, arg_p2p_reuseport))
+      public_zone.m_net_server.set_accept_sharding(true);
     public_zone.m_notifier = cryptonote::levin::notify{
       public_zone.m_net_server.get_io_service(), public_zone.m_net_server.get_config_shared(), nullptr, true, pad_txs
     };
@@ -1,8 +1,15 @@
 #include "bootstrap_daemon.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
 #include <stdexcept>
+#include <vector>
 
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_core.h"
@@ -11,14 +18,183 @@
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc.bootstrap_daemon"
 
+#define BOOTSTRAP_MAX_IDLE_CONNECTIONS 4 // kept alive per node
+#define BOOTSTRAP_HEDGE_DELAY_MIN_MS 250
+#define BOOTSTRAP_HEDGE_DELAY_MAX_MS 2000
+
 namespace cryptonote
 {
 
+  struct bootstrap_daemon::state
+  {
+    typedef epee::net_utils::http::http_simple_client http_client;
+
+    state(std::unique_ptr<bootstrap_node::selector> selector, bool rpc_payment_enabled)
+      : selector(std::move(selector))
+      , rpc_payment_enabled(rpc_payment_enabled)
+    {
+    }
+
+    // the node requests go to until it fails, or another node than exclude
+    boost::optional<bootstrap_node::node_info> get_node(const std::string &exclude = std::string())
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      if (current && current->address != exclude)
+      {
+        return current;
+      }
+      if (!selector)
+      {
+        return boost::none;
+      }
+      boost::optional<bootstrap_node::node_info> node = selector->next_node(exclude);
+      if (node && exclude.empty())
+      {
+        MINFO("Changed bootstrap daemon address to " << node->address);
+        current = node;
+      }
+      return node;
+    }
+
+    std::chrono::milliseconds hedge_delay(const std::string &address) const
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      const uint64_t latency = selector ? selector->get_latency(address).count() : 0;
+      if (latency == 0)
+      {
+        return std::chrono::milliseconds(BOOTSTRAP_HEDGE_DELAY_MAX_MS);
+      }
+      return std::chrono::milliseconds(std::min<uint64_t>(std::max<uint64_t>(latency * 3, BOOTSTRAP_HEDGE_DELAY_MIN_MS), BOOTSTRAP_HEDGE_DELAY_MAX_MS));
+    }
+
+    std::unique_ptr<http_client> acquire(const bootstrap_node::node_info &node)
+    {
+      {
+        const boost::unique_lock<boost::mutex> lock(mutex);
+        auto &clients = idle[node.address];
+        if (!clients.empty())
+        {
+          std::unique_ptr<http_client> client = std::move(clients.back());
+          clients.pop_back();
+          return client;
+        }
+      }
+      std::unique_ptr<http_client> client(new http_client());
+      if (!client->set_server(node.address, node.credentials))
+      {
+        MERROR("Failed to set bootstrap daemon address " << node.address);
+        return nullptr;
+      }
+      return client;
+    }
+
+    void release(const std::string &address, std::unique_ptr<http_client> client)
+    {
+      if (!client->is_connected())
+      {
+        return;
+      }
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      auto &clients = idle[address];
+      if (clients.size() < BOOTSTRAP_MAX_IDLE_CONNECTIONS)
+      {
+        clients.push_back(std::move(client));
+      }
+    }
+
+    void handle_result(const std::string &address, bool success, std::chrono::milliseconds latency)
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      if (!selector)
+      {
+        return;
+      }
+      selector->handle_result(address, success);
+      if (success)
+      {
+        selector->handle_latency(address, latency);
+      }
+      else
+      {
+        idle.erase(address);
+        if (current && current->address == address)
+        {
+          current = boost::none;
+        }
+      }
+    }
+
+    attempt_result run(const bootstrap_node::node_info &node, const attempt_fn &attempt, size_t index)
+    {
+      std::unique_ptr<http_client> client = acquire(node);
+      if (!client)
+      {
+        return {false, std::string()};
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      attempt_result result = attempt(*client, index);
+      const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+      const bool failed = !result.success || (!rpc_payment_enabled && result.status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
+      handle_result(node.address, !failed, latency);
+      if (failed)
+      {
+        client->disconnect();
+      }
+      else
+      {
+        release(node.address, std::move(client));
+      }
+      return result;
+    }
+
+    // hedged copies run on threads owned here; finished ones are joined when
+    // the next one starts, the rest when the bootstrap daemon is destroyed
+    void spawn(std::function<void()> f)
+    {
+      const boost::unique_lock<boost::mutex> lock(threads_mutex);
+      for (auto i = threads.begin(); i != threads.end(); )
+      {
+        if (i->second->load())
+        {
+          i->first.join();
+          i = threads.erase(i);
+        }
+        else
+        {
+          ++i;
+        }
+      }
+      const std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+      threads.emplace_back(boost::thread([f, done]() { f(); *done = true; }), done);
+    }
+
+    void join_threads()
+    {
+      const boost::unique_lock<boost::mutex> lock(threads_mutex);
+      for (auto &t: threads)
+      {
+        t.first.join();
+      }
+      threads.clear();
+    }
+
+    mutable boost::mutex mutex;
+    boost::mutex threads_mutex;
+    std::list<std::pair<boost::thread, std::shared_ptr<std::atomic<bool>>>> threads;
+    const std::unique_ptr<bootstrap_node::selector> selector;
+    const bool rpc_payment_enabled;
+    boost::optional<bootstrap_node::node_info> current;
+    std::map<std::string, std::vector<std::unique_ptr<http_client>>> idle;
+  };
+
   bootstrap_daemon::bootstrap_daemon(
     std::function<std::map<std::string, bool>()> get_public_nodes,
     bool rpc_payment_enabled)
-    : m_selector(new bootstrap_node::selector_auto(std::move(get_public_nodes)))
-    , m_rpc_payment_enabled(rpc_payment_enabled)
+    : m_state(std::make_shared<state>(
+        std::unique_ptr<bootstrap_node::selector>(new bootstrap_node::selector_auto(std::move(get_public_nodes))),
+        rpc_payment_enabled))
   {
   }
 
@@ -26,23 +202,27 @@ namespace cryptonote
     const std::string &address,
     boost::optional<epee::net_utils::http::login> credentials,
     bool rpc_payment_enabled)
-    : m_selector(nullptr)
-    , m_rpc_payment_enabled(rpc_payment_enabled)
+    : m_state(std::make_shared<state>(nullptr, rpc_payment_enabled))
   {
-    if (!set_server(address, std::move(credentials)))
+    const bootstrap_node::node_info node{address, std::move(credentials)};
+    std::unique_ptr<state::http_client> client = m_state->acquire(node);
+    if (!client)
     {
       throw std::runtime_error("invalid bootstrap daemon address or credentials");
     }
+    MINFO("Changed bootstrap daemon address to " << address);
+    m_state->current = node;
+  }
+
+  bootstrap_daemon::~bootstrap_daemon()
+  {
+    m_state->join_threads();
   }
 
   std::string bootstrap_daemon::address() const noexcept
   {
-    const auto& host = m_http_client.get_host();
-    if (host.empty())
-    {
-      return std::string();
-    }
-    return host + ":" + m_http_client.get_port();
+    const boost::unique_lock<boost::mutex> lock(m_state->mutex);
+    return m_state->current ? m_state->current->address : std::string();
   }
 
   boost::optional<uint64_t> bootstrap_daemon::get_height()
@@ -65,49 +245,96 @@ namespace cryptonote
 
   bool bootstrap_daemon::handle_result(bool success, const std::string &status)
   {
-    const bool failed = !success || (!m_rpc_payment_enabled && status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
-    if (failed && m_selector)
+    const bool failed = !success || (!m_state->rpc_payment_enabled && status == CORE_RPC_STATUS_PAYMENT_REQUIRED);
+    if (failed)
     {
       const std::string current_address = address();
-      m_http_client.disconnect();
-
-      const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
-      m_selector->handle_result(current_address, !failed);
+      if (!current_address.empty())
+      {
+        m_state->handle_result(current_address, false, std::chrono::milliseconds(0));
+      }
     }
 
     return success;
   }
 
-  bool bootstrap_daemon::set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials /* = boost::none */)
+  int bootstrap_daemon::invoke_attempts(const attempt_fn &attempt, bool idempotent)
   {
-    if (!m_http_client.set_server(address, credentials))
+    const boost::optional<bootstrap_node::node_info> primary = m_state->get_node();
+    if (!primary)
     {
-      MERROR("Failed to set bootstrap daemon address " << address);
-      return false;
+      return -1;
     }
 
-    MINFO("Changed bootstrap daemon address to " << address);
-    return true;
-  }
-
-
-  bool bootstrap_daemon::switch_server_if_needed()
-  {
-    if (m_http_client.is_connected() || !m_selector)
+    // a fixed bootstrap daemon has nowhere to hedge to
+    if (!idempotent || !m_state->selector)
     {
-      return true;
+      return m_state->run(*primary, attempt, 0).success ? 0 : -1;
     }
 
-    boost::optional<bootstrap_node::node_info> node;
+    struct hedge
     {
-      const boost::unique_lock<boost::mutex> lock(m_selector_mutex);
-      node = m_selector->next_node();
-    }
-    if (node) {
-      return set_server(node->address, node->credentials);
-    }
+      boost::mutex mutex;
+      boost::condition_variable cond;
+      size_t started = 0;
+      size_t finished = 0;
+      int winner = -1;   // first copy with a usable answer
+      int fallback = -1; // first copy that got any answer
+    };
+    const std::shared_ptr<hedge> h = std::make_shared<hedge>();
+    state *st = m_state.get(); // outlives the copies, the destructor joins them
+
+    // copies run on their own threads so a slow node does not hold the caller;
+    // whichever loses finishes in the background and returns its connection
+    auto launch = [&](const bootstrap_node::node_info &node, size_t index) {
+      {
+        const boost::unique_lock<boost::mutex> lock(h->mutex);
+        ++h->started;
+      }
+      const auto run = [st, h, node, attempt, index]() {
+        const attempt_result result = st->run(node, attempt, index);
+        const bool usable = result.success && (st->rpc_payment_enabled || result.status != CORE_RPC_STATUS_PAYMENT_REQUIRED);
+        const boost::unique_lock<boost::mutex> lock(h->mutex);
+        ++h->finished;
+        if (usable && h->winner < 0)
+        {
+          h->winner = index;
+        }
+        if (result.success && h->fallback < 0)
+        {
+          h->fallback = index;
+        }
+        h->cond.notify_all();
+      };
+      try
+      {
+        st->spawn(run);
+      }
+      catch (const std::exception &e)
+      {
+        MWARNING("Failed to start bootstrap request thread: " << e.what());
+        run();
+      }
+    };
 
-    return false;
+    launch(*primary, 0);
+
+    boost::unique_lock<boost::mutex> lock(h->mutex);
+    const auto delay = boost::chrono::milliseconds(m_state->hedge_delay(primary->address).count());
+    h->cond.wait_for(lock, delay, [&h]() { return h->winner >= 0 || h->finished == h->started; });
+    if (h->winner < 0)
+    {
+      lock.unlock();
+      const boost::optional<bootstrap_node::node_info> second = m_state->get_node(primary->address);
+      if (second)
+      {
+        MDEBUG("Hedging bootstrap request to " << second->address << ", " << primary->address << " is slow or failed");
+        launch(*second, 1);
+      }
+      lock.lock();
+    }
+    h->cond.wait(lock, [&h]() { return h->winner >= 0 || h->finished == h->started; });
+    return h->winner >= 0 ? h->winner : h->fallback;
   }
 
 }
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 
 #include <boost/optional/optional.hpp>
 #include <boost/thread/mutex.hpp>
@@ -25,61 +26,73 @@ namespace cryptonote
       const std::string &address,
       boost::optional<epee::net_utils::http::login> credentials,
       bool rpc_payment_enabled);
+    ~bootstrap_daemon();
 
     std::string address() const noexcept;
     boost::optional<uint64_t> get_height();
     bool handle_result(bool success, const std::string &status);
 
+    // idempotent requests may be sent to a second node when the first one is slow
     template <class t_request, class t_response>
-    bool invoke_http_json(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct)
+    bool invoke_http_json(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct, bool idempotent = true)
     {
-      if (!switch_server_if_needed())
-      {
-        return false;
-      }
-
-      const bool result = epee::net_utils::invoke_http_json(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
+      const std::string uri_copy(uri.begin(), uri.end());
+      return invoke<t_response>([uri_copy, out_struct](epee::net_utils::http::http_simple_client &client, t_response &result) {
+        return epee::net_utils::invoke_http_json(uri_copy, out_struct, result, client);
+      }, result_struct, idempotent);
     }
 
     template <class t_request, class t_response>
-    bool invoke_http_bin(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct)
+    bool invoke_http_bin(const boost::string_ref uri, const t_request &out_struct, t_response &result_struct, bool idempotent = true)
     {
-      if (!switch_server_if_needed())
-      {
-        return false;
-      }
-
-      const bool result = epee::net_utils::invoke_http_bin(uri, out_struct, result_struct, m_http_client);
-      return handle_result(result, result_struct.status);
+      const std::string uri_copy(uri.begin(), uri.end());
+      return invoke<t_response>([uri_copy, out_struct](epee::net_utils::http::http_simple_client &client, t_response &result) {
+        return epee::net_utils::invoke_http_bin(uri_copy, out_struct, result, client);
+      }, result_struct, idempotent);
     }
 
     template <class t_request, class t_response>
-    bool invoke_http_json_rpc(const boost::string_ref command_name, const t_request &out_struct, t_response &result_struct)
+    bool invoke_http_json_rpc(const boost::string_ref command_name, const t_request &out_struct, t_response &result_struct, bool idempotent = true)
     {
-      if (!switch_server_if_needed())
+      const std::string command(command_name.begin(), command_name.end());
+      return invoke<t_response>([command, out_struct](epee::net_utils::http::http_simple_client &client, t_response &result) {
+        return epee::net_utils::invoke_http_json_rpc("/json_rpc", command, out_struct, result, client);
+      }, result_struct, idempotent);
+    }
+
+  private:
+    struct attempt_result
+    {
+      bool success;
+      std::string status;
+    };
+    // runs one copy of a request; the index tells hedged copies apart
+    typedef std::function<attempt_result(epee::net_utils::http::http_simple_client &client, size_t index)> attempt_fn;
+    struct state;
+
+    // returns the index of the copy whose response should be used, or -1
+    int invoke_attempts(const attempt_fn &attempt, bool idempotent);
+
+    template <class t_response>
+    bool invoke(std::function<bool(epee::net_utils::http::http_simple_client &, t_response &)> request, t_response &result_struct, bool idempotent)
+    {
+      // each copy gets its own response, a losing copy may still be running when we return
+      const std::shared_ptr<t_response> responses[2] = {std::make_shared<t_response>(), std::make_shared<t_response>()};
+      const int winner = invoke_attempts([request, responses](epee::net_utils::http::http_simple_client &client, size_t index) {
+        t_response &result = *responses[index];
+        const bool success = request(client, result);
+        return attempt_result{success, result.status};
+      }, idempotent);
+      if (winner < 0)
       {
         return false;
       }
-
-      const bool result = epee::net_utils::invoke_http_json_rpc(
-        "/json_rpc",
-        std::string(command_name.begin(), command_name.end()),
-        out_struct,
-        result_struct,
-        m_http_client);
-      return handle_result(result, result_struct.status);
+      result_struct = std::move(*responses[winner]);
+      return true;
     }
 
   private:
-    bool set_server(const std::string &address, const boost::optional<epee::net_utils::http::login> &credentials = boost::none);
-    bool switch_server_if_needed();
-
-  private:
-    epee::net_utils::http::http_simple_client m_http_client;
-    const bool m_rpc_payment_enabled;
-    const std::unique_ptr<bootstrap_node::selector> m_selector;
-    boost::mutex m_selector_mutex;
+    const std::shared_ptr<state> m_state;
   };
 
 }
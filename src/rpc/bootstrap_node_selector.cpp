@@ -28,6 +28,8 @@
 
 #include "bootstrap_node_selector.h"
 
+#include <vector>
+
 #include "crypto/crypto.h"
 
 namespace cryptonote
@@ -47,6 +49,12 @@ namespace bootstrap_node
     }
   }
 
+  void selector_auto::node::handle_latency(std::chrono::milliseconds latency)
+  {
+    const uint64_t sample = std::max<uint64_t>(latency.count(), 1);
+    latency_ms = latency_ms == 0 ? sample : (latency_ms * 7 + sample) / 8;
+  }
+
   void selector_auto::handle_result(const std::string &address, bool success)
   {
     auto &nodes_by_address = m_nodes.get<by_address>();
@@ -59,23 +67,67 @@ namespace bootstrap_node
     }
   }
 
+  void selector_auto::handle_latency(const std::string &address, std::chrono::milliseconds latency)
+  {
+    auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    if (it != nodes_by_address.end())
+    {
+      nodes_by_address.modify(it, [latency](node &entry) {
+        entry.handle_latency(latency);
+      });
+    }
+  }
+
+  std::chrono::milliseconds selector_auto::get_latency(const std::string &address) const
+  {
+    const auto &nodes_by_address = m_nodes.get<by_address>();
+    const auto it = nodes_by_address.find(address);
+    return std::chrono::milliseconds(it != nodes_by_address.end() ? it->latency_ms : 0);
+  }
+
   boost::optional<node_info> selector_auto::next_node()
+  {
+    return next_node(std::string());
+  }
+
+  boost::optional<node_info> selector_auto::next_node(const std::string &exclude)
   {
     if (!has_at_least_one_good_node())
     {
       append_new_nodes();
     }
 
-    if (m_nodes.empty())
+    // among the nodes with the fewest fails, pick one of the fastest; nodes not
+    // measured yet count as fastest so each gets tried
+    std::vector<const node *> candidates;
+    for (const auto &entry : m_nodes.get<by_fails>())
     {
-      return {};
+      if (entry.address == exclude)
+      {
+        continue;
+      }
+      if (!candidates.empty() && entry.fails != candidates.front()->fails)
+      {
+        break;
+      }
+      if (!candidates.empty() && entry.latency_ms > candidates.front()->latency_ms)
+      {
+        continue;
+      }
+      if (!candidates.empty() && entry.latency_ms < candidates.front()->latency_ms)
+      {
+        candidates.clear();
+      }
+      candidates.push_back(&entry);
     }
 
-    auto node = m_nodes.get<by_fails>().begin();
-    const size_t count = std::distance(node, m_nodes.get<by_fails>().upper_bound(node->fails));
-    std::advance(node, crypto::rand_idx(count));
+    if (candidates.empty())
+    {
+      return {};
+    }
 
-    return {{node->address, {}}};
+    return {{candidates[crypto::rand_idx(candidates.size())]->address, {}}};
   }
 
   bool selector_auto::has_at_least_one_good_node() const
@@ -92,7 +144,7 @@ namespace bootstrap_node
       const auto &address = node.first;
       const auto &white = node.second;
       const size_t initial_score = white ? 0 : 1;
-      updated |= m_nodes.get<by_address>().insert({address, initial_score}).second;
+      updated |= m_nodes.get<by_address>().insert({address, initial_score, 0}).second;
     }
 
     if (updated)
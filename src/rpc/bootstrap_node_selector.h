@@ -28,6 +28,7 @@
 
 #pragma  once
 
+#include <chrono>
 #include <functional>
 #include <limits>
 #include <map>
@@ -57,7 +58,11 @@ namespace bootstrap_node
     virtual ~selector() = default;
 
     virtual void handle_result(const std::string &address, bool success) = 0;
+    virtual void handle_latency(const std::string &address, std::chrono::milliseconds latency) {}
+    virtual std::chrono::milliseconds get_latency(const std::string &address) const { return std::chrono::milliseconds(0); }
     virtual boost::optional<node_info> next_node() = 0;
+    // picks a node other than exclude, to send a hedged copy of a request to
+    virtual boost::optional<node_info> next_node(const std::string &exclude) = 0;
   };
 
   class selector_auto : public selector
@@ -69,7 +74,10 @@ namespace bootstrap_node
     {}
 
     void handle_result(const std::string &address, bool success) final;
+    void handle_latency(const std::string &address, std::chrono::milliseconds latency) final;
+    std::chrono::milliseconds get_latency(const std::string &address) const final;
     boost::optional<node_info> next_node() final;
+    boost::optional<node_info> next_node(const std::string &exclude) final;
 
   private:
     bool has_at_least_one_good_node() const;
@@ -81,8 +89,10 @@ namespace bootstrap_node
     {
       std::string address;
       size_t fails;
+      uint64_t latency_ms; // moving average of response times, 0 until measured
 
       void handle_result(bool success);
+      void handle_latency(std::chrono::milliseconds latency);
     };
 
     struct by_address {};
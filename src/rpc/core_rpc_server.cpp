@@ -72,6 +72,14 @@ using namespace epee;
 #define RESTRICTED_TRANSACTIONS_COUNT 100
 #define RESTRICTED_SPENT_KEY_IMAGES_COUNT 5000
 #define RESTRICTED_BLOCK_COUNT 1000
+#define RESTRICTED_CIRCULATING_SUPPLY_CONVERSIONS_COUNT 1000
+#define MAX_CIRCULATING_SUPPLY_CONVERSIONS_COUNT 100000
+
+#define RPC_LIGHT_IO_THREADS 2
+#define DEFAULT_RPC_MAX_HEAVY_REQUESTS 2
+#define DEFAULT_RPC_MAX_QUEUED_HEAVY_REQUESTS 4
+#define RPC_ADMIN_MAX_QUEUED_REQUESTS 2
+#define RPC_QUEUE_TIMEOUT_MS 20000
 
 #define RPC_TRACKER(rpc) \
   PERF_TIMER(rpc); \
@@ -165,6 +173,9 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_payment_difficulty);
     command_line::add_arg(desc, arg_rpc_payment_credits);
     command_line::add_arg(desc, arg_rpc_payment_allow_free_loopback);
+    command_line::add_arg(desc, arg_rpc_max_heavy_requests);
+    command_line::add_arg(desc, arg_rpc_max_queued_heavy_requests);
+    command_line::add_arg(desc, arg_rpc_reuseport);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -249,6 +260,77 @@ namespace cryptonote
 
     return true;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    MINFO("HTTP [" << m_conn_context.m_remote_address.host_str() << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    try
+    {
+      std::string cache_key, id_json;
+      crypto::hash top_hash;
+      uint64_t pool_cookie;
+      if (get_cached_response(query_info, response, cache_key, id_json, top_hash, pool_cookie))
+        return true;
+      if(!handle_http_request_map(query_info, response, m_conn_context))
+      {
+        response.m_response_code = 404;
+        response.m_response_comment = "Not found";
+      }
+      else if (!cache_key.empty())
+      {
+        cache_response(cache_key, id_json, top_hash, pool_cookie, response);
+      }
+    }
+    catch (const std::exception &e)
+    {
+      MERROR(m_conn_context << "Exception in handle_http_request_map: " << e.what());
+      response.m_response_code = 500;
+      response.m_response_comment = "Internal Server Error";
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_cached_response(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, std::string &key, std::string &id_json, crypto::hash &top_hash, uint64_t &pool_cookie)
+  {
+    // paid and bootstrapped answers depend on the client or on another daemon
+    if (m_rpc_payment || m_should_use_bootstrap_daemon)
+      return false;
+    if (!rpc_response_cache::get_request_key(query_info.m_URI, query_info.m_body, key, id_json))
+    {
+      key.clear();
+      return false;
+    }
+
+    // read before the request is handled, so an answer is never cached under a newer state than it saw
+    top_hash = m_core.get_blockchain_storage().get_tail_id();
+    pool_cookie = m_core.get_pool_cookie();
+    rpc_response_cache::response cached;
+    if (!m_response_cache.get(top_hash, pool_cookie, key, id_json, cached))
+      return false;
+    response.m_body = std::move(cached.body);
+    response.m_mime_tipe = std::move(cached.mime_type);
+    response.m_header_info.m_content_type = std::move(cached.content_type);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::cache_response(const std::string &key, const std::string &id_json, const crypto::hash &top_hash, uint64_t pool_cookie, const epee::net_utils::http::http_response_info& response)
+  {
+    if (response.m_response_code != 200)
+      return;
+    rpc_response_cache::response res;
+    res.body = response.m_body;
+    res.mime_type = response.m_mime_tipe;
+    res.content_type = response.m_header_info.m_content_type;
+    m_response_cache.put(top_hash, pool_cookie, key, id_json, res);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t core_rpc_server::get_io_threads() const
+  {
+    return m_rpc_scheduler.get_io_threads(RPC_LIGHT_IO_THREADS);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::~core_rpc_server()
   {
     if (m_rpc_payment)
@@ -326,6 +408,15 @@ namespace cryptonote
     if (m_rpc_payment)
       m_net_server.add_idle_handler([this](){ return m_rpc_payment->on_idle(); }, 60 * 1000);
 
+    const size_t max_heavy = std::max<size_t>(command_line::get_arg(vm, arg_rpc_max_heavy_requests), 1);
+    const size_t max_queued_heavy = command_line::get_arg(vm, arg_rpc_max_queued_heavy_requests);
+    // a single client may fill the running slots and half of the queue, so others still get a turn
+    m_rpc_scheduler.configure(rpc_request_scheduler::cost_heavy, max_heavy, max_queued_heavy, max_heavy + max_queued_heavy / 2, RPC_QUEUE_TIMEOUT_MS);
+    m_rpc_scheduler.configure(rpc_request_scheduler::cost_admin, 1, RPC_ADMIN_MAX_QUEUED_REQUESTS, 1 + RPC_ADMIN_MAX_QUEUED_REQUESTS, RPC_QUEUE_TIMEOUT_MS);
+
+    if (command_line::get_arg(vm, arg_rpc_reuseport))
+      m_net_server.set_accept_sharding(true);
+
     auto rng = [](size_t len, uint8_t *ptr){ return crypto::rand(len, ptr); };
     return epee::http_server_impl_base<core_rpc_server, connection_context>::init(
       rng, std::move(port), std::move(rpc_config->bind_ip),
@@ -370,6 +461,14 @@ namespace cryptonote
   }
 #define CHECK_PAYMENT_BASE(req, res, payment, same_ts) do { if (!ctx) break; uint64_t P = (uint64_t)payment; if (P > 0 && !check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
 #define CHECK_PAYMENT(req, res, payment) CHECK_PAYMENT_BASE(req, res, payment, false)
+  // used after any forwarding to the bootstrap daemon, so a forwarded request does not hold a slot
+#define RPC_SCHEDULE(cost) \
+  rpc_request_scheduler::slot rpc_slot; \
+  if (ctx) \
+  { \
+    rpc_slot = m_rpc_scheduler.acquire(rpc_request_scheduler::cost, ctx->m_remote_address.host_str()); \
+    if (!rpc_slot) { res.status = CORE_RPC_STATUS_BUSY; return true; } \
+  }
 #define CHECK_PAYMENT_SAME_TS(req, res, payment) CHECK_PAYMENT_BASE(req, res, payment, true)
 #define CHECK_PAYMENT_MIN1(req, res, payment, same_ts) do { if (!ctx || (m_rpc_payment_allow_free_loopback && ctx->m_remote_address.is_loopback())) break; uint64_t P = (uint64_t)payment; if (P == 0) P = 1; if(!check_payment(req.client, P, tracker.rpc_name(), same_ts, res.status, res.credits, res.top_hash)){return true;} tracker.pay(P); } while(0)
   //------------------------------------------------------------------------------------------------------------------------------
@@ -527,6 +626,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     CHECK_PAYMENT(req, res, 1);
 
@@ -664,6 +764,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_BY_HEIGHT>(invoke_http_mode::BIN, "/getblocks_by_height.bin", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     if (restricted && req.heights.size() > RESTRICTED_BLOCK_COUNT)
@@ -706,6 +807,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_HASHES_FAST>(invoke_http_mode::BIN, "/gethashes.bin", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     CHECK_PAYMENT(req, res, 1);
 
@@ -729,6 +831,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS_BIN>(invoke_http_mode::BIN, "/get_outs.bin", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     CHECK_PAYMENT_MIN1(req, res, req.outputs.size() * COST_PER_OUT, false);
 
@@ -759,6 +862,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUTS>(invoke_http_mode::JON, "/get_outs", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     CHECK_PAYMENT_MIN1(req, res, req.outputs.size() * COST_PER_OUT, false);
 
@@ -835,6 +939,7 @@ namespace cryptonote
     bool ok;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTIONS>(invoke_http_mode::JON, "/gettransactions", req, res, ok))
       return ok;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     const bool request_has_rpc_origin = ctx != NULL;
@@ -1014,6 +1119,29 @@ namespace cryptonote
           }
         }
       }
+      if (req.decode_assets)
+      {
+        // the pruned part holds the prefix and rct base, which is all the Haven fields need
+        cryptonote::transaction t;
+        cryptonote::tx_asset_info info;
+        // a tx we cannot decode is still returned, just without asset_info
+        if (!cryptonote::parse_and_validate_tx_base_from_blob(std::get<1>(tx), t) || !cryptonote::get_tx_asset_info(t, tx_hash, info))
+        {
+          MWARNING("Failed to decode asset info of tx " << tx_hash);
+        }
+        else
+        {
+          e.asset_info.tx_type = cryptonote::get_tx_type_name(info.type);
+          e.asset_info.source_asset_type = std::move(info.source_asset_type);
+          e.asset_info.dest_asset_type = std::move(info.dest_asset_type);
+          e.asset_info.pricing_record_height = info.pricing_record_height;
+          e.asset_info.amount_burnt = info.amount_burnt;
+          e.asset_info.amount_minted = info.amount_minted;
+          e.asset_info.fee = info.fee;
+          e.asset_info.conversion_fee = info.conversion_fee;
+          e.asset_info.collateral_indices = std::move(info.collateral_indices);
+        }
+      }
       e.in_pool = pool_tx_hashes.find(tx_hash) != pool_tx_hashes.end();
       if (e.in_pool)
       {
@@ -1082,6 +1210,7 @@ namespace cryptonote
     bool ok;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_IS_KEY_IMAGE_SPENT>(invoke_http_mode::JON, "/is_key_image_spent", req, res, ok))
       return ok;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     const bool request_has_rpc_origin = ctx != NULL;
@@ -1161,6 +1290,13 @@ namespace cryptonote
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_SEND_RAW_TX>(invoke_http_mode::JON, "/sendrawtransaction", req, res, ok))
       return ok;
 
+    if (m_core.is_read_only_follower())
+    {
+      res.status = "Failed";
+      res.reason = "Daemon is a read only follower, send transactions to the daemon writing its db";
+      return true;
+    }
+
     CHECK_CORE_READY();
     CHECK_PAYMENT_MIN1(req, res, COST_PER_TX_RELAY, false);
 
@@ -1237,6 +1373,11 @@ namespace cryptonote
   {
     RPC_TRACKER(start_mining);
     CHECK_CORE_READY();
+    if (m_core.is_read_only_follower())
+    {
+      res.status = "Daemon is a read only follower";
+      return true;
+    }
     cryptonote::address_parse_info info;
     if(!get_account_address_from_str(info, nettype(), req.miner_address))
     {
@@ -1349,6 +1490,7 @@ namespace cryptonote
   bool core_rpc_server::on_save_bc(const COMMAND_RPC_SAVE_BC::request& req, COMMAND_RPC_SAVE_BC::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(save_bc);
+    RPC_SCHEDULE(cost_admin);
     if( !m_core.get_blockchain_storage().store_blockchain() )
     {
       res.status = "Error while storing blockchain";
@@ -1483,6 +1625,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL>(invoke_http_mode::JON, "/get_transaction_pool", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     CHECK_PAYMENT(req, res, 1);
 
@@ -1842,6 +1985,12 @@ namespace cryptonote
         return false;
       }
     }
+    if (m_core.is_read_only_follower())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Daemon is a read only follower";
+      return false;
+    }
     CHECK_CORE_READY();
     if(req.size()!=1)
     {
@@ -1890,6 +2039,7 @@ namespace cryptonote
   bool core_rpc_server::on_generateblocks(const COMMAND_RPC_GENERATEBLOCKS::request& req, COMMAND_RPC_GENERATEBLOCKS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(generateblocks);
+    RPC_SCHEDULE(cost_admin);
 
     CHECK_CORE_READY();
     
@@ -2070,17 +2220,21 @@ namespace cryptonote
         return false;
     }
 
+    // let other requests use the bootstrap daemon while this one is in flight
+    boost::shared_lock<boost::shared_mutex> shared_lock(std::move(upgrade_lock));
+
+    const bool idempotent = !std::is_base_of<rpc_not_idempotent, COMMAND_TYPE>::value;
     if (mode == invoke_http_mode::JON)
     {
-      r = m_bootstrap_daemon->invoke_http_json(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_json(command_name, req, res, idempotent);
     }
     else if (mode == invoke_http_mode::BIN)
     {
-      r = m_bootstrap_daemon->invoke_http_bin(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_bin(command_name, req, res, idempotent);
     }
     else if (mode == invoke_http_mode::JON_RPC)
     {
-      r = m_bootstrap_daemon->invoke_http_json_rpc(command_name, req, res);
+      r = m_bootstrap_daemon->invoke_http_json_rpc(command_name, req, res, idempotent);
     }
     else
     {
@@ -2088,10 +2242,7 @@ namespace cryptonote
       return false;
     }
 
-    {
-      boost::upgrade_to_unique_lock<boost::shared_mutex> lock(upgrade_lock);
-      m_was_bootstrap_ever_used = true;
-    }
+    m_was_bootstrap_ever_used = true;
 
     if (r && res.status != CORE_RPC_STATUS_PAYMENT_REQUIRED && res.status != CORE_RPC_STATUS_OK)
     {
@@ -2209,6 +2360,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCK_HEADERS_RANGE>(invoke_http_mode::JON_RPC, "getblockheadersrange", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     const uint64_t bc_height = m_core.get_current_blockchain_height();
     if (req.start_height >= bc_height || req.end_height >= bc_height || req.start_height > req.end_height)
@@ -2517,6 +2669,7 @@ namespace cryptonote
   bool core_rpc_server::on_set_bans(const COMMAND_RPC_SETBANS::request& req, COMMAND_RPC_SETBANS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(set_bans);
+    RPC_SCHEDULE(cost_admin);
 
     for (auto i = req.bans.begin(); i != req.bans.end(); ++i)
     {
@@ -2565,6 +2718,7 @@ namespace cryptonote
   bool core_rpc_server::on_flush_txpool(const COMMAND_RPC_FLUSH_TRANSACTION_POOL::request& req, COMMAND_RPC_FLUSH_TRANSACTION_POOL::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(flush_txpool);
+    RPC_SCHEDULE(cost_admin);
 
     bool failed = false;
     std::vector<crypto::hash> txids;
@@ -2622,6 +2776,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUT_HISTOGRAM>(invoke_http_mode::JON_RPC, "get_output_histogram", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     size_t amounts = req.amounts.size();
@@ -2679,6 +2834,7 @@ namespace cryptonote
   bool core_rpc_server::on_get_coinbase_tx_sum(const COMMAND_RPC_GET_COINBASE_TX_SUM::request& req, COMMAND_RPC_GET_COINBASE_TX_SUM::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(get_coinbase_tx_sum);
+    RPC_SCHEDULE(cost_heavy);
     const uint64_t bc_height = m_core.get_current_blockchain_height();
     if (req.height >= bc_height || req.count > bc_height)
     {
@@ -2706,6 +2862,83 @@ namespace cryptonote
     return true;    
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_circulating_supply_changes(const COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES::request& req, COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    PERF_TIMER(on_get_circulating_supply_changes);
+    const BlockchainDB &db = m_core.get_blockchain_storage().get_db();
+    const uint64_t height = db.height();
+    res.start_height = req.start_height;
+    res.end_height = req.end_height ? std::min(req.end_height, height) : height;
+    if (res.start_height > res.end_height)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "start_height is above end_height";
+      return false;
+    }
+
+    const std::vector<std::string> &currencies = req.currencies.empty() ? offshore::ASSET_TYPES : req.currencies;
+    for (const std::string &currency: currencies)
+    {
+      if (std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), currency) == offshore::ASSET_TYPES.end())
+      {
+        error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+        error_resp.message = "Unknown currency: " + currency;
+        return false;
+      }
+    }
+
+    try
+    {
+      for (const std::string &currency: currencies)
+      {
+        const circ_supply_delta delta = db.get_circulating_supply_delta(currency, res.start_height, res.end_height);
+        COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES::supply_change change;
+        change.currency_label = currency;
+        change.burnt = boost::to_string(delta.burnt);
+        change.minted = boost::to_string(delta.minted);
+        change.net = boost::to_string(boost::multiprecision::int128_t(delta.minted) - boost::multiprecision::int128_t(delta.burnt));
+        change.conversions = delta.conversions;
+        res.changes.push_back(std::move(change));
+      }
+
+      res.conversions_truncated = false;
+      if (req.include_conversions)
+      {
+        // each pair returns its first max_count + 1, enough to fill and tell whether more were left out
+        const size_t max_count = m_restricted ? RESTRICTED_CIRCULATING_SUPPLY_CONVERSIONS_COUNT : MAX_CIRCULATING_SUPPLY_CONVERSIONS_COUNT;
+        std::vector<circ_supply_conversion> conversions;
+        for (const std::string &source: offshore::ASSET_TYPES)
+        {
+          for (const std::string &dest: offshore::ASSET_TYPES)
+          {
+            if (source == dest || (std::find(currencies.begin(), currencies.end(), source) == currencies.end() && std::find(currencies.begin(), currencies.end(), dest) == currencies.end()))
+              continue;
+            std::vector<circ_supply_conversion> pair_conversions = db.get_circulating_supply_conversions(source, dest, res.start_height, res.end_height, max_count + 1);
+            conversions.insert(conversions.end(), pair_conversions.begin(), pair_conversions.end());
+          }
+        }
+        std::stable_sort(conversions.begin(), conversions.end(), [](const circ_supply_conversion &a, const circ_supply_conversion &b) { return a.height < b.height; });
+        if (conversions.size() > max_count)
+        {
+          conversions.resize(max_count);
+          res.conversions_truncated = true;
+        }
+        res.conversions.reserve(conversions.size());
+        for (const circ_supply_conversion &c: conversions)
+          res.conversions.push_back({c.height, epee::string_tools::pod_to_hex(c.tx_hash), c.source, c.dest, c.pricing_record_height, c.amount_burnt, c.amount_minted});
+      }
+    }
+    catch (const std::exception &e)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = std::string("Failed to read circulating supply changes: ") + e.what();
+      return false;
+    }
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_collateral_requirements(const COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS::request& req, COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     PERF_TIMER(on_get_collateral_requirements);
@@ -2860,6 +3093,7 @@ namespace cryptonote
   bool core_rpc_server::on_update(const COMMAND_RPC_UPDATE::request& req, COMMAND_RPC_UPDATE::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(update);
+    RPC_SCHEDULE(cost_admin);
 
     res.update = false;
     if (m_core.offline())
@@ -2967,6 +3201,13 @@ namespace cryptonote
   bool core_rpc_server::on_pop_blocks(const COMMAND_RPC_POP_BLOCKS::request& req, COMMAND_RPC_POP_BLOCKS::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(pop_blocks);
+    RPC_SCHEDULE(cost_admin);
+
+    if (m_core.is_read_only_follower())
+    {
+      res.status = "Daemon is a read only follower";
+      return true;
+    }
 
     m_core.get_blockchain_storage().pop_blocks(req.nblocks);
 
@@ -3056,6 +3297,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_TRANSACTION_POOL_BACKLOG>(invoke_http_mode::JON_RPC, "get_txpool_backlog", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
     size_t n_txes = m_core.get_pool_transactions_count();
     CHECK_PAYMENT_MIN1(req, res, COST_PER_TX_POOL_STATS * n_txes, false);
 
@@ -3076,6 +3318,7 @@ namespace cryptonote
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUT_DISTRIBUTION>(invoke_http_mode::JON_RPC, "get_output_distribution", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     if (restricted && req.amounts != std::vector<uint64_t>(1, 0))
@@ -3130,10 +3373,10 @@ namespace cryptonote
   bool core_rpc_server::on_get_output_distribution_bin(const COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request& req, COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response& res, const connection_context *ctx)
   {
     RPC_TRACKER(get_output_distribution_bin);
-
     bool r;
     if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_OUTPUT_DISTRIBUTION>(invoke_http_mode::BIN, "/get_output_distribution.bin", req, res, r))
       return r;
+    RPC_SCHEDULE(cost_heavy);
 
     const bool restricted = m_restricted && ctx;
     if (restricted && req.amounts != std::vector<uint64_t>(1, 0))
@@ -3192,10 +3435,28 @@ namespace cryptonote
   bool core_rpc_server::on_prune_blockchain(const COMMAND_RPC_PRUNE_BLOCKCHAIN::request& req, COMMAND_RPC_PRUNE_BLOCKCHAIN::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(prune_blockchain);
+    RPC_SCHEDULE(cost_admin);
+
+    if (m_core.is_read_only_follower())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Daemon is a read only follower";
+      return false;
+    }
 
     try
     {
-      if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
+      if (req.background && !req.check)
+      {
+        // starting is a no-op if pruned or being pruned already, so this doubles as a progress query
+        if (!m_core.start_incremental_pruning() && m_core.get_blockchain_pruning_seed() == 0)
+        {
+          error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+          error_resp.message = "Failed to start background pruning";
+          return false;
+        }
+      }
+      else if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
       {
         error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
         error_resp.message = req.check ? "Failed to check blockchain pruning" : "Failed to prune blockchain";
@@ -3203,6 +3464,12 @@ namespace cryptonote
       }
       res.pruning_seed = m_core.get_blockchain_pruning_seed();
       res.pruned = res.pruning_seed != 0;
+      const pruning_progress progress = m_core.get_pruning_progress();
+      res.background_pruning = progress.active;
+      res.background_pruning_height = progress.next_height;
+      res.background_pruning_end_height = progress.end_height;
+      res.background_pruned_txes = progress.pruned_txes;
+      res.background_pruned_bytes = progress.pruned_bytes;
     }
     catch (const std::exception &e)
     {
@@ -3281,6 +3548,7 @@ namespace cryptonote
   bool core_rpc_server::on_flush_cache(const COMMAND_RPC_FLUSH_CACHE::request& req, COMMAND_RPC_FLUSH_CACHE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     RPC_TRACKER(flush_cache);
+    RPC_SCHEDULE(cost_admin);
     if (req.bad_txs)
       m_core.flush_bad_txs_cache();
     if (req.bad_blocks)
@@ -3524,4 +3792,22 @@ namespace cryptonote
     , "Allow free access from the loopback address (ie, the local host)"
     , false
     };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_max_heavy_requests = {
+      "rpc-max-heavy-requests"
+    , "Max number of expensive RPC requests (block, output and transaction scans) running at once, the rest are queued"
+    , DEFAULT_RPC_MAX_HEAVY_REQUESTS
+    };
+
+  const command_line::arg_descriptor<size_t> core_rpc_server::arg_rpc_max_queued_heavy_requests = {
+      "rpc-max-queued-heavy-requests"
+    , "Max number of expensive RPC requests waiting for a slot before new ones are answered BUSY"
+    , DEFAULT_RPC_MAX_QUEUED_HEAVY_REQUESTS
+    };
+
+  const command_line::arg_descriptor<bool> core_rpc_server::arg_rpc_reuseport = {
+      "rpc-reuseport"
+    , "Give each RPC thread its own SO_REUSEPORT listener and keep its connections on that thread"
+    , false
+    };
 }  // namespace cryptonote
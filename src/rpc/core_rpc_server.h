@@ -30,6 +30,7 @@
 
 #pragma  once 
 
+#include <atomic>
 #include <memory>
 
 #include <boost/program_options/options_description.hpp>
@@ -43,6 +44,8 @@
 #include "p2p/net_node.h"
 #include "cryptonote_protocol/cryptonote_protocol_handler.h"
 #include "rpc_payment.h"
+#include "rpc_request_scheduler.h"
+#include "rpc_response_cache.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -76,6 +79,9 @@ namespace cryptonote
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_difficulty;
     static const command_line::arg_descriptor<uint64_t> arg_rpc_payment_credits;
     static const command_line::arg_descriptor<bool> arg_rpc_payment_allow_free_loopback;
+    static const command_line::arg_descriptor<size_t> arg_rpc_max_heavy_requests;
+    static const command_line::arg_descriptor<size_t> arg_rpc_max_queued_heavy_requests;
+    static const command_line::arg_descriptor<bool> arg_rpc_reuseport;
 
     typedef epee::net_utils::connection_context_base connection_context;
 
@@ -93,8 +99,10 @@ namespace cryptonote
         bool allow_rpc_payment
       );
     network_type nettype() const { return m_core.get_nettype(); }
+    size_t get_io_threads() const;
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //forward http requests to uri map, answering idempotent calls from the response cache when possible
+    bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/get_height", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -109,6 +117,7 @@ namespace cryptonote
       MAP_URI_AUTO_BIN2("/get_outs.bin", on_get_outs_bin, COMMAND_RPC_GET_OUTPUTS_BIN)
       MAP_URI_AUTO_JON2("/get_transactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
+      MAP_URI_AUTO_BIN2("/get_transactions.bin", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/get_alt_blocks_hashes", on_get_alt_blocks_hashes, COMMAND_RPC_GET_ALT_BLOCKS_HASHES)
       MAP_URI_AUTO_JON2("/is_key_image_spent", on_is_key_image_spent, COMMAND_RPC_IS_KEY_IMAGE_SPENT)
       MAP_URI_AUTO_JON2("/send_raw_transaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
@@ -170,6 +179,7 @@ namespace cryptonote
         MAP_JON_RPC_WE("get_version",            on_get_version,                COMMAND_RPC_GET_VERSION)
         MAP_JON_RPC_WE_IF("get_coinbase_tx_sum", on_get_coinbase_tx_sum,        COMMAND_RPC_GET_COINBASE_TX_SUM, !m_restricted)
         MAP_JON_RPC_WE("get_circulating_supply", on_get_circulating_supply,  COMMAND_RPC_GET_CIRCULATING_SUPPLY)
+        MAP_JON_RPC_WE("get_circulating_supply_changes", on_get_circulating_supply_changes, COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES)
         MAP_JON_RPC_WE("get_collateral_requirements", on_get_collateral_requirements,  COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS)
         MAP_JON_RPC_WE("get_fee_estimate",       on_get_base_fee_estimate,      COMMAND_RPC_GET_BASE_FEE_ESTIMATE)
         MAP_JON_RPC_WE_IF("get_alternate_chains",on_get_alternate_chains,       COMMAND_RPC_GET_ALTERNATE_CHAINS, !m_restricted)
@@ -246,6 +256,7 @@ namespace cryptonote
     bool on_get_version(const COMMAND_RPC_GET_VERSION::request& req, COMMAND_RPC_GET_VERSION::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_coinbase_tx_sum(const COMMAND_RPC_GET_COINBASE_TX_SUM::request& req, COMMAND_RPC_GET_COINBASE_TX_SUM::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_circulating_supply(const COMMAND_RPC_GET_CIRCULATING_SUPPLY::request& req, COMMAND_RPC_GET_CIRCULATING_SUPPLY::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
+    bool on_get_circulating_supply_changes(const COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES::request& req, COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_collateral_requirements(const COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS::request& req, COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_base_fee_estimate(const COMMAND_RPC_GET_BASE_FEE_ESTIMATE::request& req, COMMAND_RPC_GET_BASE_FEE_ESTIMATE::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
     bool on_get_alternate_chains(const COMMAND_RPC_GET_ALTERNATE_CHAINS::request& req, COMMAND_RPC_GET_ALTERNATE_CHAINS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx = NULL);
@@ -280,6 +291,8 @@ private:
     bool use_bootstrap_daemon_if_necessary(const invoke_http_mode &mode, const std::string &command_name, const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res, bool &r);
     bool get_block_template(const account_public_address &address, const crypto::hash *prev_block, const cryptonote::blobdata &extra_nonce, size_t &reserved_offset, cryptonote::difficulty_type &difficulty, uint64_t &height, uint64_t &expected_reward, block &b, uint64_t &seed_height, crypto::hash &seed_hash, crypto::hash &next_seed_hash, epee::json_rpc::error &error_resp);
     bool check_payment(const std::string &client, uint64_t payment, const std::string &rpc, bool same_ts, std::string &message, uint64_t &credits, std::string &top_hash);
+    bool get_cached_response(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, std::string &key, std::string &id_json, crypto::hash &top_hash, uint64_t &pool_cookie);
+    void cache_response(const std::string &key, const std::string &id_json, const crypto::hash &top_hash, uint64_t pool_cookie, const epee::net_utils::http::http_response_info& response);
     
     core& m_core;
     nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
@@ -287,13 +300,16 @@ private:
     std::unique_ptr<bootstrap_daemon> m_bootstrap_daemon;
     bool m_should_use_bootstrap_daemon;
     std::chrono::system_clock::time_point m_bootstrap_height_check_time;
-    bool m_was_bootstrap_ever_used;
+    std::atomic<bool> m_was_bootstrap_ever_used;
     bool m_restricted;
     epee::critical_section m_host_fails_score_lock;
     std::map<std::string, uint64_t> m_host_fails_score;
     std::unique_ptr<rpc_payment> m_rpc_payment;
     bool disable_rpc_ban;
     bool m_rpc_payment_allow_free_loopback;
+    rpc_request_scheduler m_rpc_scheduler;
+
+    rpc_response_cache m_response_cache;
   };
 }
 
@@ -88,7 +88,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 1
+#define CORE_RPC_VERSION_MINOR 2
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -135,6 +135,12 @@ namespace cryptonote
     END_KV_SERIALIZE_MAP()
   };
 
+  // Commands with side effects derive from this, so they are never sent to
+  // more than one bootstrap node.
+  struct rpc_not_idempotent
+  {
+  };
+
   struct COMMAND_RPC_GET_HEIGHT
   {
     struct request_t: public rpc_request_base
@@ -348,6 +354,7 @@ namespace cryptonote
       bool decode_as_json;
       bool prune;
       bool split;
+      bool decode_assets;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_request_base)
@@ -355,10 +362,37 @@ namespace cryptonote
         KV_SERIALIZE(decode_as_json)
         KV_SERIALIZE_OPT(prune, false)
         KV_SERIALIZE_OPT(split, false)
+        KV_SERIALIZE_OPT(decode_assets, false)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
 
+    // Haven fields of a tx, filled when decode_assets is set so callers need not parse as_json
+    struct asset_info_entry
+    {
+      std::string tx_type;
+      std::string source_asset_type;
+      std::string dest_asset_type;
+      uint64_t pricing_record_height;
+      uint64_t amount_burnt;
+      uint64_t amount_minted;
+      uint64_t fee;
+      uint64_t conversion_fee;
+      std::vector<uint32_t> collateral_indices;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(tx_type)
+        KV_SERIALIZE(source_asset_type)
+        KV_SERIALIZE(dest_asset_type)
+        KV_SERIALIZE(pricing_record_height)
+        KV_SERIALIZE(amount_burnt)
+        KV_SERIALIZE(amount_minted)
+        KV_SERIALIZE(fee)
+        KV_SERIALIZE(conversion_fee)
+        KV_SERIALIZE(collateral_indices)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct entry
     {
       std::string tx_hash;
@@ -375,6 +409,7 @@ namespace cryptonote
       std::vector<uint64_t> output_indices;
       std::vector<uint64_t> asset_type_output_indices;
       bool relayed;
+      asset_info_entry asset_info;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(tx_hash)
@@ -383,6 +418,9 @@ namespace cryptonote
         KV_SERIALIZE(prunable_as_hex)
         KV_SERIALIZE(prunable_hash)
         KV_SERIALIZE(as_json)
+        // only present when decode_assets was requested, tx_type is never empty once decoded
+        if (!is_store || !this_ref.asset_info.tx_type.empty())
+          KV_SERIALIZE(asset_info)
         KV_SERIALIZE(in_pool)
         KV_SERIALIZE(double_spend_seen)
         if (!this_ref.in_pool)
@@ -593,7 +631,7 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
   //-----------------------------------------------
-  struct COMMAND_RPC_SEND_RAW_TX
+  struct COMMAND_RPC_SEND_RAW_TX: public rpc_not_idempotent
   {
     struct request_t: public rpc_access_request_base
     {
@@ -2035,6 +2073,83 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
   
+  struct COMMAND_RPC_GET_CIRCULATING_SUPPLY_CHANGES
+  {
+    struct request_t
+    {
+      std::vector<std::string> currencies;
+      uint64_t start_height;
+      uint64_t end_height;
+      bool include_conversions;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(currencies)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE_OPT(end_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(include_conversions, false)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct supply_change
+    {
+      std::string currency_label;
+      std::string burnt;
+      std::string minted;
+      std::string net;
+      uint64_t conversions;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(currency_label)
+        KV_SERIALIZE(burnt)
+        KV_SERIALIZE(minted)
+        KV_SERIALIZE(net)
+        KV_SERIALIZE(conversions)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct conversion_entry
+    {
+      uint64_t height;
+      std::string tx_hash;
+      std::string source;
+      std::string dest;
+      uint64_t pricing_record_height;
+      uint64_t amount_burnt;
+      uint64_t amount_minted;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(tx_hash)
+        KV_SERIALIZE(source)
+        KV_SERIALIZE(dest)
+        KV_SERIALIZE(pricing_record_height)
+        KV_SERIALIZE(amount_burnt)
+        KV_SERIALIZE(amount_minted)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response_t
+    {
+      std::string status;
+      uint64_t start_height;
+      uint64_t end_height;
+      std::vector<supply_change> changes;
+      std::vector<conversion_entry> conversions;
+      bool conversions_truncated;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(end_height)
+        KV_SERIALIZE(changes)
+        KV_SERIALIZE(conversions)
+        KV_SERIALIZE(conversions_truncated)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_GET_COLLATERAL_REQUIREMENTS
   {
     struct request_t
@@ -2482,7 +2597,7 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
-  struct COMMAND_RPC_ACCESS_SUBMIT_NONCE
+  struct COMMAND_RPC_ACCESS_SUBMIT_NONCE: public rpc_not_idempotent
   {
     struct request_t: public rpc_access_request_base
     {
@@ -2506,7 +2621,7 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
-  struct COMMAND_RPC_ACCESS_PAY
+  struct COMMAND_RPC_ACCESS_PAY: public rpc_not_idempotent
   {
     struct request_t: public rpc_access_request_base
     {
@@ -2676,10 +2791,12 @@ namespace cryptonote
     struct request_t: public rpc_request_base
     {
       bool check;
+      bool background; // prune in small steps while the daemon runs, also reports on a running job
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_request_base)
         KV_SERIALIZE_OPT(check, false)
+        KV_SERIALIZE_OPT(background, false)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<request_t> request;
@@ -2688,11 +2805,21 @@ namespace cryptonote
     {
       bool pruned;
       uint32_t pruning_seed;
+      bool background_pruning;
+      uint64_t background_pruning_height;
+      uint64_t background_pruning_end_height;
+      uint64_t background_pruned_txes;
+      uint64_t background_pruned_bytes;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_response_base)
         KV_SERIALIZE(pruned)
         KV_SERIALIZE(pruning_seed)
+        KV_SERIALIZE_OPT(background_pruning, false)
+        KV_SERIALIZE_OPT(background_pruning_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(background_pruning_end_height, (uint64_t)0)
+        KV_SERIALIZE_OPT(background_pruned_txes, (uint64_t)0)
+        KV_SERIALIZE_OPT(background_pruned_bytes, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -307,6 +307,25 @@ namespace rpc
       info.in_pool = in_pool[i];
       info.transaction = std::move(found_txs_vec[i]);
 
+      // one tx we cannot decode should not hide the others: it is returned with an empty tx_type
+      cryptonote::tx_asset_info asset_info;
+      if (!cryptonote::get_tx_asset_info(info.transaction, found_hashes[i], asset_info))
+      {
+        MWARNING("[GetTransactions]: Failed to decode asset info of tx " << found_hashes[i]);
+        info.asset_info = cryptonote::rpc::tx_asset_info{};
+        res.txs.emplace(found_hashes[i], std::move(info));
+        continue;
+      }
+      info.asset_info.tx_type = cryptonote::get_tx_type_name(asset_info.type);
+      info.asset_info.source_asset_type = std::move(asset_info.source_asset_type);
+      info.asset_info.dest_asset_type = std::move(asset_info.dest_asset_type);
+      info.asset_info.pricing_record_height = asset_info.pricing_record_height;
+      info.asset_info.amount_burnt = asset_info.amount_burnt;
+      info.asset_info.amount_minted = asset_info.amount_minted;
+      info.asset_info.fee = asset_info.fee;
+      info.asset_info.conversion_fee = asset_info.conversion_fee;
+      info.asset_info.collateral_indices = std::move(asset_info.collateral_indices);
+
       res.txs.emplace(found_hashes[i], std::move(info));
     }
                                       
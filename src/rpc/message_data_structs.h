@@ -55,11 +55,25 @@ namespace rpc
   typedef std::vector<tx_output_indices> block_output_indices;
   typedef std::vector<tx_asset_type_output_indices> block_asset_type_output_indices;
 
+  struct tx_asset_info
+  {
+    std::string tx_type; // empty if the tx could not be decoded
+    std::string source_asset_type;
+    std::string dest_asset_type;
+    uint64_t pricing_record_height;
+    uint64_t amount_burnt;
+    uint64_t amount_minted;
+    uint64_t fee;
+    uint64_t conversion_fee;
+    std::vector<uint32_t> collateral_indices;
+  };
+
   struct transaction_info
   {
     cryptonote::transaction transaction;
     bool in_pool;
     uint64_t height;
+    tx_asset_info asset_info;
   };
 
   struct output_key_and_amount_index
@@ -54,6 +54,44 @@
 #define DEFAULT_FLUSH_AGE (3600 * 24 * 180) // half a year
 #define DEFAULT_ZERO_FLUSH_AGE (60 * 2) // 2 minutes
 
+#define LEDGER_RECORD_SIZE (32 + 8 + 8 + 8 + 8) // client key, credits, update time, last request timestamp, flags
+#define LEDGER_RECORD_ERASED 1 // the client was flushed, the other fields are unused
+#define LEDGER_COMPACT_SIZE (16 * 1024 * 1024) // rewrite the state file once the ledger grows past this
+
+#define MAX_IDLE_CN_CONTEXTS 4
+
+namespace
+{
+  // each CN context owns a 4 MB scratchpad, so RPC threads share a few idle ones
+  // instead of each keeping its own for the life of the thread
+  class cn_context_pool
+  {
+  public:
+    cn_pow_hash_v3 acquire()
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if (m_idle.empty())
+        return cn_pow_hash_v3();
+      cn_pow_hash_v3 cph(std::move(m_idle.back()));
+      m_idle.pop_back();
+      return cph;
+    }
+
+    void release(cn_pow_hash_v3 &&cph)
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      if (m_idle.size() < MAX_IDLE_CN_CONTEXTS)
+        m_idle.push_back(std::move(cph));
+    }
+
+  private:
+    std::vector<cn_pow_hash_v3> m_idle;
+    boost::mutex m_mutex;
+  };
+
+  cn_context_pool cn_contexts;
+}
+
 namespace cryptonote
 {
   rpc_payment::client_info::client_info():
@@ -86,14 +124,16 @@ namespace cryptonote
     m_nonces_good(0),
     m_nonces_stale(0),
     m_nonces_bad(0),
-    m_nonces_dupe(0)
+    m_nonces_dupe(0),
+    m_ledger_size(0)
   {
   }
 
   uint64_t rpc_payment::balance(const crypto::public_key &client, int64_t delta)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    client_info &info = m_client_info[client]; // creates if not found
+    client_shard &shard = get_shard(client);
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+    client_info &info = shard.clients[client]; // creates if not found
     uint64_t credits = info.credits;
     if (delta > 0 && credits > std::numeric_limits<uint64_t>::max() - delta)
       credits = std::numeric_limits<uint64_t>::max();
@@ -103,13 +143,17 @@ namespace cryptonote
       credits += delta;
     if (delta)
       MINFO("Client " << client << ": balance change from " << info.credits << " to " << credits);
-    return info.credits = credits;
+    info.credits = credits;
+    if (delta)
+      log_credits(client, info);
+    return credits;
   }
 
   bool rpc_payment::pay(const crypto::public_key &client, uint64_t ts, uint64_t payment, const std::string &rpc, bool same_ts, uint64_t &credits)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    client_info &info = m_client_info[client]; // creates if not found
+    client_shard &shard = get_shard(client);
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+    client_info &info = shard.clients[client]; // creates if not found
     if (ts < info.last_request_timestamp || (ts == info.last_request_timestamp && !same_ts))
     {
       MDEBUG("Invalid ts: " << ts << " <= " << info.last_request_timestamp);
@@ -124,7 +168,12 @@ namespace cryptonote
     }
     info.credits -= payment;
     add64clamp(&info.credits_used, payment);
-    add64clamp(&m_credits_used, payment);
+    {
+      boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+      add64clamp(&m_credits_used, payment);
+    }
+    if (payment)
+      log_credits(client, info);
     MDEBUG("client " << client << " paying " << payment << " for " << rpc << ", " << info.credits << " left");
     credits = info.credits;
     return true;
@@ -132,8 +181,9 @@ namespace cryptonote
 
   bool rpc_payment::get_info(const crypto::public_key &client, const std::function<bool(const cryptonote::blobdata&, cryptonote::block&, uint64_t &seed_height, crypto::hash &seed_hash)> &get_block_template, cryptonote::blobdata &hashing_blob, uint64_t &seed_height, crypto::hash &seed_hash, const crypto::hash &top, uint64_t &diff, uint64_t &credits_per_hash_found, uint64_t &credits, uint32_t &cookie)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    client_info &info = m_client_info[client]; // creates if not found
+    client_shard &shard = get_shard(client);
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+    client_info &info = shard.clients[client]; // creates if not found
     const uint64_t now = time(NULL);
     bool need_template = top != info.top || now >= info.block_template_update_time + STALE_THRESHOLD;
     if (need_template)
@@ -183,62 +233,84 @@ namespace cryptonote
 
   bool rpc_payment::submit_nonce(const crypto::public_key &client, uint32_t nonce, const crypto::hash &top, int64_t &error_code, std::string &error_message, uint64_t &credits, crypto::hash &hash, cryptonote::block &block, uint32_t cookie, bool &stale)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    client_info &info = m_client_info[client]; // creates if not found
-    if (cookie != info.cookie && cookie != info.cookie - 1)
-    {
-      MWARNING("Very stale nonce");
-      ++m_nonces_stale;
-      ++info.nonces_stale;
-      sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
-      error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
-      error_message = "Very stale payment";
-      return false;
-    }
-    const bool is_current = cookie == info.cookie;
-    MINFO("client " << client << " sends nonce: " << nonce << ", " << (is_current ? "current" : "stale"));
-    std::unordered_set<uint64_t> &payments = is_current ? info.payments : info.previous_payments;
-    if (!payments.insert(nonce).second)
-    {
-      MWARNING("Duplicate nonce " << nonce << " from " << (is_current ? "current" : "previous"));
-      ++m_nonces_dupe;
-      ++info.nonces_dupe;
-      sub64clamp(&info.credits, PENALTY_FOR_DUPLICATE * m_credits_per_hash_found);
-      error_code = CORE_RPC_ERROR_CODE_DUPLICATE_PAYMENT;
-      error_message = "Duplicate payment";
-      return false;
-    }
-
+    client_shard &shard = get_shard(client);
+    cryptonote::blobdata hashing_blob;
+    uint64_t seed_height = 0;
+    crypto::hash seed_hash = crypto::null_hash;
+    bool is_current;
     const uint64_t now = time(NULL);
-    if (!is_current)
     {
-      if (now > info.update_time + STALE_THRESHOLD)
+      boost::lock_guard<boost::mutex> lock(shard.mutex);
+      client_info &info = shard.clients[client]; // creates if not found
+      if (cookie != info.cookie && cookie != info.cookie - 1)
       {
-        MWARNING("Nonce is stale (top " << top << ", should be " << info.top << " or within " << STALE_THRESHOLD << " seconds");
-        ++m_nonces_stale;
+        MWARNING("Very stale nonce");
+        {
+          boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+          ++m_nonces_stale;
+        }
         ++info.nonces_stale;
         sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
+        log_credits(client, info);
         error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
-        error_message = "stale payment";
+        error_message = "Very stale payment";
+        return false;
+      }
+      is_current = cookie == info.cookie;
+      MINFO("client " << client << " sends nonce: " << nonce << ", " << (is_current ? "current" : "stale"));
+      std::unordered_set<uint64_t> &payments = is_current ? info.payments : info.previous_payments;
+      if (!payments.insert(nonce).second)
+      {
+        MWARNING("Duplicate nonce " << nonce << " from " << (is_current ? "current" : "previous"));
+        {
+          boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+          ++m_nonces_dupe;
+        }
+        ++info.nonces_dupe;
+        sub64clamp(&info.credits, PENALTY_FOR_DUPLICATE * m_credits_per_hash_found);
+        log_credits(client, info);
+        error_code = CORE_RPC_ERROR_CODE_DUPLICATE_PAYMENT;
+        error_message = "Duplicate payment";
         return false;
       }
-    }
 
-    cryptonote::blobdata hashing_blob = is_current ? info.hashing_blob : info.previous_hashing_blob;
-    if (hashing_blob.size() < 43)
-    {
-      // not initialized ?
-      error_code = CORE_RPC_ERROR_CODE_WRONG_BLOCKBLOB;
-      error_message = "not initialized";
-      return false;
+      if (!is_current)
+      {
+        if (now > info.update_time + STALE_THRESHOLD)
+        {
+          MWARNING("Nonce is stale (top " << top << ", should be " << info.top << " or within " << STALE_THRESHOLD << " seconds");
+          {
+            boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+            ++m_nonces_stale;
+          }
+          ++info.nonces_stale;
+          sub64clamp(&info.credits, PENALTY_FOR_STALE * m_credits_per_hash_found);
+          log_credits(client, info);
+          error_code = CORE_RPC_ERROR_CODE_STALE_PAYMENT;
+          error_message = "stale payment";
+          return false;
+        }
+      }
+
+      hashing_blob = is_current ? info.hashing_blob : info.previous_hashing_blob;
+      if (hashing_blob.size() < 43)
+      {
+        // not initialized ?
+        error_code = CORE_RPC_ERROR_CODE_WRONG_BLOCKBLOB;
+        error_message = "not initialized";
+        return false;
+      }
+
+      block = is_current ? info.block : info.previous_block;
+      seed_height = is_current ? info.seed_height : info.previous_seed_height;
+      seed_hash = is_current ? info.seed_hash : info.previous_seed_hash;
     }
 
-    block = is_current ? info.block : info.previous_block;
+    // the nonce is already recorded, so the hash can be checked without the lock,
+    // letting submissions from other clients and threads go ahead in parallel
     *(uint32_t*)(hashing_blob.data() + 39) = SWAP32LE(nonce);
     if (block.major_version >= RX_BLOCK_VERSION)
     {
-      const uint64_t seed_height = is_current ? info.seed_height : info.previous_seed_height;
-      const crypto::hash &seed_hash = is_current ? info.seed_hash : info.previous_seed_hash;
       const uint64_t height = cryptonote::get_block_height(block);
       crypto::rx_slow_hash(height, seed_height, seed_hash.data, hashing_blob.data(), hashing_blob.size(), hash.data, 0, 0);
     }
@@ -246,28 +318,41 @@ namespace cryptonote
     {
       //const int cn_variant = hashing_blob[0] >= 7 ? hashing_blob[0] - 6 : 0;
       //crypto::cn_slow_hash(hashing_blob.data(), hashing_blob.size(), hash, cn_variant, cryptonote::get_block_height(block));
-      cn_pow_hash_v3 cph;
+      cn_pow_hash_v3 cph = cn_contexts.acquire();
       cph.hash(hashing_blob.data(), hashing_blob.size(), hash.data);
+      cn_contexts.release(std::move(cph));
     }
-    if (!check_hash(hash, m_diff))
+    const bool hash_ok = check_hash(hash, m_diff);
+
+    boost::lock_guard<boost::mutex> lock(shard.mutex);
+    client_info &info = shard.clients[client]; // creates if flushed meanwhile
+    if (!hash_ok)
     {
       MWARNING("Payment too low");
-      ++m_nonces_bad;
+      {
+        boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+        ++m_nonces_bad;
+      }
       ++info.nonces_bad;
       error_code = CORE_RPC_ERROR_CODE_PAYMENT_TOO_LOW;
       error_message = "Hash does not meet difficulty (could be wrong PoW hash, or mining at lower difficulty than required, or attempt to defraud)";
       sub64clamp(&info.credits, PENALTY_FOR_BAD_HASH * m_credits_per_hash_found);
+      log_credits(client, info);
       return false;
     }
 
     add64clamp(&info.credits, m_credits_per_hash_found);
     MINFO("client " << client << " credited for " << m_credits_per_hash_found << ", now " << info.credits << (is_current ? "" : " (close)"));
 
-    m_hashrate[now] += m_diff;
-    add64clamp(&m_credits_total, m_credits_per_hash_found);
+    {
+      boost::lock_guard<boost::mutex> stats_lock(m_stats_mutex);
+      m_hashrate[now] += m_diff;
+      add64clamp(&m_credits_total, m_credits_per_hash_found);
+      ++m_nonces_good;
+    }
     add64clamp(&info.credits_total, m_credits_per_hash_found);
-    ++m_nonces_good;
     ++info.nonces_good;
+    log_credits(client, info);
 
     credits = info.credits;
     block = info.block;
@@ -278,57 +363,194 @@ namespace cryptonote
 
   bool rpc_payment::foreach(const std::function<bool(const crypto::public_key &client, const client_info &info)> &f) const
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
-    for (std::unordered_map<crypto::public_key, client_info>::const_iterator i = m_client_info.begin(); i != m_client_info.end(); ++i)
+    for (const client_shard &shard: m_shards)
     {
-      if (!f(i->first, i->second))
-        return false;
+      boost::lock_guard<boost::mutex> lock(shard.mutex);
+      for (std::unordered_map<crypto::public_key, client_info>::const_iterator i = shard.clients.begin(); i != shard.clients.end(); ++i)
+      {
+        if (!f(i->first, i->second))
+          return false;
+      }
     }
     return true;
   }
 
+  void rpc_payment::log_credits(const crypto::public_key &client, const client_info &info)
+  {
+    log_record(client, info.credits, info.update_time, info.last_request_timestamp, 0);
+  }
+
+  void rpc_payment::log_erase(const crypto::public_key &client)
+  {
+    log_record(client, 0, 0, 0, LEDGER_RECORD_ERASED);
+  }
+
+  void rpc_payment::log_record(const crypto::public_key &client, uint64_t credits, uint64_t update_time, uint64_t last_request_timestamp, uint64_t flags)
+  {
+    boost::lock_guard<boost::mutex> lock(m_ledger_mutex);
+    if (!m_ledger.is_open())
+      return;
+    char record[LEDGER_RECORD_SIZE];
+    credits = SWAP64LE(credits);
+    update_time = SWAP64LE(update_time);
+    last_request_timestamp = SWAP64LE(last_request_timestamp);
+    flags = SWAP64LE(flags);
+    memcpy(record, &client, 32);
+    memcpy(record + 32, &credits, 8);
+    memcpy(record + 40, &update_time, 8);
+    memcpy(record + 48, &last_request_timestamp, 8);
+    memcpy(record + 56, &flags, 8);
+    m_ledger.write(record, sizeof(record));
+    m_ledger_size += sizeof(record);
+  }
+
+  bool rpc_payment::open_ledger()
+  {
+    // called with m_ledger_mutex held
+    const std::string ledger_path = m_directory + "/" + RPC_PAYMENTS_LEDGER_FILENAME;
+    if (!tools::create_directories_if_necessary(m_directory))
+      MWARNING("Failed to create data directory: " << m_directory);
+    m_ledger.open(ledger_path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    if (m_ledger.fail())
+    {
+      MWARNING("Failed to open RPC payments ledger " << ledger_path << ", balance changes will only be saved on exit");
+      m_ledger.close();
+      return false;
+    }
+    boost::system::error_code ec;
+    const uint64_t size = boost::filesystem::file_size(ledger_path, ec);
+    m_ledger_size = ec ? 0 : size;
+    return true;
+  }
+
+  bool rpc_payment::flush_ledger()
+  {
+    boost::lock_guard<boost::mutex> lock(m_ledger_mutex);
+    if (!m_ledger.is_open())
+      return true;
+    m_ledger.flush();
+    if (m_ledger.fail())
+    {
+      MWARNING("Failed to write RPC payments ledger");
+      m_ledger.clear();
+      return false;
+    }
+    return true;
+  }
+
+  void rpc_payment::replay_ledger(const std::string &path)
+  {
+    std::ifstream ledger(path, std::ios_base::binary | std::ios_base::in);
+    if (ledger.fail())
+      return;
+    char record[LEDGER_RECORD_SIZE];
+    size_t count = 0;
+    while (ledger.read(record, sizeof(record))) // a torn trailing record is ignored
+    {
+      crypto::public_key client;
+      uint64_t credits, update_time, last_request_timestamp, flags;
+      memcpy(&client, record, 32);
+      memcpy(&credits, record + 32, 8);
+      memcpy(&update_time, record + 40, 8);
+      memcpy(&last_request_timestamp, record + 48, 8);
+      memcpy(&flags, record + 56, 8);
+      client_shard &shard = get_shard(client);
+      boost::lock_guard<boost::mutex> lock(shard.mutex);
+      ++count;
+      if (SWAP64LE(flags) & LEDGER_RECORD_ERASED)
+      {
+        shard.clients.erase(client);
+        continue;
+      }
+      client_info &info = shard.clients[client];
+      info.credits = SWAP64LE(credits);
+      info.update_time = SWAP64LE(update_time);
+      info.last_request_timestamp = SWAP64LE(last_request_timestamp);
+    }
+    MINFO("Replayed " << count << " balance changes from " << path);
+  }
+
   bool rpc_payment::load(std::string directory)
   {
     TRY_ENTRY();
-    boost::lock_guard<boost::mutex> lock(mutex);
     m_directory = std::move(directory);
     std::string state_file_path = m_directory + "/" + RPC_PAYMENTS_DATA_FILENAME;
     MINFO("loading rpc payments data from " << state_file_path);
     std::ifstream data;
     data.open(state_file_path, std::ios_base::binary | std::ios_base::in);
+    bool loaded = false;
     if (!data.fail())
     {
       try
       {
         boost::archive::portable_binary_iarchive a(data);
         a >> *this;
+        loaded = true;
       }
       catch (const std::exception &e)
       {
         MERROR("Failed to load RPC payments file: " << e.what());
-        m_client_info.clear();
       }
     }
-    else
+    if (!loaded)
     {
-      m_client_info.clear();
+      for (client_shard &shard: m_shards)
+      {
+        boost::lock_guard<boost::mutex> lock(shard.mutex);
+        shard.clients.clear();
+      }
     }
 
+    // balances changed since the state file was written, oldest first
+    const std::string ledger_path = m_directory + "/" + RPC_PAYMENTS_LEDGER_FILENAME;
+    replay_ledger(ledger_path + ".old");
+    replay_ledger(ledger_path);
+
+    boost::lock_guard<boost::mutex> lock(m_ledger_mutex);
+    open_ledger();
+
     CATCH_ENTRY_L0("rpc_payment::load", false);
     return true;
   }
 
-  bool rpc_payment::store(const std::string &directory_) const
+  bool rpc_payment::store(const std::string &directory_)
   {
     TRY_ENTRY();
-    boost::lock_guard<boost::mutex> lock(mutex);
     const std::string &directory = directory_.empty() ? m_directory : directory_;
+    const bool own_ledger = !m_directory.empty() && directory == m_directory;
     MDEBUG("storing rpc payments data to " << directory);
     if (!tools::create_directories_if_necessary(directory))
     {
       MWARNING("Failed to create data directory: " << directory);
       return false;
     }
+    const std::string ledger_path = (boost::filesystem::path(directory) / RPC_PAYMENTS_LEDGER_FILENAME).string();
+    const std::string ledger_path_old = ledger_path + ".old";
+    if (own_ledger)
+    {
+      // start a new ledger before taking the snapshot: every change logged to the
+      // old one is then part of the snapshot, and later ones land in the new one
+      boost::lock_guard<boost::mutex> lock(m_ledger_mutex);
+      m_ledger.close();
+      if (boost::filesystem::exists(ledger_path_old))
+      {
+        // a previous store did not complete, keep its changes
+        std::ifstream in(ledger_path, std::ios_base::binary | std::ios_base::in);
+        std::ofstream out(ledger_path_old, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+        if (!in.fail() && in.peek() != std::ifstream::traits_type::eof())
+          out << in.rdbuf();
+        in.close();
+        boost::system::error_code ec;
+        boost::filesystem::remove(ledger_path, ec);
+      }
+      else if (boost::filesystem::exists(ledger_path))
+      {
+        std::error_code e = tools::replace_file(ledger_path, ledger_path_old);
+        if (e)
+          MWARNING("Failed to rename " << ledger_path << " to " << ledger_path_old << ": " << e);
+      }
+      open_ledger();
+    }
     const boost::filesystem::path state_file_path = (boost::filesystem::path(directory) / RPC_PAYMENTS_DATA_FILENAME);
     if (boost::filesystem::exists(state_file_path))
     {
@@ -346,15 +568,27 @@ namespace cryptonote
       MWARNING("Failed to save RPC payments to file " << state_file_path);
       return false;
     };
-    boost::archive::portable_binary_oarchive a(data);
-    a << *this;
+    {
+      boost::archive::portable_binary_oarchive a(data);
+      a << *this;
+    }
+    data.close();
+    if (data.fail())
+    {
+      MWARNING("Failed to save RPC payments to file " << state_file_path);
+      return false;
+    }
+    if (own_ledger)
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(ledger_path_old, ec);
+    }
     return true;
     CATCH_ENTRY_L0("rpc_payment::store", false);
   }
 
   unsigned int rpc_payment::flush_by_age(time_t seconds)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
     unsigned int count = 0;
     const time_t now = time(NULL);
     time_t seconds0 = seconds;
@@ -365,16 +599,21 @@ namespace cryptonote
     }
     const time_t threshold = seconds > now ? 0 : now - seconds;
     const time_t threshold0 = seconds0 > now ? 0 : now - seconds0;
-    for (std::unordered_map<crypto::public_key, client_info>::iterator i = m_client_info.begin(); i != m_client_info.end(); )
+    for (client_shard &shard: m_shards)
     {
-      std::unordered_map<crypto::public_key, client_info>::iterator j = i++;
-      const time_t t = std::max(j->second.last_request_timestamp / 1000000, j->second.update_time);
-      const bool erase = t < ((j->second.credits == 0) ? threshold0 : threshold);
-      if (erase)
+      boost::lock_guard<boost::mutex> lock(shard.mutex);
+      for (std::unordered_map<crypto::public_key, client_info>::iterator i = shard.clients.begin(); i != shard.clients.end(); )
       {
-        MINFO("Erasing " << j->first << " with " << j->second.credits << " credits, inactive for " << (now-t)/86400 << " days");
-        m_client_info.erase(j);
-        ++count;
+        std::unordered_map<crypto::public_key, client_info>::iterator j = i++;
+        const time_t t = std::max(j->second.last_request_timestamp / 1000000, j->second.update_time);
+        const bool erase = t < ((j->second.credits == 0) ? threshold0 : threshold);
+        if (erase)
+        {
+          MINFO("Erasing " << j->first << " with " << j->second.credits << " credits, inactive for " << (now-t)/86400 << " days");
+          log_erase(j->first);
+          shard.clients.erase(j);
+          ++count;
+        }
       }
     }
     return count;
@@ -382,7 +621,7 @@ namespace cryptonote
 
   uint64_t rpc_payment::get_hashes(unsigned int seconds) const
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<boost::mutex> lock(m_stats_mutex);
     const uint64_t now = time(NULL);
     uint64_t hashes = 0;
     for (std::map<uint64_t, uint64_t>::const_reverse_iterator i = m_hashrate.crbegin(); i != m_hashrate.crend(); ++i)
@@ -396,7 +635,7 @@ namespace cryptonote
 
   void rpc_payment::prune_hashrate(unsigned int seconds)
   {
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<boost::mutex> lock(m_stats_mutex);
     const uint64_t now = time(NULL);
     std::map<uint64_t, uint64_t>::iterator i;
     for (i = m_hashrate.begin(); i != m_hashrate.end(); ++i)
@@ -411,6 +650,14 @@ namespace cryptonote
   {
     flush_by_age();
     prune_hashrate(3600);
+    flush_ledger();
+    bool compact;
+    {
+      boost::lock_guard<boost::mutex> lock(m_ledger_mutex);
+      compact = m_ledger.is_open() && m_ledger_size > LEDGER_COMPACT_SIZE;
+    }
+    if (compact)
+      store();
     return true;
   }
 }
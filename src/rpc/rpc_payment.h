@@ -28,6 +28,8 @@
 
 #pragma once
 
+#include <array>
+#include <fstream>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
@@ -114,7 +116,32 @@ namespace cryptonote
     template <class t_archive>
     inline void serialize(t_archive &a, const unsigned int ver)
     {
-      a & m_client_info;
+      // the on-disk format keeps a single client map
+      std::unordered_map<crypto::public_key, client_info> clients;
+      if (t_archive::is_saving::value)
+      {
+        for (const client_shard &shard: m_shards)
+        {
+          boost::lock_guard<boost::mutex> lock(shard.mutex);
+          clients.insert(shard.clients.begin(), shard.clients.end());
+        }
+      }
+      a & clients;
+      if (t_archive::is_loading::value)
+      {
+        for (client_shard &shard: m_shards)
+        {
+          boost::lock_guard<boost::mutex> lock(shard.mutex);
+          shard.clients.clear();
+        }
+        for (auto &e: clients)
+        {
+          client_shard &shard = get_shard(e.first);
+          boost::lock_guard<boost::mutex> lock(shard.mutex);
+          shard.clients.insert(std::move(e));
+        }
+      }
+      boost::lock_guard<boost::mutex> lock(m_stats_mutex);
       a & m_hashrate;
       a & m_credits_total;
       a & m_credits_used;
@@ -125,13 +152,31 @@ namespace cryptonote
     }
 
     bool load(std::string directory);
-    bool store(const std::string &directory = std::string()) const;
+    bool store(const std::string &directory = std::string());
 
   private:
+    static constexpr size_t CLIENT_SHARDS = 16;
+
+    struct client_shard
+    {
+      std::unordered_map<crypto::public_key, client_info> clients;
+      mutable boost::mutex mutex;
+    };
+
+    client_shard &get_shard(const crypto::public_key &client) { return m_shards[(uint8_t)client.data[0] % CLIENT_SHARDS]; }
+    // append the client's balance to the ledger, called with the client's shard locked
+    void log_credits(const crypto::public_key &client, const client_info &info);
+    // append an erase record, so replaying the ledger does not bring back a flushed client
+    void log_erase(const crypto::public_key &client);
+    void log_record(const crypto::public_key &client, uint64_t credits, uint64_t update_time, uint64_t last_request_timestamp, uint64_t flags);
+    bool open_ledger();
+    bool flush_ledger();
+    void replay_ledger(const std::string &path);
+
     cryptonote::account_public_address m_address;
     uint64_t m_diff;
     uint64_t m_credits_per_hash_found;
-    std::unordered_map<crypto::public_key, client_info> m_client_info;
+    std::array<client_shard, CLIENT_SHARDS> m_shards;
     std::string m_directory;
     std::map<uint64_t, uint64_t> m_hashrate;
     uint64_t m_credits_total;
@@ -140,7 +185,12 @@ namespace cryptonote
     uint64_t m_nonces_stale;
     uint64_t m_nonces_bad;
     uint64_t m_nonces_dupe;
-    mutable boost::mutex mutex;
+    mutable boost::mutex m_stats_mutex; // guards m_hashrate and the global counters
+
+    // balances changed since the last store, replayed on top of the state file by load
+    std::ofstream m_ledger;
+    uint64_t m_ledger_size;
+    mutable boost::mutex m_ledger_mutex;
   };
 }
 
@@ -0,0 +1,227 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/chrono/chrono.hpp>
+#include "misc_log_ex.h"
+#include "misc_os_dependent.h"
+#include "rpc_request_scheduler.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "daemon.rpc.scheduler"
+
+#define STATS_LOG_INTERVAL_US (60 * 1000000ull)
+
+namespace
+{
+  uint64_t now_us()
+  {
+    return epee::misc_utils::get_ns_count() / 1000;
+  }
+}
+
+namespace cryptonote
+{
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::slot::slot(slot &&other): m_scheduler(other.m_scheduler), m_class(other.m_class), m_client(std::move(other.m_client)), m_start_us(other.m_start_us)
+  {
+    other.m_scheduler = nullptr;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::slot &rpc_request_scheduler::slot::operator=(slot &&other)
+  {
+    if (this != &other)
+    {
+      reset();
+      m_scheduler = other.m_scheduler;
+      m_class = other.m_class;
+      m_client = std::move(other.m_client);
+      m_start_us = other.m_start_us;
+      other.m_scheduler = nullptr;
+    }
+    return *this;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::slot::~slot()
+  {
+    try { reset(); }
+    catch (...) { /* ignore */ }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_request_scheduler::slot::reset()
+  {
+    if (m_scheduler)
+      m_scheduler->release(m_class, m_client, m_start_us);
+    m_scheduler = nullptr;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::rpc_request_scheduler(): m_last_log_us(now_us())
+  {
+    for (class_state &st: m_classes)
+    {
+      st.max_running = 0;
+      st.max_queued = 0;
+      st.max_per_client = 0;
+      st.queue_timeout_ms = 0;
+      st.next_ticket = 0;
+      st.stats = class_stats();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_request_scheduler::configure(cost_class c, size_t max_running, size_t max_queued, size_t max_per_client, uint64_t queue_timeout_ms)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    class_state &st = m_classes[c];
+    st.max_running = max_running;
+    st.max_queued = max_queued;
+    st.max_per_client = std::max<size_t>(max_per_client, 1);
+    st.queue_timeout_ms = queue_timeout_ms;
+    st.cond.notify_all();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::slot rpc_request_scheduler::acquire(cost_class c, const std::string &client)
+  {
+    slot s;
+    const uint64_t start_us = now_us();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    class_state &st = m_classes[c];
+    if (st.max_running > 0)
+    {
+      const auto it = st.clients.find(client);
+      const size_t client_requests = it == st.clients.end() ? 0 : it->second;
+      const bool must_wait = st.stats.running >= st.max_running || !st.waiting.empty();
+      if (client_requests >= st.max_per_client || (must_wait && st.waiting.size() >= st.max_queued))
+      {
+        ++st.stats.rejected;
+        MDEBUG("Rejecting " << get_class_name(c) << " request from " << client << ": " << st.stats.running << " running, "
+            << st.waiting.size() << " queued, " << client_requests << " from this client");
+        return s;
+      }
+      ++st.clients[client];
+
+      if (must_wait)
+      {
+        const uint64_t ticket = st.next_ticket++;
+        st.waiting.push_back(ticket);
+        st.stats.queued = st.waiting.size();
+        st.stats.peak_queued = std::max(st.stats.peak_queued, st.stats.queued);
+        const auto deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(st.queue_timeout_ms);
+        while (st.stats.running >= st.max_running || st.waiting.front() != ticket)
+        {
+          if (st.cond.wait_until(lock, deadline) == boost::cv_status::timeout && (st.stats.running >= st.max_running || st.waiting.front() != ticket))
+          {
+            st.waiting.erase(std::find(st.waiting.begin(), st.waiting.end(), ticket));
+            st.stats.queued = st.waiting.size();
+            ++st.stats.timed_out;
+            if (--st.clients[client] == 0)
+              st.clients.erase(client);
+            st.cond.notify_all();
+            return s;
+          }
+        }
+        st.waiting.pop_front();
+        st.stats.queued = st.waiting.size();
+        // the next waiter may fit too if more than one slot was freed
+        st.cond.notify_all();
+      }
+    }
+
+    ++st.stats.running;
+    const uint64_t granted_us = now_us();
+    st.stats.total_wait_us += granted_us - start_us;
+    s.m_scheduler = this;
+    s.m_class = c;
+    s.m_client = client;
+    s.m_start_us = granted_us;
+    return s;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_request_scheduler::release(cost_class c, const std::string &client, uint64_t start_us)
+  {
+    const uint64_t end_us = now_us();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    class_state &st = m_classes[c];
+    --st.stats.running;
+    ++st.stats.served;
+    const uint64_t service_us = end_us - start_us;
+    st.stats.total_service_us += service_us;
+    st.stats.max_service_us = std::max(st.stats.max_service_us, service_us);
+    if (st.max_running > 0)
+    {
+      const auto it = st.clients.find(client);
+      if (it != st.clients.end() && --it->second == 0)
+        st.clients.erase(it);
+      st.cond.notify_all();
+    }
+    log_stats_if_needed(end_us);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_request_scheduler::log_stats_if_needed(uint64_t now)
+  {
+    if (now - m_last_log_us < STATS_LOG_INTERVAL_US)
+      return;
+    m_last_log_us = now;
+    for (size_t c = 0; c < cost_class_count; ++c)
+    {
+      class_stats &stats = m_classes[c].stats;
+      MINFO(get_class_name((cost_class)c) << " requests: " << stats.running << " running, " << stats.queued << " queued (peak " << stats.peak_queued
+          << "), " << stats.served << " served, " << stats.rejected << " rejected, " << stats.timed_out << " timed out, avg wait "
+          << (stats.served ? stats.total_wait_us / stats.served : 0) << " us, avg service "
+          << (stats.served ? stats.total_service_us / stats.served : 0) << " us, max service " << stats.max_service_us << " us");
+      stats.peak_queued = stats.queued;
+      stats.max_service_us = 0;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_request_scheduler::class_stats rpc_request_scheduler::get_stats(cost_class c) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return m_classes[c].stats;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  size_t rpc_request_scheduler::get_io_threads(size_t light_threads) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    size_t threads = light_threads;
+    for (const class_state &st: m_classes)
+      if (st.max_running > 0)
+        threads += st.max_running + st.max_queued;
+    return threads;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  const char *rpc_request_scheduler::get_class_name(cost_class c)
+  {
+    switch (c)
+    {
+      case cost_light: return "light";
+      case cost_heavy: return "heavy";
+      case cost_admin: return "admin";
+      default: return "unknown";
+    }
+  }
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* Admission control for RPC handlers, by cost class.                  */
+  /************************************************************************/
+  //  Handlers run on the http server's IO threads, so a burst of expensive
+  //  calls can occupy all of them. Each cost class gets a bounded number of
+  //  running requests and a bounded FIFO of waiting ones; past that, or past
+  //  a client's share of the class, acquire() fails and the handler answers
+  //  BUSY. Light calls are not limited.
+  class rpc_request_scheduler
+  {
+  public:
+    enum cost_class
+    {
+      cost_light,
+      cost_heavy,
+      cost_admin,
+      cost_class_count
+    };
+
+    struct class_stats
+    {
+      uint64_t running;
+      uint64_t queued;
+      uint64_t peak_queued;
+      uint64_t served;
+      uint64_t rejected;
+      uint64_t timed_out;
+      uint64_t total_wait_us;
+      uint64_t total_service_us;
+      uint64_t max_service_us;
+    };
+
+    class slot
+    {
+    public:
+      slot(): m_scheduler(nullptr), m_class(cost_light), m_start_us(0) {}
+      slot(slot &&other);
+      slot &operator=(slot &&other);
+      ~slot();
+
+      explicit operator bool() const { return m_scheduler != nullptr; }
+
+    private:
+      friend class rpc_request_scheduler;
+      void reset();
+
+      rpc_request_scheduler *m_scheduler;
+      cost_class m_class;
+      std::string m_client;
+      uint64_t m_start_us;
+    };
+
+    rpc_request_scheduler();
+
+    void configure(cost_class c, size_t max_running, size_t max_queued, size_t max_per_client, uint64_t queue_timeout_ms);
+    slot acquire(cost_class c, const std::string &client);
+    class_stats get_stats(cost_class c) const;
+    //! IO threads needed so that light calls still find a free thread when every limited class is full
+    size_t get_io_threads(size_t light_threads) const;
+
+    static const char *get_class_name(cost_class c);
+
+  private:
+    struct class_state
+    {
+      size_t max_running;
+      size_t max_queued;
+      size_t max_per_client;
+      uint64_t queue_timeout_ms;
+      uint64_t next_ticket;
+      std::deque<uint64_t> waiting;
+      std::unordered_map<std::string, size_t> clients;
+      boost::condition_variable cond;
+      class_stats stats;
+    };
+
+    void release(cost_class c, const std::string &client, uint64_t start_us);
+    void log_stats_if_needed(uint64_t now_us);
+
+    mutable boost::mutex m_mutex;
+    class_state m_classes[cost_class_count];
+    uint64_t m_last_log_us;
+  };
+}
@@ -0,0 +1,243 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cctype>
+#include <sstream>
+#include "misc_log_ex.h"
+#include "misc_os_dependent.h"
+#include "storages/portable_storage.h"
+#include "storages/portable_storage_to_json.h"
+#include "core_rpc_server_commands_defs.h"
+#include "rpc_response_cache.h"
+
+namespace
+{
+  // calls whose answer only changes with the chain tip or the pool, and whose params fully determine it
+  const char *const cacheable_json_rpc_methods[] = {
+    "get_info",
+    "get_last_block_header",
+    "getlastblockheader",
+    "get_block_header_by_height",
+    "getblockheaderbyheight",
+    "get_fee_estimate",
+    "get_circulating_supply",
+    "get_circulating_supply_changes",
+    "get_collateral_requirements",
+    "hard_fork_info",
+  };
+
+  bool is_cacheable_json_rpc_method(const std::string &method)
+  {
+    for (const char *m: cacheable_json_rpc_methods)
+      if (method == m)
+        return true;
+    return false;
+  }
+
+  bool may_call_cacheable_json_rpc_method(const std::string &body)
+  {
+    // cheap filter so other json_rpc calls do not pay for an extra parse
+    for (const char *m: cacheable_json_rpc_methods)
+      if (body.find(m) != std::string::npos)
+        return true;
+    return false;
+  }
+
+  std::string entry_to_json(const epee::serialization::storage_entry &entry)
+  {
+    std::stringstream ss;
+    epee::serialization::dump_as_json(ss, entry, 0, false);
+    return ss.str();
+  }
+
+  bool is_ok_response(const std::string &body, bool json_rpc)
+  {
+    epee::serialization::portable_storage ps;
+    if (!ps.load_from_json(body))
+      return false;
+    epee::serialization::portable_storage::hsection section = nullptr;
+    if (json_rpc)
+    {
+      // an error envelope has no result
+      section = ps.open_section("result", nullptr, false);
+      if (!section)
+        return false;
+    }
+    std::string status;
+    return ps.get_value("status", status, section) && status == CORE_RPC_STATUS_OK;
+  }
+
+  size_t skip_space(const std::string &json, size_t pos)
+  {
+    while (pos < json.size() && isspace((unsigned char)json[pos]))
+      ++pos;
+    return pos;
+  }
+
+  // offset of the value of the named field of the outermost object, npos if it has none
+  size_t find_top_level_value(const std::string &json, const std::string &name)
+  {
+    int depth = 0;
+    for (size_t i = 0; i < json.size(); ++i)
+    {
+      const char c = json[i];
+      if (c == '"')
+      {
+        const size_t start = ++i;
+        for (; i < json.size() && json[i] != '"'; ++i)
+          if (json[i] == '\\')
+            ++i;
+        if (i >= json.size())
+          return std::string::npos;
+        if (depth != 1 || json.compare(start, i - start, name) != 0)
+          continue;
+        const size_t colon = skip_space(json, i + 1);
+        if (colon < json.size() && json[colon] == ':')
+          return skip_space(json, colon + 1);
+      }
+      else if (c == '{' || c == '[')
+        ++depth;
+      else if (c == '}' || c == ']')
+        --depth;
+    }
+    return std::string::npos;
+  }
+}
+
+namespace cryptonote
+{
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_response_cache::rpc_response_cache(size_t max_entries, uint64_t max_age_ms):
+    m_max_entries(max_entries),
+    m_max_age_ms(max_age_ms),
+    m_top_hash(crypto::null_hash),
+    m_pool_cookie(0)
+  {
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_response_cache::get_request_key(const std::string &uri, const std::string &body, std::string &request_key, std::string &id_json)
+  {
+    id_json.clear();
+    if (uri == "/get_info" || uri == "/getinfo")
+    {
+      request_key = uri + "\n" + body;
+      return true;
+    }
+    if (uri != "/json_rpc" || !may_call_cacheable_json_rpc_method(body))
+      return false;
+
+    epee::serialization::portable_storage ps;
+    std::string method;
+    if (!ps.load_from_json(body) || !ps.get_value("method", method, nullptr) || !is_cacheable_json_rpc_method(method))
+      return false;
+    epee::serialization::storage_entry id = std::string();
+    ps.get_value("id", id, nullptr);
+    if (id.type() == typeid(epee::serialization::section) || id.type() == typeid(epee::serialization::array_entry))
+      return false;
+    id_json = entry_to_json(id);
+    epee::serialization::storage_entry params;
+    request_key = "/json_rpc\n" + method + "\n" + (ps.get_value("params", params, nullptr) ? entry_to_json(params) : std::string());
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_response_cache::check_state(const crypto::hash &top_hash, uint64_t pool_cookie)
+  {
+    // called with m_mutex held
+    if (top_hash == m_top_hash && pool_cookie == m_pool_cookie)
+      return true;
+    m_entries.clear();
+    m_top_hash = top_hash;
+    m_pool_cookie = pool_cookie;
+    return false;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_response_cache::get(const crypto::hash &top_hash, uint64_t pool_cookie, const std::string &request_key, const std::string &id_json, response &res)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (!check_state(top_hash, pool_cookie))
+      return false;
+    const auto it = m_entries.find(request_key);
+    if (it == m_entries.end())
+      return false;
+    const entry &e = it->second;
+    if (epee::misc_utils::get_tick_count() - e.time > m_max_age_ms)
+    {
+      m_entries.erase(it);
+      return false;
+    }
+    if (e.id_offset == std::string::npos)
+    {
+      res.body = e.res.body;
+    }
+    else
+    {
+      res.body.clear();
+      res.body.reserve(e.res.body.size() - e.id_size + id_json.size());
+      res.body.append(e.res.body, 0, e.id_offset);
+      res.body.append(id_json);
+      res.body.append(e.res.body, e.id_offset + e.id_size, std::string::npos);
+    }
+    res.mime_type = e.res.mime_type;
+    res.content_type = e.res.content_type;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_response_cache::put(const crypto::hash &top_hash, uint64_t pool_cookie, const std::string &request_key, const std::string &id_json, const response &res)
+  {
+    const bool json_rpc = !id_json.empty();
+    if (!is_ok_response(res.body, json_rpc))
+      return false;
+
+    entry e;
+    e.id_offset = std::string::npos;
+    e.id_size = 0;
+    if (json_rpc)
+    {
+      const size_t id_offset = find_top_level_value(res.body, "id");
+      if (id_offset == std::string::npos || res.body.compare(id_offset, id_json.size(), id_json) != 0)
+        return false;
+      const size_t next = skip_space(res.body, id_offset + id_json.size());
+      if (next >= res.body.size() || (res.body[next] != ',' && res.body[next] != '}'))
+        return false;
+      e.id_offset = id_offset;
+      e.id_size = id_json.size();
+    }
+    e.res = res;
+    e.time = epee::misc_utils::get_tick_count();
+
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    // an answer computed before the tip or the pool moved must not be served after
+    if (top_hash != m_top_hash || pool_cookie != m_pool_cookie)
+      return false;
+    if (m_entries.size() >= m_max_entries)
+      m_entries.clear();
+    m_entries[request_key] = std::move(e);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+}
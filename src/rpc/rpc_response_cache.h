@@ -0,0 +1,84 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /* Short lived cache of whole RPC responses.                            */
+  /************************************************************************/
+  //  Some calls are polled by many clients and their answer only changes
+  //  with the chain tip or the pool. Successful answers are kept for a few
+  //  seconds, keyed by the request, and everything is dropped as soon as
+  //  the tip or the pool changes. json_rpc answers are stored with the id
+  //  of the request that filled them, and served with the caller's id.
+  class rpc_response_cache
+  {
+  public:
+    struct response
+    {
+      std::string body;
+      std::string mime_type;
+      std::string content_type;
+    };
+
+    rpc_response_cache(size_t max_entries = 4096, uint64_t max_age_ms = 5000);
+
+    //! false if the request may not be answered from the cache; id_json is empty unless the request is a json_rpc call
+    static bool get_request_key(const std::string &uri, const std::string &body, std::string &request_key, std::string &id_json);
+
+    bool get(const crypto::hash &top_hash, uint64_t pool_cookie, const std::string &request_key, const std::string &id_json, response &res);
+    //! stores res if it is a successful answer for the current tip and pool, returns whether it did
+    bool put(const crypto::hash &top_hash, uint64_t pool_cookie, const std::string &request_key, const std::string &id_json, const response &res);
+
+  private:
+    struct entry
+    {
+      response res;
+      size_t id_offset;
+      size_t id_size;
+      uint64_t time;
+    };
+
+    //! drops all entries if the tip or the pool changed, returns false if it did
+    bool check_state(const crypto::hash &top_hash, uint64_t pool_cookie);
+
+    const size_t m_max_entries;
+    const uint64_t m_max_age_ms;
+    boost::mutex m_mutex;
+    std::unordered_map<std::string, entry> m_entries;
+    crypto::hash m_top_hash;
+    uint64_t m_pool_cookie;
+  };
+}
@@ -0,0 +1,276 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "zmq_pub.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <utility>
+
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "span.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "net.zmq"
+
+namespace cryptonote
+{
+namespace listener
+{
+  namespace
+  {
+    constexpr const int send_high_water_mark = 1000; // messages queued per subscriber
+    constexpr const std::size_t max_queued_events = 1000; // events waiting for the worker
+    constexpr const std::chrono::milliseconds linger_timeout{0}; // drop pending events on shutdown
+  }
+
+  constexpr const char zmq_pub::json_topic[];
+  constexpr const char zmq_pub::binary_topic[];
+  constexpr const char zmq_pub::disconnect_json_topic[];
+  constexpr const char zmq_pub::disconnect_binary_topic[];
+
+  zmq_pub::zmq_pub(void* context, const Blockchain& blockchain)
+    : blockchain(blockchain), sync(), pub_socket(zmq_socket(context, ZMQ_PUB)), stopping(false)
+  {
+    if (!pub_socket)
+      MONERO_ZMQ_THROW("Failed to create ZMQ PUB socket");
+
+    if (zmq_setsockopt(pub_socket.get(), ZMQ_SNDHWM, std::addressof(send_high_water_mark), sizeof(send_high_water_mark)) != 0)
+      MONERO_ZMQ_THROW("Failed to set ZMQ PUB high water mark");
+
+    static constexpr const int linger_value = std::chrono::milliseconds{linger_timeout}.count();
+    if (zmq_setsockopt(pub_socket.get(), ZMQ_LINGER, std::addressof(linger_value), sizeof(linger_value)) != 0)
+      MONERO_ZMQ_THROW("Failed to set ZMQ PUB linger timeout");
+
+    worker = boost::thread([this]() { run(); });
+  }
+
+  zmq_pub::~zmq_pub()
+  {
+    close();
+  }
+
+  bool zmq_pub::bind(boost::string_ref address, boost::string_ref port)
+  {
+    if (address.empty())
+      address = "*";
+    if (port.empty())
+    {
+      MERROR("ZMQ PUB port must be specified");
+      return false;
+    }
+
+    std::string bind_address = "tcp://";
+    bind_address.append(address.data(), address.size());
+    bind_address += ":";
+    bind_address.append(port.data(), port.size());
+
+    const boost::lock_guard<boost::mutex> lock{sync};
+    if (!pub_socket)
+    {
+      MERROR("ZMQ PUB socket already closed");
+      return false;
+    }
+    if (zmq_bind(pub_socket.get(), bind_address.c_str()) < 0)
+    {
+      MONERO_LOG_ZMQ_ERROR("ZMQ PUB bind failed");
+      return false;
+    }
+    return true;
+  }
+
+  void zmq_pub::close()
+  {
+    {
+      const boost::lock_guard<boost::mutex> lock{queue_sync};
+      stopping = true;
+      queue.clear();
+    }
+    queue_cond.notify_all();
+    if (worker.joinable())
+      worker.join();
+
+    const boost::lock_guard<boost::mutex> lock{sync};
+    pub_socket.reset();
+  }
+
+  block_supply_event zmq_pub::make_event(const BlockchainDB& db, const uint64_t height, const crypto::hash& id, const block& bl, const std::vector<transaction>& txs)
+  {
+    block_supply_event event{};
+    event.height = height;
+    event.hash = epee::string_tools::pod_to_hex(id);
+    event.timestamp = bl.timestamp;
+    event.major_version = bl.major_version;
+    event.pricing_record = bl.pricing_record;
+
+    const uint64_t generated = db.get_block_already_generated_coins(height);
+    event.emission = height ? generated - db.get_block_already_generated_coins(height - 1) : generated;
+
+    // keyed by asset index so events list assets in ASSET_TYPES order
+    std::map<std::size_t, asset_supply_delta> deltas;
+    std::map<std::pair<std::size_t, std::size_t>, asset_conversion> conversions;
+    const auto asset_index = [](const std::string& asset) {
+      return std::size_t(std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), asset) - offshore::ASSET_TYPES.begin());
+    };
+
+    for (const transaction& tx : txs)
+    {
+      if (tx.version < OFFSHORE_TRANSACTION_VERSION)
+        continue;
+
+      std::string source;
+      std::string dest;
+      if (!get_tx_asset_types(tx, get_transaction_hash(tx), source, dest, false))
+      {
+        MERROR("Failed to get asset types of tx " << get_transaction_hash(tx) << " in block " << id);
+        continue;
+      }
+      if (source == dest)
+        continue;
+
+      const std::size_t source_index = asset_index(source);
+      const std::size_t dest_index = asset_index(dest);
+
+      asset_supply_delta& burnt = deltas[source_index];
+      burnt.asset_type = source;
+      burnt.amount_burnt += tx.amount_burnt;
+
+      asset_supply_delta& minted = deltas[dest_index];
+      minted.asset_type = dest;
+      minted.amount_minted += tx.amount_minted;
+
+      asset_conversion& conversion = conversions[{source_index, dest_index}];
+      conversion.source_asset_type = source;
+      conversion.dest_asset_type = dest;
+      ++conversion.count;
+      conversion.amount_burnt += tx.amount_burnt;
+      conversion.amount_minted += tx.amount_minted;
+    }
+
+    event.supply_deltas.reserve(deltas.size());
+    for (auto& delta : deltas)
+      event.supply_deltas.push_back(std::move(delta.second));
+    event.conversions.reserve(conversions.size());
+    for (auto& conversion : conversions)
+      event.conversions.push_back(std::move(conversion.second));
+
+    // the tally only reflects the tip, so blocks replayed by a reorg carry no totals
+    if (db.height() == height + 1)
+    {
+      for (auto& supply : db.get_circulating_supply())
+        event.circulating_supply.push_back({std::move(supply.first), std::move(supply.second)});
+    }
+
+    return event;
+  }
+
+  void zmq_pub::send_block(const uint64_t height, const crypto::hash& id, const block& bl, const std::vector<transaction>& txs)
+  {
+    // built now, while the db still matches the block; serialized and sent by the worker
+    queue_event(json_topic, binary_topic, make_event(blockchain.get_db(), height, id, bl, txs));
+  }
+
+  void zmq_pub::send_disconnect(const uint64_t height, const crypto::hash& id)
+  {
+    queue_event(disconnect_json_topic, disconnect_binary_topic, block_disconnect_event{height, epee::string_tools::pod_to_hex(id)});
+  }
+
+  template<typename T>
+  void zmq_pub::queue_event(const char* const json_topic, const char* const binary_topic, T event)
+  {
+    {
+      const boost::lock_guard<boost::mutex> lock{queue_sync};
+      if (stopping)
+        return;
+      if (queue.size() >= max_queued_events)
+      {
+        MWARNING("ZMQ PUB queue full, dropping " << json_topic << " event for block " << event.hash);
+        return;
+      }
+      queue.push_back([this, json_topic, binary_topic, event]() { publish(json_topic, binary_topic, event); });
+    }
+    queue_cond.notify_one();
+  }
+
+  template<typename T>
+  void zmq_pub::publish(const char* const json_topic, const char* const binary_topic, const T& event)
+  {
+    std::string json;
+    std::string binary;
+    if (!epee::serialization::store_t_to_json(event, json, 0, false) || !epee::serialization::store_t_to_binary(event, binary))
+    {
+      MERROR("Failed to serialize ZMQ " << json_topic << " event for block " << event.hash);
+      return;
+    }
+
+    send(json_topic, json);
+    send(binary_topic, binary);
+  }
+
+  void zmq_pub::run()
+  {
+    boost::unique_lock<boost::mutex> lock{queue_sync};
+    for (;;)
+    {
+      while (!stopping && queue.empty())
+        queue_cond.wait(lock);
+      if (stopping)
+        return;
+
+      const std::function<void()> publish_event = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+      publish_event();
+      lock.lock();
+    }
+  }
+
+  bool zmq_pub::send(const char* const topic, const std::string& payload)
+  {
+    std::string message{topic};
+    message += payload;
+
+    const boost::lock_guard<boost::mutex> lock{sync};
+    if (!pub_socket)
+      return false;
+
+    const expect<void> sent = net::zmq::send(epee::strspan<std::uint8_t>(message), pub_socket.get(), ZMQ_DONTWAIT);
+    if (!sent)
+    {
+      MWARNING("Failed to publish " << topic << " event: " << sent.error().message());
+      return false;
+    }
+    return true;
+  }
+}  // namespace listener
+}  // namespace cryptonote
@@ -0,0 +1,199 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "net/zmq.h"
+#include "offshore/pricing_record.h"
+#include "serialization/keyvalue_serialization.h"
+
+namespace cryptonote
+{
+  class Blockchain;
+  class BlockchainDB;
+
+namespace listener
+{
+  //! Mint and burn totals of one asset within a block
+  struct asset_supply_delta
+  {
+    std::string asset_type;
+    uint64_t amount_minted;
+    uint64_t amount_burnt;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(asset_type)
+      KV_SERIALIZE(amount_minted)
+      KV_SERIALIZE(amount_burnt)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Conversion totals of one source -> destination pair within a block
+  struct asset_conversion
+  {
+    std::string source_asset_type;
+    std::string dest_asset_type;
+    uint64_t count;
+    uint64_t amount_burnt;
+    uint64_t amount_minted;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(source_asset_type)
+      KV_SERIALIZE(dest_asset_type)
+      KV_SERIALIZE(count)
+      KV_SERIALIZE(amount_burnt)
+      KV_SERIALIZE(amount_minted)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Circulating supply of one asset, as a decimal string since tallies are 128 bit
+  struct asset_supply
+  {
+    std::string asset_type;
+    std::string amount;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(asset_type)
+      KV_SERIALIZE(amount)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Event published for every block added to the main chain
+  struct block_supply_event
+  {
+    uint64_t height;
+    std::string hash;
+    uint64_t timestamp;
+    uint8_t major_version;
+    offshore::pricing_record pricing_record;
+    uint64_t emission;
+    std::vector<asset_supply_delta> supply_deltas;
+    std::vector<asset_conversion> conversions;
+    std::vector<asset_supply> circulating_supply; //!< empty unless the block was the chain tip when published
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE(timestamp)
+      KV_SERIALIZE(major_version)
+      KV_SERIALIZE(pricing_record)
+      KV_SERIALIZE(emission)
+      KV_SERIALIZE(supply_deltas)
+      KV_SERIALIZE(conversions)
+      KV_SERIALIZE(circulating_supply)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  //! Event published for every block removed from the main chain, by a reorg or a pop
+  struct block_disconnect_event
+  {
+    uint64_t height;
+    std::string hash;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(hash)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  /*! Publishes a `block_supply_event` for every block added to the main
+      chain, and a `block_disconnect_event` for every block removed from it,
+      on a ZMQ PUB socket. On a reorg, the disconnect events for the old
+      blocks, highest first, come before the events for the new blocks.
+
+      Every event is sent twice, as a single part message prefixed by its
+      topic: `json-haven_block:` followed by the JSON encoding, and
+      `bin-haven_block:` followed by the epee portable storage binary
+      encoding (`json-haven_disconnect:` and `bin-haven_disconnect:` for
+      disconnects). Subscribers filter on the prefix with `ZMQ_SUBSCRIBE`.
+
+      Events are built when the block is added or removed, then serialized
+      and sent by a worker thread, so the blockchain lock is not held while
+      publishing. Sends never block; if a subscriber falls behind the high
+      water mark its messages are dropped by ZMQ. */
+  class zmq_pub
+  {
+  public:
+    static constexpr const char json_topic[] = "json-haven_block:";
+    static constexpr const char binary_topic[] = "bin-haven_block:";
+    static constexpr const char disconnect_json_topic[] = "json-haven_disconnect:";
+    static constexpr const char disconnect_binary_topic[] = "bin-haven_disconnect:";
+
+    zmq_pub(void* context, const Blockchain& blockchain);
+    ~zmq_pub();
+
+    zmq_pub(const zmq_pub&) = delete;
+    zmq_pub& operator=(const zmq_pub&) = delete;
+
+    //! Binds the PUB socket on `tcp://address:port`. \return false on error.
+    bool bind(boost::string_ref address, boost::string_ref port);
+
+    //! Stops the worker, dropping queued events, and closes the PUB socket; must be called before the context is terminated.
+    void close();
+
+    //! Builds the event for a block and its (non miner) transactions, `db` must not have moved past the block yet.
+    static block_supply_event make_event(const BlockchainDB& db, uint64_t height, const crypto::hash& id, const block& bl, const std::vector<transaction>& txs);
+
+    //! Queues the event for a block. Suitable as a `Blockchain::block_added_callback`.
+    void send_block(uint64_t height, const crypto::hash& id, const block& bl, const std::vector<transaction>& txs);
+
+    //! Queues the event for a removed block. Suitable as a `Blockchain::block_disconnected_callback`.
+    void send_disconnect(uint64_t height, const crypto::hash& id);
+
+  private:
+    template<typename T>
+    void queue_event(const char* json_topic, const char* binary_topic, T event);
+    template<typename T>
+    void publish(const char* json_topic, const char* binary_topic, const T& event);
+    bool send(const char* topic, const std::string& payload);
+    void run();
+
+    const Blockchain& blockchain;
+    boost::mutex sync; //!< ZMQ sockets are not thread safe
+    net::zmq::socket pub_socket;
+
+    boost::mutex queue_sync;
+    boost::condition_variable queue_cond;
+    std::deque<std::function<void()>> queue;
+    bool stopping;
+    boost::thread worker;
+  };
+}  // namespace listener
+}  // namespace cryptonote
@@ -57,6 +57,9 @@ ZmqServer::ZmqServer(RpcHandler& h) :
 
 ZmqServer::~ZmqServer()
 {
+  // publisher socket must close before `zmq_term` will exit.
+  if (shared_pub)
+    shared_pub->close();
 }
 
 void ZmqServer::serve()
@@ -149,6 +152,29 @@ bool ZmqServer::addTCPSocket(boost::string_ref address, boost::string_ref port)
   return true;
 }
 
+std::shared_ptr<listener::zmq_pub> ZmqServer::init_pub(boost::string_ref address, boost::string_ref port, const Blockchain& blockchain)
+{
+  if (!context)
+  {
+    MERROR("ZMQ RPC Server already shutdown");
+    return nullptr;
+  }
+
+  try
+  {
+    std::shared_ptr<listener::zmq_pub> pub = std::make_shared<listener::zmq_pub>(context.get(), blockchain);
+    if (!pub->bind(address, port))
+      return nullptr;
+    shared_pub = pub;
+    return pub;
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Failed to create ZMQ PUB socket: " << e.what());
+  }
+  return nullptr;
+}
+
 void ZmqServer::run()
 {
   run_thread = boost::thread(boost::bind(&ZmqServer::serve, this));
@@ -156,6 +182,9 @@ void ZmqServer::run()
 
 void ZmqServer::stop()
 {
+  if (shared_pub)
+    shared_pub->close();
+
   if (!run_thread.joinable())
     return;
 
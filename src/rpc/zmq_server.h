@@ -30,10 +30,12 @@
 
 #include <boost/thread/thread.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <memory>
 
 #include "common/command_line.h"
 #include "net/zmq.h"
 #include "rpc_handler.h"
+#include "zmq_pub.h"
 
 namespace cryptonote
 {
@@ -56,6 +58,9 @@ class ZmqServer
     bool addIPCSocket(boost::string_ref address, boost::string_ref port);
     bool addTCPSocket(boost::string_ref address, boost::string_ref port);
 
+    //! \return A block event publisher bound to `tcp://address:port`, or null on error.
+    std::shared_ptr<listener::zmq_pub> init_pub(boost::string_ref address, boost::string_ref port, const Blockchain& blockchain);
+
     void run();
     void stop();
 
@@ -67,6 +72,8 @@ class ZmqServer
     boost::thread run_thread;
 
     net::zmq::socket rep_socket;
+
+    std::shared_ptr<listener::zmq_pub> shared_pub;
 };
 
 
@@ -902,6 +902,42 @@ void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::block_with_tran
   GET_FROM_JSON_OBJECT(val, blk.transactions, transactions);
 }
 
+void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const cryptonote::rpc::tx_asset_info& asset_info)
+{
+  dest.StartObject();
+
+  INSERT_INTO_JSON_OBJECT(dest, tx_type, asset_info.tx_type);
+  INSERT_INTO_JSON_OBJECT(dest, source_asset_type, asset_info.source_asset_type);
+  INSERT_INTO_JSON_OBJECT(dest, dest_asset_type, asset_info.dest_asset_type);
+  INSERT_INTO_JSON_OBJECT(dest, pricing_record_height, asset_info.pricing_record_height);
+  INSERT_INTO_JSON_OBJECT(dest, amount_burnt, asset_info.amount_burnt);
+  INSERT_INTO_JSON_OBJECT(dest, amount_minted, asset_info.amount_minted);
+  INSERT_INTO_JSON_OBJECT(dest, fee, asset_info.fee);
+  INSERT_INTO_JSON_OBJECT(dest, conversion_fee, asset_info.conversion_fee);
+  INSERT_INTO_JSON_OBJECT(dest, collateral_indices, asset_info.collateral_indices);
+
+  dest.EndObject();
+}
+
+
+void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::tx_asset_info& asset_info)
+{
+  if (!val.IsObject())
+  {
+    throw WRONG_TYPE("json object");
+  }
+
+  GET_FROM_JSON_OBJECT(val, asset_info.tx_type, tx_type);
+  GET_FROM_JSON_OBJECT(val, asset_info.source_asset_type, source_asset_type);
+  GET_FROM_JSON_OBJECT(val, asset_info.dest_asset_type, dest_asset_type);
+  GET_FROM_JSON_OBJECT(val, asset_info.pricing_record_height, pricing_record_height);
+  GET_FROM_JSON_OBJECT(val, asset_info.amount_burnt, amount_burnt);
+  GET_FROM_JSON_OBJECT(val, asset_info.amount_minted, amount_minted);
+  GET_FROM_JSON_OBJECT(val, asset_info.fee, fee);
+  GET_FROM_JSON_OBJECT(val, asset_info.conversion_fee, conversion_fee);
+  GET_FROM_JSON_OBJECT(val, asset_info.collateral_indices, collateral_indices);
+}
+
 void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const cryptonote::rpc::transaction_info& tx_info)
 {
   dest.StartObject();
@@ -909,6 +945,7 @@ void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const cryptonote::r
   INSERT_INTO_JSON_OBJECT(dest, height, tx_info.height);
   INSERT_INTO_JSON_OBJECT(dest, in_pool, tx_info.in_pool);
   INSERT_INTO_JSON_OBJECT(dest, transaction, tx_info.transaction);
+  INSERT_INTO_JSON_OBJECT(dest, asset_info, tx_info.asset_info);
 
   dest.EndObject();
 }
@@ -924,6 +961,13 @@ void fromJsonValue(const rapidjson::Value& val, cryptonote::rpc::transaction_inf
   GET_FROM_JSON_OBJECT(val, tx_info.height, height);
   GET_FROM_JSON_OBJECT(val, tx_info.in_pool, in_pool);
   GET_FROM_JSON_OBJECT(val, tx_info.transaction, transaction);
+
+  // asset_info is optional, older daemons do not send it
+  const auto asset_info = val.FindMember("asset_info");
+  if (asset_info != val.MemberEnd())
+  {
+    cryptonote::json::fromJsonValue(asset_info->value, tx_info.asset_info);
+  }
 }
 
 void toJsonValue(rapidjson::Writer<epee::byte_stream>& dest, const cryptonote::rpc::output_key_and_amount_index& out)
@@ -3095,6 +3095,40 @@ bool simple_wallet::set_credits_target(const std::vector<std::string> &args/* =
   return true;
 }
 
+bool simple_wallet::set_refresh_pipeline_depth(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    uint32_t depth;
+    if (!epee::string_tools::get_xtype_from_string(depth, args[1]) || depth == 0)
+    {
+      fail_msg_writer() << tr("Invalid depth");
+      return true;
+    }
+    m_wallet->refresh_pipeline_depth(depth);
+    m_wallet->rewrite(m_wallet_file, pwd_container->password());
+  }
+  return true;
+}
+
+bool simple_wallet::set_refresh_pipeline_max_memory(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    uint64_t bytes;
+    if (!epee::string_tools::get_xtype_from_string(bytes, args[1]))
+    {
+      fail_msg_writer() << tr("Invalid size");
+      return true;
+    }
+    m_wallet->refresh_pipeline_max_memory(bytes);
+    m_wallet->rewrite(m_wallet_file, pwd_container->password());
+  }
+  return true;
+}
+
 bool simple_wallet::set_key_reuse_mitigation2(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
   const auto pwd_container = get_and_verify_password();
@@ -3536,6 +3570,10 @@ simple_wallet::simple_wallet()
                                   "  Whether to automatically start mining for RPC payment if the daemon requires it.\n"
                                   "credits-target <unsigned int>\n"
                                   "  The RPC payment credits balance to target (0 for default).\n "
+                                  "refresh-pipeline-depth <unsigned int>\n "
+                                  "  How many block batches to download and scan ahead of the one being added to the wallet during refresh.\n "
+                                  "refresh-pipeline-max-memory <unsigned int>\n "
+                                  "  Approximate number of bytes of downloaded blocks to keep queued ahead during refresh.\n "
                                   "inactivity-lock-timeout <unsigned int>\n "
                                   "  How many seconds to wait before locking the wallet (0 to disable)."));
   m_cmd_binder.set_handler("encrypted_seed",
@@ -3984,6 +4022,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "persistent-rpc-client-id = " << m_wallet->persistent_rpc_client_id();
     success_msg_writer() << "auto-mine-for-rpc-payment-threshold = " << m_wallet->auto_mine_for_rpc_payment_threshold();
     success_msg_writer() << "credits-target = " << m_wallet->credits_target();
+    success_msg_writer() << "refresh-pipeline-depth = " << m_wallet->refresh_pipeline_depth();
+    success_msg_writer() << "refresh-pipeline-max-memory = " << m_wallet->refresh_pipeline_max_memory();
     return true;
   }
   else
@@ -4048,6 +4088,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("persistent-rpc-client-id", set_persistent_rpc_client_id, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("auto-mine-for-rpc-payment-threshold", set_auto_mine_for_rpc_payment_threshold, tr("floating point >= 0"));
     CHECK_SIMPLE_VARIABLE("credits-target", set_credits_target, tr("unsigned integer"));
+    CHECK_SIMPLE_VARIABLE("refresh-pipeline-depth", set_refresh_pipeline_depth, tr("unsigned integer > 0"));
+    CHECK_SIMPLE_VARIABLE("refresh-pipeline-max-memory", set_refresh_pipeline_max_memory, tr("unsigned integer (bytes)"));
   }
   fail_msg_writer() << tr("set: unrecognized argument(s)");
   return true;
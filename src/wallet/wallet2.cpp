@@ -134,6 +134,9 @@ using namespace cryptonote;
 
 #define FIRST_REFRESH_GRANULARITY     1024
 
+#define DEFAULT_REFRESH_PIPELINE_DEPTH 2
+#define DEFAULT_REFRESH_PIPELINE_MAX_MEMORY (256 * 1024 * 1024) // bytes of block/tx blobs queued ahead of the apply stage
+
 #define GAMMA_SHAPE 19.28
 #define GAMMA_SCALE (1/1.61)
 
@@ -142,6 +145,12 @@ using namespace cryptonote;
 
 #define DEFAULT_INACTIVITY_LOCK_TIMEOUT 90 // a minute and a half
 
+#define KEY_IMAGES_FILTER_MIN_SIZE 1024
+
+#define DAEMON_RPC_PARALLEL_CONNECTIONS 2 // on top of the main one
+
+#define RCT_DISTRIBUTION_CACHE_OVERLAP (2 * CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE) // blocks re-requested to detect reorgs, at least the spendable age
+
 #define IGNORE_LONG_PAYMENT_ID_FROM_BLOCK_VERSION 12
 
 #define DEFAULT_UNLOCK_TIME (CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE * DIFFICULTY_TARGET_V2)
@@ -1255,10 +1264,18 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended, std
   m_offline(false),
   m_rpc_version(0),
   m_export_format(ExportFormat::Binary),
-  m_credits_target(0)
+  m_credits_target(0),
+  m_refresh_pipeline_depth(DEFAULT_REFRESH_PIPELINE_DEPTH),
+  m_refresh_pipeline_max_memory(DEFAULT_REFRESH_PIPELINE_MAX_MEMORY)
 {
   set_rpc_client_secret_key(rct::rct2sk(rct::skGen()));
 
+  for (size_t i = 0; i < DAEMON_RPC_PARALLEL_CONNECTIONS; ++i)
+  {
+    m_daemon_rpc_connections.emplace_back(new daemon_rpc_connection());
+    m_daemon_rpc_connections.back()->http_client = http_client_factory->create();
+  }
+
   for (auto &asset_type: offshore::ASSET_TYPES) {
     m_multisig_rescan_info[asset_type].clear();
     m_multisig_rescan_k[asset_type].clear();
@@ -1368,6 +1385,12 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
 
   if(m_http_client->is_connected())
     m_http_client->disconnect();
+  for (const auto &connection: m_daemon_rpc_connections)
+  {
+    boost::lock_guard<boost::mutex> connection_lock(connection->mutex);
+    if (connection->http_client->is_connected())
+      connection->http_client->disconnect();
+  }
   const bool changed = m_daemon_address != daemon_address;
   m_daemon_address = std::move(daemon_address);
   m_daemon_login = std::move(daemon_login);
@@ -1381,6 +1404,11 @@ bool wallet2::set_daemon(std::string daemon_address, boost::optional<epee::net_u
 
   const std::string address = get_daemon_address();
   MINFO("setting daemon to " << address);
+  for (const auto &connection: m_daemon_rpc_connections)
+  {
+    boost::lock_guard<boost::mutex> connection_lock(connection->mutex);
+    connection->http_client->set_server(address, get_daemon_login(), ssl_options);
+  }
   bool ret =  m_http_client->set_server(address, get_daemon_login(), std::move(ssl_options));
   if (ret)
   {
@@ -1400,7 +1428,13 @@ bool wallet2::init(std::string daemon_address, boost::optional<epee::net_utils::
     epee::net_utils::http::abstract_http_client* abstract_http_client = m_http_client.get();
     epee::net_utils::http::http_simple_client* http_simple_client = dynamic_cast<epee::net_utils::http::http_simple_client*>(abstract_http_client);
     CHECK_AND_ASSERT_MES(http_simple_client != nullptr, false, "http_simple_client must be used to set proxy");
-    http_simple_client->set_connector(net::socks::connector{std::move(proxy)});
+    http_simple_client->set_connector(net::socks::connector{proxy});
+    for (const auto &connection: m_daemon_rpc_connections)
+    {
+      http_simple_client = dynamic_cast<epee::net_utils::http::http_simple_client*>(connection->http_client.get());
+      CHECK_AND_ASSERT_MES(http_simple_client != nullptr, false, "http_simple_client must be used to set proxy");
+      http_simple_client->set_connector(net::socks::connector{proxy});
+    }
   }
   return set_daemon(daemon_address, daemon_login, trusted_daemon, std::move(ssl_options));
 }
@@ -2030,6 +2064,8 @@ bool wallet2::spends_one_of_ours(const cryptonote::transaction &tx) const
     if (in.type() != typeid(cryptonote::txin_to_key))
       continue;
     const cryptonote::txin_to_key &in_to_key = boost::get<cryptonote::txin_to_key>(in);
+    if (!m_key_images_filter.may_contain(in_to_key.k_image))
+      continue;
     auto it = m_key_images.find(in_to_key.k_image);
     if (it != m_key_images.end())
       return true;
@@ -2037,6 +2073,23 @@ bool wallet2::spends_one_of_ours(const cryptonote::transaction &tx) const
   return false;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_key_images_filter()
+{
+  // leave room to grow so we don't rebuild again on the next few outputs
+  m_key_images_filter.reset(std::max<size_t>(2 * m_key_images.size(), KEY_IMAGES_FILTER_MIN_SIZE));
+  for (const auto &e: m_key_images)
+    m_key_images_filter.insert(e.first);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_key_image_to_filter(const crypto::key_image &ki)
+{
+  // the filter can't remove entries, so it's rebuilt from the map when it fills up
+  if (m_key_images_filter.full())
+    rebuild_key_images_filter();
+  else
+    m_key_images_filter.insert(ki);
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::get_pricing_record(offshore::pricing_record& pr, const uint64_t height)
 {
   // Issue an RPC call to get the block header (and thus the pricing record) at the specified height
@@ -2599,7 +2652,10 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 
             // key image and target_key
             if (td.m_key_image_known)
+            {
               m_key_images[td.m_key_image] = specific_transfers.size()-1;
+              add_key_image_to_filter(td.m_key_image);
+            }
             m_pub_keys[tx_scan_info[o].in_ephemeral.pub] = specific_transfers.size()-1;
             
             if (output_tracker_cache)
@@ -2773,7 +2829,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
     transfer_container& specific_transfers = asset_type == "XHV" ? m_transfers :
                                             asset_type == "XUSD" ? m_offshore_transfers :
                                             m_xasset_transfers[asset_type];
-    auto it = m_key_images.find(k_image);
+    // most inputs on chain aren't ours, the filter lets us skip the map lookup for them
+    auto it = m_key_images_filter.may_contain(k_image) ? m_key_images.find(k_image) : m_key_images.end();
     if(it != m_key_images.end())
     {
       // grap the transfer
@@ -3201,11 +3258,18 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   req.start_height = start_height;
   req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
 
+  uint64_t pre_call_credits;
   {
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-    uint64_t pre_call_credits = m_rpc_payment_state.credits;
+    pre_call_credits = m_rpc_payment_state.credits;
     req.client = get_client_signature();
-    bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, *m_http_client, rpc_timeout);
+  }
+  // refresh pulls the next blocks while it does other daemon calls, don't hold those up
+  bool r = invoke_daemon_rpc([&](epee::net_utils::http::abstract_http_client &http_client) {
+    return net_utils::invoke_http_bin("/getblocks.bin", req, res, http_client, rpc_timeout);
+  });
+  {
+    const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
     THROW_ON_RPC_RESPONSE_ERROR(r, {}, res, "getblocks.bin", error::get_blocks_error, get_rpc_status(res.status));
     THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.output_indices.size(), error::wallet_internal_error,
         "mismatched blocks (" + boost::lexical_cast<std::string>(res.blocks.size()) + ") and output_indices (" +
@@ -3254,24 +3318,18 @@ void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height,
   hashes = std::move(res.m_block_ids);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+void wallet2::derive_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data) const
 {
-  size_t current_index = start_height;
-  blocks_added = 0;
-
-  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
-
   tools::threadpool& tpool = tools::threadpool::getInstance();
   tools::threadpool::waiter waiter;
 
   size_t num_txes = 0;
-  std::vector<tx_cache_data> tx_cache_data;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
     num_txes += 1 + parsed_blocks[i].txes.size();
+  tx_cache_data.clear();
   tx_cache_data.resize(num_txes);
   size_t txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
   {
     THROW_WALLET_EXCEPTION_IF(parsed_blocks[i].txes.size() != parsed_blocks[i].block.tx_hashes.size(),
         error::wallet_internal_error, "Mismatched parsed_blocks[i].txes.size() and parsed_blocks[i].block.tx_hashes.size()");
@@ -3281,11 +3339,11 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
       continue;
     }
     if (m_refresh_type != RefreshNoCoinbase)
-      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); });
+      tpool.submit(&waiter, [&, i, txidx](){ cache_tx_data(parsed_blocks[i].block.miner_tx, get_transaction_hash(parsed_blocks[i].block.miner_tx), tx_cache_data[txidx]); }, true);
     ++txidx;
     for (size_t idx = 0; idx < parsed_blocks[i].txes.size(); ++idx)
     {
-      tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); });
+      tpool.submit(&waiter, [&, i, idx, txidx](){ cache_tx_data(parsed_blocks[i].txes[idx], parsed_blocks[i].block.tx_hashes[idx], tx_cache_data[txidx]); }, true);
       ++txidx;
     }
   }
@@ -3320,6 +3378,17 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     }, true);
   }
   waiter.wait(&tpool);
+  hwdev.set_mode(hw::device::NONE);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::match_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data, const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses) const
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+
+  hw::device &hwdev =  m_account.get_device();
+  hw::reset_mode rst(hwdev);
+  hwdev.set_mode(hw::device::TRANSACTION_PARSE);
 
   auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
     for (size_t k = 0; k < n_vouts; ++k)
@@ -3341,15 +3410,15 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
         {
           THROW_WALLET_EXCEPTION_IF(tx_cache_data[txidx].primary[l].received.size() != n_vouts,
               error::wallet_internal_error, "Unexpected received array size");
-          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(m_subaddresses, key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev);
+          tx_cache_data[txidx].primary[l].received[k] = is_out_to_acc_precomp(subaddresses, key, tx_cache_data[txidx].primary[l].derivation, additional_derivations, k, hwdev);
           additional_derivations.clear();
         }
       }
     }
   };
 
-  txidx = 0;
-  for (size_t i = 0; i < blocks.size(); ++i)
+  size_t txidx = 0;
+  for (size_t i = 0; i < parsed_blocks.size(); ++i)
   {
     if (should_skip_block(parsed_blocks[i].block, start_height + i))
     {
@@ -3374,6 +3443,26 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   THROW_WALLET_EXCEPTION_IF(txidx != tx_cache_data.size(), error::wallet_internal_error, "txidx did not reach expected value");
   waiter.wait(&tpool);
   hwdev.set_mode(hw::device::NONE);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+{
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
+  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(start_height), error::out_of_hashchain_bounds_error);
+
+  std::vector<tx_cache_data> tx_cache_data;
+  derive_parsed_blocks(start_height, parsed_blocks, tx_cache_data);
+  match_parsed_blocks(start_height, parsed_blocks, tx_cache_data, m_subaddresses);
+  process_parsed_blocks(start_height, blocks, parsed_blocks, tx_cache_data, blocks_added, output_tracker_cache);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, const std::vector<tx_cache_data> &tx_cache_data, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+{
+  size_t current_index = start_height;
+  blocks_added = 0;
+
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
+  THROW_WALLET_EXCEPTION_IF(!m_blockchain.is_in_bounds(current_index), error::out_of_hashchain_bounds_error);
 
   size_t tx_cache_data_offset = 0;
   for (size_t i = 0; i < blocks.size(); ++i)
@@ -3418,7 +3507,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   refresh(trusted_daemon, start_height, blocks_fetched, received_money);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
+void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception, refresh_stage_timings *timings)
 {
   error = false;
   last = false;
@@ -3441,7 +3530,11 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> asset_type_output_indices;
     uint64_t current_height;
+    TIME_MEASURE_START(fetch_time);
     pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, asset_type_output_indices, current_height);
+    TIME_MEASURE_FINISH(fetch_time);
+    if (timings)
+      timings->fetch += fetch_time;
     THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
 
     // HERE BE DRAGONS!!!
@@ -3451,6 +3544,7 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
     THROW_WALLET_EXCEPTION_IF(asset_type_output_indices.size() > 0 && blocks.size() != asset_type_output_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and asset_type_output_indices");
     // LAND AHOY!!!
 
+    TIME_MEASURE_START(parse_time);
     tools::threadpool& tpool = tools::threadpool::getInstance();
     tools::threadpool::waiter waiter;
     parsed_blocks.resize(blocks.size());
@@ -3489,6 +3583,9 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
       }
     }
     waiter.wait(&tpool);
+    TIME_MEASURE_FINISH(parse_time);
+    if (timings)
+      timings->parse += parse_time;
     last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
   }
   catch(...)
@@ -3968,12 +4065,33 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   tools::threadpool& tpool = tools::threadpool::getInstance();
   tools::threadpool::waiter waiter;
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
   bool refreshed = false;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
 
+  // A span is one getblocks.bin response. Spans are fetched and parsed ahead of
+  // the one being applied, up to m_refresh_pipeline_depth of them, and scanned
+  // (key derivations and output matching) in the background while the previous
+  // span is applied to the wallet, in order, on this thread.
+  struct refresh_span
+  {
+    uint64_t start_height;
+    std::vector<cryptonote::block_complete_entry> blocks;
+    std::vector<parsed_block> parsed_blocks;
+    std::vector<tx_cache_data> cache_data;
+    bool derived;
+    size_t matched_subaddresses; // size of the subaddress table outputs were matched against, 0 if not matched yet
+    size_t bytes;
+
+    refresh_span(): start_height(0), derived(false), matched_subaddresses(0), bytes(0) {}
+  };
+  std::deque<refresh_span> spans;
+  const std::vector<cryptonote::block_complete_entry> no_blocks;
+  const std::vector<parsed_block> no_parsed_blocks;
+  // scanning uses the device, which can only run alongside the apply stage if it's in software
+  const bool background_scan = !key_on_device();
+  m_refresh_stage_timings = refresh_stage_timings();
+
   // pull the first set of blocks
   get_short_chain_history(short_chain_history, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
   m_run.store(true, std::memory_order_relaxed);
@@ -4006,47 +4124,145 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
 
   auto scope_exit_handler_hwdev = epee::misc_utils::create_scope_leave_handler([&](){hwdev.computing_key_images(false);});
 
-  // get updated pool state first, but do not process those txes just yet,
-  // since that might cause a password prompt, which would introduce a data
-  // leak allowing a passive adversary with traffic analysis capability to
-  // infer when we get an incoming output
   std::vector<std::tuple<cryptonote::transaction, crypto::hash, bool>> process_pool_txs;
-  update_pool_state(process_pool_txs, true);
+  bool pool_updated = false;
+
+  // the apply stage may add subaddresses, so the background scan matches
+  // against a snapshot, taken again only when the table grew, and spans
+  // matched against an older one are matched again before being applied
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> scan_subaddresses;
 
   bool first = true, last = false;
   while(m_run.load(std::memory_order_relaxed))
   {
-    uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
-    bool error;
-    std::exception_ptr exception;
+    std::vector<refresh_span> next_spans;
+    refresh_stage_timings fetch_timings;
+    uint64_t background_scan_time = 0;
+    bool error, apply_error = false;
+    std::exception_ptr exception, scan_exception;
     try
     {
-      // pull the next set of blocks while we're processing the current one
+      // pull the next sets of blocks while we're processing the current one
       error = false;
       exception = NULL;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
       added_blocks = 0;
-      if (!first && blocks.empty())
+      if (!first && spans.empty())
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         refreshed = true;
         break;
       }
-      if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
 
-      if (!first)
+      size_t queued_spans = spans.empty() ? 0 : spans.size() - 1;
+      size_t queued_bytes = 0;
+      for (size_t i = 1; i < spans.size(); ++i)
+        queued_bytes += spans[i].bytes;
+      if (!last && queued_spans < m_refresh_pipeline_depth && (queued_spans == 0 || queued_bytes < m_refresh_pipeline_max_memory))
+      {
+        tpool.submit(&waiter, [&, queued_spans, queued_bytes]() mutable {
+          while (!last && m_run.load(std::memory_order_relaxed))
+          {
+            const refresh_span *prev = !next_spans.empty() ? &next_spans.back() : !spans.empty() ? &spans.back() : NULL;
+            refresh_span span;
+            pull_and_parse_next_blocks(start_height, span.start_height, short_chain_history, prev ? prev->blocks : no_blocks, prev ? prev->parsed_blocks : no_parsed_blocks,
+                span.blocks, span.parsed_blocks, last, error, exception, &fetch_timings);
+            if (error)
+              break;
+            if (span.blocks.empty() || (prev && span.start_height == prev->start_height))
+            {
+              // nothing past what we already have
+              last = true;
+              break;
+            }
+            for (const auto &b: span.blocks)
+            {
+              span.bytes += b.block.size();
+              for (const auto &tx: b.txs)
+                span.bytes += tx.blob.size();
+            }
+            queued_bytes += span.bytes;
+            next_spans.push_back(std::move(span));
+            // get the first span applied as soon as possible
+            if (spans.empty() || ++queued_spans >= m_refresh_pipeline_depth || queued_bytes >= m_refresh_pipeline_max_memory)
+              break;
+          }
+        });
+      }
+
+      // get updated pool state first, but do not process those txes just yet,
+      // since that might cause a password prompt, which would introduce a data
+      // leak allowing a passive adversary with traffic analysis capability to
+      // infer when we get an incoming output. The first blocks are being pulled
+      // on another daemon connection meanwhile.
+      if (!pool_updated)
+      {
+        update_pool_state(process_pool_txs, true);
+        pool_updated = true;
+      }
+
+      if (background_scan && spans.size() > 1)
+      {
+        // subaddresses are only ever added during a refresh, so an unchanged size means an unchanged table
+        if (scan_subaddresses.size() != m_subaddresses.size())
+          scan_subaddresses = m_subaddresses;
+        tpool.submit(&waiter, [&]() {
+          try
+          {
+            TIME_MEASURE_START(scan_time);
+            for (size_t i = 1; i < spans.size(); ++i)
+            {
+              refresh_span &span = spans[i];
+              if (!span.derived)
+              {
+                derive_parsed_blocks(span.start_height, span.parsed_blocks, span.cache_data);
+                span.derived = true;
+              }
+              if (span.matched_subaddresses != scan_subaddresses.size())
+              {
+                match_parsed_blocks(span.start_height, span.parsed_blocks, span.cache_data, scan_subaddresses);
+                span.matched_subaddresses = scan_subaddresses.size();
+              }
+            }
+            TIME_MEASURE_FINISH(scan_time);
+            background_scan_time = scan_time;
+          }
+          catch (...)
+          {
+            scan_exception = std::current_exception();
+          }
+        });
+      }
+
+      if (!spans.empty())
       {
+        refresh_span &span = spans.front();
         try
         {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
+          TIME_MEASURE_START(scan_time);
+          if (!span.derived)
+          {
+            derive_parsed_blocks(span.start_height, span.parsed_blocks, span.cache_data);
+            span.derived = true;
+          }
+          if (span.matched_subaddresses != m_subaddresses.size())
+          {
+            match_parsed_blocks(span.start_height, span.parsed_blocks, span.cache_data, m_subaddresses);
+            span.matched_subaddresses = m_subaddresses.size();
+          }
+          TIME_MEASURE_FINISH(scan_time);
+          m_refresh_stage_timings.scan += scan_time;
+
+          TIME_MEASURE_START(apply_time);
+          process_parsed_blocks(span.start_height, span.blocks, span.parsed_blocks, span.cache_data, added_blocks, output_tracker_cache.get());
+          TIME_MEASURE_FINISH(apply_time);
+          m_refresh_stage_timings.apply += apply_time;
+          ++m_refresh_stage_timings.spans;
         }
         catch (const tools::error::out_of_hashchain_bounds_error&)
         {
           MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
+          // the fetch stage is still using the short chain history
+          waiter.wait(&tpool);
           uint64_t stop_height = m_blockchain.offset();
           std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
           for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
@@ -4070,38 +4286,41 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
         catch (const std::exception &e)
         {
           MERROR("Error parsing blocks: " << e.what());
-          error = true;
+          apply_error = true;
         }
         blocks_fetched += added_blocks;
       }
+      TIME_MEASURE_START(wait_time);
       waiter.wait(&tpool);
-      if(!first && blocks_start_height == next_blocks_start_height)
-      {
-        m_node_rpc_proxy.set_height(m_blockchain.size());
-        refreshed = true;
-        break;
-      }
+      TIME_MEASURE_FINISH(wait_time);
+      m_refresh_stage_timings.wait += wait_time;
+      m_refresh_stage_timings.fetch += fetch_timings.fetch;
+      m_refresh_stage_timings.parse += fetch_timings.parse;
+      m_refresh_stage_timings.scan += background_scan_time;
 
       first = false;
 
-      // handle error from async fetching thread
-      if (error)
+      // handle error from async fetching and scanning threads
+      if (error || apply_error)
       {
         if (exception)
           std::rethrow_exception(exception);
         else
           throw std::runtime_error("proxy exception in refresh thread");
       }
+      if (scan_exception)
+        std::rethrow_exception(scan_exception);
 
       // if we've got at least 10 blocks to refresh, assume we're starting
       // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks.size() >= 10)
+      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && !next_spans.empty() && next_spans.front().blocks.size() >= 10)
         output_tracker_cache = create_output_tracker_cache();
 
-      // switch to the new blocks from the daemon
-      blocks_start_height = next_blocks_start_height;
-      blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
+      // retire the applied span and queue up the new ones from the daemon
+      if (!spans.empty())
+        spans.pop_front();
+      for (auto &span: next_spans)
+        spans.push_back(std::move(span));
     }
     catch (const tools::error::password_needed&)
     {
@@ -4123,9 +4342,9 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
         first = true;
+        last = false;
         start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
+        spans.clear();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -4153,6 +4372,9 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
 
   m_first_refresh_done = true;
 
+  LOG_PRINT_L1("Refresh stage timings: fetch " << m_refresh_stage_timings.fetch << " ms, parse " << m_refresh_stage_timings.parse
+      << " ms, scan " << m_refresh_stage_timings.scan << " ms, apply " << m_refresh_stage_timings.apply
+      << " ms, waiting " << m_refresh_stage_timings.wait << " ms, " << m_refresh_stage_timings.spans << " spans");
   LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance (all accounts): ");
   std::map<std::string, uint64_t> balances = balance_all(false);
   std::map<std::string, uint64_t> unlocked_balances = unlocked_balance_all(false);
@@ -4204,10 +4426,19 @@ bool wallet2::get_rct_distribution(const bool use_global_outs, const std::string
     }
   }
 
+  // The cumulative distribution only ever changes at the top of the chain, so we keep
+  // what we got last time and only ask for the blocks after it, plus an overlap which
+  // has to match what we have, or the chain was reorganized under us
+  const std::string cache_key = use_global_outs ? std::string() : rct_asset_type;
+  uint64_t from_height = 0;
+  auto cached = m_rct_distribution_cache.find(cache_key);
+  if (cached != m_rct_distribution_cache.end() && cached->second.distribution.size() > RCT_DISTRIBUTION_CACHE_OVERLAP)
+    from_height = cached->second.start_height + cached->second.distribution.size() - RCT_DISTRIBUTION_CACHE_OVERLAP;
+
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res = AUTO_VAL_INIT(res);
   req.amounts.push_back(0);
-  req.from_height = 0;
+  req.from_height = from_height;
   if (!use_global_outs)
     req.rct_asset_type = rct_asset_type;
   req.default_tx_spendable_age = CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
@@ -4218,16 +4449,34 @@ bool wallet2::get_rct_distribution(const bool use_global_outs, const std::string
   bool r;
   try
   {
+    uint64_t pre_call_credits;
+    {
+      const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
+      pre_call_credits = m_rpc_payment_state.credits;
+      req.client = get_client_signature();
+    }
+    r = invoke_daemon_rpc([&](epee::net_utils::http::abstract_http_client &http_client) {
+      return net_utils::invoke_http_bin("/get_output_distribution.bin", req, res, http_client, rpc_timeout);
+    });
     const boost::lock_guard<boost::recursive_mutex> lock{m_daemon_rpc_mutex};
-    uint64_t pre_call_credits = m_rpc_payment_state.credits;
-    req.client = get_client_signature();
-    r = net_utils::invoke_http_bin("/get_output_distribution.bin", req, res, *m_http_client, rpc_timeout);
     THROW_ON_RPC_RESPONSE_ERROR_GENERIC(r, {}, res, "/get_output_distribution.bin");
     check_rpc_cost("/get_output_distribution.bin", res.credits, pre_call_credits, COST_PER_OUTPUT_DISTRIBUTION_0);
   }
   catch(...)
   {
-    return false;
+    r = false;
+  }
+  if (!r || res.distributions.size() != 1 || res.distributions[0].amount != 0)
+  {
+    if (from_height > 0)
+    {
+      // the daemon may be on a shorter chain than the one we cached
+      MDEBUG("Failed to extend cached output distribution, requesting it in full");
+      m_rct_distribution_cache.erase(cache_key);
+      return get_rct_distribution(use_global_outs, rct_asset_type, start_height, distribution, num_spendable_global_outs);
+    }
+    if (!r)
+      return false;
   }
   if (res.distributions.size() != 1)
   {
@@ -4239,9 +4488,38 @@ bool wallet2::get_rct_distribution(const bool use_global_outs, const std::string
     MWARNING("Failed to request output distribution: results are not for amount 0");
     return false;
   }
-  start_height = res.distributions[0].data.start_height;
-  num_spendable_global_outs = res.distributions[0].data.num_spendable_global_outs;
-  distribution = std::move(res.distributions[0].data.distribution);
+
+  cryptonote::rpc::output_distribution_data &data = res.distributions[0].data;
+  if (from_height > 0)
+  {
+    rct_distribution_cache_entry &entry = cached->second;
+    const size_t offset = from_height - entry.start_height;
+    bool consistent = data.start_height == from_height && data.distribution.size() >= RCT_DISTRIBUTION_CACHE_OVERLAP;
+    for (size_t i = 0; consistent && i < RCT_DISTRIBUTION_CACHE_OVERLAP; ++i)
+      consistent = data.distribution[i] == entry.distribution[offset + i];
+    if (!consistent)
+    {
+      MINFO("Cached output distribution does not match the daemon's, requesting it in full");
+      m_rct_distribution_cache.erase(cache_key);
+      return get_rct_distribution(use_global_outs, rct_asset_type, start_height, distribution, num_spendable_global_outs);
+    }
+    entry.distribution.resize(offset);
+    entry.distribution.insert(entry.distribution.end(), data.distribution.begin(), data.distribution.end());
+    entry.num_spendable_global_outs = data.num_spendable_global_outs;
+    MDEBUG("Extended cached output distribution by " << (data.distribution.size() - RCT_DISTRIBUTION_CACHE_OVERLAP) << " blocks");
+  }
+  else
+  {
+    rct_distribution_cache_entry &entry = m_rct_distribution_cache[cache_key];
+    entry.start_height = data.start_height;
+    entry.distribution = std::move(data.distribution);
+    entry.num_spendable_global_outs = data.num_spendable_global_outs;
+    cached = m_rct_distribution_cache.find(cache_key);
+  }
+
+  start_height = cached->second.start_height;
+  num_spendable_global_outs = cached->second.num_spendable_global_outs;
+  distribution = cached->second.distribution;
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -4327,6 +4605,12 @@ void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, ui
     else
       ++it;
   }
+  for (auto &e: m_rct_distribution_cache)
+  {
+    rct_distribution_cache_entry &cached = e.second;
+    if (height < cached.start_height + cached.distribution.size())
+      cached.distribution.resize(height > cached.start_height ? height - cached.start_height : 0);
+  }
 
   LOG_PRINT_L0("Detached blockchain on height " << height << ", total transfers detached " << total_transfers_detached << ", blocks detached " << blocks_detached);
 }
@@ -4348,6 +4632,7 @@ bool wallet2::clear()
     asset_type.second.clear();
   }
   m_key_images.clear();
+  rebuild_key_images_filter();
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
@@ -4360,6 +4645,7 @@ bool wallet2::clear()
   m_address_book.clear();
   m_subaddresses.clear();
   m_subaddress_labels.clear();
+  m_rct_distribution_cache.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
   return true;
@@ -4374,7 +4660,10 @@ void wallet2::clear_soft(bool keep_key_images)
     asset_type.second.clear();
   }
   if (!keep_key_images)
+  {
     m_key_images.clear();
+    rebuild_key_images_filter();
+  }
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
@@ -4613,6 +4902,12 @@ boost::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee:
   value2.SetUint64(m_credits_target);
   json.AddMember("credits_target", value2, json.GetAllocator());
 
+  value2.SetUint(m_refresh_pipeline_depth);
+  json.AddMember("refresh_pipeline_depth", value2, json.GetAllocator());
+
+  value2.SetUint64(m_refresh_pipeline_max_memory);
+  json.AddMember("refresh_pipeline_max_memory", value2, json.GetAllocator());
+
   // Serialize the JSON object
   rapidjson::StringBuffer buffer;
   rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
@@ -4759,6 +5054,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_persistent_rpc_client_id = false;
     m_auto_mine_for_rpc_payment_threshold = -1.0f;
     m_credits_target = 0;
+    m_refresh_pipeline_depth = DEFAULT_REFRESH_PIPELINE_DEPTH;
+    m_refresh_pipeline_max_memory = DEFAULT_REFRESH_PIPELINE_MAX_MEMORY;
   }
   else if(json.IsObject())
   {
@@ -4984,6 +5281,10 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_auto_mine_for_rpc_payment_threshold = field_auto_mine_for_rpc_payment;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, credits_target, uint64_t, Uint64, false, 0);
     m_credits_target = field_credits_target;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, refresh_pipeline_depth, uint32_t, Uint, false, DEFAULT_REFRESH_PIPELINE_DEPTH);
+    m_refresh_pipeline_depth = field_refresh_pipeline_depth ? field_refresh_pipeline_depth : 1;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, refresh_pipeline_max_memory, uint64_t, Uint64, false, DEFAULT_REFRESH_PIPELINE_MAX_MEMORY);
+    m_refresh_pipeline_max_memory = field_refresh_pipeline_max_memory;
   }
   else
   {
@@ -6205,11 +6506,19 @@ void wallet2::set_offline(bool offline)
   m_offline = offline;
   m_node_rpc_proxy.set_offline(offline);
   m_http_client->set_auto_connect(!offline);
+  for (const auto &connection: m_daemon_rpc_connections)
+    connection->http_client->set_auto_connect(!offline);
   if (offline)
   {
     boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
     if(m_http_client->is_connected())
       m_http_client->disconnect();
+    for (const auto &connection: m_daemon_rpc_connections)
+    {
+      boost::lock_guard<boost::mutex> connection_lock(connection->mutex);
+      if (connection->http_client->is_connected())
+        connection->http_client->disconnect();
+    }
   }
 }
 //----------------------------------------------------------------------------------------------------
@@ -6371,6 +6680,7 @@ void wallet2::load(const std::string& wallet_, const epee::wipeable_string& pass
   }
 
   trim_hashchain();
+  rebuild_key_images_filter();
 
   if (get_num_subaddress_accounts() == 0)
     add_subaddress_account(tr("Primary account"));
@@ -9106,23 +9416,38 @@ void wallet2::get_outs(const transfer_container &specific_transfers, const std::
     // use_global_outs should only be true when connected to a node < v17. Eventually it should never be true, when nodes 
     // require users to use rings constructed with outputs of the same asset type.
     //
-    const bool has_rct_distribution = has_rct && (!rct_offsets.empty() || get_rct_distribution(use_global_outs, rct_asset_type, rct_start_height, rct_offsets, num_spendable_global_outs));
-    
-    THROW_WALLET_EXCEPTION_IF(!has_rct_distribution,
-        error::get_output_distribution, "Failed to get rct distribution");
-
-    // check we're clear enough of rct start, to avoid corner cases below
-    THROW_WALLET_EXCEPTION_IF(rct_offsets.size() <= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE,
-        error::get_output_distribution, "Not enough rct outputs");
-    THROW_WALLET_EXCEPTION_IF(rct_offsets.back() <= max_rct_index,
-        error::get_output_distribution, "Daemon reports suspicious number of rct outputs");
+    // The distribution does not depend on the histogram and segregation requests below,
+    // so it is fetched on another daemon connection meanwhile
+    bool has_rct_distribution = has_rct && !rct_offsets.empty();
+    std::exception_ptr rct_distribution_exception;
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter rct_distribution_waiter;
+    // the waiter's own destructor does not run queued jobs, so drain it through the
+    // pool if anything below throws, or a single core host never gets to the job
+    auto rct_distribution_drain = epee::misc_utils::create_scope_leave_handler([&]() {
+      try { rct_distribution_waiter.wait(&tpool); }
+      catch (...) { /* ignore */ }
+    });
+    if (has_rct && rct_offsets.empty())
+    {
+      tpool.submit(&rct_distribution_waiter, [&]() {
+        try
+        {
+          has_rct_distribution = get_rct_distribution(use_global_outs, rct_asset_type, rct_start_height, rct_offsets, num_spendable_global_outs);
+        }
+        catch (...)
+        {
+          rct_distribution_exception = std::current_exception();
+        }
+      });
+    }
 
     // get histogram for the amounts we need
     cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::request req_t = AUTO_VAL_INIT(req_t);
     cryptonote::COMMAND_RPC_GET_OUTPUT_HISTOGRAM::response resp_t = AUTO_VAL_INIT(resp_t);
     // request histogram for all outputs, except 0 if we have the rct distribution
     for(size_t idx: selected_transfers)
-      if (!specific_transfers[idx].is_rct() || !has_rct_distribution)
+      if (!specific_transfers[idx].is_rct() || !has_rct)
         req_t.amounts.push_back(specific_transfers[idx].is_rct() ? 0 : specific_transfers[idx].amount());
     if (!req_t.amounts.empty())
     {
@@ -9195,6 +9520,18 @@ void wallet2::get_outs(const transfer_container &specific_transfers, const std::
       }
     }
 
+    rct_distribution_waiter.wait(&tpool);
+    if (rct_distribution_exception)
+      std::rethrow_exception(rct_distribution_exception);
+    THROW_WALLET_EXCEPTION_IF(!has_rct_distribution,
+        error::get_output_distribution, "Failed to get rct distribution");
+
+    // check we're clear enough of rct start, to avoid corner cases below
+    THROW_WALLET_EXCEPTION_IF(rct_offsets.size() <= CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE,
+        error::get_output_distribution, "Not enough rct outputs");
+    THROW_WALLET_EXCEPTION_IF(rct_offsets.back() <= max_rct_index,
+        error::get_output_distribution, "Daemon reports suspicious number of rct outputs");
+
     // we ask for more, to have spares if some outputs are still locked
     size_t base_requested_outputs_count = (size_t)((fake_outputs_count + 1) * 1.5 + 1);
     LOG_PRINT_L2("base_requested_outputs_count: " << base_requested_outputs_count);
@@ -10258,7 +10595,7 @@ void wallet2::transfer_selected_rct(
   LOG_PRINT_L2("transfer_selected_rct done");
 }
 
-std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, const std::string asset_type)
+std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, const std::string asset_type, const std::set<size_t> &excluded_transfers)
 {
   std::vector<size_t> picks;
   float current_output_relatdness = 1.0f;
@@ -10271,7 +10608,7 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   for (size_t i = 0; i < specific_transfers.size(); ++i)
   {
     const transfer_details& td = specific_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    if (!is_spent(td, false) && !td.m_frozen && !excluded_transfers.count(i) && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
     {
       if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
       {
@@ -10291,7 +10628,7 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   for (size_t i = 0; i < specific_transfers.size(); ++i)
   {
     const transfer_details& td = specific_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    if (!is_spent(td, false) && !td.m_frozen && !excluded_transfers.count(i) && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
     {
       if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
       {
@@ -10307,7 +10644,7 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
           MDEBUG("Ignoring output " << j << " of amount " << print_money(td2.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
           continue;
         }
-        if (!is_spent(td2, false) && !td2.m_frozen && !td2.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
+        if (!is_spent(td2, false) && !td2.m_frozen && !excluded_transfers.count(j) && !td2.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
         {
           // update our picks if those outputs are less related than any we
           // already found. If the same, don't update, and oldest suitable outputs
@@ -10583,6 +10920,7 @@ void wallet2::light_wallet_get_unspent_outs()
     if(!spent)
       set_unspent(m_transfers.size()-1);
     m_key_images[td.m_key_image] = m_transfers.size()-1;
+    add_key_image_to_filter(td.m_key_image);
     m_pub_keys[td.get_public_key()] = m_transfers.size()-1;
   }
 }
@@ -10885,7 +11223,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(
   uint32_t priority,
   const std::vector<uint8_t>& extra,
   uint32_t subaddr_account,
-  std::set<uint32_t> subaddr_indices
+  std::set<uint32_t> subaddr_indices,
+  const std::set<size_t> &excluded_transfers
 ){
 
   //ensure device is let in NONE mode in any case
@@ -11195,7 +11534,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(
       MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is below fractional threshold " << print_money(fractional_threshold));
       continue;
     }
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    if (!is_spent(td, false) && !td.m_frozen && !excluded_transfers.count(i) && !td.m_key_image_partial && (use_rct ? true : !td.is_rct()) && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
     {
       if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
       {
@@ -11277,7 +11616,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(
   // will get us a known fee.
   uint64_t estimated_fee = estimate_fee(use_per_byte_fee, use_rct, 2, fake_outs_count, 2, extra.size(), bulletproof, clsag, base_fee, fee_multiplier, fee_quantization_mask);
   estimated_fee += offshore_fee;
-  preferred_inputs = pick_preferred_rct_inputs(needed_money + estimated_fee, subaddr_account, subaddr_indices, strSource);
+  preferred_inputs = pick_preferred_rct_inputs(needed_money + estimated_fee, subaddr_account, subaddr_indices, strSource, excluded_transfers);
   if (!preferred_inputs.empty())
   {
     string s;
@@ -14230,6 +14569,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
   {
     m_transfers[n + offset].m_key_image = signed_key_images[n].first;
     m_key_images[m_transfers[n + offset].m_key_image] = n + offset;
+    add_key_image_to_filter(m_transfers[n + offset].m_key_image);
     m_transfers[n + offset].m_key_image_known = true;
     m_transfers[n + offset].m_key_image_request = false;
     m_transfers[n + offset].m_key_image_partial = false;
@@ -14499,6 +14839,7 @@ bool wallet2::import_key_images(std::map<std::string, std::vector<crypto::key_im
         LOG_PRINT_L0("WARNING: imported key image differs from previously known key image at index " << ki_idx << ": trusting imported one");
       td.m_key_image = key_images[ki_idx];
       m_key_images[td.m_key_image] = transfer_idx;
+      add_key_image_to_filter(td.m_key_image);
       td.m_key_image_known = true;
       td.m_key_image_request = false;
       td.m_key_image_partial = false;
@@ -14729,6 +15070,7 @@ process:
           error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key at index " + boost::lexical_cast<std::string>(i + offset));
 
       m_key_images[td.m_key_image] = i + offset;
+      add_key_image_to_filter(td.m_key_image);
       m_pub_keys[td.get_public_key()] = i + offset;
       specific_transfers[i + offset] = std::move(td);
     }
@@ -14999,6 +15341,7 @@ void wallet2::update_multisig_rescan_info(transfer_container &specific_transfers
   td.m_key_image_partial = false;
   td.m_multisig_k = multisig_k[n];
   m_key_images[td.m_key_image] = n;
+  add_key_image_to_filter(td.m_key_image);
 }
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_multisig(std::vector<cryptonote::blobdata> blobs)
@@ -53,6 +53,7 @@
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
+#include "common/bloom_filter.h"
 #include "common/unordered_containers_boost_serialization.h"
 #include "common/util.h"
 #include "crypto/chacha.h"
@@ -628,6 +629,15 @@ private:
       crypto::signature key_image_sig;
     };
 
+    struct rct_distribution_cache_entry
+    {
+      uint64_t start_height;
+      std::vector<uint64_t> distribution; // cumulative number of rct outputs in each block from start_height
+      uint64_t num_spendable_global_outs;
+
+      rct_distribution_cache_entry(): start_height(0), num_spendable_global_outs(0) {}
+    };
+
     typedef std::tuple<uint64_t, crypto::public_key, rct::key> get_outs_entry;
 
     struct parsed_block
@@ -656,6 +666,18 @@ private:
       bool empty() const { return tx_extra_fields.empty() && primary.empty() && additional.empty(); }
     };
 
+    struct refresh_stage_timings
+    {
+      uint64_t fetch; // ms spent in getblocks.bin calls
+      uint64_t parse; // ms spent parsing blocks and txes
+      uint64_t scan; // ms spent deriving keys and matching outputs
+      uint64_t apply; // ms spent applying scanned blocks to the wallet
+      uint64_t wait; // ms the apply stage spent waiting on the fetch/scan stages
+      uint64_t spans; // number of getblocks.bin responses processed
+
+      refresh_stage_timings(): fetch(0), parse(0), scan(0), apply(0), wait(0), spans(0) {}
+    };
+
     /*!
      * \brief  Generates a wallet or restores one.
      * \param  wallet_              Name of wallet file
@@ -965,7 +987,8 @@ private:
       uint32_t priority,
       const std::vector<uint8_t>& extra,
       uint32_t subaddr_account,
-      std::set<uint32_t> subaddr_indices // pass subaddr_indices by value on purpose
+      std::set<uint32_t> subaddr_indices, // pass subaddr_indices by value on purpose
+      const std::set<size_t> &excluded_transfers = {} // indices into the source asset's transfers, not to be spent
     );
     std::vector<wallet2::pending_tx> create_transactions_all(
       uint64_t below,
@@ -1160,6 +1183,9 @@ private:
       if(ver < 30)
         return;
       a & m_xasset_transfers;
+      if(ver < 31)
+        return;
+      a & m_rct_distribution_cache;
     }
 
     /*!
@@ -1241,6 +1267,11 @@ private:
     void set_rpc_client_secret_key(const crypto::secret_key &key) { m_rpc_client_secret_key = key; m_node_rpc_proxy.set_client_secret_key(key); }
     uint64_t credits_target() const { return m_credits_target; }
     void credits_target(uint64_t threshold) { m_credits_target = threshold; }
+    uint32_t refresh_pipeline_depth() const { return m_refresh_pipeline_depth; }
+    void refresh_pipeline_depth(uint32_t depth) { m_refresh_pipeline_depth = depth ? depth : 1; }
+    uint64_t refresh_pipeline_max_memory() const { return m_refresh_pipeline_max_memory; }
+    void refresh_pipeline_max_memory(uint64_t bytes) { m_refresh_pipeline_max_memory = bytes; }
+    const refresh_stage_timings &get_refresh_stage_timings() const { return m_refresh_stage_timings; }
 
     bool get_tx_key_cached(const crypto::hash &txid, crypto::secret_key &tx_key, std::vector<crypto::secret_key> &additional_tx_keys) const;
     void set_tx_key(const crypto::hash &txid, const crypto::secret_key &tx_key, const std::vector<crypto::secret_key> &additional_tx_keys);
@@ -1582,8 +1613,11 @@ private:
     void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_asset_type_output_indices> &asset_type_output_indices, uint64_t &current_height);
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
+    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception, refresh_stage_timings *timings = NULL);
     void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, const std::vector<tx_cache_data> &tx_cache_data, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    void derive_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data) const;
+    void match_parsed_blocks(uint64_t start_height, const std::vector<parsed_block> &parsed_blocks, std::vector<tx_cache_data> &tx_cache_data, const std::unordered_map<crypto::public_key, cryptonote::subaddress_index> &subaddresses) const;
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height);
@@ -1602,7 +1636,7 @@ private:
     std::vector<uint64_t> get_unspent_amounts_vector(bool strict);
     uint64_t get_dynamic_base_fee_estimate();
     float get_output_relatedness(const transfer_details &td0, const transfer_details &td1) const;
-    std::vector<size_t> pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, const std::string asset_type);
+    std::vector<size_t> pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices, const std::string asset_type, const std::set<size_t> &excluded_transfers = {});
     void set_spent(size_t idx, uint64_t height);
     void set_unspent(size_t idx);
     void set_spent(transfer_details &td, uint64_t height);
@@ -1671,8 +1705,41 @@ private:
     std::string get_client_signature() const;
     void check_rpc_cost(const char *call, uint64_t post_call_credits, uint64_t pre_credits, double expected_cost);
 
+    struct daemon_rpc_connection
+    {
+      std::unique_ptr<epee::net_utils::http::abstract_http_client> http_client;
+      boost::mutex mutex;
+    };
+
+    // Calls f with an idle connection of our own to the daemon, so independent calls can be in
+    // flight at the same time. Falls back to the main connection under m_daemon_rpc_mutex when
+    // they are all busy, or when we are paying for RPC, since credits are tracked per call.
+    template<typename F>
+    bool invoke_daemon_rpc(F f)
+    {
+      if (m_offline) return false;
+      bool parallel;
+      {
+        boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
+        parallel = m_rpc_payment_state.credits == 0;
+      }
+      if (parallel)
+      {
+        for (const auto &connection: m_daemon_rpc_connections)
+        {
+          boost::unique_lock<boost::mutex> lock(connection->mutex, boost::try_to_lock);
+          if (lock.owns_lock())
+            return f(*connection->http_client);
+        }
+      }
+      boost::lock_guard<boost::recursive_mutex> lock(m_daemon_rpc_mutex);
+      return f(*m_http_client);
+    }
+
     bool should_expand(const cryptonote::subaddress_index &index) const;
     bool spends_one_of_ours(const cryptonote::transaction &tx) const;
+    void rebuild_key_images_filter();
+    void add_key_image_to_filter(const crypto::key_image &ki);
 
     cryptonote::account_base m_account;
     boost::optional<epee::net_utils::http::login> m_daemon_login;
@@ -1681,6 +1748,7 @@ private:
     std::string m_keys_file;
     std::string m_mms_file;
     const std::unique_ptr<epee::net_utils::http::abstract_http_client> m_http_client;
+    std::vector<std::unique_ptr<daemon_rpc_connection>> m_daemon_rpc_connections;
     hashchain m_blockchain;
     std::unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
     std::unordered_map<crypto::hash, confirmed_transfer_details> m_confirmed_txs;
@@ -1692,8 +1760,10 @@ private:
     transfer_container m_transfers;
     transfer_container m_offshore_transfers;
     std::map<std::string, transfer_container> m_xasset_transfers;
+    std::map<std::string, rct_distribution_cache_entry> m_rct_distribution_cache; // by asset type, empty for all outputs
     payment_container m_payments;
     std::unordered_map<crypto::key_image, size_t> m_key_images;
+    tools::blocked_bloom_filter<crypto::key_image> m_key_images_filter; // in front of m_key_images, rebuilt on load
     std::unordered_map<crypto::public_key, size_t> m_pub_keys;
     cryptonote::account_public_address m_account_public_address;
     std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
@@ -1770,6 +1840,9 @@ private:
     crypto::secret_key m_rpc_client_secret_key;
     rpc_payment_state_t m_rpc_payment_state;
     uint64_t m_credits_target;
+    uint32_t m_refresh_pipeline_depth;
+    uint64_t m_refresh_pipeline_max_memory;
+    refresh_stage_timings m_refresh_stage_timings;
 
     // Aux transaction data from device
     std::unordered_map<crypto::hash, std::string> m_tx_device;
@@ -1818,7 +1891,7 @@ private:
     static std::string default_daemon_address;
   };
 }
-BOOST_CLASS_VERSION(tools::wallet2, 30)
+BOOST_CLASS_VERSION(tools::wallet2, 31)
 BOOST_CLASS_VERSION(tools::wallet2::transfer_details, 12)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info, 1)
 BOOST_CLASS_VERSION(tools::wallet2::multisig_info::LR, 0)
@@ -1829,6 +1902,7 @@ BOOST_CLASS_VERSION(tools::wallet2::unconfirmed_transfer_details, 11)
 BOOST_CLASS_VERSION(tools::wallet2::confirmed_transfer_details, 9)
 BOOST_CLASS_VERSION(tools::wallet2::address_book_row, 18)
 BOOST_CLASS_VERSION(tools::wallet2::reserve_proof_entry, 0)
+BOOST_CLASS_VERSION(tools::wallet2::rct_distribution_cache_entry, 0)
 BOOST_CLASS_VERSION(tools::wallet2::unsigned_tx_set, 0)
 BOOST_CLASS_VERSION(tools::wallet2::signed_tx_set, 1)
 BOOST_CLASS_VERSION(tools::wallet2::tx_construction_data, 7)
@@ -2262,6 +2336,14 @@ namespace boost
       a & x.key_image_sig;
     }
 
+    template <class Archive>
+    inline void serialize(Archive& a, tools::wallet2::rct_distribution_cache_entry& x, const boost::serialization::version_type ver)
+    {
+      a & x.start_height;
+      a & x.distribution;
+      a & x.num_spendable_global_outs;
+    }
+
     template <class Archive>
     inline void serialize(Archive &a, tools::wallet2::unsigned_tx_set &x, const boost::serialization::version_type ver)
     {
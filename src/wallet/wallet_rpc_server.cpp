@@ -1691,6 +1691,140 @@ namespace tools
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_transfer_batch(const wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::request& req, wallet_rpc::COMMAND_RPC_TRANSFER_BATCH::response& res, epee::json_rpc::error& er, const connection_context *ctx)
+  {
+    if (!m_wallet) return not_open(er);
+    if (m_restricted)
+    {
+      er.code = WALLET_RPC_ERROR_CODE_DENIED;
+      er.message = "Command unavailable in restricted mode.";
+      return false;
+    }
+
+    if (req.groups.empty())
+    {
+      er.code = WALLET_RPC_ERROR_CODE_ZERO_DESTINATION;
+      er.message = "No transfer groups";
+      return false;
+    }
+
+    // validate all the groups first, so a bad one does not leave half a batch relayed
+    std::vector<std::vector<cryptonote::tx_destination_entry>> dsts(req.groups.size());
+    std::vector<std::vector<uint8_t>> extra(req.groups.size());
+    size_t n = 0;
+    for (const auto &group: req.groups)
+    {
+      if (group.asset_type.empty() || std::find(offshore::ASSET_TYPES.begin(), offshore::ASSET_TYPES.end(), group.asset_type) == offshore::ASSET_TYPES.end())
+      {
+        er.code = WALLET_RPC_ERROR_CODE_TX_NOT_POSSIBLE;
+        er.message = "Invalid asset type in transfer group " + std::to_string(n);
+        return false;
+      }
+      size_t memo_size = group.memo.size();
+      if (memo_size > TX_EXTRA_MEMO_MAX_COUNT)
+      {
+        er.code = WALLET_RPC_ERROR_CODE_DENIED;
+        er.message = "Transaction memo can't be more than 255 characters long!";
+        return false;
+      }
+      if (memo_size > 0 && !cryptonote::add_memo_to_tx_extra(extra[n], group.memo))
+      {
+        er.code = WALLET_RPC_ERROR_CODE_DENIED;
+        er.message = "Transaction memo failed to serialize";
+        return false;
+      }
+      if (!validate_transfer(group.destinations, group.payment_id, dsts[n], extra[n], true, er))
+      {
+        return false;
+      }
+      ++n;
+    }
+
+    // The inputs picked for a group are excluded from the following groups, so no two
+    // transactions of the batch spend the same output. Everything is built before any
+    // of it is relayed.
+    std::vector<std::vector<wallet2::pending_tx>> ptx_vectors;
+    std::map<std::string, std::set<size_t>> used_transfers;
+    try
+    {
+      uint64_t mixin = m_wallet->adjust_mixin(req.ring_size ? req.ring_size - 1 : 0);
+      uint32_t priority = m_wallet->adjust_priority(req.priority);
+      n = 0;
+      for (const auto &group: req.groups)
+      {
+        cryptonote::transaction_type tx_type;
+        if (group.asset_type == "XHV") {
+          tx_type = cryptonote::transaction_type::TRANSFER;
+        } else if (group.asset_type == "XUSD") {
+          tx_type = cryptonote::transaction_type::OFFSHORE_TRANSFER;
+        } else {
+          tx_type = cryptonote::transaction_type::XASSET_TRANSFER;
+        }
+
+        LOG_PRINT_L2("on_transfer_batch calling create_transactions_2 for group " << n);
+        std::set<size_t> &used = used_transfers[group.asset_type];
+        ptx_vectors.push_back(m_wallet->create_transactions_2(
+          dsts[n], mixin, group.asset_type, group.asset_type, tx_type, req.unlock_time, priority, extra[n], req.account_index, req.subaddr_indices, used));
+        if (ptx_vectors.back().empty())
+        {
+          er.code = WALLET_RPC_ERROR_CODE_TX_NOT_POSSIBLE;
+          er.message = "No transaction created for transfer group " + std::to_string(n);
+          return false;
+        }
+        for (const auto &ptx: ptx_vectors.back())
+          used.insert(ptx.selected_transfers.begin(), ptx.selected_transfers.end());
+        ++n;
+      }
+
+      n = 0;
+      for (const auto &group: req.groups)
+      {
+        res.groups.push_back(wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::response_t());
+        wallet_rpc::COMMAND_RPC_TRANSFER_SPLIT::response_t &gres = res.groups.back();
+        gres.amount_asset = group.asset_type;
+        gres.fee_asset = group.asset_type;
+        if (!fill_response(ptx_vectors[n], req.get_tx_keys, gres.tx_key_list, gres.amount_list, gres.amount_asset, gres.fee_list, gres.weight_list, gres.multisig_txset, gres.unsigned_txset,
+            true, gres.tx_hash_list, req.get_tx_hex, gres.tx_blob_list, req.get_tx_metadata, gres.tx_metadata_list, er))
+          return false;
+        ++n;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_GENERIC_TRANSFER_ERROR);
+      return false;
+    }
+
+    if (req.do_not_relay || m_wallet->multisig() || m_wallet->watch_only())
+      return true;
+
+    // Once the first transaction is out there is no taking it back, so a failure past
+    // that point is reported alongside the hashes already relayed instead of as an
+    // error, letting the caller tell which groups still need sending.
+    for (auto &ptx_vector: ptx_vectors)
+    {
+      for (auto &ptx: ptx_vector)
+      {
+        try
+        {
+          m_wallet->commit_tx(ptx);
+        }
+        catch (const std::exception& e)
+        {
+          if (res.relayed_tx_hash_list.empty())
+          {
+            handle_rpc_exception(std::current_exception(), er, WALLET_RPC_ERROR_CODE_GENERIC_TRANSFER_ERROR);
+            return false;
+          }
+          res.relay_error = e.what();
+          return true;
+        }
+        res.relayed_tx_hash_list.push_back(epee::string_tools::pod_to_hex(cryptonote::get_transaction_hash(ptx.tx)));
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sign_transfer(const wallet_rpc::COMMAND_RPC_SIGN_TRANSFER::request& req, wallet_rpc::COMMAND_RPC_SIGN_TRANSFER::response& res, epee::json_rpc::error& er, const connection_context *ctx)
   {
     if (!m_wallet) return not_open(er);
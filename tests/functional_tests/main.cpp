@@ -37,12 +37,14 @@ using namespace epee;
 #include "common/command_line.h"
 #include "common/util.h"
 #include "transactions_flow_test.h"
+#include "refresh_pipeline_test.h"
 
 namespace po = boost::program_options;
 
 namespace
 {
   const command_line::arg_descriptor<bool> arg_test_transactions_flow = {"test_transactions_flow", ""};
+  const command_line::arg_descriptor<bool> arg_test_refresh_pipeline = {"test_refresh_pipeline", ""};
 
   const command_line::arg_descriptor<std::string> arg_working_folder  = {"working-folder", "", "."};
   const command_line::arg_descriptor<std::string> arg_source_wallet   = {"source-wallet",  "", "", true};
@@ -55,6 +57,7 @@ namespace
   const command_line::arg_descriptor<size_t> arg_tx_count          = {"tx-count",          "", 100};
   const command_line::arg_descriptor<size_t> arg_tx_per_second     = {"tx-per-second",     "", 20};
   const command_line::arg_descriptor<size_t> arg_test_repeat_count = {"test_repeat_count", "", 1};
+  const command_line::arg_descriptor<uint32_t> arg_refresh_pipeline_depth = {"refresh-pipeline-depth", "", 8};
 }
 
 int main(int argc, char* argv[])
@@ -71,6 +74,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_options, command_line::arg_help);
 
   command_line::add_arg(desc_options, arg_test_transactions_flow);
+  command_line::add_arg(desc_options, arg_test_refresh_pipeline);
 
   command_line::add_arg(desc_options, arg_working_folder);
   command_line::add_arg(desc_options, arg_source_wallet);
@@ -83,6 +87,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_options, arg_tx_count);
   command_line::add_arg(desc_options, arg_tx_per_second);
   command_line::add_arg(desc_options, arg_test_repeat_count);
+  command_line::add_arg(desc_options, arg_refresh_pipeline_depth);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -126,6 +131,16 @@ int main(int argc, char* argv[])
     
     return 1;
   }
+  else if (command_line::get_arg(vm, arg_test_refresh_pipeline))
+  {
+    if (!command_line::has_arg(vm, arg_source_wallet))
+    {
+      std::cout << "--source-wallet is needed" << std::endl;
+      return 1;
+    }
+    const std::string wallet_path = command_line::get_arg(vm, arg_working_folder) + "/" + command_line::get_arg(vm, arg_source_wallet);
+    return refresh_pipeline_test(wallet_path, command_line::get_arg(vm, arg_daemon_addr_a), command_line::get_arg(vm, arg_refresh_pipeline_depth)) ? 0 : 1;
+  }
   else
   {
     std::cout << desc_options << std::endl;
@@ -0,0 +1,149 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "include_base_utils.h"
+#include "string_tools.h"
+#include "wallet/wallet2.h"
+#include "refresh_pipeline_test.h"
+
+namespace
+{
+  bool refresh_from_scratch(tools::wallet2& w, const std::string& wallet_path, const std::string& daemon_addr, uint32_t pipeline_depth)
+  {
+    try
+    {
+      w.load(wallet_path, "");
+      w.init(daemon_addr);
+      w.refresh_pipeline_depth(pipeline_depth);
+      w.rescan_blockchain(true, false);
+      uint64_t blocks_fetched = 0;
+      bool received_money, ok;
+      if (!w.refresh(true, blocks_fetched, received_money, ok) || !ok)
+      {
+        LOG_ERROR("failed to refresh " << wallet_path << " with a pipeline depth of " << pipeline_depth);
+        return false;
+      }
+      const tools::wallet2::refresh_stage_timings &timings = w.get_refresh_stage_timings();
+      LOG_PRINT_L0("pipeline depth " << pipeline_depth << ": " << blocks_fetched << " blocks in " << timings.spans << " spans, fetch "
+          << timings.fetch << " ms, parse " << timings.parse << " ms, scan " << timings.scan << " ms, apply " << timings.apply << " ms, wait " << timings.wait << " ms");
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("failed to refresh " << wallet_path << " with a pipeline depth of " << pipeline_depth << ": " << e.what());
+      return false;
+    }
+    return true;
+  }
+
+  bool same_transfer(const tools::wallet2::transfer_details& a, const tools::wallet2::transfer_details& b)
+  {
+    return a.m_txid == b.m_txid && a.m_internal_output_index == b.m_internal_output_index && a.m_global_output_index == b.m_global_output_index
+        && a.m_block_height == b.m_block_height && a.m_amount == b.m_amount && a.m_spent == b.m_spent && a.m_spent_height == b.m_spent_height
+        && a.m_key_image == b.m_key_image && a.m_subaddr_index.major == b.m_subaddr_index.major && a.m_subaddr_index.minor == b.m_subaddr_index.minor;
+  }
+
+  // payments are kept in hash tables, so they are compared as sorted descriptions
+  std::vector<std::string> describe(const std::list<std::pair<crypto::hash, tools::wallet2::payment_details>>& payments)
+  {
+    std::vector<std::string> descriptions;
+    for (const auto& p: payments)
+      descriptions.push_back(epee::string_tools::pod_to_hex(p.second.m_tx_hash) + " " + epee::string_tools::pod_to_hex(p.first) + " " + p.second.m_asset_type + " "
+          + std::to_string(p.second.m_amount) + " " + std::to_string(p.second.m_block_height) + " " + std::to_string(p.second.m_subaddr_index.major) + "/" + std::to_string(p.second.m_subaddr_index.minor));
+    std::sort(descriptions.begin(), descriptions.end());
+    return descriptions;
+  }
+
+  std::vector<std::string> describe(const std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>>& payments)
+  {
+    std::vector<std::string> descriptions;
+    for (const auto& p: payments)
+      descriptions.push_back(epee::string_tools::pod_to_hex(p.first) + " " + std::to_string(p.second.m_amount_in) + " " + std::to_string(p.second.m_amount_out) + " "
+          + std::to_string(p.second.m_change) + " " + std::to_string(p.second.m_block_height));
+    std::sort(descriptions.begin(), descriptions.end());
+    return descriptions;
+  }
+
+  template<typename T, typename F>
+  bool check_same(const char* what, const T& serial, const T& pipelined, F same)
+  {
+    if (serial.size() != pipelined.size())
+    {
+      LOG_ERROR(what << ": " << serial.size() << " with the serial refresh, " << pipelined.size() << " with the pipelined refresh");
+      return false;
+    }
+    size_t i = 0;
+    for (auto s = serial.begin(), p = pipelined.begin(); s != serial.end(); ++s, ++p, ++i)
+    {
+      if (!same(*s, *p))
+      {
+        LOG_ERROR(what << ": entry " << i << " differs between the serial and the pipelined refresh");
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+bool refresh_pipeline_test(const std::string& wallet_path, const std::string& daemon_addr, uint32_t pipeline_depth)
+{
+  LOG_PRINT_L0("-----------------------STARTING REFRESH PIPELINE TEST-----------------------");
+  // a depth of one fetches a single span ahead of the one being applied, as refresh did before the pipeline
+  tools::wallet2 serial, pipelined;
+  if (!refresh_from_scratch(serial, wallet_path, daemon_addr, 1) || !refresh_from_scratch(pipelined, wallet_path, daemon_addr, pipeline_depth))
+    return false;
+
+  if (serial.get_blockchain_current_height() != pipelined.get_blockchain_current_height())
+  {
+    LOG_ERROR("refreshed to height " << serial.get_blockchain_current_height() << " serially, " << pipelined.get_blockchain_current_height() << " pipelined");
+    return false;
+  }
+
+  tools::wallet2::transfer_container serial_transfers, pipelined_transfers;
+  serial.get_transfers(serial_transfers);
+  pipelined.get_transfers(pipelined_transfers);
+
+  std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> serial_payments, pipelined_payments;
+  serial.get_payments(serial_payments, 0);
+  pipelined.get_payments(pipelined_payments, 0);
+
+  std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> serial_payments_out, pipelined_payments_out;
+  serial.get_payments_out(serial_payments_out, 0);
+  pipelined.get_payments_out(pipelined_payments_out, 0);
+
+  const auto same_description = [](const std::string& a, const std::string& b) { return a == b; };
+  if (!check_same("transfers", serial_transfers, pipelined_transfers, same_transfer)
+      || !check_same("incoming payments", describe(serial_payments), describe(pipelined_payments), same_description)
+      || !check_same("outgoing payments", describe(serial_payments_out), describe(pipelined_payments_out), same_description))
+    return false;
+
+  LOG_PRINT_L0("refresh pipeline test passed: " << serial_transfers.size() << " transfers, " << serial_payments.size() << " incoming and "
+      << serial_payments_out.size() << " outgoing payments at height " << serial.get_blockchain_current_height());
+  return true;
+}
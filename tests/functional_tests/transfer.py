@@ -52,6 +52,7 @@ class TransferTest():
         self.check_tx_notes()
         self.check_rescan()
         self.check_is_key_image_spent()
+        self.check_transfer_batch()
 
     def reset(self):
         print('Resetting blockchain')
@@ -833,5 +834,64 @@ class TransferTest():
         assert res.spent_status == expected
 
 
+    def check_transfer_batch(self):
+        daemon = Daemon()
+
+        print('Testing transfer_batch')
+        daemon.generateblocks('42ey1afDFnn4886T7196doS9GPMzexD9gXpsZJDwVjeRVdFCSoHnv7KPbBeGpzJBzHRCAs9UxqeoyFQMYbqSWYTfJJQAWDm', 10)
+        self.wallet[0].refresh()
+        res = daemon.get_transaction_pool_hashes()
+        pool = res.tx_hashes if 'tx_hashes' in res else []
+
+        dst1 = {'address': '44Kbx4sJ7JDRDV5aAhLJzQCjDz2ViLRduE3ijDZu3osWKBjMGkV1XPk4pfDUMqt1Aiezvephdqm6YD19GKFD9ZcXVUTp6BW', 'amount': 100000000000}
+        dst2 = {'address': '46r4nYSevkfBUMhuykdK3gQ98XDqDTYW1hNLaXNvjpsJaSbNtdXh1sKMsdVgqkaihChAzEy29zEDPMR3NHQvGoZCLGwTerK', 'amount': 200000000000}
+
+        print('Checking a batch fails as a whole when a later group cannot be funded')
+        res = self.wallet[0].get_balance()
+        ok = False
+        try: self.wallet[0].transfer_batch([{'destinations': [dst1]}, {'destinations': [{'address': dst2['address'], 'amount': res.balance}]}], ring_size = 11)
+        except: ok = True
+        assert ok
+        res = daemon.get_transaction_pool_hashes()
+        assert (res.tx_hashes if 'tx_hashes' in res else []) == pool
+        res = self.wallet[0].get_transfers()
+        assert not 'pending' in res or len(res.pending) == 0
+
+        print('Checking each group gets its own transactions')
+        res = self.wallet[0].transfer_batch([{'destinations': [dst1]}, {'destinations': [dst2], 'memo': 'second group'}], ring_size = 11, get_tx_hex = True)
+        assert len(res.groups) == 2
+        txids = []
+        for group, dst in zip(res.groups, [dst1, dst2]):
+            assert len(group.tx_hash_list) == 1
+            assert group.amount_list == [dst['amount']]
+            assert group.fee_list[0] > 0
+            assert len(group.tx_blob_list) == 1
+            txids += group.tx_hash_list
+        assert len(set(txids)) == 2
+        assert res.relayed_tx_hash_list == txids
+        assert not 'relay_error' in res or res.relay_error == ''
+        res = daemon.get_transaction_pool_hashes()
+        assert sorted(res.tx_hashes) == sorted(pool + txids)
+
+        # the groups must not share inputs, or one of them would have been rejected by the pool
+        res = daemon.get_transactions(txids, decode_as_json = True)
+        assert len(res.txs) == 2
+        key_images = [[vin['key']['k_image'] for vin in json.loads(tx.as_json)['vin']] for tx in res.txs]
+        assert len(set(key_images[0]) & set(key_images[1])) == 0
+
+        print('Checking do_not_relay keeps the whole batch back')
+        res = self.wallet[0].transfer_batch([{'destinations': [dst1]}, {'destinations': [dst2]}], ring_size = 11, do_not_relay = True)
+        assert len(res.groups) == 2
+        assert not 'relayed_tx_hash_list' in res or len(res.relayed_tx_hash_list) == 0
+        res = daemon.get_transaction_pool_hashes()
+        assert sorted(res.tx_hashes) == sorted(pool + txids)
+
+        daemon.generateblocks('42ey1afDFnn4886T7196doS9GPMzexD9gXpsZJDwVjeRVdFCSoHnv7KPbBeGpzJBzHRCAs9UxqeoyFQMYbqSWYTfJJQAWDm', 1)
+        res = daemon.get_transactions(txids)
+        assert len(res.txs) == 2
+        for tx in res.txs:
+            assert not tx.in_pool
+
+
 if __name__ == '__main__':
     TransferTest().run_test()
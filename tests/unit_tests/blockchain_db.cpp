@@ -38,6 +38,7 @@
 #include "string_tools.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/lmdb/db_lmdb.h"
+#include "common/pruning.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 
 using namespace cryptonote;
@@ -151,6 +152,45 @@ std::string h2b(const std::string& s)
   return result;
 }
 
+// a key image per n, spread over the whole key image space
+crypto::key_image make_key_image(uint64_t n)
+{
+  const crypto::hash h = crypto::cn_fast_hash(&n, sizeof(n));
+  crypto::key_image ki;
+  memcpy(&ki, &h, sizeof(ki));
+  return ki;
+}
+
+// an XHV to XUSD conversion spending the given key images, only valid as far
+// as the db looks at it
+std::pair<transaction, blobdata> make_test_conversion(const std::vector<crypto::key_image> &key_images, uint64_t amount_burnt, uint64_t amount_minted)
+{
+  transaction tx;
+  tx.version = POU_TRANSACTION_VERSION;
+  for (const auto &ki: key_images)
+  {
+    txin_to_key in;
+    in.amount = 0;
+    in.key_offsets.push_back(0);
+    in.k_image = ki;
+    tx.vin.push_back(in);
+  }
+  tx_out out;
+  out.amount = 0;
+  out.target = txout_to_key(crypto::null_pkey);
+  tx.vout.push_back(out);
+  out.target = txout_offshore(crypto::null_pkey);
+  tx.vout.push_back(out);
+  tx.output_unlock_times.resize(tx.vout.size(), 0);
+  tx.amount_burnt = amount_burnt;
+  tx.amount_minted = amount_minted;
+  tx.rct_signatures.type = rct::RCTTypeNull;
+  tx.rct_signatures.outPk.resize(tx.vout.size());
+  tx.rct_signatures.outPk_usd.resize(tx.vout.size());
+  tx.rct_signatures.outPk_xasset.resize(tx.vout.size());
+  return std::make_pair(tx, tx_to_blob(tx));
+}
+
 template <typename T>
 class BlockchainDBTest : public testing::Test
 {
@@ -228,6 +268,22 @@ protected:
   {
     m_prefix = prefix;
   }
+
+  // adds a block with the given txs on top of the chain, built from the
+  // first test block with its own miner tx so any number can be added
+  void add_test_block(const std::vector<std::pair<transaction, blobdata>> &txs)
+  {
+    const uint64_t height = m_db->height();
+    block blk = m_blocks[0].first;
+    blk.prev_id = height ? m_db->top_block_hash() : crypto::null_hash;
+    boost::get<txin_gen>(blk.miner_tx.vin[0]).height = height;
+    blk.miner_tx.invalidate_hashes();
+    blk.tx_hashes.clear();
+    for (const auto &tx: txs)
+      blk.tx_hashes.push_back(get_transaction_hash(tx.first));
+    blk.invalidate_hashes();
+    m_db->add_block(std::make_pair(blk, block_to_blob(blk)), t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], txs);
+  }
 };
 
 using testing::Types;
@@ -302,6 +358,355 @@ TYPED_TEST(BlockchainDBTest, AddBlock)
   }
 }
 
+TYPED_TEST(BlockchainDBTest, PipelinedSync)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  BlockchainLMDB *db = dynamic_cast<BlockchainLMDB*>(this->m_db);
+  ASSERT_NE(nullptr, db);
+  uint64_t committed_blocks, synced_blocks;
+
+  // with a bound of one block, each commit waits for the previous one to be flushed
+  ASSERT_NO_THROW(this->m_db->set_pipelined_sync(1));
+  for (size_t i = 0; i < 2; ++i)
+  {
+    {
+      db_wtxn_guard guard(this->m_db);
+      ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[i], t_sizes[i], t_sizes[i], t_diffs[i], t_coins[i], this->m_txs[i]));
+    }
+    db->get_sync_progress(committed_blocks, synced_blocks);
+    ASSERT_EQ(i + 1, committed_blocks);
+    ASSERT_LE(committed_blocks - synced_blocks, 1);
+  }
+  ASSERT_EQ(2, this->m_db->height());
+
+  // the second commit could only return once the first block was flushed
+  ASSERT_GE(synced_blocks, 1);
+
+  ASSERT_NO_THROW(this->m_db->set_pipelined_sync(0));
+  ASSERT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1].first)));
+}
+
+TYPED_TEST(BlockchainDBTest, PresizedMap)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // with MDB_WRITEMAP the data file is extended to the whole map
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FASTEST | DBF_PRESIZE));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // batches keep working on top of a map reserved up front
+  ASSERT_TRUE(this->m_db->batch_start(2));
+  for (size_t i = 0; i < 2; ++i)
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[i], t_sizes[i], t_sizes[i], t_diffs[i], t_coins[i], this->m_txs[i]));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  ASSERT_EQ(2, this->m_db->height());
+
+  // the map size LMDB recorded in the data file
+  auto get_mapsize = [&dirPath]() {
+    MDB_env *env;
+    MDB_envinfo mei;
+    mei.me_mapsize = 0;
+    if (mdb_env_create(&env))
+      return mei.me_mapsize;
+    if (mdb_env_open(env, dirPath.c_str(), MDB_RDONLY, 0644) == 0)
+      mdb_env_info(env, &mei);
+    mdb_env_close(env);
+    return mei.me_mapsize;
+  };
+  ASSERT_NO_THROW(this->m_db->close());
+  const size_t mapsize = get_mapsize();
+  ASSERT_GT(mapsize, 0);
+
+  // reopening reserves from the pages in use, so the map does not grow by
+  // the free disk space every time
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FASTEST | DBF_PRESIZE));
+    ASSERT_EQ(2, this->m_db->height());
+    ASSERT_NO_THROW(this->m_db->close());
+    ASSERT_EQ(mapsize, get_mapsize());
+  }
+}
+
+TYPED_TEST(BlockchainDBTest, IncrementalPruning)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // a conversion every 10 blocks, the ones below the tip blocks are prunable.
+  // all of those are in the first stripe, so stripe 2 prunes them
+  const uint64_t blocks = CRYPTONOTE_PRUNING_TIP_BLOCKS + 100;
+  const uint32_t pruning_seed = tools::make_pruning_seed(2, CRYPTONOTE_PRUNING_LOG_STRIPES);
+  std::map<uint64_t, crypto::hash> conversions;
+  uint64_t key_images = 0;
+  auto add_blocks = [this, &conversions, &key_images](uint64_t end, uint64_t period) {
+    ASSERT_TRUE(this->m_db->batch_start(end - this->m_db->height()));
+    for (uint64_t h = this->m_db->height(); h < end; ++h)
+    {
+      std::vector<std::pair<transaction, blobdata>> txs;
+      if (h % period == 0)
+      {
+        txs.push_back(make_test_conversion({make_key_image(key_images++)}, 10, 1));
+        conversions[h] = get_transaction_hash(txs.back().first);
+      }
+      ASSERT_NO_THROW(this->add_test_block(txs));
+    }
+    ASSERT_NO_THROW(this->m_db->batch_stop());
+  };
+  auto pop_blocks = [this, &conversions](uint64_t end) {
+    while (this->m_db->height() > end)
+    {
+      block blk;
+      std::vector<transaction> txs;
+      ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+      conversions.erase(this->m_db->height());
+    }
+  };
+  auto check_pruned = [this, &conversions, pruning_seed]() {
+    const uint64_t height = this->m_db->height();
+    for (const auto &i: conversions)
+    {
+      blobdata bd;
+      EXPECT_EQ(tools::has_unpruned_block(i.first, height, pruning_seed), this->m_db->get_prunable_tx_blob(i.second, bd)) << "height " << i.first;
+    }
+  };
+  // small steps, so they stop close to the given height
+  auto run_steps = [this](uint64_t until_height) {
+    while (this->m_db->get_pruning_progress().next_height < until_height)
+      ASSERT_TRUE(this->m_db->prune_blockchain_step(20));
+  };
+
+  add_blocks(blocks, 10);
+  ASSERT_FALSE(this->m_db->prune_blockchain_step(500));
+  ASSERT_FALSE(this->m_db->get_pruning_progress().active);
+
+  // start: the seed is set right away, nothing is pruned yet
+  ASSERT_TRUE(this->m_db->start_incremental_pruning(pruning_seed));
+  ASSERT_FALSE(this->m_db->start_incremental_pruning(pruning_seed));
+  ASSERT_EQ(pruning_seed, this->m_db->get_blockchain_pruning_seed());
+  pruning_progress progress = this->m_db->get_pruning_progress();
+  ASSERT_TRUE(progress.active);
+  ASSERT_EQ(0, progress.next_height);
+  ASSERT_EQ(blocks, progress.end_height);
+  ASSERT_EQ(0, progress.pruned_txes);
+  blobdata bd;
+  ASSERT_TRUE(this->m_db->get_prunable_tx_blob(conversions[0], bd));
+
+  // step: a step stops once it went through the given number of txes
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(50));
+  progress = this->m_db->get_pruning_progress();
+  ASSERT_TRUE(progress.active);
+  ASSERT_GT(progress.next_height, 0);
+  ASSERT_LT(progress.next_height, 50);
+  ASSERT_GT(progress.pruned_txes, 0);
+  ASSERT_FALSE(this->m_db->get_prunable_tx_blob(conversions[0], bd));
+
+  // resume: the job is kept across a reopen
+  run_steps(50);
+  progress = this->m_db->get_pruning_progress();
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  const pruning_progress reopened = this->m_db->get_pruning_progress();
+  ASSERT_TRUE(reopened.active);
+  ASSERT_EQ(progress.next_height, reopened.next_height);
+  ASSERT_EQ(progress.end_height, reopened.end_height);
+  ASSERT_EQ(progress.pruned_txes, reopened.pruned_txes);
+  ASSERT_EQ(progress.pruned_bytes, reopened.pruned_bytes);
+
+  // pop then resume: blocks below the cursor are replaced by ones with more
+  // txes, so the tx ids the job saved no longer line up
+  run_steps(blocks - 50);
+  pop_blocks(blocks - 100);
+  add_blocks(blocks, 5);
+  while (this->m_db->prune_blockchain_step(500));
+  ASSERT_FALSE(this->m_db->get_pruning_progress().active);
+  check_pruned();
+
+  // tip table handoff: the blocks the job left in the tip table get pruned
+  // by update_pruning once they fall out of the tip
+  add_blocks(blocks + 200, 10);
+  ASSERT_TRUE(this->m_db->update_pruning());
+  check_pruned();
+  ASSERT_FALSE(this->m_db->get_prunable_tx_blob(conversions[250], bd));
+  ASSERT_TRUE(this->m_db->get_prunable_tx_blob(conversions[300], bd));
+}
+
+TYPED_TEST(BlockchainDBTest, KeyImageFilter)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // the filter is built in up to four ranges of the last 32 bit word, so
+  // spend key images on both edges and in the middle of each
+  std::vector<crypto::key_image> edges;
+  for (uint64_t range = 0; range < 4; ++range)
+  {
+    const uint64_t lo = (((uint64_t)1) << 32) * range / 4;
+    const uint64_t hi = (((uint64_t)1) << 32) * (range + 1) / 4;
+    for (uint64_t top: {lo, lo + 1, (lo + hi) / 2, hi - 1})
+    {
+      crypto::key_image ki = make_key_image(edges.size());
+      const uint32_t top32 = top;
+      memcpy((char*)&ki + sizeof(ki) - sizeof(top32), &top32, sizeof(top32));
+      edges.push_back(ki);
+    }
+  }
+
+  // more key images than the initial filter holds, all in one batch, so
+  // the filter grows while most of them are not committed yet
+  const size_t per_tx = 1000;
+  const size_t n_key_images = KEY_IMAGE_FILTER_MIN_SIZE + 10 * per_tx;
+  std::vector<crypto::key_image> key_images;
+  for (size_t n = 0; n < n_key_images; ++n)
+    key_images.push_back(make_key_image(edges.size() + n));
+
+  ASSERT_TRUE(this->m_db->batch_start(1 + n_key_images / per_tx));
+  ASSERT_NO_THROW(this->add_test_block({make_test_conversion(edges, 10, 1)}));
+  for (size_t n = 0; n < n_key_images; n += per_tx)
+  {
+    const std::vector<crypto::key_image> spent(key_images.begin() + n, key_images.begin() + std::min(n + per_tx, n_key_images));
+    ASSERT_NO_THROW(this->add_test_block({make_test_conversion(spent, 10, 1)}));
+  }
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+
+  auto check_key_images = [&]() {
+    for (const crypto::key_image &ki: edges)
+      ASSERT_TRUE(this->m_db->has_key_image(ki));
+    for (const crypto::key_image &ki: key_images)
+      ASSERT_TRUE(this->m_db->has_key_image(ki));
+    for (size_t n = 0; n < 1000; ++n)
+      ASSERT_FALSE(this->m_db->has_key_image(make_key_image(edges.size() + n_key_images + n)));
+  };
+  check_key_images();
+
+  // reopening builds the filter from the table again
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  check_key_images();
+}
+
+TYPED_TEST(BlockchainDBTest, CircSupplyIndex)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  // one conversion every 100 blocks, on both sides of the first checkpoint
+  const uint64_t blocks = 1060;
+  auto add_blocks = [this](uint64_t end) {
+    for (uint64_t h = this->m_db->height(); h < end; ++h)
+    {
+      std::vector<std::pair<transaction, blobdata>> txs;
+      if (h % 100 == 50)
+        txs.push_back(make_test_conversion({make_key_image(h)}, h * 10, h));
+      this->add_test_block(txs);
+    }
+  };
+  auto check_range = [this](uint64_t start, uint64_t end) {
+    uint64_t burnt = 0, minted = 0, conversions = 0;
+    for (uint64_t h = start; h < std::min(end, this->m_db->height()); ++h)
+    {
+      if (h % 100 != 50)
+        continue;
+      burnt += h * 10;
+      minted += h;
+      ++conversions;
+    }
+    const circ_supply_delta xhv = this->m_db->get_circulating_supply_delta("XHV", start, end);
+    EXPECT_EQ(xhv.burnt, burnt);
+    EXPECT_EQ(xhv.minted, 0);
+    EXPECT_EQ(xhv.conversions, conversions);
+    const circ_supply_delta xusd = this->m_db->get_circulating_supply_delta("XUSD", start, end);
+    EXPECT_EQ(xusd.burnt, 0);
+    EXPECT_EQ(xusd.minted, minted);
+    EXPECT_EQ(xusd.conversions, conversions);
+  };
+  auto check_ranges = [&check_range]() {
+    check_range(0, blocks);
+    check_range(0, 1000);
+    check_range(1000, blocks);
+    check_range(500, 1020);
+    check_range(123, 456);
+    check_range(0, 10000);
+  };
+
+  ASSERT_TRUE(this->m_db->batch_start(blocks));
+  ASSERT_NO_THROW(add_blocks(blocks));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  ASSERT_EQ(blocks, this->m_db->height());
+  check_ranges();
+
+  std::vector<circ_supply_conversion> conversions = this->m_db->get_circulating_supply_conversions("XHV", "XUSD", 900, 1100, 100);
+  ASSERT_EQ(2, conversions.size());
+  EXPECT_EQ(950, conversions[0].height);
+  EXPECT_EQ(9500, conversions[0].amount_burnt);
+  EXPECT_EQ(950, conversions[0].amount_minted);
+  EXPECT_EQ(1050, conversions[1].height);
+  EXPECT_TRUE(this->m_db->get_circulating_supply_conversions("XUSD", "XHV", 0, blocks, 100).empty());
+  EXPECT_EQ(1, this->m_db->get_circulating_supply_conversions("XHV", "XUSD", 0, blocks, 1).size());
+
+  // popping below the checkpoint removes it, adding the blocks back writes it again
+  while (this->m_db->height() > 990)
+  {
+    block blk;
+    std::vector<transaction> txs;
+    ASSERT_NO_THROW(this->m_db->pop_block(blk, txs));
+  }
+  check_ranges();
+  ASSERT_TRUE(this->m_db->batch_start(blocks - 990));
+  ASSERT_NO_THROW(add_blocks(blocks));
+  ASSERT_NO_THROW(this->m_db->batch_stop());
+  check_ranges();
+
+  // an emptied index is rebuilt on the next read-write open
+  ASSERT_NO_THROW(this->m_db->close());
+  {
+    MDB_env *env;
+    MDB_txn *txn;
+    MDB_dbi dbi;
+    ASSERT_EQ(0, mdb_env_create(&env));
+    ASSERT_EQ(0, mdb_env_set_maxdbs(env, 32));
+    ASSERT_EQ(0, mdb_env_open(env, dirPath.c_str(), 0, 0644));
+    ASSERT_EQ(0, mdb_txn_begin(env, NULL, 0, &txn));
+    ASSERT_EQ(0, mdb_dbi_open(txn, "circ_supply_index", 0, &dbi));
+    ASSERT_EQ(0, mdb_drop(txn, dbi, 0));
+    ASSERT_EQ(0, mdb_txn_commit(txn));
+    mdb_env_close(env);
+  }
+  ASSERT_NO_THROW(this->m_db->open(dirPath, DBF_FAST));
+  check_ranges();
+  ASSERT_EQ(2, this->m_db->get_circulating_supply_conversions("XHV", "XUSD", 900, 1100, 100).size());
+}
+
 TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
 {
   boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
@@ -0,0 +1,117 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <unordered_set>
+#include "crypto/crypto.h"
+#include "crypto/random.h"
+#include "common/bloom_filter.h"
+
+static crypto::key_image random_key_image()
+{
+  crypto::key_image ki;
+  generate_random_bytes_not_thread_safe(sizeof(ki), &ki);
+  return ki;
+}
+
+TEST(bloom_filter, empty_matches_everything)
+{
+  tools::blocked_bloom_filter<crypto::key_image> filter;
+  ASSERT_TRUE(filter.may_contain(random_key_image()));
+  ASSERT_EQ(filter.capacity(), 0u);
+  ASSERT_TRUE(filter.full());
+}
+
+TEST(bloom_filter, no_false_negatives)
+{
+  tools::blocked_bloom_filter<crypto::key_image> filter(1000);
+  std::vector<crypto::key_image> kis;
+  for (size_t n = 0; n < 1000; ++n)
+  {
+    kis.push_back(random_key_image());
+    filter.insert(kis.back());
+  }
+  for (const auto &ki: kis)
+    ASSERT_TRUE(filter.may_contain(ki));
+  ASSERT_EQ(filter.size(), 1000u);
+  ASSERT_FALSE(filter.full());
+}
+
+TEST(bloom_filter, false_positive_rate)
+{
+  tools::blocked_bloom_filter<crypto::key_image> filter(10000);
+  std::unordered_set<crypto::key_image> kis;
+  while (kis.size() < filter.capacity())
+  {
+    const crypto::key_image ki = random_key_image();
+    kis.insert(ki);
+    filter.insert(ki);
+  }
+  ASSERT_TRUE(filter.full());
+  size_t false_positives = 0;
+  for (size_t n = 0; n < 100000; ++n)
+  {
+    const crypto::key_image ki = random_key_image();
+    if (filter.may_contain(ki) && kis.find(ki) == kis.end())
+      ++false_positives;
+  }
+  // ~0.1% expected at 16 bits per element, leave plenty of slack
+  ASSERT_LT(false_positives, 2000u);
+}
+
+TEST(bloom_filter, reset)
+{
+  tools::blocked_bloom_filter<crypto::key_image> filter(16);
+  const crypto::key_image ki = random_key_image();
+  filter.insert(ki);
+  ASSERT_TRUE(filter.may_contain(ki));
+  filter.reset(100);
+  ASSERT_EQ(filter.size(), 0u);
+  ASSERT_GE(filter.capacity(), 100u);
+  size_t matches = 0;
+  for (size_t n = 0; n < 1000; ++n)
+    matches += filter.may_contain(random_key_image());
+  ASSERT_EQ(matches, 0u);
+}
+
+TEST(bloom_filter, merge)
+{
+  tools::blocked_bloom_filter<crypto::key_image> a(1000), b(1000), c(2000);
+  std::vector<crypto::key_image> kis;
+  for (size_t n = 0; n < 1000; ++n)
+  {
+    kis.push_back(random_key_image());
+    (n & 1 ? a : b).insert(kis.back());
+  }
+  ASSERT_TRUE(a.merge(b));
+  ASSERT_EQ(a.size(), 1000u);
+  for (const auto &ki: kis)
+    ASSERT_TRUE(a.may_contain(ki));
+  ASSERT_FALSE(a.merge(c));
+}
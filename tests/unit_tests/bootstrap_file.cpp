@@ -0,0 +1,238 @@
+// Copyright (c) 2018-2021, Haven Protocol
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/tx_pool.h"
+#include "serialization/binary_utils.h"
+#include "blockchain_db/testdb.h"
+#include "blockchain_utilities/bootstrap_file.h"
+
+#define TEST_BOOTSTRAP_BLOCKS 40
+// large enough for the blocks to span several chunks
+#define TEST_BOOTSTRAP_EXTRA_SIZE 50000
+
+namespace
+{
+
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB()
+  {
+    m_open = true;
+    for (uint64_t h = 0; h < TEST_BOOTSTRAP_BLOCKS; ++h)
+    {
+      cryptonote::block b;
+      b.major_version = 1;
+      b.minor_version = 1;
+      b.timestamp = h;
+      b.nonce = h;
+      b.prev_id = h ? cryptonote::get_block_hash(blocks.back()) : crypto::null_hash;
+      b.miner_tx.version = 1;
+      b.miner_tx.unlock_time = h + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+      b.miner_tx.extra.resize(TEST_BOOTSTRAP_EXTRA_SIZE);
+      for (size_t i = 0; i < b.miner_tx.extra.size(); ++i)
+        b.miner_tx.extra[i] = (h * 7 + i * 13) & 0xff;
+      blocks.push_back(b);
+    }
+  }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override { return cryptonote::get_block_hash(blocks[height]); }
+  virtual cryptonote::block get_block_from_height(const uint64_t &height) const override { return blocks[height]; }
+  virtual cryptonote::blobdata get_block_blob(const crypto::hash &h) const override {
+    for (const cryptonote::block &b: blocks)
+      if (cryptonote::get_block_hash(b) == h)
+        return cryptonote::block_to_blob(b);
+    throw cryptonote::BLOCK_DNE("block not found");
+  }
+  virtual size_t get_block_weight(const uint64_t &height) const override { return 1000 + height; }
+  virtual cryptonote::difficulty_type get_block_cumulative_difficulty(const uint64_t &height) const override { return height + 1; }
+  virtual uint64_t get_block_already_generated_coins(const uint64_t &height) const override { return height * 1000000; }
+
+  std::vector<cryptonote::block> blocks;
+};
+
+class bootstrap_file_test: public ::testing::Test
+{
+protected:
+  bootstrap_file_test():
+    txpool(*bc),
+    path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+  {
+  }
+
+  void SetUp() override
+  {
+    bc.reset(new cryptonote::Blockchain(txpool));
+    db = new TestDB();
+    ASSERT_TRUE(bc->init(db, cryptonote::FAKECHAIN, true, &test_options, 0, NULL));
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+  }
+
+  // reads every chunk of the file and checks it holds the expected blocks
+  void check_chunks(const std::vector<bootstrap::chunk_index_entry> &index, uint64_t expected_blocks)
+  {
+    std::ifstream import_file(path.string(), std::ios_base::binary | std::ifstream::in);
+    ASSERT_FALSE(import_file.fail());
+    uint64_t h = 0;
+    for (const bootstrap::chunk_index_entry &entry: index)
+    {
+      ASSERT_EQ(h, entry.first_height);
+      bootstrap::chunk_header header;
+      std::string stored;
+      ASSERT_TRUE(BootstrapFile::read_chunk(import_file, entry, header, stored));
+      std::vector<std::string> blobs;
+      ASSERT_TRUE(BootstrapFile::decode_chunk(header, stored, blobs));
+      ASSERT_EQ(entry.block_count, blobs.size());
+      for (const std::string &blob: blobs)
+      {
+        bootstrap::block_package bp;
+        ASSERT_TRUE(::serialization::parse_binary(blob, bp));
+        ASSERT_EQ(cryptonote::get_block_hash(db->blocks[h]), cryptonote::get_block_hash(bp.block));
+        ASSERT_EQ(db->get_block_weight(h), bp.block_weight);
+        ASSERT_EQ(db->get_block_cumulative_difficulty(h), bp.cumulative_difficulty);
+        ASSERT_EQ(db->get_block_already_generated_coins(h), bp.coins_generated);
+        ASSERT_TRUE(bp.txs.empty());
+        ++h;
+      }
+    }
+    ASSERT_EQ(expected_blocks, h);
+  }
+
+  std::vector<bootstrap::chunk_index_entry> read_index()
+  {
+    std::vector<bootstrap::chunk_index_entry> index;
+    std::ifstream import_file(path.string(), std::ios_base::binary | std::ifstream::in);
+    BootstrapFile bootstrap;
+    EXPECT_TRUE(bootstrap.read_index(import_file, index));
+    return index;
+  }
+
+  const std::pair<uint8_t, uint64_t> hard_forks[2] = {std::make_pair((uint8_t)1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+  const cryptonote::test_options test_options = { hard_forks };
+  std::unique_ptr<cryptonote::Blockchain> bc;
+  cryptonote::tx_memory_pool txpool;
+  TestDB *db;
+  boost::filesystem::path path;
+};
+
+}
+
+TEST_F(bootstrap_file_test, export_and_decode)
+{
+  for (int compression_level: {0, INDEXED_DEFAULT_COMPRESSION_LEVEL})
+  {
+    boost::filesystem::remove(path);
+    BootstrapFile bootstrap;
+    ASSERT_TRUE(bootstrap.store_blockchain_indexed(bc.get(), path, 0, compression_level));
+    ASSERT_TRUE(BootstrapFile::is_indexed(path.string()));
+    ASSERT_EQ(TEST_BOOTSTRAP_BLOCKS, BootstrapFile().count_blocks(path.string()));
+
+    const std::vector<bootstrap::chunk_index_entry> index = read_index();
+    ASSERT_GT(index.size(), 1);
+    check_chunks(index, TEST_BOOTSTRAP_BLOCKS);
+  }
+}
+
+TEST_F(bootstrap_file_test, append)
+{
+  BootstrapFile first;
+  ASSERT_TRUE(first.store_blockchain_indexed(bc.get(), path, TEST_BOOTSTRAP_BLOCKS / 2 - 1, 0));
+  std::vector<bootstrap::chunk_index_entry> index = read_index();
+  check_chunks(index, TEST_BOOTSTRAP_BLOCKS / 2);
+
+  BootstrapFile second;
+  ASSERT_TRUE(second.store_blockchain_indexed(bc.get(), path, 0, 0));
+  index = read_index();
+  check_chunks(index, TEST_BOOTSTRAP_BLOCKS);
+}
+
+TEST_F(bootstrap_file_test, rebuild_index)
+{
+  BootstrapFile bootstrap;
+  ASSERT_TRUE(bootstrap.store_blockchain_indexed(bc.get(), path, 0, 0));
+  const std::vector<bootstrap::chunk_index_entry> index = read_index();
+  ASSERT_GT(index.size(), 1);
+
+  // without a valid footer, the index is rebuilt from the chunk headers
+  const uint64_t file_size = boost::filesystem::file_size(path);
+  boost::filesystem::resize_file(path, file_size - 1);
+  std::vector<bootstrap::chunk_index_entry> rebuilt = read_index();
+  ASSERT_EQ(index.size(), rebuilt.size());
+  for (size_t i = 0; i < index.size(); ++i)
+  {
+    ASSERT_EQ(index[i].first_height, rebuilt[i].first_height);
+    ASSERT_EQ(index[i].offset, rebuilt[i].offset);
+    ASSERT_EQ(index[i].block_count, rebuilt[i].block_count);
+  }
+  check_chunks(rebuilt, TEST_BOOTSTRAP_BLOCKS);
+
+  // a partially written chunk is dropped
+  boost::filesystem::resize_file(path, index.back().offset + 10);
+  rebuilt = read_index();
+  ASSERT_EQ(index.size() - 1, rebuilt.size());
+  check_chunks(rebuilt, index.back().first_height);
+
+  // and appending picks up after the last complete chunk
+  BootstrapFile append;
+  ASSERT_TRUE(append.store_blockchain_indexed(bc.get(), path, 0, 0));
+  check_chunks(read_index(), TEST_BOOTSTRAP_BLOCKS);
+}
+
+TEST_F(bootstrap_file_test, bad_checksum)
+{
+  BootstrapFile bootstrap;
+  ASSERT_TRUE(bootstrap.store_blockchain_indexed(bc.get(), path, 0, 0));
+  const std::vector<bootstrap::chunk_index_entry> index = read_index();
+  ASSERT_FALSE(index.empty());
+
+  std::ifstream import_file(path.string(), std::ios_base::binary | std::ifstream::in);
+  bootstrap::chunk_header header;
+  std::string stored;
+  ASSERT_TRUE(BootstrapFile::read_chunk(import_file, index[0], header, stored));
+  std::vector<std::string> blobs;
+  ASSERT_TRUE(BootstrapFile::decode_chunk(header, stored, blobs));
+
+  stored[stored.size() / 2] ^= 1;
+  ASSERT_FALSE(BootstrapFile::decode_chunk(header, stored, blobs));
+  stored[stored.size() / 2] ^= 1;
+  ++header.checksum;
+  ASSERT_FALSE(BootstrapFile::decode_chunk(header, stored, blobs));
+}
@@ -170,3 +170,25 @@ TEST_F(bootstrap_node_selector, selector_auto_max_nodes)
 
   EXPECT_EQ(unique_nodes.size(), max_nodes);
 }
+
+TEST_F(bootstrap_node_selector, selector_auto_prefers_low_latency)
+{
+  cryptonote::bootstrap_node::selector_auto selector([this]() {
+    return white_nodes;
+  });
+
+  ASSERT_TRUE(selector.next_node()); // fetches the nodes
+  selector.handle_latency("white_node_1:18089", std::chrono::milliseconds(400));
+  EXPECT_EQ(selector.next_node()->address, "white_node_2:18081"); // not measured yet
+
+  selector.handle_latency("white_node_2:18081", std::chrono::milliseconds(50));
+  for (size_t iterations = 0; iterations < 8; ++iterations)
+  {
+    EXPECT_EQ(selector.next_node()->address, "white_node_2:18081");
+  }
+  EXPECT_EQ(selector.next_node("white_node_2:18081")->address, "white_node_1:18089");
+  EXPECT_EQ(selector.get_latency("white_node_2:18081").count(), 50);
+
+  selector.handle_result("white_node_2:18081", false);
+  EXPECT_EQ(selector.next_node()->address, "white_node_1:18089");
+}
@@ -80,6 +80,29 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  const size_t burst_message_count = 300;
+  const size_t burst_message_size = 1000;
+
+  // queues a burst of messages as soon as a client connects
+  struct burst_protocol_handler : test_protocol_handler
+  {
+    burst_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler(psnd_hndlr, config, conn_context), m_psnd_hndlr(psnd_hndlr)
+    {
+    }
+
+    void after_init_connection()
+    {
+      for (size_t i = 0; i < burst_message_count; ++i)
+      {
+        std::string message(burst_message_size, char('a' + i % 26));
+        m_psnd_hndlr->do_send(epee::byte_slice{std::move(message)});
+      }
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+  };
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -132,3 +155,58 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, queued_sends_arrive_in_order)
+{
+  epee::net_utils::boosted_tcp_server<burst_protocol_handler> srv(epee::net_utils::e_connection_type_RPC); // RPC disables network limit for unit tests
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket socket(io_service);
+  socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port));
+
+  std::string received(burst_message_count * burst_message_size, 0);
+  boost::system::error_code ec;
+  boost::asio::read(socket, boost::asio::buffer(&received[0], received.size()), ec);
+  ASSERT_FALSE(ec);
+
+  for (size_t i = 0; i < burst_message_count; ++i)
+    ASSERT_EQ(std::string(burst_message_size, char('a' + i % 26)), received.substr(i * burst_message_size, burst_message_size));
+
+  socket.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
+
+TEST(boosted_tcp_server, sharded_listeners_serve_all_clients)
+{
+  epee::net_utils::boosted_tcp_server<burst_protocol_handler> srv(epee::net_utils::e_connection_type_RPC); // RPC disables network limit for unit tests
+  const bool sharded = srv.set_accept_sharding(true);
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(4, false));
+
+  // connections land on whichever listener the kernel picks, each must be served
+  boost::asio::io_service io_service;
+  std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> sockets;
+  for (size_t i = 0; i < 16; ++i)
+  {
+    sockets.emplace_back(new boost::asio::ip::tcp::socket(io_service));
+    sockets.back()->connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port));
+  }
+
+  for (auto &socket: sockets)
+  {
+    std::string received(burst_message_count * burst_message_size, 0);
+    boost::system::error_code ec;
+    boost::asio::read(*socket, boost::asio::buffer(&received[0], received.size()), ec);
+    ASSERT_FALSE(ec) << "sharded: " << sharded;
+    ASSERT_EQ(std::string(burst_message_size, 'a'), received.substr(0, burst_message_size));
+    socket->close();
+  }
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
@@ -747,3 +747,60 @@ TEST(get_tx_asset_types, fail_on_1_unknown_asset_type)
     std::string dest;
     EXPECT_FALSE(get_tx_asset_types(tx, tx.hash, source, dest, false));
 }
+
+// decoded asset info
+TEST(get_tx_asset_info, offshore)
+{
+    cryptonote::transaction tx;
+    tx.version = 7;
+    tx.pricing_record_height = 1000;
+    tx.amount_burnt = 5;
+    tx.amount_minted = 7;
+    tx.collateral_indices = {0, 1};
+    tx.rct_signatures.txnFee = 3;
+    tx.rct_signatures.txnOffshoreFee = 2;
+
+    cryptonote::txin_to_key xhv_key;
+    tx.vin.push_back(xhv_key);
+
+    cryptonote::tx_out out;
+    out.target = cryptonote::txout_to_key();
+    tx.vout.push_back(out);
+    cryptonote::tx_out out1;
+    out1.target = cryptonote::txout_offshore();
+    tx.vout.push_back(out1);
+
+    cryptonote::tx_asset_info info;
+    EXPECT_TRUE(get_tx_asset_info(tx, tx.hash, info));
+
+    EXPECT_EQ(info.type, cryptonote::transaction_type::OFFSHORE);
+    EXPECT_STREQ(get_tx_type_name(info.type), "offshore");
+    EXPECT_EQ(info.source_asset_type, "XHV");
+    EXPECT_EQ(info.dest_asset_type, "XUSD");
+    EXPECT_EQ(info.pricing_record_height, 1000);
+    EXPECT_EQ(info.amount_burnt, 5);
+    EXPECT_EQ(info.amount_minted, 7);
+    EXPECT_EQ(info.fee, 3);
+    EXPECT_EQ(info.conversion_fee, 2);
+    EXPECT_EQ(info.collateral_indices, std::vector<uint32_t>({0, 1}));
+}
+TEST(get_tx_asset_info, fail_on_invalid_conversion)
+{
+    cryptonote::transaction tx;
+    tx.version = 7;
+
+    cryptonote::txin_to_key xhv_key;
+    tx.vin.push_back(xhv_key);
+
+    cryptonote::tx_out out;
+    out.target = cryptonote::txout_to_key();
+    tx.vout.push_back(out);
+    cryptonote::txout_xasset out_xasset;
+    out_xasset.asset_type = "XBTC";
+    cryptonote::tx_out out1;
+    out1.target = out_xasset;
+    tx.vout.push_back(out1);
+
+    cryptonote::tx_asset_info info;
+    EXPECT_FALSE(get_tx_asset_info(tx, tx.hash, info));
+}
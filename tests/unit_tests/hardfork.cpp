@@ -605,3 +605,58 @@ TEST(get, earliest_ideal_height)
     ASSERT_EQ(hf.get_earliest_ideal_height_for_version(10), std::numeric_limits<uint64_t>::max());
 }
 
+
+TEST(follow, matches_rescan)
+{
+  // window size 4, default threshold 50%, same forks as voting.info
+  auto setup = [](HardFork &hf) {
+    ASSERT_TRUE(hf.add_fork(1, 0,  0));
+    ASSERT_TRUE(hf.add_fork(2, 5,    0,  1));
+    ASSERT_TRUE(hf.add_fork(3, 10, 100,  2));
+    ASSERT_TRUE(hf.add_fork(4, 15,  3));
+    hf.init();
+  };
+
+  TestDB db;
+  HardFork writer(db, 1, 0, 1, 1, 4, 50);
+  HardFork follower(db, 1, 0, 1, 1, 4, 50);
+  setup(writer);
+
+  //                                          0  1  2  3  4  5  6  7  8  9  0  1  2  3  4  5  6  7  8  9
+  static const uint8_t block_versions[]   = { 1, 1, 1, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4 };
+  // the writer adds blocks in uneven steps, the follower catches up after each
+  static const uint64_t steps[] = { 1, 3, 1, 6, 2, 7 };
+
+  uint64_t h = 0;
+  for (uint64_t step: steps) {
+    const uint64_t follow_height = db.height();
+    for (uint64_t i = 0; i < step; ++i, ++h) {
+      db.add_block(mkblock(writer, h, block_versions[h]), 0, 0, 0, 0, 0, crypto::hash());
+      ASSERT_TRUE(writer.add(db.get_block_from_height(h), h));
+    }
+    if (follow_height == 0)
+      setup(follower);
+    else
+      ASSERT_TRUE(follower.follow_from_chain_height(follow_height));
+
+    HardFork rescan(db, 1, 0, 1, 1, 4, 50);
+    setup(rescan);
+
+    ASSERT_EQ(follower.get_current_version(), rescan.get_current_version());
+    ASSERT_EQ(follower.get_ideal_version(), rescan.get_ideal_version());
+    ASSERT_EQ(follower.get_current_version(), writer.get_current_version());
+    for (uint8_t v = 1; v <= 4; ++v) {
+      uint32_t window, votes, threshold, rescan_window, rescan_votes, rescan_threshold;
+      uint64_t earliest_height, rescan_earliest_height;
+      uint8_t voting, rescan_voting;
+      ASSERT_EQ(follower.get_voting_info(v, window, votes, threshold, earliest_height, voting),
+          rescan.get_voting_info(v, rescan_window, rescan_votes, rescan_threshold, rescan_earliest_height, rescan_voting));
+      ASSERT_EQ(window, rescan_window);
+      ASSERT_EQ(votes, rescan_votes);
+      ASSERT_EQ(threshold, rescan_threshold);
+      ASSERT_EQ(earliest_height, rescan_earliest_height);
+      ASSERT_EQ(voting, rescan_voting);
+    }
+  }
+  ASSERT_EQ(h, sizeof(block_versions) / sizeof(block_versions[0]));
+}
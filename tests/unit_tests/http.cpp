@@ -28,6 +28,7 @@
 
 #include "gtest/gtest.h"
 #include "net/http_auth.h"
+#include "net/http_protocol_handler.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -743,3 +744,118 @@ TEST(HTTP, Add_Field)
 
   EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+namespace
+{
+  struct dummy_service_endpoint final : epee::net_utils::i_service_endpoint
+  {
+    size_t sent = 0;
+
+    virtual bool do_send(epee::byte_slice message) override { ++sent; return true; }
+    virtual bool close() override { return true; }
+    virtual bool send_done() override { return true; }
+    virtual bool call_run_once_service_io() override { return false; }
+    virtual bool request_callback() override { return false; }
+    virtual boost::asio::io_service& get_io_service() override { return io_service; }
+    virtual bool add_ref() override { return true; }
+    virtual bool release() override { return true; }
+
+    boost::asio::io_service io_service;
+  };
+
+  struct recording_http_handler final : http::simple_http_connection_handler<epee::net_utils::connection_context_base>
+  {
+    recording_http_handler(epee::net_utils::i_service_endpoint* endpoint, http::http_server_config& config, epee::net_utils::connection_context_base& context)
+      : http::simple_http_connection_handler<epee::net_utils::connection_context_base>(endpoint, config, context)
+    {}
+
+    virtual bool handle_request(const http::http_request_info& query_info, http::http_response_info& response) override
+    {
+      requests.push_back(query_info);
+      response.m_response_code = 200;
+      response.m_response_comment = "OK";
+      return true;
+    }
+
+    std::vector<http::http_request_info> requests;
+  };
+
+  const std::string pipelined_requests =
+    "\r\nPOST /json_rpc HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "content-length:4\r\n"
+    "X-Folded: first\r\n"
+    "\tsecond\r\n"
+    "\r\n"
+    "abcd"
+    "get /get_height HTTP/1.0\n"
+    "Origin:  http://localhost \n"
+    "\n";
+
+  void check_pipelined_requests(const std::vector<http::http_request_info>& requests)
+  {
+    ASSERT_EQ(2u, requests.size());
+    EXPECT_EQ(http::http_method_post, requests[0].m_http_method);
+    EXPECT_EQ("/json_rpc", requests[0].m_URI);
+    EXPECT_EQ(1, requests[0].m_http_ver_hi);
+    EXPECT_EQ(1, requests[0].m_http_ver_lo);
+    EXPECT_EQ("127.0.0.1", requests[0].m_header_info.m_host);
+    EXPECT_EQ("4", requests[0].m_header_info.m_content_length);
+    ASSERT_EQ(1u, requests[0].m_header_info.m_etc_fields.size());
+    EXPECT_EQ("X-Folded", requests[0].m_header_info.m_etc_fields.front().first);
+    EXPECT_EQ("first second", requests[0].m_header_info.m_etc_fields.front().second);
+    EXPECT_EQ("abcd", requests[0].m_body);
+
+    EXPECT_EQ(http::http_method_get, requests[1].m_http_method);
+    EXPECT_EQ("get", requests[1].m_http_method_str);
+    EXPECT_EQ("/get_height", requests[1].m_URI);
+    EXPECT_EQ(0, requests[1].m_http_ver_lo);
+    EXPECT_EQ("http://localhost", requests[1].m_header_info.m_origin);
+    EXPECT_TRUE(requests[1].m_body.empty());
+  }
+}
+
+TEST(HTTP, Server_Pipelined_Requests)
+{
+  dummy_service_endpoint endpoint;
+  http::http_server_config config;
+  epee::net_utils::connection_context_base context;
+  recording_http_handler handler(&endpoint, config, context);
+
+  EXPECT_TRUE(handler.handle_recv(pipelined_requests.data(), pipelined_requests.size()));
+  check_pipelined_requests(handler.requests);
+  EXPECT_EQ(2u, endpoint.sent);
+}
+
+TEST(HTTP, Server_Requests_Byte_By_Byte)
+{
+  dummy_service_endpoint endpoint;
+  http::http_server_config config;
+  epee::net_utils::connection_context_base context;
+  recording_http_handler handler(&endpoint, config, context);
+
+  for (char c: pipelined_requests)
+    ASSERT_TRUE(handler.handle_recv(&c, 1));
+  check_pipelined_requests(handler.requests);
+}
+
+TEST(HTTP, Server_Bad_Request_Line)
+{
+  static const char* const bad_lines[] = {
+    "FETCH / HTTP/1.1\r\n\r\n",
+    "GET /\r\n\r\n",
+    "GET  / HTTP/1.1\r\n\r\n",
+    "GET / HTTP/1.x\r\n\r\n",
+    "GET / HTTP/1.1 trailing\r\n\r\n",
+  };
+  for (const char* line: bad_lines)
+  {
+    dummy_service_endpoint endpoint;
+    http::http_server_config config;
+    epee::net_utils::connection_context_base context;
+    recording_http_handler handler(&endpoint, config, context);
+
+    EXPECT_FALSE(handler.handle_recv(line, strlen(line))) << line;
+    EXPECT_TRUE(handler.requests.empty()) << line;
+  }
+}
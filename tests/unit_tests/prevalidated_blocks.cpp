@@ -0,0 +1,244 @@
+// Copyright (c) 2018-2021, Haven Protocol
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/tx_pool.h"
+#include "blockchain_db/testdb.h"
+
+// two hashes of hashes, so the chain starting at height 1 gets them loaded
+#define TEST_PREVALIDATED_BLOCKS (2 * HASH_OF_HASHES_STEP)
+
+namespace
+{
+
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  struct block_t
+  {
+    cryptonote::block bl;
+    size_t weight;
+    uint64_t coins_generated;
+  };
+
+  TestDB(const cryptonote::block &genesis, size_t weight)
+  {
+    m_open = true;
+    blocks.push_back({genesis, weight, 0});
+  }
+
+  virtual void add_block( const cryptonote::block& blk
+                        , size_t block_weight
+                        , uint64_t long_term_block_weight
+                        , const cryptonote::difficulty_type& cumulative_difficulty
+                        , const uint64_t& coins_generated
+                        , uint64_t num_rct_outs
+                        , offshore::asset_type_counts& cum_rct_by_asset_type
+                        , const crypto::hash& blk_hash
+                        ) override {
+    blocks.push_back({blk, block_weight, coins_generated});
+  }
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override { return cryptonote::get_block_hash(blocks[height].bl); }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    if (block_height)
+      *block_height = blocks.size() - 1;
+    return cryptonote::get_block_hash(blocks.back().bl);
+  }
+  virtual cryptonote::block get_block_from_height(const uint64_t &height) const override { return blocks[height].bl; }
+  virtual size_t get_block_weight(const uint64_t &height) const override { return blocks[height].weight; }
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const override {
+    std::vector<uint64_t> ret;
+    while (count-- && start_height < blocks.size()) ret.push_back(blocks[start_height++].weight);
+    return ret;
+  }
+  virtual uint64_t get_block_already_generated_coins(const uint64_t &height) const override { return blocks[height].coins_generated; }
+
+  std::vector<block_t> blocks;
+};
+
+uint64_t test_reward(uint64_t height)
+{
+  return 1000000 + height * 7;
+}
+
+class prevalidated_blocks_test: public ::testing::Test
+{
+protected:
+  prevalidated_blocks_test(): txpool(*bc) {}
+
+  void SetUp() override
+  {
+    crypto::public_key key;
+    crypto::secret_key sec;
+    crypto::generate_keys(key, sec);
+    for (uint64_t h = 0; h < TEST_PREVALIDATED_BLOCKS; ++h)
+    {
+      cryptonote::block b;
+      b.major_version = 1;
+      b.minor_version = 1;
+      b.timestamp = h;
+      b.prev_id = h ? chain.back().id : crypto::null_hash;
+      b.miner_tx.version = 1;
+      b.miner_tx.unlock_time = h + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{h});
+      b.miner_tx.vout.push_back({test_reward(h), cryptonote::txout_to_key(key)});
+      cryptonote::Blockchain::prevalidated_block pb;
+      pb.bl = b;
+      pb.id = cryptonote::get_block_hash(b);
+      pb.block_weight = 1000 + h;
+      chain.push_back(pb);
+    }
+
+    // the precompiled data: a block count, then a hash of the block hashes
+    // and one of the block weights for every HASH_OF_HASHES_STEP blocks
+    const uint32_t nblocks = TEST_PREVALIDATED_BLOCKS / HASH_OF_HASHES_STEP;
+    for (int i = 0; i < 4; ++i)
+      block_hashes.push_back((nblocks >> (i * 8)) & 0xff);
+    for (uint32_t n = 0; n < nblocks; ++n)
+    {
+      std::vector<crypto::hash> hashes;
+      std::vector<uint64_t> weights;
+      for (uint64_t h = n * HASH_OF_HASHES_STEP; h < (n + 1) * HASH_OF_HASHES_STEP; ++h)
+      {
+        hashes.push_back(chain[h].id);
+        weights.push_back(chain[h].block_weight);
+      }
+      crypto::hash hash;
+      crypto::cn_fast_hash(hashes.data(), hashes.size() * sizeof(crypto::hash), hash);
+      block_hashes.append(hash.data, sizeof(hash.data));
+      crypto::cn_fast_hash(weights.data(), weights.size() * sizeof(uint64_t), hash);
+      block_hashes.append(hash.data, sizeof(hash.data));
+    }
+
+    bc.reset(new cryptonote::Blockchain(txpool));
+    db = new TestDB(chain.front().bl, chain.front().block_weight);
+    const std::string &data = block_hashes;
+    ASSERT_TRUE(bc->init(db, cryptonote::FAKECHAIN, true, &test_options, 1,
+        [&data](cryptonote::network_type) { return epee::strspan<unsigned char>(data); }));
+
+    std::vector<crypto::hash> hashes;
+    std::vector<uint64_t> weights;
+    for (size_t h = 1; h < chain.size(); ++h)
+    {
+      hashes.push_back(chain[h].id);
+      weights.push_back(chain[h].block_weight);
+    }
+    bc->prevalidate_block_hashes(1, hashes, weights);
+  }
+
+  std::vector<cryptonote::Blockchain::prevalidated_block> blocks_to_add() const
+  {
+    return std::vector<cryptonote::Blockchain::prevalidated_block>(chain.begin() + 1, chain.end());
+  }
+
+  const std::pair<uint8_t, uint64_t> hard_forks[2] = {std::make_pair((uint8_t)1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+  const cryptonote::test_options test_options = { hard_forks };
+  std::unique_ptr<cryptonote::Blockchain> bc;
+  cryptonote::tx_memory_pool txpool;
+  TestDB *db;
+  std::vector<cryptonote::Blockchain::prevalidated_block> chain;
+  std::string block_hashes;
+};
+
+}
+
+#if defined(PER_BLOCK_CHECKPOINT)
+
+TEST_F(prevalidated_blocks_test, adds_matching_blocks)
+{
+  size_t added = 0;
+  ASSERT_TRUE(bc->add_prevalidated_blocks(blocks_to_add(), added));
+  ASSERT_EQ(chain.size() - 1, added);
+  ASSERT_EQ(chain.size(), db->height());
+
+  // the generated coins come from the miner tx, there are no fees to take off
+  uint64_t coins = 0;
+  for (size_t h = 1; h < chain.size(); ++h)
+  {
+    ASSERT_EQ(chain[h].id, cryptonote::get_block_hash(db->blocks[h].bl));
+    ASSERT_EQ(chain[h].block_weight, db->blocks[h].weight);
+    coins += test_reward(h);
+    ASSERT_EQ(coins, db->blocks[h].coins_generated);
+  }
+}
+
+TEST_F(prevalidated_blocks_test, rejects_hash_mismatch)
+{
+  std::vector<cryptonote::Blockchain::prevalidated_block> blocks = blocks_to_add();
+  cryptonote::Blockchain::prevalidated_block &pb = blocks[10];
+  pb.bl.nonce ^= 1;
+  pb.id = cryptonote::get_block_hash(pb.bl);
+
+  size_t added = 0;
+  ASSERT_FALSE(bc->add_prevalidated_blocks(blocks, added));
+  ASSERT_EQ(10u, added);
+  ASSERT_EQ(11u, db->height());
+}
+
+TEST_F(prevalidated_blocks_test, rejects_weight_mismatch)
+{
+  std::vector<cryptonote::Blockchain::prevalidated_block> blocks = blocks_to_add();
+  blocks[20].block_weight += 1;
+
+  size_t added = 0;
+  ASSERT_FALSE(bc->add_prevalidated_blocks(blocks, added));
+  ASSERT_EQ(20u, added);
+  ASSERT_EQ(21u, db->height());
+}
+
+TEST_F(prevalidated_blocks_test, stops_past_known_hashes)
+{
+  // before prevalidate_block_hashes no block has a known hash to check against
+  bc.reset(new cryptonote::Blockchain(txpool));
+  db = new TestDB(chain.front().bl, chain.front().block_weight);
+  const std::string &data = block_hashes;
+  ASSERT_TRUE(bc->init(db, cryptonote::FAKECHAIN, true, &test_options, 1,
+      [&data](cryptonote::network_type) { return epee::strspan<unsigned char>(data); }));
+
+  size_t added = 0;
+  ASSERT_TRUE(bc->add_prevalidated_blocks(blocks_to_add(), added));
+  ASSERT_EQ(0u, added);
+  ASSERT_EQ(1u, db->height());
+}
+
+#else
+
+TEST_F(prevalidated_blocks_test, nothing_added_without_precompiled_hashes)
+{
+  size_t added = 0;
+  ASSERT_TRUE(bc->add_prevalidated_blocks(blocks_to_add(), added));
+  ASSERT_EQ(0u, added);
+  ASSERT_EQ(1u, db->height());
+}
+
+#endif
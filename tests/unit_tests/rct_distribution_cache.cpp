@@ -0,0 +1,246 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+#include "net/abstract_http_client.h"
+#include "storages/portable_storage_template_helper.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "wallet/wallet2.h"
+
+class wallet_accessor_test
+{
+public:
+  static bool get_rct_distribution(tools::wallet2 &wallet, uint64_t &start_height, std::vector<uint64_t> &distribution)
+  {
+    uint64_t num_spendable_global_outs;
+    return wallet.get_rct_distribution(false, "XHV", start_height, distribution, num_spendable_global_outs);
+  }
+  static void detach_blockchain(tools::wallet2 &wallet, uint64_t wallet_height, uint64_t height)
+  {
+    while (wallet.m_blockchain.size() < wallet_height)
+      wallet.m_blockchain.push_back(crypto::null_hash);
+    wallet.detach_blockchain(height);
+  }
+  static bool clear(tools::wallet2 &wallet)
+  {
+    return wallet.clear();
+  }
+};
+
+namespace
+{
+  // the cumulative rct output distribution of a chain, and the from_height of every request made for it
+  struct fake_daemon
+  {
+    std::vector<uint64_t> cumulative;
+    std::vector<uint64_t> requests;
+
+    void add_blocks(size_t count, uint64_t outputs_per_block)
+    {
+      for (size_t i = 0; i < count; ++i)
+        cumulative.push_back((cumulative.empty() ? 0 : cumulative.back()) + outputs_per_block);
+    }
+    void pop_blocks(size_t count)
+    {
+      cumulative.resize(cumulative.size() - count);
+    }
+  };
+
+  class fake_daemon_client: public epee::net_utils::http::abstract_http_client
+  {
+  public:
+    fake_daemon_client(const std::shared_ptr<fake_daemon> &daemon): m_daemon(daemon) {}
+
+    void set_server(std::string host, std::string port, boost::optional<epee::net_utils::http::login> user, epee::net_utils::ssl_options_t ssl_options) override {}
+    void set_auto_connect(bool auto_connect) override {}
+    bool connect(std::chrono::milliseconds timeout) override { return true; }
+    bool disconnect() override { return true; }
+    bool is_connected(bool *ssl) override { return true; }
+    bool invoke_get(const boost::string_ref uri, std::chrono::milliseconds timeout, const std::string& body, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      return invoke(uri, "GET", body, timeout, ppresponse_info, additional_params);
+    }
+    bool invoke_post(const boost::string_ref uri, const std::string& body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      return invoke(uri, "POST", body, timeout, ppresponse_info, additional_params);
+    }
+    uint64_t get_bytes_sent() const override { return 0; }
+    uint64_t get_bytes_received() const override { return 0; }
+
+    bool invoke(const boost::string_ref uri, const boost::string_ref method, const std::string& body, std::chrono::milliseconds timeout, const epee::net_utils::http::http_response_info** ppresponse_info, const epee::net_utils::http::fields_list& additional_params) override
+    {
+      m_response.clear();
+      m_response.m_response_code = 200;
+      if (uri == "/json_rpc")
+        m_response.m_body = "{\"jsonrpc\": \"2.0\", \"id\": \"0\", \"result\": {\"status\": \"OK\", \"untrusted\": false, \"release\": true, \"version\": " + std::to_string(CORE_RPC_VERSION) + "}}";
+      else if (uri == "/get_output_distribution.bin")
+        m_response.m_body = get_output_distribution(body);
+      else
+        m_response.m_response_code = 404;
+      if (ppresponse_info)
+        *ppresponse_info = &m_response;
+      return true;
+    }
+
+  private:
+    std::string get_output_distribution(const std::string &body)
+    {
+      cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::request req;
+      cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::response res;
+      if (!epee::serialization::load_t_from_binary(req, body))
+        return std::string();
+      m_daemon->requests.push_back(req.from_height);
+      if (req.from_height >= m_daemon->cumulative.size())
+      {
+        res.status = "Failed to get output distribution";
+      }
+      else
+      {
+        cryptonote::COMMAND_RPC_GET_OUTPUT_DISTRIBUTION::distribution d;
+        d.amount = 0;
+        d.binary = req.binary;
+        d.compress = req.compress;
+        d.data.start_height = req.from_height;
+        d.data.distribution.assign(m_daemon->cumulative.begin() + req.from_height, m_daemon->cumulative.end());
+        d.data.base = 0;
+        d.data.num_spendable_global_outs = m_daemon->cumulative.back();
+        res.distributions.push_back(std::move(d));
+        res.status = CORE_RPC_STATUS_OK;
+      }
+      std::string response;
+      epee::serialization::store_t_to_binary(res, response);
+      return response;
+    }
+
+    std::shared_ptr<fake_daemon> m_daemon;
+    epee::net_utils::http::http_response_info m_response;
+  };
+
+  class fake_daemon_client_factory: public epee::net_utils::http::http_client_factory
+  {
+  public:
+    fake_daemon_client_factory(const std::shared_ptr<fake_daemon> &daemon): m_daemon(daemon) {}
+    std::unique_ptr<epee::net_utils::http::abstract_http_client> create() override
+    {
+      return std::unique_ptr<epee::net_utils::http::abstract_http_client>(new fake_daemon_client(m_daemon));
+    }
+
+  private:
+    std::shared_ptr<fake_daemon> m_daemon;
+  };
+
+  // the number of blocks the wallet asks for again to detect reorgs
+  const size_t overlap = 2 * CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+
+  class rct_distribution_cache: public ::testing::Test
+  {
+  protected:
+    rct_distribution_cache():
+      daemon(std::make_shared<fake_daemon>()),
+      wallet(cryptonote::MAINNET, 1, true, std::unique_ptr<epee::net_utils::http::http_client_factory>(new fake_daemon_client_factory(daemon)))
+    {
+      daemon->add_blocks(3 * overlap, 2);
+    }
+
+    void check_distribution()
+    {
+      uint64_t start_height = 0;
+      std::vector<uint64_t> distribution;
+      ASSERT_TRUE(wallet_accessor_test::get_rct_distribution(wallet, start_height, distribution));
+      ASSERT_EQ(0, start_height);
+      ASSERT_EQ(daemon->cumulative, distribution);
+    }
+
+    std::shared_ptr<fake_daemon> daemon;
+    tools::wallet2 wallet;
+  };
+}
+
+TEST_F(rct_distribution_cache, first_request_is_in_full)
+{
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0}), daemon->requests);
+}
+
+TEST_F(rct_distribution_cache, extends_past_overlap)
+{
+  check_distribution();
+  const uint64_t height = daemon->cumulative.size();
+  daemon->add_blocks(overlap + 5, 3);
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, height - overlap}), daemon->requests);
+
+  // nothing new, the overlap alone is asked for again
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, height - overlap, daemon->cumulative.size() - overlap}), daemon->requests);
+}
+
+TEST_F(rct_distribution_cache, refetches_after_reorg_within_overlap)
+{
+  check_distribution();
+  const uint64_t height = daemon->cumulative.size();
+  daemon->pop_blocks(overlap / 2);
+  daemon->add_blocks(overlap / 2 + 2, 5);
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, height - overlap, 0}), daemon->requests);
+}
+
+TEST_F(rct_distribution_cache, refetches_when_daemon_is_behind)
+{
+  check_distribution();
+  const uint64_t height = daemon->cumulative.size();
+  daemon->pop_blocks(overlap + 1);
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, height - overlap, 0}), daemon->requests);
+}
+
+TEST_F(rct_distribution_cache, detach_truncates)
+{
+  check_distribution();
+  const uint64_t height = daemon->cumulative.size();
+
+  // a reorg deeper than the overlap, which only the wallet's own detach can tell
+  const uint64_t split_height = height - 2 * overlap;
+  wallet_accessor_test::detach_blockchain(wallet, height, split_height);
+  daemon->pop_blocks(height - split_height);
+  daemon->add_blocks(height - split_height + 1, 7);
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, split_height - overlap}), daemon->requests);
+}
+
+TEST_F(rct_distribution_cache, clear)
+{
+  check_distribution();
+  ASSERT_TRUE(wallet_accessor_test::clear(wallet));
+  check_distribution();
+  ASSERT_EQ(std::vector<uint64_t>({0, 0}), daemon->requests);
+}
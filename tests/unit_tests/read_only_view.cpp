@@ -0,0 +1,185 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/tx_pool.h"
+#include "blockchain_db/testdb.h"
+
+class blockchain_accessor_test
+{
+public:
+  static void dirty_caches(cryptonote::Blockchain &bc)
+  {
+    bc.m_timestamps_and_difficulties_height = bc.m_db->height();
+    bc.m_reset_timestamps_and_difficulties_height = false;
+    bc.m_btc_valid = true;
+  }
+  static bool caches_reset(const cryptonote::Blockchain &bc)
+  {
+    return bc.m_timestamps_and_difficulties_height == 0 && bc.m_reset_timestamps_and_difficulties_height && !bc.m_btc_valid;
+  }
+  static uint64_t followed_height(const cryptonote::Blockchain &bc) { return bc.m_followed_height; }
+  static crypto::hash followed_top_hash(const cryptonote::Blockchain &bc) { return bc.m_followed_top_hash; }
+};
+
+namespace
+{
+
+// the version the test hard forks give a block at a height
+uint8_t test_version(uint64_t height)
+{
+  return height >= 3 ? 2 : 1;
+}
+
+// a db another process writes to: the test swaps its blocks under the follower
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB() { m_open = true; }
+
+  virtual uint64_t height() const override { return blocks.size(); }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override { return cryptonote::get_block_hash(blocks[height]); }
+  virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+    if (block_height)
+      *block_height = blocks.size() - 1;
+    return cryptonote::get_block_hash(blocks.back());
+  }
+  virtual cryptonote::block get_block_from_height(const uint64_t &height) const override {
+    lowest_block_read = std::min(lowest_block_read, height);
+    return blocks[height];
+  }
+  virtual uint8_t get_hard_fork_version(uint64_t height) const override { return blocks[height].major_version; }
+  virtual std::vector<uint64_t> get_block_weights(uint64_t start_height, size_t count) const override {
+    std::vector<uint64_t> ret;
+    while (count-- && start_height++ < blocks.size()) ret.push_back(1000);
+    return ret;
+  }
+
+  // builds the chain up to the given height, keeping the blocks below from_height and
+  // replacing the ones above with blocks from a different branch
+  void set_chain(uint64_t height, uint64_t from_height, uint32_t branch)
+  {
+    blocks.resize(std::min<uint64_t>(blocks.size(), from_height));
+    while (blocks.size() < height)
+    {
+      cryptonote::block b;
+      b.major_version = b.minor_version = test_version(blocks.size());
+      b.timestamp = blocks.size();
+      b.nonce = blocks.size() ? branch : 0;
+      b.prev_id = blocks.empty() ? crypto::null_hash : cryptonote::get_block_hash(blocks.back());
+      b.miner_tx.version = 1;
+      b.miner_tx.vin.push_back(cryptonote::txin_gen{blocks.size()});
+      blocks.push_back(b);
+    }
+    lowest_block_read = std::numeric_limits<uint64_t>::max();
+  }
+
+  std::vector<cryptonote::block> blocks;
+  mutable uint64_t lowest_block_read;
+};
+
+class read_only_view: public ::testing::Test
+{
+protected:
+  read_only_view(): txpool(*bc) {}
+
+  void SetUp() override
+  {
+    bc.reset(new cryptonote::Blockchain(txpool));
+    db = new TestDB();
+    db->set_chain(2, 0, 0);
+    ASSERT_TRUE(bc->init(db, cryptonote::FAKECHAIN, true, &test_options, 1, NULL));
+    ASSERT_TRUE(bc->refresh_read_only_view());
+    ASSERT_EQ(2, blockchain_accessor_test::followed_height(*bc));
+    ASSERT_EQ(1, bc->get_current_hard_fork_version());
+  }
+
+  const std::pair<uint8_t, uint64_t> hard_forks[3] = {std::make_pair((uint8_t)1, (uint64_t)0), std::make_pair((uint8_t)2, (uint64_t)3), std::make_pair((uint8_t)0, (uint64_t)0)};
+  const cryptonote::test_options test_options = { hard_forks };
+  std::unique_ptr<cryptonote::Blockchain> bc;
+  cryptonote::tx_memory_pool txpool;
+  TestDB *db;
+};
+
+}
+
+TEST_F(read_only_view, unchanged_top)
+{
+  blockchain_accessor_test::dirty_caches(*bc);
+  ASSERT_FALSE(bc->refresh_read_only_view());
+  ASSERT_FALSE(blockchain_accessor_test::caches_reset(*bc));
+}
+
+TEST_F(read_only_view, follows_extension)
+{
+  db->set_chain(5, 2, 0);
+  blockchain_accessor_test::dirty_caches(*bc);
+  ASSERT_TRUE(bc->refresh_read_only_view());
+
+  // only the new blocks are scanned
+  ASSERT_EQ(2, db->lowest_block_read);
+  ASSERT_TRUE(blockchain_accessor_test::caches_reset(*bc));
+  ASSERT_EQ(5, blockchain_accessor_test::followed_height(*bc));
+  ASSERT_EQ(db->top_block_hash(), blockchain_accessor_test::followed_top_hash(*bc));
+  ASSERT_EQ(2, bc->get_current_hard_fork_version());
+}
+
+TEST_F(read_only_view, rescans_after_reorg)
+{
+  // the block below the followed top is replaced, the chain is longer
+  db->set_chain(4, 1, 1);
+  blockchain_accessor_test::dirty_caches(*bc);
+  ASSERT_TRUE(bc->refresh_read_only_view());
+
+  // the hard fork state is rebuilt from the start of its window
+  ASSERT_EQ(0, db->lowest_block_read);
+  ASSERT_TRUE(blockchain_accessor_test::caches_reset(*bc));
+  ASSERT_EQ(4, blockchain_accessor_test::followed_height(*bc));
+  ASSERT_EQ(db->top_block_hash(), blockchain_accessor_test::followed_top_hash(*bc));
+  ASSERT_EQ(2, bc->get_current_hard_fork_version());
+}
+
+TEST_F(read_only_view, rescans_after_rollback)
+{
+  db->set_chain(5, 2, 0);
+  ASSERT_TRUE(bc->refresh_read_only_view());
+  ASSERT_EQ(2, bc->get_current_hard_fork_version());
+
+  // the writer popped blocks back below the fork, which only a full rescan can undo
+  db->set_chain(2, 1, 2);
+  blockchain_accessor_test::dirty_caches(*bc);
+  ASSERT_TRUE(bc->refresh_read_only_view());
+
+  ASSERT_TRUE(blockchain_accessor_test::caches_reset(*bc));
+  ASSERT_EQ(2, blockchain_accessor_test::followed_height(*bc));
+  ASSERT_EQ(1, bc->get_current_hard_fork_version());
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <boost/filesystem.hpp>
+#include "crypto/crypto.h"
+#include "cryptonote_config.h"
+#include "rpc/rpc_payment.h"
+
+namespace
+{
+  struct rpc_payment_dir
+  {
+    rpc_payment_dir(): path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()) {}
+    ~rpc_payment_dir() { boost::system::error_code ec; boost::filesystem::remove_all(path, ec); }
+    boost::filesystem::path path;
+  };
+
+  crypto::public_key make_client()
+  {
+    crypto::public_key pkey;
+    crypto::secret_key skey;
+    crypto::generate_keys(pkey, skey);
+    return pkey;
+  }
+}
+
+TEST(rpc_payment, ledger_restores_balances_without_store)
+{
+  rpc_payment_dir dir;
+  const crypto::public_key client0 = make_client(), client1 = make_client();
+  {
+    cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+    ASSERT_TRUE(payment.load(dir.path.string()));
+    payment.balance(client0, 500);
+    payment.balance(client1, 70);
+    uint64_t credits;
+    ASSERT_TRUE(payment.pay(client0, 1, 200, "test", false, credits));
+    ASSERT_EQ(credits, 300);
+    ASSERT_TRUE(payment.on_idle());
+  }
+  EXPECT_FALSE(boost::filesystem::exists(dir.path / RPC_PAYMENTS_DATA_FILENAME));
+
+  cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+  ASSERT_TRUE(payment.load(dir.path.string()));
+  EXPECT_EQ(payment.balance(client0), 300);
+  EXPECT_EQ(payment.balance(client1), 70);
+
+  // the replayed request timestamp still rejects a replayed payment
+  uint64_t credits;
+  EXPECT_FALSE(payment.pay(client0, 1, 200, "test", false, credits));
+  EXPECT_EQ(payment.balance(client0), 300);
+}
+
+TEST(rpc_payment, store_starts_a_new_ledger)
+{
+  rpc_payment_dir dir;
+  const crypto::public_key client = make_client();
+  {
+    cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+    ASSERT_TRUE(payment.load(dir.path.string()));
+    payment.balance(client, 500);
+    ASSERT_TRUE(payment.store());
+    EXPECT_EQ(boost::filesystem::file_size(dir.path / RPC_PAYMENTS_LEDGER_FILENAME), 0);
+    payment.balance(client, -100);
+  }
+
+  cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+  ASSERT_TRUE(payment.load(dir.path.string()));
+  EXPECT_EQ(payment.balance(client), 400);
+  size_t clients = 0;
+  payment.foreach([&](const crypto::public_key&, const cryptonote::rpc_payment::client_info&){ ++clients; return true; });
+  EXPECT_EQ(clients, 1);
+}
+
+TEST(rpc_payment, ledger_does_not_restore_flushed_clients)
+{
+  rpc_payment_dir dir;
+  const crypto::public_key client = make_client();
+  {
+    cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+    ASSERT_TRUE(payment.load(dir.path.string()));
+    payment.balance(client, 500);
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    ASSERT_EQ(payment.flush_by_age(1), 1);
+    ASSERT_TRUE(payment.on_idle());
+  }
+
+  cryptonote::rpc_payment payment(cryptonote::account_public_address{}, 1000, 100);
+  ASSERT_TRUE(payment.load(dir.path.string()));
+  size_t clients = 0;
+  payment.foreach([&](const crypto::public_key&, const cryptonote::rpc_payment::client_info&){ ++clients; return true; });
+  EXPECT_EQ(clients, 0);
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include <boost/thread/thread.hpp>
+#include "rpc/rpc_request_scheduler.h"
+
+using cryptonote::rpc_request_scheduler;
+
+TEST(rpc_request_scheduler, light_is_unlimited)
+{
+  rpc_request_scheduler scheduler;
+  std::vector<rpc_request_scheduler::slot> slots;
+  for (int i = 0; i < 64; ++i)
+  {
+    slots.push_back(scheduler.acquire(rpc_request_scheduler::cost_light, "client"));
+    ASSERT_TRUE(bool(slots.back()));
+  }
+  EXPECT_EQ(scheduler.get_stats(rpc_request_scheduler::cost_light).running, 64);
+  slots.clear();
+  EXPECT_EQ(scheduler.get_stats(rpc_request_scheduler::cost_light).running, 0);
+  EXPECT_EQ(scheduler.get_stats(rpc_request_scheduler::cost_light).served, 64);
+}
+
+TEST(rpc_request_scheduler, rejects_when_queue_is_full)
+{
+  rpc_request_scheduler scheduler;
+  scheduler.configure(rpc_request_scheduler::cost_heavy, 1, 0, 10, 1000);
+  rpc_request_scheduler::slot first = scheduler.acquire(rpc_request_scheduler::cost_heavy, "a");
+  ASSERT_TRUE(bool(first));
+  EXPECT_FALSE(bool(scheduler.acquire(rpc_request_scheduler::cost_heavy, "b")));
+  EXPECT_EQ(scheduler.get_stats(rpc_request_scheduler::cost_heavy).rejected, 1);
+  first = rpc_request_scheduler::slot();
+  EXPECT_TRUE(bool(scheduler.acquire(rpc_request_scheduler::cost_heavy, "b")));
+}
+
+TEST(rpc_request_scheduler, per_client_cap)
+{
+  rpc_request_scheduler scheduler;
+  scheduler.configure(rpc_request_scheduler::cost_heavy, 4, 4, 2, 1000);
+  rpc_request_scheduler::slot a1 = scheduler.acquire(rpc_request_scheduler::cost_heavy, "a");
+  rpc_request_scheduler::slot a2 = scheduler.acquire(rpc_request_scheduler::cost_heavy, "a");
+  ASSERT_TRUE(bool(a1));
+  ASSERT_TRUE(bool(a2));
+  EXPECT_FALSE(bool(scheduler.acquire(rpc_request_scheduler::cost_heavy, "a")));
+  EXPECT_TRUE(bool(scheduler.acquire(rpc_request_scheduler::cost_heavy, "b")));
+}
+
+TEST(rpc_request_scheduler, queued_request_runs_after_release)
+{
+  rpc_request_scheduler scheduler;
+  scheduler.configure(rpc_request_scheduler::cost_heavy, 1, 1, 10, 10000);
+  rpc_request_scheduler::slot first = scheduler.acquire(rpc_request_scheduler::cost_heavy, "a");
+  ASSERT_TRUE(bool(first));
+
+  bool granted = false;
+  boost::thread waiter([&](){
+    rpc_request_scheduler::slot s = scheduler.acquire(rpc_request_scheduler::cost_heavy, "b");
+    granted = bool(s);
+  });
+  while (scheduler.get_stats(rpc_request_scheduler::cost_heavy).queued == 0)
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+  // running and queued slots are both taken
+  EXPECT_FALSE(bool(scheduler.acquire(rpc_request_scheduler::cost_heavy, "c")));
+  first = rpc_request_scheduler::slot();
+  waiter.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(scheduler.get_stats(rpc_request_scheduler::cost_heavy).served, 2);
+}
+
+TEST(rpc_request_scheduler, queue_timeout)
+{
+  rpc_request_scheduler scheduler;
+  scheduler.configure(rpc_request_scheduler::cost_admin, 1, 1, 10, 50);
+  rpc_request_scheduler::slot first = scheduler.acquire(rpc_request_scheduler::cost_admin, "a");
+  ASSERT_TRUE(bool(first));
+  EXPECT_FALSE(bool(scheduler.acquire(rpc_request_scheduler::cost_admin, "b")));
+  const rpc_request_scheduler::class_stats stats = scheduler.get_stats(rpc_request_scheduler::cost_admin);
+  EXPECT_EQ(stats.timed_out, 1);
+  EXPECT_EQ(stats.queued, 0);
+  EXPECT_EQ(stats.running, 1);
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "misc_os_dependent.h"
+#include "crypto/crypto.h"
+#include "rpc/rpc_response_cache.h"
+
+using cryptonote::rpc_response_cache;
+
+namespace
+{
+  const char get_info_request[] = "{\"jsonrpc\": \"2.0\", \"id\": 1, \"method\": \"get_info\"}";
+
+  rpc_response_cache::response make_response(const std::string &body)
+  {
+    rpc_response_cache::response res;
+    res.body = body;
+    res.mime_type = "application/json";
+    res.content_type = "application/json";
+    return res;
+  }
+
+  std::string get_info_response(const std::string &id, const std::string &status)
+  {
+    // the id is deliberately not the first field
+    return "{\n  \"jsonrpc\": \"2.0\",\n  \"result\": {\n    \"height\": 12,\n    \"id\": 7,\n    \"status\": \"" + status + "\"\n  },\n  \"id\": " + id + "\n}";
+  }
+}
+
+TEST(rpc_response_cache, request_key)
+{
+  std::string key, id_json;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", get_info_request, key, id_json));
+  EXPECT_EQ(id_json, "1");
+  std::string other_key;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", "{\"jsonrpc\": \"2.0\", \"id\": \"x\", \"method\": \"get_info\"}", other_key, id_json));
+  EXPECT_EQ(id_json, "\"x\"");
+  EXPECT_EQ(key, other_key);
+
+  EXPECT_FALSE(rpc_response_cache::get_request_key("/json_rpc", "{\"jsonrpc\": \"2.0\", \"id\": 1, \"method\": \"get_block\"}", key, id_json));
+  EXPECT_FALSE(rpc_response_cache::get_request_key("/json_rpc", "{\"jsonrpc\": \"2.0\", \"id\": {}, \"method\": \"get_info\"}", key, id_json));
+  EXPECT_FALSE(rpc_response_cache::get_request_key("/get_transactions", "{}", key, id_json));
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/get_info", "", key, id_json));
+  EXPECT_TRUE(id_json.empty());
+}
+
+TEST(rpc_response_cache, hit)
+{
+  rpc_response_cache cache;
+  const crypto::hash top = crypto::rand<crypto::hash>();
+  std::string key, id_json;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", get_info_request, key, id_json));
+  rpc_response_cache::response res;
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+  ASSERT_TRUE(cache.put(top, 1, key, id_json, make_response(get_info_response("1", "OK"))));
+
+  ASSERT_TRUE(cache.get(top, 1, key, id_json, res));
+  EXPECT_EQ(res.body, get_info_response("1", "OK"));
+  EXPECT_EQ(res.content_type, "application/json");
+
+  // another caller gets its own id back, and the id inside the result is left alone
+  ASSERT_TRUE(cache.get(top, 1, key, "\"abc\"", res));
+  EXPECT_EQ(res.body, get_info_response("\"abc\"", "OK"));
+}
+
+TEST(rpc_response_cache, miss)
+{
+  rpc_response_cache cache;
+  const crypto::hash top = crypto::rand<crypto::hash>();
+  std::string key, id_json;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", get_info_request, key, id_json));
+  rpc_response_cache::response res;
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+  ASSERT_TRUE(cache.put(top, 1, key, id_json, make_response(get_info_response("1", "OK"))));
+
+  std::string other_key;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", "{\"jsonrpc\": \"2.0\", \"id\": 1, \"method\": \"get_block_header_by_height\", \"params\": {\"height\": 3}}", other_key, id_json));
+  EXPECT_FALSE(cache.get(top, 1, other_key, id_json, res));
+
+  // expired entries are not served
+  rpc_response_cache short_lived(16, 0);
+  EXPECT_FALSE(short_lived.get(top, 1, key, "1", res));
+  ASSERT_TRUE(short_lived.put(top, 1, key, "1", make_response(get_info_response("1", "OK"))));
+  const uint64_t start = epee::misc_utils::get_tick_count();
+  while (epee::misc_utils::get_tick_count() == start)
+    ;
+  EXPECT_FALSE(short_lived.get(top, 1, key, "1", res));
+}
+
+TEST(rpc_response_cache, new_top_or_pool_drops_entries)
+{
+  rpc_response_cache cache;
+  const crypto::hash top = crypto::rand<crypto::hash>(), new_top = crypto::rand<crypto::hash>();
+  std::string key, id_json;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", get_info_request, key, id_json));
+  rpc_response_cache::response res;
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+  ASSERT_TRUE(cache.put(top, 1, key, id_json, make_response(get_info_response("1", "OK"))));
+
+  EXPECT_FALSE(cache.get(new_top, 1, key, id_json, res));
+  // an answer computed for the old tip is not stored once the tip moved
+  EXPECT_FALSE(cache.put(top, 1, key, id_json, make_response(get_info_response("1", "OK"))));
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+
+  EXPECT_FALSE(cache.get(top, 2, key, id_json, res));
+  ASSERT_TRUE(cache.put(top, 2, key, id_json, make_response(get_info_response("1", "OK"))));
+  EXPECT_TRUE(cache.get(top, 2, key, id_json, res));
+  EXPECT_FALSE(cache.get(top, 3, key, id_json, res));
+}
+
+TEST(rpc_response_cache, only_ok_responses_are_stored)
+{
+  rpc_response_cache cache;
+  const crypto::hash top = crypto::rand<crypto::hash>();
+  std::string key, id_json;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/json_rpc", get_info_request, key, id_json));
+  rpc_response_cache::response res;
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+
+  EXPECT_FALSE(cache.put(top, 1, key, id_json, make_response(get_info_response("1", "BUSY"))));
+  EXPECT_FALSE(cache.put(top, 1, key, id_json, make_response("{\"error\": {\"code\": -1, \"message\": \"\\\"status\\\": \\\"OK\\\"\"}, \"id\": 1, \"jsonrpc\": \"2.0\"}")));
+  EXPECT_FALSE(cache.put(top, 1, key, id_json, make_response("not json")));
+  // the id of the answer must be the one of the request that filled it
+  EXPECT_FALSE(cache.put(top, 1, key, id_json, make_response(get_info_response("12", "OK"))));
+  EXPECT_FALSE(cache.get(top, 1, key, id_json, res));
+
+  std::string get_info_key;
+  ASSERT_TRUE(rpc_response_cache::get_request_key("/get_info", "", get_info_key, id_json));
+  EXPECT_FALSE(cache.put(top, 1, get_info_key, id_json, make_response("{\"height\": 12, \"status\": \"Failed\"}")));
+  ASSERT_TRUE(cache.put(top, 1, get_info_key, id_json, make_response("{\"height\": 12, \"status\": \"OK\"}")));
+  ASSERT_TRUE(cache.get(top, 1, get_info_key, id_json, res));
+  EXPECT_EQ(res.body, "{\"height\": 12, \"status\": \"OK\"}");
+}
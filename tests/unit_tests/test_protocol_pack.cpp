@@ -34,6 +34,70 @@
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "storages/portable_storage_template_helper.h"
 
+namespace
+{
+  struct pack_inner
+  {
+    uint64_t height;
+    std::string hash;
+    std::vector<uint32_t> indices;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE(indices)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct pack_outer
+  {
+    bool flag;
+    double ratio;
+    int16_t small;
+    std::string name;
+    crypto::hash id;
+    std::vector<crypto::hash> ids;
+    std::vector<std::string> names;
+    std::vector<uint64_t> empty;
+    pack_inner inner;
+    std::list<pack_inner> entries;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(ratio)
+      KV_SERIALIZE(small)
+      KV_SERIALIZE(name)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(id)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(ids)
+      KV_SERIALIZE(names)
+      KV_SERIALIZE(empty)
+      KV_SERIALIZE(inner)
+      KV_SERIALIZE(entries)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct pack_duplicate
+  {
+    uint64_t first;
+    uint64_t second;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_N(first, "value")
+      KV_SERIALIZE_N(second, "value")
+    END_KV_SERIALIZE_MAP()
+  };
+
+  std::string loaded_as_json(const std::string& blob)
+  {
+    epee::serialization::portable_storage ps;
+    if (!ps.load_from_binary(blob))
+      return {};
+    std::string json;
+    ps.dump_as_json(json);
+    return json;
+  }
+}
+
 TEST(protocol_pack, protocol_pack_command) 
 {
   std::string buff;
@@ -54,3 +118,80 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+TEST(protocol_pack, streamed_binary_matches_storage)
+{
+  pack_outer o;
+  o.flag = true;
+  o.ratio = 0.25;
+  o.small = -7;
+  o.name = "haven";
+  o.id = crypto::hash{};
+  o.id.data[0] = 1;
+  o.ids.resize(3, o.id);
+  o.names = {"a", "", std::string(300, 'x')};
+  o.inner.height = 42;
+  o.inner.hash = "inner";
+  o.inner.indices = {1, 2, 3};
+  for (uint64_t i = 0; i < 100; ++i)
+  {
+    pack_inner e;
+    e.height = i;
+    e.hash = std::to_string(i);
+    e.indices.assign(i % 4, uint32_t(i));
+    o.entries.push_back(e);
+  }
+
+  std::string streamed;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(o, streamed));
+
+  epee::serialization::portable_storage ps;
+  o.store(ps);
+  std::string tree;
+  ASSERT_TRUE(ps.store_to_binary(tree));
+
+  EXPECT_EQ(loaded_as_json(tree), loaded_as_json(streamed));
+  EXPECT_FALSE(loaded_as_json(streamed).empty());
+  // entries in name order and minimal varint counts, like the tree storage writes them
+  EXPECT_EQ(streamed, tree);
+
+  pack_outer o2;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(o2, streamed));
+  EXPECT_EQ(o2.name, o.name);
+  EXPECT_EQ(o2.small, o.small);
+  EXPECT_EQ(o2.ids.size(), 3u);
+  EXPECT_EQ(o2.names.back(), o.names.back());
+  EXPECT_EQ(o2.inner.indices, o.inner.indices);
+  ASSERT_EQ(o2.entries.size(), 100u);
+  EXPECT_EQ(o2.entries.back().indices.size(), 3u);
+}
+
+TEST(protocol_pack, streamed_binary_falls_back_on_duplicate_names)
+{
+  pack_duplicate d;
+  d.first = 1;
+  d.second = 2;
+
+  std::string blob;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(d, blob));
+
+  pack_duplicate d2;
+  d2.first = d2.second = 0;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(d2, blob));
+  EXPECT_EQ(d2.first, 2);
+  EXPECT_EQ(d2.second, 2);
+}
+
+TEST(protocol_pack, streamed_binary_rejects_closed_section_handle)
+{
+  std::string blob;
+  epee::serialization::portable_storage_binary_writer writer(blob);
+  auto first = writer.open_section("first", nullptr, true);
+  ASSERT_TRUE(bool(first));
+  ASSERT_TRUE(writer.set_value("a", uint64_t(1), first));
+  // opening a sibling closes "first", and the new section takes its place on the stack
+  auto second = writer.open_section("second", nullptr, true);
+  ASSERT_TRUE(bool(second));
+  EXPECT_FALSE(writer.set_value("b", uint64_t(2), first));
+  EXPECT_FALSE(writer.finish());
+}
@@ -0,0 +1,231 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/filesystem.hpp>
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/testdb.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/txpool_store.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  crypto::hash make_txid(uint8_t n)
+  {
+    crypto::hash txid = crypto::null_hash;
+    txid.data[0] = n;
+    return txid;
+  }
+
+  txpool_tx_meta_t make_meta(uint64_t fee, relay_method method)
+  {
+    txpool_tx_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.fee = fee;
+    meta.set_relay_method(method);
+    return meta;
+  }
+
+  crypto::key_image make_key_image(uint8_t n)
+  {
+    crypto::key_image ki;
+    memset(&ki, 0, sizeof(ki));
+    ki.data[0] = n;
+    return ki;
+  }
+
+  // the prefix of a tx spending the given key image, as much as tx_memory_pool::init parses
+  cryptonote::blobdata make_tx_blob(const crypto::key_image &ki)
+  {
+    transaction_prefix tx;
+    tx.version = 1;
+    tx.vin.push_back(txin_to_key{1, {0}, ki});
+    tx.vout.push_back({1, txout_to_key(crypto::public_key())});
+    return t_serializable_object_to_blob(tx);
+  }
+
+  // a chain of one block, with some mined txes and spent key images
+  class TxpoolTestDB: public BaseTestDB
+  {
+  public:
+    TxpoolTestDB()
+    {
+      m_open = true;
+      genesis.major_version = 1;
+      genesis.minor_version = 1;
+      genesis.miner_tx.version = 1;
+      genesis.miner_tx.vin.push_back(txin_gen{0});
+    }
+
+    virtual uint64_t height() const override { return 1; }
+    virtual crypto::hash get_block_hash_from_height(const uint64_t &height) const override { return get_block_hash(genesis); }
+    virtual crypto::hash top_block_hash(uint64_t *block_height = NULL) const override {
+      if (block_height)
+        *block_height = 0;
+      return get_block_hash(genesis);
+    }
+    virtual block get_block_from_height(const uint64_t &height) const override { return genesis; }
+    virtual bool tx_exists(const crypto::hash& h) const override { return mined.count(h); }
+    virtual bool has_key_image(const crypto::key_image& img) const override { return spent.count(img); }
+
+    block genesis;
+    std::unordered_set<crypto::hash> mined;
+    std::unordered_set<crypto::key_image> spent;
+  };
+}
+
+TEST(txpool_store, add_get_remove)
+{
+  BaseTestDB db;
+  txpool_store store;
+  ASSERT_TRUE(store.init("", db));
+
+  store.add_tx(make_txid(1), "blob1", make_meta(10, relay_method::fluff));
+  store.add_tx(make_txid(2), "blob2", make_meta(20, relay_method::local));
+  ASSERT_THROW(store.add_tx(make_txid(1), "blob1", make_meta(10, relay_method::fluff)), DB_ERROR);
+
+  ASSERT_EQ(2, store.get_tx_count(relay_category::all));
+  ASSERT_EQ(1, store.get_tx_count(relay_category::broadcasted));
+  ASSERT_TRUE(store.has_tx(make_txid(2), relay_category::all));
+  ASSERT_FALSE(store.has_tx(make_txid(2), relay_category::broadcasted));
+
+  cryptonote::blobdata bd;
+  ASSERT_TRUE(store.get_tx_blob(make_txid(2), bd, relay_category::all));
+  ASSERT_EQ("blob2", bd);
+  ASSERT_FALSE(store.get_tx_blob(make_txid(2), bd, relay_category::broadcasted));
+
+  txpool_tx_meta_t meta;
+  store.update_tx(make_txid(1), make_meta(11, relay_method::fluff));
+  ASSERT_TRUE(store.get_tx_meta(make_txid(1), meta));
+  ASSERT_EQ(11, meta.fee);
+
+  store.remove_tx(make_txid(1));
+  ASSERT_FALSE(store.get_tx_meta(make_txid(1), meta));
+  ASSERT_EQ("blob2", store.get_tx_blob(make_txid(2), relay_category::all));
+  ASSERT_THROW(store.update_tx(make_txid(1), meta), DB_ERROR);
+}
+
+TEST(txpool_store, txn_abort)
+{
+  BaseTestDB db;
+  txpool_store store;
+  ASSERT_TRUE(store.init("", db));
+  store.add_tx(make_txid(1), "blob1", make_meta(10, relay_method::fluff));
+
+  {
+    txpool_store::txn lock(store);
+    store.remove_tx(make_txid(1));
+    store.add_tx(make_txid(2), "blob2", make_meta(20, relay_method::fluff));
+    {
+      // nested groups fold into the outer one
+      txpool_store::txn nested(store);
+      store.add_tx(make_txid(3), "blob3", make_meta(30, relay_method::fluff));
+      nested.commit();
+    }
+  }
+  ASSERT_EQ(1, store.get_tx_count(relay_category::all));
+  ASSERT_EQ("blob1", store.get_tx_blob(make_txid(1), relay_category::all));
+
+  {
+    txpool_store::txn lock(store);
+    store.add_tx(make_txid(2), "blob2", make_meta(20, relay_method::fluff));
+    lock.commit();
+  }
+  ASSERT_EQ(2, store.get_tx_count(relay_category::all));
+}
+
+TEST(txpool_store, snapshot)
+{
+  const boost::filesystem::path filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  BaseTestDB db;
+  {
+    txpool_store store;
+    ASSERT_TRUE(store.init(filename.string(), db));
+    for (uint8_t n = 0; n < 10; ++n)
+      store.add_tx(make_txid(n), std::string(n, 'x'), make_meta(n, relay_method::fluff));
+    store.remove_tx(make_txid(4));
+    ASSERT_TRUE(store.store());
+  }
+
+  txpool_store store;
+  ASSERT_TRUE(store.init(filename.string(), db));
+  boost::filesystem::remove(filename);
+  ASSERT_EQ(9, store.get_tx_count(relay_category::all));
+  size_t seen = 0;
+  ASSERT_TRUE(store.for_all_txes([&seen](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+    const uint8_t n = txid.data[0];
+    EXPECT_EQ(n, meta.fee);
+    EXPECT_EQ(std::string(n, 'x'), *bd);
+    ++seen;
+    return true;
+  }, true, relay_category::all));
+  ASSERT_EQ(9, seen);
+}
+
+TEST(txpool_store, init_drops_stale_snapshot_txes)
+{
+  const boost::filesystem::path filename = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  {
+    BaseTestDB db;
+    txpool_store store;
+    ASSERT_TRUE(store.init(filename.string(), db));
+    for (uint8_t n = 1; n <= 3; ++n)
+    {
+      txpool_tx_meta_t meta = make_meta(n, relay_method::fluff);
+      meta.weight = 100;
+      store.add_tx(make_txid(n), make_tx_blob(make_key_image(n)), meta);
+    }
+    ASSERT_TRUE(store.store());
+  }
+
+  // blocks stored after the snapshot mined tx 1 and spent the key image of tx 2
+  std::unique_ptr<Blockchain> bc;
+  tx_memory_pool txpool(*bc);
+  bc.reset(new Blockchain(txpool));
+  TxpoolTestDB *db = new TxpoolTestDB();
+  db->mined.insert(make_txid(1));
+  db->spent.insert(make_key_image(2));
+  const std::pair<uint8_t, uint64_t> hard_forks[2] = {std::make_pair((uint8_t)1, (uint64_t)0), std::make_pair((uint8_t)0, (uint64_t)0)};
+  const test_options options = { hard_forks };
+  ASSERT_TRUE(bc->init(db, FAKECHAIN, true, &options, 1, NULL));
+  ASSERT_TRUE(bc->init_txpool_store(filename.string()));
+  boost::filesystem::remove(filename);
+  ASSERT_EQ(3, bc->get_txpool_tx_count(true));
+
+  ASSERT_TRUE(txpool.init(0, false));
+  ASSERT_EQ(1, bc->get_txpool_tx_count(true));
+  ASSERT_FALSE(bc->txpool_has_tx(make_txid(1), relay_category::all));
+  ASSERT_FALSE(bc->txpool_has_tx(make_txid(2), relay_category::all));
+  ASSERT_TRUE(bc->txpool_has_tx(make_txid(3), relay_category::all));
+  ASSERT_EQ(100, txpool.get_txpool_weight());
+}
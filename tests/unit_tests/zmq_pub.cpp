@@ -0,0 +1,216 @@
+// Copyright (c) 2018-2021, Haven Protocol
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <gtest/gtest.h>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "blockchain_db/testdb.h"
+#include "rpc/zmq_pub.h"
+#include "storages/portable_storage_template_helper.h"
+#include "string_tools.h"
+
+using cryptonote::listener::block_disconnect_event;
+using cryptonote::listener::block_supply_event;
+using cryptonote::listener::zmq_pub;
+
+namespace
+{
+  class TestDB: public cryptonote::BaseTestDB
+  {
+  public:
+    TestDB(uint64_t height): m_height(height) {}
+
+    virtual uint64_t height() const override { return m_height; }
+    virtual uint64_t get_block_already_generated_coins(const uint64_t& height) const override { return (height + 1) * 1000; }
+    virtual std::vector<std::pair<std::string, std::string>> get_circulating_supply() const override
+    {
+      return {{"XHV", "340282366920938463463374607431768211455"}, {"XUSD", "12"}};
+    }
+
+  private:
+    uint64_t m_height;
+  };
+
+  cryptonote::transaction make_conversion(const cryptonote::txin_v &in, const cryptonote::txout_target_v &change, const cryptonote::txout_target_v &converted, uint64_t burnt, uint64_t minted)
+  {
+    cryptonote::transaction tx;
+    tx.version = OFFSHORE_TRANSACTION_VERSION;
+    tx.vin.push_back(in);
+    tx.vout.push_back({0, change});
+    tx.vout.push_back({0, converted});
+    tx.amount_burnt = burnt;
+    tx.amount_minted = minted;
+    return tx;
+  }
+
+  cryptonote::transaction make_offshore(uint64_t burnt, uint64_t minted)
+  {
+    return make_conversion(cryptonote::txin_to_key{}, cryptonote::txout_to_key{}, cryptonote::txout_offshore{}, burnt, minted);
+  }
+
+  cryptonote::transaction make_xasset(const std::string &asset, uint64_t burnt, uint64_t minted)
+  {
+    return make_conversion(cryptonote::txin_offshore{}, cryptonote::txout_offshore{}, cryptonote::txout_xasset{crypto::public_key{}, asset}, burnt, minted);
+  }
+
+  cryptonote::block make_block()
+  {
+    cryptonote::block bl;
+    bl.major_version = 5;
+    bl.timestamp = 1600000000;
+    bl.pricing_record.xUSD = 123456789;
+    bl.pricing_record.timestamp = 1599999990;
+    return bl;
+  }
+
+  std::vector<cryptonote::transaction> make_txs()
+  {
+    std::vector<cryptonote::transaction> txs;
+    txs.push_back(make_offshore(100, 7));
+    txs.push_back(make_xasset("XEUR", 50, 40));
+    txs.push_back(make_offshore(200, 14));
+    // a plain transfer is not a conversion
+    cryptonote::transaction transfer = make_offshore(0, 0);
+    transfer.vout.pop_back();
+    txs.push_back(transfer);
+    return txs;
+  }
+}
+
+TEST(zmq_pub, block_event)
+{
+  const TestDB db(11);
+  const crypto::hash id = crypto::cn_fast_hash("block", 5);
+  const block_supply_event event = zmq_pub::make_event(db, 10, id, make_block(), make_txs());
+
+  EXPECT_EQ(event.height, 10);
+  EXPECT_EQ(event.hash, epee::string_tools::pod_to_hex(id));
+  EXPECT_EQ(event.timestamp, 1600000000);
+  EXPECT_EQ(event.major_version, 5);
+  EXPECT_EQ(event.pricing_record.xUSD, 123456789);
+  EXPECT_EQ(event.pricing_record.timestamp, 1599999990);
+  EXPECT_EQ(event.emission, 1000);
+
+  // listed in ASSET_TYPES order
+  ASSERT_EQ(event.supply_deltas.size(), 3);
+  EXPECT_EQ(event.supply_deltas[0].asset_type, "XHV");
+  EXPECT_EQ(event.supply_deltas[0].amount_burnt, 300);
+  EXPECT_EQ(event.supply_deltas[0].amount_minted, 0);
+  EXPECT_EQ(event.supply_deltas[1].asset_type, "XEUR");
+  EXPECT_EQ(event.supply_deltas[1].amount_burnt, 0);
+  EXPECT_EQ(event.supply_deltas[1].amount_minted, 40);
+  EXPECT_EQ(event.supply_deltas[2].asset_type, "XUSD");
+  EXPECT_EQ(event.supply_deltas[2].amount_burnt, 50);
+  EXPECT_EQ(event.supply_deltas[2].amount_minted, 21);
+
+  ASSERT_EQ(event.conversions.size(), 2);
+  EXPECT_EQ(event.conversions[0].source_asset_type, "XHV");
+  EXPECT_EQ(event.conversions[0].dest_asset_type, "XUSD");
+  EXPECT_EQ(event.conversions[0].count, 2);
+  EXPECT_EQ(event.conversions[0].amount_burnt, 300);
+  EXPECT_EQ(event.conversions[0].amount_minted, 21);
+  EXPECT_EQ(event.conversions[1].source_asset_type, "XUSD");
+  EXPECT_EQ(event.conversions[1].dest_asset_type, "XEUR");
+  EXPECT_EQ(event.conversions[1].count, 1);
+
+  ASSERT_EQ(event.circulating_supply.size(), 2);
+  EXPECT_EQ(event.circulating_supply[0].asset_type, "XHV");
+  EXPECT_EQ(event.circulating_supply[0].amount, "340282366920938463463374607431768211455");
+  EXPECT_EQ(event.circulating_supply[1].asset_type, "XUSD");
+  EXPECT_EQ(event.circulating_supply[1].amount, "12");
+}
+
+TEST(zmq_pub, block_event_below_tip_has_no_supply)
+{
+  const TestDB db(12);
+  const block_supply_event event = zmq_pub::make_event(db, 10, crypto::null_hash, make_block(), {});
+  EXPECT_TRUE(event.supply_deltas.empty());
+  EXPECT_TRUE(event.conversions.empty());
+  EXPECT_TRUE(event.circulating_supply.empty());
+}
+
+TEST(zmq_pub, block_event_payloads)
+{
+  const TestDB db(11);
+  const block_supply_event event = zmq_pub::make_event(db, 10, crypto::cn_fast_hash("block", 5), make_block(), make_txs());
+
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(event, json, 0, false));
+  EXPECT_NE(json.find("\"amount\": \"340282366920938463463374607431768211455\""), std::string::npos);
+  std::string binary;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(event, binary));
+
+  for (int i = 0; i < 2; ++i)
+  {
+    block_supply_event loaded{};
+    ASSERT_TRUE(i == 0 ? epee::serialization::load_t_from_json(loaded, json) : epee::serialization::load_t_from_binary(loaded, binary));
+    EXPECT_EQ(loaded.height, event.height);
+    EXPECT_EQ(loaded.hash, event.hash);
+    EXPECT_EQ(loaded.timestamp, event.timestamp);
+    EXPECT_EQ(loaded.major_version, event.major_version);
+    EXPECT_EQ(loaded.pricing_record.xUSD, event.pricing_record.xUSD);
+    EXPECT_EQ(loaded.emission, event.emission);
+    ASSERT_EQ(loaded.supply_deltas.size(), event.supply_deltas.size());
+    for (size_t n = 0; n < loaded.supply_deltas.size(); ++n)
+    {
+      EXPECT_EQ(loaded.supply_deltas[n].asset_type, event.supply_deltas[n].asset_type);
+      EXPECT_EQ(loaded.supply_deltas[n].amount_minted, event.supply_deltas[n].amount_minted);
+      EXPECT_EQ(loaded.supply_deltas[n].amount_burnt, event.supply_deltas[n].amount_burnt);
+    }
+    ASSERT_EQ(loaded.conversions.size(), event.conversions.size());
+    for (size_t n = 0; n < loaded.conversions.size(); ++n)
+    {
+      EXPECT_EQ(loaded.conversions[n].source_asset_type, event.conversions[n].source_asset_type);
+      EXPECT_EQ(loaded.conversions[n].dest_asset_type, event.conversions[n].dest_asset_type);
+      EXPECT_EQ(loaded.conversions[n].count, event.conversions[n].count);
+    }
+    ASSERT_EQ(loaded.circulating_supply.size(), event.circulating_supply.size());
+    EXPECT_EQ(loaded.circulating_supply[0].amount, event.circulating_supply[0].amount);
+  }
+}
+
+TEST(zmq_pub, disconnect_event_payloads)
+{
+  const block_disconnect_event event{10, epee::string_tools::pod_to_hex(crypto::cn_fast_hash("block", 5))};
+
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(event, json, 0, false));
+  EXPECT_NE(json.find("\"hash\": \"" + event.hash + "\""), std::string::npos);
+  EXPECT_NE(json.find("\"height\": 10"), std::string::npos);
+
+  std::string binary;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(event, binary));
+
+  for (int i = 0; i < 2; ++i)
+  {
+    block_disconnect_event loaded{};
+    ASSERT_TRUE(i == 0 ? epee::serialization::load_t_from_json(loaded, json) : epee::serialization::load_t_from_binary(loaded, binary));
+    EXPECT_EQ(loaded.height, 10);
+    EXPECT_EQ(loaded.hash, event.hash);
+  }
+}